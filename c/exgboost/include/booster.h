@@ -2,6 +2,9 @@
 #define EXGBOOST_BOOSTER_H
 
 #include "utils.h"
+#include "collective.h"
+#include "cpu_budget.h"
+#include "cancel.h"
 
 ERL_NIF_TERM EXGBoosterCreate(ErlNifEnv *env, int argc,
                               const ERL_NIF_TERM argv[]);
@@ -19,6 +22,12 @@ ERL_NIF_TERM EXGBoosterBoostOneIter(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterEvalOneIter(ErlNifEnv *env, int argc,
                                    const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGBoosterTrain(ErlNifEnv *env, int argc,
+                             const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGBoosterEval(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGBoosterEvalHistory(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterGetAttrNames(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterGetAttr(ErlNifEnv *env, int argc,
@@ -33,6 +42,12 @@ ERL_NIF_TERM EXGBoosterFeatureScore(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterPredictFromDMatrix(ErlNifEnv *env, int argc,
                                           const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGBoosterPredictChunked(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGBoosterPredictMargin(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterPredictFromDense(ErlNifEnv *env, int argc,
                                         const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterPredictFromCSR(ErlNifEnv *env, int argc,
@@ -45,8 +60,18 @@ ERL_NIF_TERM EXGBoosterSerializeToBuffer(ErlNifEnv *env, int argc,
                                          const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterDeserializeFromBuffer(ErlNifEnv *env, int argc,
                                              const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGBoosterRestoreFromBuffer(ErlNifEnv *env, int argc,
+                                         const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGBoosterMemory(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGBoosterFree(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterLoadModelFromBuffer(ErlNifEnv *env, int argc,
                                            const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGBoosterLoadModelMmap(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterSaveModelToBuffer(ErlNifEnv *env, int argc,
                                          const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGBoosterSaveJsonConfig(ErlNifEnv *env, int argc,
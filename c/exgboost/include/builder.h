@@ -0,0 +1,64 @@
+#ifndef EXGBOOST_BUILDER_H
+#define EXGBOOST_BUILDER_H
+
+#include "dmatrix.h"
+
+// One pushed batch. Chunks are never resized once written, so appending
+// never copies rows that are already buffered.
+typedef struct exg_builder_chunk {
+  struct exg_builder_chunk *next;
+  // Held by the builder while the chunk is buffered and by each quantile
+  // sketch reading it. Guarded by the builder lock.
+  int refs;
+  bst_ulong nrow;
+  bst_ulong nnz;
+  ErlNifSInt64 timestamp;
+  uint64_t *indptr;
+  unsigned *indices;
+  float *values;
+  float *labels;
+  float *weights;
+} exg_builder_chunk;
+
+typedef struct {
+  ErlNifMutex *lock;
+  exg_builder_chunk *head;
+  exg_builder_chunk *tail;
+  // Rows of the head chunk that were evicted by the row window
+  bst_ulong head_offset;
+  bst_ulong ncol;
+  bst_ulong nrow;
+  bst_ulong nnz;
+  // 0 disables the corresponding window
+  bst_ulong max_rows;
+  ErlNifSInt64 max_age;
+  float missing;
+  // -1 until the first push decides whether labels/weights are present
+  int has_labels;
+  int has_weights;
+} exg_builder;
+
+void Builder_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg);
+
+ERL_NIF_TERM EXGDMatrixBuilderCreate(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderPushDense(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderPushCSR(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderNumRow(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderEvict(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderToDMatrix(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixBuilderToQuantileDMatrix(ErlNifEnv *env, int argc,
+                                                const ERL_NIF_TERM argv[]);
+
+#endif
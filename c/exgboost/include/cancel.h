@@ -0,0 +1,41 @@
+#ifndef EXGBOOST_CANCEL_H
+#define EXGBOOST_CANCEL_H
+
+#include "utils.h"
+#include "collective.h"
+
+// Cancellation tokens
+//
+// A dirty NIF keeps running after its calling process is killed, so long
+// operations work in chunks (boosting rounds, row blocks) and check between
+// chunks whether they should stop. They stop once their token is cancelled,
+// explicitly or because the process it monitors went down, or once their
+// calling process is no longer alive.
+
+typedef struct {
+  _Atomic int cancelled;
+  ErlNifMonitor monitor;
+} exg_cancel_token;
+
+// Opens CancelToken_RESOURCE_TYPE, whose `down` callback cancels the token
+ErlNifResourceType *exg_open_cancel_token_type(ErlNifEnv *env,
+                                               ErlNifResourceFlags flags);
+
+// Reads a token, or `nil` into NULL
+int exg_get_cancel_token(ErlNifEnv *env, ERL_NIF_TERM term,
+                         exg_cancel_token **token);
+
+// Whether the operation running in `env` with `token` (which may be NULL)
+// should stop
+int exg_cancelled(ErlNifEnv *env, exg_cancel_token *token);
+
+ERL_NIF_TERM exg_cancel_token_create(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM exg_cancel_token_cancel(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM exg_cancel_token_cancelled(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef EXGBOOST_CHECKPOINT_H
+#define EXGBOOST_CHECKPOINT_H
+
+#include "utils.h"
+
+// Checkpoint writer
+//
+// Snapshotting a booster only costs the serialization and one copy into a
+// buffer owned by the checkpoint; writing it out happens on a dedicated thread
+// so the training loop does not wait for the disk. Each checkpoint is written
+// to a temporary file, flushed with fsync and renamed over its final path, so
+// a crash never leaves a partially written checkpoint behind. The thread is
+// started when the library is loaded and drains its queue before it stops on
+// unload.
+
+// Returns 0 if the thread could not be started, in which case checkpoints are
+// written by the caller.
+int exg_checkpoint_writer_start(void);
+
+void exg_checkpoint_writer_stop(void);
+
+ERL_NIF_TERM EXGBoosterCheckpoint(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]);
+
+#endif
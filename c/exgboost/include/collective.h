@@ -0,0 +1,70 @@
+#ifndef EXGBOOST_COLLECTIVE_H
+#define EXGBOOST_COLLECTIVE_H
+
+#include "utils.h"
+
+// Collective communicator
+//
+// XGBoost keeps its communicator in thread local storage, while the BEAM runs
+// every NIF call on whichever scheduler thread is free. So the communicator is
+// initialized on a dedicated thread, and while it is, the NIFs that may take
+// part in a collective operation (building a DMatrix, configuring, updating or
+// evaluating a Booster) hand their call to that thread and wait for the
+// result, when they are called by the process that owns the communicator. The
+// owner is the process that initialized it, or the one it handed ownership to
+// with communicator_adopt. Calls from any other process, and calls without a
+// communicator, run in place as usual, so they never queue behind training.
+// Every dispatched NIF is dirty, since it may wait for the whole of a queued
+// call. Calls on the thread run with a process independent env holding copies
+// of their arguments, so they must send messages through exg_caller_env.
+
+#define EXG_COLLECTIVE_MAX_ARGS 16
+
+typedef ERL_NIF_TERM (*exg_nif_fun)(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]);
+
+// Returns 0 if the thread could not be started, in which case the
+// communicator can't be initialized.
+int exg_collective_start(void);
+
+void exg_collective_stop(void);
+
+// Runs `fun` on the communicator thread when called by the owner of an
+// initialized communicator, and in place otherwise
+ERL_NIF_TERM exg_collective_dispatch(exg_nif_fun fun, ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+// The env to pass as `caller_env` to enif_send: NULL on the communicator
+// thread, `env` elsewhere
+ErlNifEnv *exg_caller_env(ErlNifEnv *env);
+
+// Defines `<fun>Collective`, a NIF that calls `fun` through
+// exg_collective_dispatch
+#define EXG_COLLECTIVE_NIF(fun)                                                \
+  static ERL_NIF_TERM fun##Collective(ErlNifEnv *env, int argc,                \
+                                      const ERL_NIF_TERM argv[]) {             \
+    return exg_collective_dispatch(fun, env, argc, argv);                      \
+  }
+
+ERL_NIF_TERM EXGCommunicatorInit(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorFinalize(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorGetRank(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorGetWorldSize(ErlNifEnv *env, int argc,
+                                         const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorIsDistributed(ErlNifEnv *env, int argc,
+                                          const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorPrint(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGCommunicatorAdopt(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]);
+
+#endif
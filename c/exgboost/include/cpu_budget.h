@@ -0,0 +1,47 @@
+#ifndef EXGBOOST_CPU_BUDGET_H
+#define EXGBOOST_CPU_BUDGET_H
+
+#include "utils.h"
+
+// CPU budget
+//
+// Every XGBoost call runs an OpenMP team sized from `nthread`, and with several
+// dirty schedulers training or predicting at once the teams add up to many
+// more threads than cores. When a budget of cores is set, each call that runs
+// an OpenMP team first takes a share of it: the budget split evenly between the
+// calls in flight, capped by the cores not already taken. The share is applied
+// through the calling thread's OpenMP thread count, which XGBoost reads when a
+// booster or DMatrix has `nthread` 0 (the default), so an explicit `nthread`
+// still wins. Shares are sized when a call starts and given back when it ends;
+// `booster_train` takes a new one every round.
+
+typedef struct {
+  // 0 when no share was taken
+  int threads;
+  int previous;
+  ErlNifTime started;
+} exg_cpu_share;
+
+void exg_cpu_share_acquire(exg_cpu_share *share);
+
+void exg_cpu_share_release(exg_cpu_share *share);
+
+// Defines `<fun>Budgeted`, a NIF that calls `fun` within a CPU share
+#define EXG_CPU_BUDGET_NIF(fun)                                                \
+  static ERL_NIF_TERM fun##Budgeted(ErlNifEnv *env, int argc,                  \
+                                    const ERL_NIF_TERM argv[]) {               \
+    exg_cpu_share share;                                                       \
+    ERL_NIF_TERM ret;                                                          \
+    exg_cpu_share_acquire(&share);                                             \
+    ret = fun(env, argc, argv);                                                \
+    exg_cpu_share_release(&share);                                             \
+    return ret;                                                                \
+  }
+
+ERL_NIF_TERM exg_cpu_budget_set_nif(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM exg_cpu_budget_stats_nif(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]);
+
+#endif
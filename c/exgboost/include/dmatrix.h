@@ -3,6 +3,16 @@
 
 #include "utils.h"
 
+// Resource helpers
+
+// Wraps the handle in a resource term. Returns 0 if the resource could not be
+// allocated, in which case the caller still owns the handle.
+int make_DMatrix_resource_term(ErlNifEnv *env, DMatrixHandle handle,
+                               ERL_NIF_TERM *out);
+
+// Same as make_DMatrix_resource_term but returns {:ok, ref} or {:error, msg}
+ERL_NIF_TERM make_DMatrix_resource(ErlNifEnv *env, DMatrixHandle handle);
+
 ERL_NIF_TERM EXGDMatrixCreateFromFile(ErlNifEnv *env, int argc,
                                       const ERL_NIF_TERM argv[]);
 
@@ -18,6 +28,12 @@ ERL_NIF_TERM EXGDMatrixCreateFromSparse(ErlNifEnv *env, int argc,
 ERL_NIF_TERM EXGDMatrixCreateFromDense(ErlNifEnv *env, int argc,
                                        const ERL_NIF_TERM argv[]);
 
+ERL_NIF_TERM EXGDMatrixCreateFromCOO(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixCreateFromDenseAuto(ErlNifEnv *env, int argc,
+                                           const ERL_NIF_TERM argv[]);
+
 ERL_NIF_TERM EXGDMatrixGetStrFeatureInfo(ErlNifEnv *env, int argc,
                                          const ERL_NIF_TERM argv[]);
 
@@ -27,6 +43,9 @@ ERL_NIF_TERM EXGDMatrixSetStrFeatureInfo(ErlNifEnv *env, int argc,
 ERL_NIF_TERM EXGDMatrixSetDenseInfo(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
 
+ERL_NIF_TERM EXGDMatrixSetDenseInfoList(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]);
+
 ERL_NIF_TERM EXGDMatrixNumRow(ErlNifEnv *env, int argc,
                               const ERL_NIF_TERM argv[]);
 
@@ -36,6 +55,12 @@ ERL_NIF_TERM EXGDMatrixNumCol(ErlNifEnv *env, int argc,
 ERL_NIF_TERM EXGDMatrixNumNonMissing(ErlNifEnv *env, int argc,
                                      const ERL_NIF_TERM argv[]);
 
+ERL_NIF_TERM EXGDMatrixMemory(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGDMatrixFree(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]);
+
 ERL_NIF_TERM EXGDMatrixSetInfoFromInterface(ErlNifEnv *env, int argc,
                                             const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGDMatrixSaveBinary(ErlNifEnv *env, int argc,
@@ -48,6 +73,8 @@ ERL_NIF_TERM EXGDMatrixGetDataAsCSR(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGDMatrixSliceDMatrix(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]);
+ERL_NIF_TERM EXGDMatrixFolds(ErlNifEnv *env, int argc,
+                             const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGProxyDMatrixCreate(ErlNifEnv *env, int argc,
                                    const ERL_NIF_TERM argv[]);
 ERL_NIF_TERM EXGDMatrixGetQuantileCut(ErlNifEnv *env, int argc,
@@ -0,0 +1,50 @@
+#ifndef EXGBOOST_ENCODER_H
+#define EXGBOOST_ENCODER_H
+
+#include "utils.h"
+
+// Dictionary from category strings to dense integer codes, assigned in order
+// of first appearance. Lookups go through an open-addressing hash table whose
+// slots hold code + 1 (0 marks an empty slot); the strings themselves live in
+// a single growable byte arena indexed by `offsets`.
+typedef struct {
+  // Encoding only reads the dictionary, so serving requests share the lock
+  ErlNifRWLock *lock;
+  uint32_t *slots;
+  uint64_t *hashes;
+  size_t capacity;
+  char *bytes;
+  size_t bytes_len;
+  size_t bytes_cap;
+  uint64_t *offsets;
+  uint32_t count;
+  uint32_t offsets_cap;
+  // `count` published after every insert, for readers that don't take the
+  // lock while a fit holds it
+  _Atomic uint32_t num_categories;
+} exg_encoder;
+
+void Encoder_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg);
+
+ERL_NIF_TERM EXGEncoderCreate(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderFit(ErlNifEnv *env, int argc,
+                           const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderEncode(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderNumCategories(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderCategories(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderSerialize(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGEncoderDeserialize(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]);
+
+#endif
@@ -4,5 +4,11 @@
 #include "config.h"
 #include "dmatrix.h"
 #include "booster.h"
+#include "builder.h"
+#include "checkpoint.h"
+#include "collective.h"
+#include "cpu_budget.h"
+#include "encoder.h"
+#include "objective.h"
 
 #endif
\ No newline at end of file
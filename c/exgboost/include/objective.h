@@ -0,0 +1,78 @@
+#ifndef EXGBOOST_OBJECTIVE_H
+#define EXGBOOST_OBJECTIVE_H
+
+#include "utils.h"
+
+#define EXG_OBJECTIVE_MAX_PARAMS 4
+
+// Computes the gradient and hessian of `n` rows from their margins, labels and
+// weights (NULL when the DMatrix has none)
+typedef void (*exg_objective_kernel)(const float *margin, const float *label,
+                                     const float *weight, size_t n,
+                                     const double *params, float *grad,
+                                     float *hess);
+
+typedef struct {
+  const char *name;
+  const char *param_names[EXG_OBJECTIVE_MAX_PARAMS];
+  double defaults[EXG_OBJECTIVE_MAX_PARAMS];
+  exg_objective_kernel kernel;
+} exg_objective_def;
+
+// A configured objective along with the gradient buffers it reuses between
+// rounds
+typedef struct {
+  const exg_objective_def *def;
+  double params[EXG_OBJECTIVE_MAX_PARAMS];
+  float *grad;
+  float *hess;
+  size_t capacity;
+} exg_objective;
+
+// Reads `{name, [{param, value}]}` into `obj`. Returns 0 and sets `error` on
+// failure.
+int exg_get_objective(ErlNifEnv *env, ERL_NIF_TERM term, exg_objective *obj,
+                      const char **error);
+
+// Runs one boosting round of `obj` on `dtrain`. Returns 0 on success, -1 on
+// an XGBoost error (see XGBGetLastError) and -2 with `error` set otherwise.
+int exg_objective_boost(BoosterHandle booster, DMatrixHandle dtrain,
+                        exg_objective *obj, const char **error);
+
+void exg_objective_free(exg_objective *obj);
+
+// Gradient-based one-side sampling (GOSS, as in LightGBM). Every round keeps
+// the `top_rate` fraction of rows with the largest |gradient| and samples
+// `other_rate` of all rows from the rest, scaling their gradients up by
+// (1 - top_rate) / other_rate. The tree is built on a slice of the DMatrix
+// with the kept rows only.
+typedef struct {
+  double top_rate;
+  double other_rate;
+  uint64_t seed;
+  // Scratch buffers reused between rounds
+  float *abs_grad;
+  int *rows;
+  size_t capacity;
+} exg_goss;
+
+// Reads `{top_rate, other_rate, seed}` into `goss`. Returns 0 and sets `error`
+// on failure.
+int exg_get_goss(ErlNifEnv *env, ERL_NIF_TERM term, exg_goss *goss,
+                 const char **error);
+
+// Runs one boosting round of `obj` on the rows of `dtrain` sampled for
+// `iteration`. Returns like exg_objective_boost.
+int exg_objective_boost_goss(BoosterHandle booster, DMatrixHandle dtrain,
+                             exg_objective *obj, exg_goss *goss, int iteration,
+                             const char **error);
+
+void exg_goss_free(exg_goss *goss);
+
+ERL_NIF_TERM EXGBoosterBoostNative(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM EXGBoosterBoostGOSS(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]);
+
+#endif
@@ -2,14 +2,57 @@
 #define EXGBOOST_UTILS_H
 
 #include <erl_nif.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <xgboost/c_api.h>
 
 ErlNifResourceType *DMatrix_RESOURCE_TYPE;
 ErlNifResourceType *Booster_RESOURCE_TYPE;
+ErlNifResourceType *Builder_RESOURCE_TYPE;
+ErlNifResourceType *Encoder_RESOURCE_TYPE;
+ErlNifResourceType *CancelToken_RESOURCE_TYPE;
 typedef uint64_t bst_ulong;
 
+// DMatrix and Booster resource layouts. The handle stays the first member, so
+// code that reads a resource as a `Handle *` keeps working.
+//
+// The resource itself is tiny compared to the native memory behind the handle,
+// so each one records an estimate of that memory in `footprint`, and the sum
+// over all live resources is kept in a global gauge (exg_native_memory). We do
+// not surface it through enif_make_resource_binary: that requires `footprint`
+// readable bytes behind the binary, and XGBoost's memory is neither contiguous
+// nor ours to expose.
+//
+// `handle` is set to NULL once the object is freed explicitly, and every NIF
+// checks for that before using it. `freed` makes the explicit free happen once.
+typedef struct {
+  DMatrixHandle handle;
+  _Atomic uint64_t footprint;
+  _Atomic int freed;
+} exg_dmatrix_resource;
+
+// Metrics recorded each time a booster is evaluated, one row per evaluation and
+// one column per (dataset, metric) key. Values are stored row-major and a key
+// missing from a row is NaN.
+typedef struct {
+  ErlNifMutex *lock;
+  char **datasets;
+  char **metrics;
+  unsigned num_keys;
+  int32_t *iterations;
+  double *values;
+  size_t num_rows;
+  size_t capacity;
+} exg_eval_history;
+
+typedef struct {
+  BoosterHandle handle;
+  _Atomic uint64_t footprint;
+  _Atomic int freed;
+  exg_eval_history history;
+} exg_booster_resource;
+
 void DMatrix_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg);
 
 void Booster_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg);
@@ -42,4 +85,151 @@ int exg_get_string_list(ErlNifEnv *env, ERL_NIF_TERM term, char ***out,
 int exg_get_dmatrix_list(ErlNifEnv *env, ERL_NIF_TERM term,
                          DMatrixHandle **dmats, unsigned *len);
 
+// Writes a 1-D __array_interface__ JSON document describing `len` elements of
+// type `typestr` at `data` into `buf`. Returns 0 if `buf` is too small.
+int exg_make_array_interface(char *buf, size_t size, const void *data,
+                             bst_ulong len, const char *typestr);
+
+// Sparse helpers
+
+// Returns NULL if a COO matrix of this shape can be converted, otherwise the
+// reason it can't: the row and column pointers must be addressable and column
+// indices must fit the u32 CSR indices.
+const char *exg_check_coo_shape(bst_ulong nrow, bst_ulong ncol);
+
+// Converts unsorted COO triplets into CSR with ascending column indices per
+// row. Duplicate (row, col) entries are summed, or the last one in input order
+// wins when `sum_duplicates` is 0. `indptr` must hold nrow + 1 elements and
+// `indices`/`out_values` nnz elements. Returns NULL on success, otherwise the
+// reason for the failure.
+const char *exg_coo_to_csr(const unsigned *rows, const unsigned *cols,
+                           const float *values, size_t nnz, bst_ulong nrow,
+                           bst_ulong ncol, int sum_duplicates,
+                           uint64_t *indptr, unsigned *indices,
+                           float *out_values, size_t *out_nnz);
+
+ERL_NIF_TERM exg_coo_to_csr_nif(ErlNifEnv *env, int argc,
+                                const ERL_NIF_TERM argv[]);
+
+// Layouts a dense matrix can be ingested as
+typedef enum { EXG_FORMAT_DENSE, EXG_FORMAT_CSR, EXG_FORMAT_CSC } exg_format;
+
+// Stores a * b in `out` and returns 1, or returns 0 if it would overflow.
+// Byte sizes computed from caller-supplied counts go through it.
+int exg_mul_size(uint64_t a, uint64_t b, uint64_t *out);
+
+// Reads a missing value passed as a float, or nil for NaN only.
+int exg_get_missing(ErlNifEnv *env, ERL_NIF_TERM term, float *missing);
+
+// Counts the present entries (neither NaN nor `missing`) of a row-major
+// nrow x ncol matrix per row and, when `col_nnz` is not NULL, per column.
+// Returns the total number of present entries.
+uint64_t exg_dense_scan(const float *data, bst_ulong nrow, bst_ulong ncol,
+                        float missing, uint64_t *row_nnz, uint64_t *col_nnz);
+
+// Picks the layout with the smallest footprint for `nnz` present entries.
+// CSC is only considered when `allow_csc` is set, and only picked when the
+// CSR row pointer alone would outweigh it.
+exg_format exg_choose_format(bst_ulong nrow, bst_ulong ncol, uint64_t nnz,
+                             int allow_csc);
+
+// Copies the present entries of a dense matrix into CSR (or CSC) arrays sized
+// from the counts of exg_dense_scan. `indptr` holds nrow + 1 (ncol + 1)
+// elements.
+void exg_dense_to_csr(const float *data, bst_ulong nrow, bst_ulong ncol,
+                      float missing, const uint64_t *row_nnz, uint64_t *indptr,
+                      unsigned *indices, float *values);
+
+void exg_dense_to_csc(const float *data, bst_ulong nrow, bst_ulong ncol,
+                      float missing, const uint64_t *col_nnz, uint64_t *indptr,
+                      unsigned *indices, float *values);
+
+ERL_NIF_TERM exg_dense_to_csr_nif(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]);
+
+// Evaluation helpers
+
+// One "name-metric:value" entry of an eval string
+typedef struct {
+  unsigned eval;
+  const char *metric;
+  size_t metric_len;
+  double value;
+} exg_eval_entry;
+
+// Splits XGBoost's "[iter]\tname-metric:value\t..." eval string into entries,
+// which come ordered by eval set and then by metric. `entries` must have room
+// for one entry per tab in `msg`. Returns the number of entries.
+size_t exg_parse_eval(const char *msg, char **evnames, unsigned num_evals,
+                      exg_eval_entry *entries);
+
+// Appends the entries of one evaluation to the history, adding columns for
+// keys not seen before. Returns 0 if memory could not be allocated.
+int exg_history_append(exg_eval_history *history, int iteration,
+                       char **evnames, const exg_eval_entry *entries,
+                       size_t count);
+
+void exg_history_free(exg_eval_history *history);
+
+// Native memory accounting
+
+// Total footprint of all live DMatrix and Booster resources, in bytes.
+uint64_t exg_native_memory(void);
+
+// Replaces a resource's footprint and moves the global gauge by the difference.
+void exg_set_footprint(_Atomic uint64_t *footprint, uint64_t bytes);
+
+// Estimated bytes held by a DMatrix: every present value is stored as an 8 byte
+// (index, value) entry, and every row adds an 8 byte offset and a 4 byte label.
+uint64_t exg_dmatrix_footprint(DMatrixHandle handle);
+
+// Bytes held by a Booster, taken to be the size of its serialized form.
+uint64_t exg_booster_footprint(BoosterHandle handle);
+
+ERL_NIF_TERM exg_native_memory_nif(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]);
+
+// Resident set size of the process in bytes, cheap enough to sample every
+// training round. Read from /proc on Linux; elsewhere only the peak resident
+// size is available without a syscall per page, so that is returned instead.
+uint64_t exg_process_rss(void);
+
+// Peak resident set size of the VM process in bytes
+uint64_t exg_process_peak_rss(void);
+
+ERL_NIF_TERM exg_process_rss_nif(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]);
+
+// Native reaper
+
+// Freeing a large DMatrix or Booster can take hundreds of milliseconds, which
+// is too long to spend in a resource destructor on a normal scheduler. The
+// destructors instead queue the handles for a dedicated thread that frees them
+// in order. The thread is started when the library is loaded and drains the
+// queue before it stops on unload.
+//
+// Only the destructors queue handles, and they run once no term refers to the
+// resource. A NIF using the handle holds such a term for the whole call, so no
+// call can still be using a queued handle, and the reaper needs no in-flight
+// count. The explicit free NIFs don't go through the reaper. They are the only
+// path where a handle can be freed while in use, and they are documented as
+// unsafe against concurrent use.
+
+typedef enum { EXG_REAP_DMATRIX, EXG_REAP_BOOSTER } exg_reap_kind;
+
+// Returns 0 if the thread could not be started, in which case handles are
+// freed inline.
+int exg_reaper_start(void);
+
+void exg_reaper_stop(void);
+
+// Queues the handle to be freed by the reaper thread.
+void exg_reap(exg_reap_kind kind, void *handle);
+
+// Random number helpers
+
+// SplitMix64 step. Deterministic for a given seed on every platform, which
+// keeps fold assignment and sampling reproducible.
+uint64_t exg_rand_next(uint64_t *state);
+
 #endif
\ No newline at end of file
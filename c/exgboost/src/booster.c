@@ -1,20 +1,48 @@
+#define _POSIX_C_SOURCE 200809L
 #include "booster.h"
+#include "objective.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-static ERL_NIF_TERM make_Booster_resource(ErlNifEnv *env,
-                                          BoosterHandle handle) {
+// `footprint` is the serialized size of the booster when the caller already
+// knows it, such as the size of the buffer it was loaded from, which spares
+// serializing the whole model again to measure it
+static ERL_NIF_TERM make_Booster_resource_sized(ErlNifEnv *env,
+                                                BoosterHandle handle,
+                                                uint64_t footprint) {
   ERL_NIF_TERM ret = -1;
-  BoosterHandle **resource =
-      enif_alloc_resource(Booster_RESOURCE_TYPE, sizeof(BoosterHandle *));
+  exg_booster_resource *resource =
+      enif_alloc_resource(Booster_RESOURCE_TYPE, sizeof(exg_booster_resource));
   if (resource != NULL) {
-    *resource = handle;
-    ret = exg_ok(env, enif_make_resource(env, resource));
+    resource->handle = handle;
+    atomic_init(&resource->footprint, 0);
+    atomic_init(&resource->freed, 0);
+    memset(&resource->history, 0, sizeof(resource->history));
+    resource->history.lock = enif_mutex_create("exgboost_eval_history");
+    exg_set_footprint(&resource->footprint, footprint);
+    ret = resource->history.lock != NULL
+              ? exg_ok(env, enif_make_resource(env, resource))
+              : exg_error(env, "Failed to create eval history lock");
     enif_release_resource(resource);
   } else {
-    ret = exg_error(env, "Failed to allocate memory for XGBoost DMatrix");
+    ret = exg_error(env, "Failed to allocate memory for XGBoost Booster");
   }
   return ret;
 }
 
+// Measuring serializes the whole model, too slow for the regular schedulers
+// that create and slice boosters and a cost training shouldn't pay every run,
+// so the footprint stays 0 until EXGBoosterMemory measures it or the booster
+// is serialized
+static ERL_NIF_TERM make_Booster_resource(ErlNifEnv *env,
+                                          BoosterHandle handle) {
+  return make_Booster_resource_sized(env, handle, 0);
+}
+
 ERL_NIF_TERM EXGBoosterCreate(ErlNifEnv *env, int argc,
                               const ERL_NIF_TERM argv[]) {
   DMatrixHandle *dmats = NULL;
@@ -72,6 +100,10 @@ ERL_NIF_TERM EXGBoosterSlice(ErlNifEnv *env, int argc,
     goto END;
   }
   in_booster = *resource;
+  if (in_booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!enif_get_int(env, argv[1], &begin_layer)) {
     ret = exg_error(env, "Invalid begin_layer");
     goto END;
@@ -112,6 +144,10 @@ ERL_NIF_TERM EXGBoosterBoostedRounds(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterBoostedRounds(booster, &rounds);
   if (result == 0) {
     ret = exg_ok(env, enif_make_int(env, rounds));
@@ -140,6 +176,10 @@ ERL_NIF_TERM EXGBoosterSetParam(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!exg_get_string(env, argv[1], &name)) {
     ret = exg_error(env, "Invalid booster parameter name");
     goto END;
@@ -175,6 +215,10 @@ ERL_NIF_TERM EXGBoosterGetNumFeature(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterGetNumFeature(booster, &num_feature);
   if (result == 0) {
     ret = exg_ok(env, enif_make_ulong(env, num_feature));
@@ -204,12 +248,20 @@ ERL_NIF_TERM EXGBoosterUpdateOneIter(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
                          (void *)&(dtrain_resource))) {
     ret = exg_error(env, "Invalid DMatrix");
     goto END;
   }
   dtrain = *dtrain_resource;
+  if (dtrain == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   if (!enif_get_int(env, argv[2], &iter)) {
     ret = exg_error(env, "Invalid iter");
     goto END;
@@ -248,12 +300,20 @@ ERL_NIF_TERM EXGBoosterBoostOneIter(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
                          (void *)&(dtrain_resource))) {
     ret = exg_error(env, "Invalid DMatrix");
     goto END;
   }
   dtrain = *dtrain_resource;
+  if (dtrain == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   if (!enif_inspect_binary(env, argv[2], &grad_bin)) {
     ret = exg_error(env, "Grad must be a binary");
     goto END;
@@ -303,6 +363,10 @@ ERL_NIF_TERM EXGBoosterEvalOneIter(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!enif_get_int(env, argv[1], &iter)) {
     ret = exg_error(env, "Invalid iter");
     goto END;
@@ -330,6 +394,476 @@ END:
   return ret;
 }
 
+// Metrics where a larger value is better, matched by name or by the prefix of
+// their `@` forms, like `ndcg@5`. Keep in sync with
+// EXGBoost.Training.maximize_metric?/1.
+static int metric_maximize(const char *metric, size_t len) {
+  static const char *names[] = {"auc", "aucpr", "map", "ndcg", "pre"};
+  static const char *prefixes[] = {"map@", "ndcg@", "pre@"};
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (len == strlen(names[i]) && strncmp(metric, names[i], len) == 0) {
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); ++i) {
+    size_t prefix_len = strlen(prefixes[i]);
+    if (len >= prefix_len && strncmp(metric, prefixes[i], prefix_len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static ERL_NIF_TERM make_eval_entries(ErlNifEnv *env, char **evnames,
+                                      exg_eval_entry *entries, size_t count) {
+  ERL_NIF_TERM list = enif_make_list(env, 0);
+  for (size_t i = count; i > 0; --i) {
+    exg_eval_entry *entry = &entries[i - 1];
+    ERL_NIF_TERM name;
+    ERL_NIF_TERM metric;
+    ERL_NIF_TERM value;
+    size_t name_len = strlen(evnames[entry->eval]);
+    memcpy(enif_make_new_binary(env, name_len, &name), evnames[entry->eval],
+           name_len);
+    memcpy(enif_make_new_binary(env, entry->metric_len, &metric),
+           entry->metric, entry->metric_len);
+    // Erlang floats can't hold NaN or infinities
+    value = isfinite(entry->value) ? enif_make_double(env, entry->value)
+                                   : enif_make_atom(env, "nan");
+    list = enif_make_list_cell(
+        env, enif_make_tuple3(env, name, metric, value), list);
+  }
+  return list;
+}
+
+// Tells the progress process how long round `iter` spent updating and
+// evaluating, in nanoseconds, and how many rounds the booster now holds
+static void send_round(ErlNifEnv *env, ErlNifEnv *msg_env, ErlNifPid *pid,
+                       ERL_NIF_TERM ref, BoosterHandle booster, int iter,
+                       ErlNifTime update_ns, ErlNifTime eval_ns) {
+  int rounds = 0;
+  XGBoosterBoostedRounds(booster, &rounds);
+  enif_send(exg_caller_env(env), pid, msg_env,
+            enif_make_tuple6(msg_env, enif_make_copy(msg_env, ref),
+                             enif_make_atom(msg_env, "round"),
+                             enif_make_int(msg_env, iter),
+                             enif_make_int64(msg_env, update_ns),
+                             enif_make_int64(msg_env, eval_ns),
+                             enif_make_int(msg_env, rounds)));
+  enif_clear_env(msg_env);
+}
+
+// Runs `num_rounds` boosting rounds starting at iteration `begin` without
+// returning to Elixir between rounds. Learning rates, native objectives,
+// evaluation and early stopping on the last metric of the last eval set all
+// happen here. Given `{pid, ref, period, rounds}`, the metrics are sent to
+// `pid` every `period` rounds, and the timing of every round if `rounds`.
+// Training stops with an error between rounds once cancelled. With GOSS, each
+// round of the native objective is built on the rows it samples.
+ERL_NIF_TERM EXGBoosterTrain(ErlNifEnv *env, int argc,
+                             const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  exg_booster_resource *booster_resource = NULL;
+  DMatrixHandle dtrain;
+  DMatrixHandle **dtrain_resource = NULL;
+  DMatrixHandle *dmats = NULL;
+  char **evnames = NULL;
+  unsigned num_dmats = 0;
+  unsigned num_evnames = 0;
+  double *learning_rates = NULL;
+  unsigned num_learning_rates = 0;
+  int begin = 0;
+  int num_rounds = 0;
+  int patience = 0;
+  const ERL_NIF_TERM *progress = NULL;
+  int progress_arity = 0;
+  ErlNifPid progress_pid;
+  int progress_period = 0;
+  int progress_rounds = 0;
+  ErlNifEnv *msg_env = NULL;
+  exg_eval_entry *entries = NULL;
+  size_t entries_cap = 0;
+  exg_objective obj;
+  int has_obj = 0;
+  exg_goss goss;
+  int has_goss = 0;
+  const char *error = NULL;
+  int last_iter = -1;
+  int best_iter = -1;
+  double best_score = 0;
+  int since_improvement = 0;
+  exg_cancel_token *token = NULL;
+  exg_cpu_share share = {0};
+  char buf[64];
+  ERL_NIF_TERM ret = -1;
+  memset(&obj, 0, sizeof(obj));
+  memset(&goss, 0, sizeof(goss));
+  if (12 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = booster_resource->handle;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
+                         (void *)&(dtrain_resource))) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  dtrain = *dtrain_resource;
+  if (dtrain == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[2], &begin) ||
+      !enif_get_int(env, argv[3], &num_rounds)) {
+    ret = exg_error(env, "Begin and num_rounds must be integers");
+    goto END;
+  }
+  if (!exg_get_dmatrix_list(env, argv[4], &dmats, &num_dmats)) {
+    ret = exg_error(env, "Invalid DMatrix list");
+    goto END;
+  }
+  if (!exg_get_string_list(env, argv[5], &evnames, &num_evnames)) {
+    ret = exg_error(env, "Invalid evnames list");
+    goto END;
+  }
+  if (num_dmats != num_evnames) {
+    ret = exg_error(env, "dmats and evnames must have the same length");
+    goto END;
+  }
+  if (!enif_get_list_length(env, argv[6], &num_learning_rates) ||
+      !exg_get_list(env, argv[6], &learning_rates)) {
+    ret = exg_error(env, "Learning rates must be a list of floats");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[7], &patience)) {
+    ret = exg_error(env, "Early stopping rounds must be an integer");
+    goto END;
+  }
+  if (enif_get_tuple(env, argv[8], &progress_arity, &progress)) {
+    if (progress_arity != 4 ||
+        !enif_get_local_pid(env, progress[0], &progress_pid) ||
+        !enif_get_int(env, progress[2], &progress_period)) {
+      ret = exg_error(env,
+                      "Progress must be {pid, ref, period, rounds} or nil");
+      goto END;
+    }
+    progress_rounds =
+        enif_is_identical(progress[3], enif_make_atom(env, "true"));
+    msg_env = enif_alloc_env();
+  }
+  if (!enif_is_identical(argv[9], enif_make_atom(env, "nil"))) {
+    if (!exg_get_objective(env, argv[9], &obj, &error)) {
+      ret = exg_error(env, error);
+      goto END;
+    }
+    has_obj = 1;
+  }
+  if (!exg_get_cancel_token(env, argv[10], &token)) {
+    ret = exg_error(env, "Invalid CancelToken");
+    goto END;
+  }
+  if (!enif_is_identical(argv[11], enif_make_atom(env, "nil"))) {
+    if (!has_obj) {
+      ret = exg_error(env, "GOSS requires a native objective");
+      goto END;
+    }
+    if (!exg_get_goss(env, argv[11], &goss, &error)) {
+      ret = exg_error(env, error);
+      goto END;
+    }
+    has_goss = 1;
+  }
+  for (int r = 0; r < num_rounds; ++r) {
+    int iter = begin + r;
+    const char *out = NULL;
+    size_t count = 0;
+    size_t tabs = 0;
+    ErlNifTime started = enif_monotonic_time(ERL_NIF_NSEC);
+    ErlNifTime updated = 0;
+    if (exg_cancelled(env, token)) {
+      ret = exg_error(env, "Cancelled");
+      goto END;
+    }
+    // Other calls may have started or finished since the last round
+    exg_cpu_share_release(&share);
+    exg_cpu_share_acquire(&share);
+    if ((unsigned)r < num_learning_rates) {
+      snprintf(buf, sizeof(buf), "%.17g", learning_rates[r]);
+      if (XGBoosterSetParam(booster, "learning_rate", buf) != 0) {
+        ret = exg_error(env, XGBGetLastError());
+        goto END;
+      }
+    }
+    if (has_obj) {
+      int result =
+          has_goss
+              ? exg_objective_boost_goss(booster, dtrain, &obj, &goss, iter,
+                                         &error)
+              : exg_objective_boost(booster, dtrain, &obj, &error);
+      if (result != 0) {
+        ret = exg_error(env, result == -1 ? XGBGetLastError() : error);
+        goto END;
+      }
+    } else if (XGBoosterUpdateOneIter(booster, iter, dtrain) != 0) {
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+    last_iter = iter;
+    updated = enif_monotonic_time(ERL_NIF_NSEC);
+    if (num_dmats == 0) {
+      if (progress_rounds) {
+        send_round(env, msg_env, &progress_pid, progress[1], booster, iter,
+                   updated - started, 0);
+      }
+      continue;
+    }
+    if (XGBoosterEvalOneIter(booster, iter, dmats, (const char **)evnames,
+                             num_dmats, &out) != 0) {
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+    for (const char *c = out; *c != '\0'; ++c) {
+      tabs += *c == '\t';
+    }
+    if (tabs > entries_cap) {
+      exg_eval_entry *grown =
+          enif_realloc(entries, sizeof(exg_eval_entry) * tabs);
+      if (grown == NULL) {
+        ret = exg_error(env, "Failed to allocate memory");
+        goto END;
+      }
+      entries = grown;
+      entries_cap = tabs;
+    }
+    count = exg_parse_eval(out, evnames, num_dmats, entries);
+    if (!exg_history_append(&booster_resource->history, iter, evnames,
+                            entries, count)) {
+      ret = exg_error(env, "Failed to allocate memory");
+      goto END;
+    }
+    if (msg_env != NULL && progress_period > 0 &&
+        iter % progress_period == 0) {
+      ERL_NIF_TERM msg = enif_make_tuple3(
+          msg_env, enif_make_copy(msg_env, progress[1]),
+          enif_make_int(msg_env, iter),
+          make_eval_entries(msg_env, evnames, entries, count));
+      enif_send(exg_caller_env(env), &progress_pid, msg_env, msg);
+      enif_clear_env(msg_env);
+    }
+    if (progress_rounds) {
+      send_round(env, msg_env, &progress_pid, progress[1], booster, iter,
+                 updated - started,
+                 enif_monotonic_time(ERL_NIF_NSEC) - updated);
+    }
+    if (patience > 0) {
+      exg_eval_entry *target = count > 0 ? &entries[count - 1] : NULL;
+      int improved = 0;
+      if (target == NULL || target->eval != num_dmats - 1) {
+        ret = exg_error(env, "Early stopping requires a metric on the last "
+                             "evaluation set");
+        goto END;
+      }
+      // A non-finite score never improves, but counts towards the patience
+      improved = isfinite(target->value) &&
+                 (best_iter < 0 ||
+                  (metric_maximize(target->metric, target->metric_len)
+                       ? target->value > best_score
+                       : target->value < best_score));
+      if (improved) {
+        best_iter = iter;
+        best_score = target->value;
+        since_improvement = 0;
+        snprintf(buf, sizeof(buf), "%d", best_iter);
+        XGBoosterSetAttr(booster, "best_iteration", buf);
+        snprintf(buf, sizeof(buf), "%.17g", best_score);
+        XGBoosterSetAttr(booster, "best_score", buf);
+      } else if (since_improvement < patience) {
+        since_improvement++;
+      } else {
+        break;
+      }
+    }
+  }
+  ret = exg_ok(
+      env,
+      enif_make_tuple3(
+          env, enif_make_int(env, last_iter),
+          best_iter < 0 ? enif_make_atom(env, "nil")
+                        : enif_make_int(env, best_iter),
+          best_iter < 0 ? enif_make_atom(env, "nil")
+                        : enif_make_double(env, best_score)));
+END:
+  exg_cpu_share_release(&share);
+  exg_goss_free(&goss);
+  exg_objective_free(&obj);
+  if (msg_env != NULL) {
+    enif_free_env(msg_env);
+  }
+  if (entries != NULL) {
+    enif_free(entries);
+  }
+  if (learning_rates != NULL) {
+    enif_free(learning_rates);
+  }
+  if (evnames != NULL) {
+    for (unsigned i = 0; i < num_evnames; ++i) {
+      enif_free(evnames[i]);
+    }
+    enif_free(evnames);
+  }
+  if (dmats != NULL) {
+    enif_free(dmats);
+  }
+  return ret;
+}
+
+// Evaluates the booster like XGBoosterEvalOneIter, but returns the metrics as
+// {eval_name, metric, value} tuples and records them in the booster's history
+ERL_NIF_TERM EXGBoosterEval(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  exg_booster_resource *resource = NULL;
+  DMatrixHandle *dmats = NULL;
+  char **evnames = NULL;
+  int iter = -1;
+  unsigned num_dmats = 0;
+  unsigned num_evnames = 0;
+  const char *out = NULL;
+  exg_eval_entry *entries = NULL;
+  size_t tabs = 0;
+  size_t count = 0;
+  ERL_NIF_TERM ret = -1;
+  if (4 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = resource->handle;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[1], &iter)) {
+    ret = exg_error(env, "Invalid iter");
+    goto END;
+  }
+  if (!exg_get_dmatrix_list(env, argv[2], &dmats, &num_dmats)) {
+    ret = exg_error(env, "Invalid DMatrix list");
+    goto END;
+  }
+  if (!exg_get_string_list(env, argv[3], &evnames, &num_evnames)) {
+    ret = exg_error(env, "Invalid evnames list");
+    goto END;
+  }
+  if (num_dmats != num_evnames) {
+    ret = exg_error(env, "dmats and evnames must have the same length");
+    goto END;
+  }
+  if (XGBoosterEvalOneIter(booster, iter, dmats, (const char **)evnames,
+                           (bst_ulong)num_dmats, &out) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  for (const char *c = out; *c != '\0'; ++c) {
+    tabs += *c == '\t';
+  }
+  entries = enif_alloc(sizeof(exg_eval_entry) * (tabs + 1));
+  if (entries == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  count = exg_parse_eval(out, evnames, num_dmats, entries);
+  if (!exg_history_append(&resource->history, iter, evnames, entries,
+                          count)) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  ret = exg_ok(env, make_eval_entries(env, evnames, entries, count));
+END:
+  if (entries != NULL) {
+    enif_free(entries);
+  }
+  if (evnames != NULL) {
+    for (unsigned i = 0; i < num_evnames; ++i) {
+      enif_free(evnames[i]);
+    }
+    enif_free(evnames);
+  }
+  if (dmats != NULL) {
+    enif_free(dmats);
+  }
+  return ret;
+}
+
+// Returns the recorded metrics as {[{eval_name, metric}], iterations, values}
+// where iterations is a binary of s32 and values a row-major binary of f64
+// with one column per key
+ERL_NIF_TERM EXGBoosterEvalHistory(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]) {
+  exg_booster_resource *resource = NULL;
+  exg_eval_history *history = NULL;
+  ERL_NIF_TERM keys;
+  ERL_NIF_TERM iterations;
+  ERL_NIF_TERM values;
+  size_t values_size = 0;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  history = &resource->history;
+  enif_mutex_lock(history->lock);
+  keys = enif_make_list(env, 0);
+  for (unsigned k = history->num_keys; k > 0; --k) {
+    ERL_NIF_TERM dataset;
+    ERL_NIF_TERM metric;
+    size_t dataset_len = strlen(history->datasets[k - 1]);
+    size_t metric_len = strlen(history->metrics[k - 1]);
+    memcpy(enif_make_new_binary(env, dataset_len, &dataset),
+           history->datasets[k - 1], dataset_len);
+    memcpy(enif_make_new_binary(env, metric_len, &metric),
+           history->metrics[k - 1], metric_len);
+    keys = enif_make_list_cell(env, enif_make_tuple2(env, dataset, metric),
+                               keys);
+  }
+  if (history->num_rows > 0) {
+    memcpy(enif_make_new_binary(env, sizeof(int32_t) * history->num_rows,
+                                &iterations),
+           history->iterations, sizeof(int32_t) * history->num_rows);
+  } else {
+    enif_make_new_binary(env, 0, &iterations);
+  }
+  values_size = sizeof(double) * history->num_rows * history->num_keys;
+  if (values_size > 0) {
+    memcpy(enif_make_new_binary(env, values_size, &values), history->values,
+           values_size);
+  } else {
+    enif_make_new_binary(env, 0, &values);
+  }
+  enif_mutex_unlock(history->lock);
+  ret = exg_ok(env, enif_make_tuple3(env, keys, iterations, values));
+END:
+  return ret;
+}
+
 ERL_NIF_TERM EXGBoosterGetAttr(ErlNifEnv *env, int argc,
                                const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
@@ -349,14 +883,19 @@ ERL_NIF_TERM EXGBoosterGetAttr(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!exg_get_string(env, argv[1], &key)) {
     ret = exg_error(env, "Key must be a string");
     goto END;
   }
   result = XGBoosterGetAttr(booster, key, &out, &success);
   if (result == 0) {
-    if (success == 0) {
-      ret = enif_make_string(env, out, ERL_NIF_LATIN1);
+    // success is 1 when the attribute exists
+    if (success == 1) {
+      ret = exg_ok(env, enif_make_string(env, out, ERL_NIF_LATIN1));
     } else {
       ret = exg_ok(env, enif_make_atom(env, "undefined"));
     }
@@ -364,6 +903,9 @@ ERL_NIF_TERM EXGBoosterGetAttr(ErlNifEnv *env, int argc,
     ret = exg_error(env, XGBGetLastError());
   }
 END:
+  if (key != NULL) {
+    enif_free(key);
+  }
   return ret;
 }
 
@@ -386,6 +928,10 @@ ERL_NIF_TERM EXGBoosterSetAttr(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   if (!exg_get_string(env, argv[1], &key)) {
     ret = exg_error(env, "Key must be a string");
     goto END;
@@ -436,6 +982,10 @@ ERL_NIF_TERM EXGBoosterGetAttrNames(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterGetAttrNames(booster, &out_len, &out);
   if (result == 0) {
     ERL_NIF_TERM arr[out_len];
@@ -485,6 +1035,10 @@ ERL_NIF_TERM EXGBoosterSetStrFeatureInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterSetStrFeatureInfo(handle, field, features, num_features);
   if (result == 0) {
     ret = ok_atom(env);
@@ -526,6 +1080,10 @@ ERL_NIF_TERM EXGBoosterGetStrFeatureInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result =
       XGBoosterGetStrFeatureInfo(handle, field, &out_size, &c_out_features);
   if (result == 0) {
@@ -573,6 +1131,10 @@ ERL_NIF_TERM EXGBoosterFeatureScore(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result =
       XGBoosterFeatureScore(booster, config, &out_n_features, &out_features,
                             &out_dim, &out_shape, &out_scores);
@@ -605,18 +1167,26 @@ static ERL_NIF_TERM collect_prediction_results(ErlNifEnv *env,
                                                float *out_result) {
   bst_ulong out_len = 1;
   ERL_NIF_TERM shape_arr[out_dim];
+  ERL_NIF_TERM *result_arr = NULL;
+  ERL_NIF_TERM ret = -1;
   for (bst_ulong j = 0; j < out_dim; ++j) {
-    shape_arr[j] = enif_make_int(env, out_shape[j]);
+    shape_arr[j] = enif_make_uint64(env, out_shape[j]);
     out_len *= out_shape[j];
   }
   ERL_NIF_TERM shape = enif_make_tuple_from_array(env, shape_arr, out_dim);
-  ERL_NIF_TERM result_arr[out_len];
+  // Predictions can have as many values as the DMatrix, too many for the stack
+  result_arr = enif_alloc(sizeof(ERL_NIF_TERM) * (out_len + 1));
+  if (result_arr == NULL) {
+    return exg_error(env, "Failed to allocate memory");
+  }
   for (bst_ulong i = 0; i < out_len; ++i) {
     result_arr[i] = enif_make_double(env, out_result[i]);
   }
-  return exg_ok(env, enif_make_tuple2(
-                         env, shape,
-                         enif_make_list_from_array(env, result_arr, out_len)));
+  ret = exg_ok(env, enif_make_tuple2(
+                        env, shape,
+                        enif_make_list_from_array(env, result_arr, out_len)));
+  enif_free(result_arr);
+  return ret;
 }
 
 ERL_NIF_TERM EXGBoosterPredictFromDMatrix(ErlNifEnv *env, int argc,
@@ -651,7 +1221,15 @@ ERL_NIF_TERM EXGBoosterPredictFromDMatrix(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   dmatrix = *dmatrix_resource;
+  if (dmatrix == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGBoosterPredictFromDMatrix(booster, dmatrix, config, &out_shape,
                                        &out_dim, &out_result);
   if (result == 0) {
@@ -666,6 +1244,237 @@ END:
   return ret;
 }
 
+// Predicts like EXGBoosterPredictFromDMatrix, `chunk_rows` rows at a time, so
+// the prediction can be cancelled between row blocks. Each block is sliced out
+// of the DMatrix, which copies its rows, so this bounds the time between
+// cancellation checks, not memory. DMatrices that can't be sliced, such as
+// quantile DMatrices or those with more rows than the int row indices slicing
+// takes, are predicted whole after a single cancellation check.
+ERL_NIF_TERM EXGBoosterPredictChunked(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  BoosterHandle **booster_resource = NULL;
+  DMatrixHandle dmatrix;
+  DMatrixHandle **dmatrix_resource = NULL;
+  DMatrixHandle slice = NULL;
+  char *config = NULL;
+  int chunk_rows = 0;
+  exg_cancel_token *token = NULL;
+  bst_ulong num_rows = 0;
+  int *rows = NULL;
+  bst_ulong *shape = NULL;
+  bst_ulong dim = 0;
+  bst_ulong row_len = 1;
+  float *preds = NULL;
+  int whole = 0;
+  bst_ulong const *out_shape = NULL;
+  bst_ulong out_dim = 0;
+  float const *out_result = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (5 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
+                         (void *)&(dmatrix_resource))) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[2], &config)) {
+    ret = exg_error(env, "Config must be a JSON-encoded string");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[3], &chunk_rows) || chunk_rows <= 0) {
+    ret = exg_error(env, "Chunk rows must be a positive integer");
+    goto END;
+  }
+  if (!exg_get_cancel_token(env, argv[4], &token)) {
+    ret = exg_error(env, "Invalid CancelToken");
+    goto END;
+  }
+  booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  dmatrix = *dmatrix_resource;
+  if (dmatrix == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  if (XGDMatrixNumRow(dmatrix, &num_rows) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  rows = enif_alloc(sizeof(int) * chunk_rows);
+  if (rows == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  whole = num_rows > (bst_ulong)INT_MAX;
+  for (bst_ulong start = 0; !whole && (start < num_rows || start == 0);
+       start += chunk_rows) {
+    bst_ulong len = num_rows - start < (bst_ulong)chunk_rows
+                        ? num_rows - start
+                        : (bst_ulong)chunk_rows;
+    if (exg_cancelled(env, token)) {
+      ret = exg_error(env, "Cancelled");
+      goto END;
+    }
+    for (bst_ulong i = 0; i < len; ++i) {
+      rows[i] = (int)(start + i);
+    }
+    if (XGDMatrixSliceDMatrix(dmatrix, rows, len, &slice) != 0) {
+      // Only the first block can fail on the kind of DMatrix
+      if (start == 0) {
+        whole = 1;
+        break;
+      }
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+    if (XGBoosterPredictFromDMatrix(booster, slice, config, &out_shape,
+                                    &out_dim, &out_result) != 0) {
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+    if (shape == NULL) {
+      // Every block has the shape of the first past its row count
+      dim = out_dim;
+      shape = enif_alloc(sizeof(bst_ulong) * dim);
+      if (shape == NULL) {
+        ret = exg_error(env, "Failed to allocate memory");
+        goto END;
+      }
+      for (bst_ulong j = 1; j < dim; ++j) {
+        shape[j] = out_shape[j];
+        row_len *= out_shape[j];
+      }
+      shape[0] = num_rows;
+      preds = enif_alloc(sizeof(float) * (num_rows * row_len + 1));
+      if (preds == NULL) {
+        ret = exg_error(env, "Failed to allocate memory");
+        goto END;
+      }
+    }
+    memcpy(preds + start * row_len, out_result,
+           sizeof(float) * len * row_len);
+    XGDMatrixFree(slice);
+    slice = NULL;
+    if (num_rows == 0) {
+      break;
+    }
+  }
+  if (!whole) {
+    ret = collect_prediction_results(env, shape, dim, preds);
+    goto END;
+  }
+  if (exg_cancelled(env, token)) {
+    ret = exg_error(env, "Cancelled");
+    goto END;
+  }
+  if (XGBoosterPredictFromDMatrix(booster, dmatrix, config, &out_shape,
+                                  &out_dim, &out_result) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  ret = collect_prediction_results(env, (bst_ulong *)out_shape, out_dim,
+                                   (float *)out_result);
+END:
+  if (slice != NULL) {
+    XGDMatrixFree(slice);
+  }
+  if (preds != NULL) {
+    enif_free(preds);
+  }
+  if (shape != NULL) {
+    enif_free(shape);
+  }
+  if (rows != NULL) {
+    enif_free(rows);
+  }
+  if (config != NULL) {
+    enif_free(config);
+  }
+  return ret;
+}
+
+// Margins for a custom objective. XGBoost keeps the predictions of its
+// training DMatrix cached in a buffer owned by the booster and returns a
+// pointer into it, so the only copy made is the one into the returned binary,
+// which Nx can wrap without decoding a list of floats.
+ERL_NIF_TERM EXGBoosterPredictMargin(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  BoosterHandle **booster_resource = NULL;
+  DMatrixHandle dmatrix;
+  DMatrixHandle **dmatrix_resource = NULL;
+  int training = 0;
+  char config[128];
+  bst_ulong const *out_shape = NULL;
+  bst_ulong out_dim = 0;
+  float const *out_result = NULL;
+  bst_ulong out_len = 1;
+  ERL_NIF_TERM out_bin;
+  ERL_NIF_TERM shape_list;
+  ERL_NIF_TERM ret = -1;
+  if (3 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
+                         (void *)&(dmatrix_resource))) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  dmatrix = *dmatrix_resource;
+  if (dmatrix == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[2], &training)) {
+    ret = exg_error(env, "Training must be an integer");
+    goto END;
+  }
+  snprintf(config, sizeof(config),
+           "{\"type\": 1, \"training\": %s, \"iteration_begin\": 0, "
+           "\"iteration_end\": 0, \"strict_shape\": false}",
+           training ? "true" : "false");
+  if (XGBoosterPredictFromDMatrix(booster, dmatrix, config, &out_shape,
+                                  &out_dim, &out_result) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  for (bst_ulong j = 0; j < out_dim; ++j) {
+    out_len *= out_shape[j];
+  }
+  memcpy(enif_make_new_binary(env, out_len * sizeof(float), &out_bin),
+         out_result, out_len * sizeof(float));
+  shape_list = enif_make_list(env, 0);
+  for (bst_ulong j = out_dim; j > 0; --j) {
+    shape_list = enif_make_list_cell(
+        env, enif_make_uint64(env, out_shape[j - 1]), shape_list);
+  }
+  ret = exg_ok(env, enif_make_tuple2(env, shape_list, out_bin));
+END:
+  return ret;
+}
+
 ERL_NIF_TERM EXGBoosterPredictFromDense(ErlNifEnv *env, int argc,
                                         const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
@@ -703,6 +1512,10 @@ ERL_NIF_TERM EXGBoosterPredictFromDense(ErlNifEnv *env, int argc,
     proxy = *proxy_resource;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterPredictFromDense(booster, values, config, proxy, &out_shape,
                                      &out_dim, &out_result);
   if (result == 0) {
@@ -771,6 +1584,10 @@ ERL_NIF_TERM EXGBoosterPredictFromCSR(ErlNifEnv *env, int argc,
     proxy = *proxy_resource;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result =
       XGBoosterPredictFromCSR(booster, indptr, indices, data, ncols, config,
                               proxy, &out_shape, &out_dim, &out_result);
@@ -799,6 +1616,7 @@ ERL_NIF_TERM EXGBoosterLoadModel(ErlNifEnv *env, int argc,
                                  const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
   char *fname = NULL;
+  struct stat st;
   int result = -1;
   ERL_NIF_TERM ret = -1;
   if (1 != argc) {
@@ -816,7 +1634,9 @@ ERL_NIF_TERM EXGBoosterLoadModel(ErlNifEnv *env, int argc,
   }
   result = XGBoosterLoadModel(booster, fname);
   if (result == 0) {
-    ret = make_Booster_resource(env, booster);
+    // The file size is the serialized size, without serializing again
+    ret = make_Booster_resource_sized(
+        env, booster, stat(fname, &st) == 0 ? (uint64_t)st.st_size : 0);
   } else {
     ret = exg_error(env, XGBGetLastError());
   }
@@ -848,6 +1668,10 @@ ERL_NIF_TERM EXGBoosterSaveModel(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterSaveModel(booster, fname);
   if (result == 0) {
     ret = ok_atom(env);
@@ -864,7 +1688,7 @@ END:
 ERL_NIF_TERM EXGBoosterSerializeToBuffer(ErlNifEnv *env, int argc,
                                          const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
-  BoosterHandle **booster_resource = NULL;
+  exg_booster_resource *booster_resource = NULL;
   bst_ulong out_len = 0;
   char *out_buf = NULL;
   int result = -1;
@@ -879,12 +1703,18 @@ ERL_NIF_TERM EXGBoosterSerializeToBuffer(ErlNifEnv *env, int argc,
     ret = exg_error(env, "Invalid Booster");
     goto END;
   }
-  booster = *booster_resource;
+  booster = booster_resource->handle;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterSerializeToBuffer(booster, &out_len, &out_buf);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
     goto END;
   }
+  // The serialized size is the footprint estimate, so refresh it for free
+  exg_set_footprint(&booster_resource->footprint, out_len);
   if (!enif_alloc_binary(out_len, &out_bin)) {
     ret = exg_error(env, "Failed to allocate binary");
     goto END;
@@ -894,10 +1724,64 @@ ERL_NIF_TERM EXGBoosterSerializeToBuffer(ErlNifEnv *env, int argc,
 END:
   return ret;
 }
+ERL_NIF_TERM EXGBoosterMemory(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]) {
+  exg_booster_resource *resource = NULL;
+  uint64_t footprint = 0;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  // Boosters grow with every round, so re-measure on each call
+  footprint = exg_booster_footprint(resource->handle);
+  exg_set_footprint(&resource->footprint, footprint);
+  ret = exg_ok(env, enif_make_uint64(env, footprint));
+END:
+  return ret;
+}
+
+// Frees the Booster now rather than when the resource is garbage collected.
+// Freeing again is a no-op. Must not race with other calls using the Booster.
+ERL_NIF_TERM EXGBoosterFree(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]) {
+  exg_booster_resource *resource = NULL;
+  BoosterHandle handle = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  if (atomic_exchange(&resource->freed, 1)) {
+    ret = ok_atom(env);
+    goto END;
+  }
+  handle = resource->handle;
+  resource->handle = NULL;
+  exg_set_footprint(&resource->footprint, 0);
+  if (XGBoosterFree(handle) == 0) {
+    ret = ok_atom(env);
+  } else {
+    ret = exg_error(env, XGBGetLastError());
+  }
+END:
+  return ret;
+}
+
+// XGBoost parses the binary in place, it is only read during the call
 ERL_NIF_TERM EXGBoosterDeserializeFromBuffer(ErlNifEnv *env, int argc,
                                              const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
-  char *buf = NULL;
   int result = -1;
   ERL_NIF_TERM ret = -1;
   ErlNifBinary bin;
@@ -909,30 +1793,61 @@ ERL_NIF_TERM EXGBoosterDeserializeFromBuffer(ErlNifEnv *env, int argc,
     ret = exg_error(env, "Buf must be a binary");
     goto END;
   }
-  buf = (char *)enif_alloc(bin.size + 1);
-  memcpy(buf, bin.data, bin.size);
   result = XGBoosterCreate(NULL, 0, &booster);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
     goto END;
   }
-  result = XGBoosterUnserializeFromBuffer(booster, buf, bin.size);
+  result = XGBoosterUnserializeFromBuffer(booster, bin.data, bin.size);
   if (result == 0) {
-    ret = make_Booster_resource(env, booster);
+    ret = make_Booster_resource_sized(env, booster, bin.size);
   } else {
     ret = exg_error(env, XGBGetLastError());
+    XGBoosterFree(booster);
   }
 END:
-  if (buf != NULL) {
-    enif_free(buf);
+  return ret;
+}
+
+// Unserializes `buf` into an existing Booster, replacing its model and
+// config, so references to it see the restored booster
+ERL_NIF_TERM EXGBoosterRestoreFromBuffer(ErlNifEnv *env, int argc,
+                                         const ERL_NIF_TERM argv[]) {
+  exg_booster_resource *resource = NULL;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  ErlNifBinary bin;
+  if (2 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[1], &bin)) {
+    ret = exg_error(env, "Buf must be a binary");
+    goto END;
   }
+  if (resource->handle == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  result = XGBoosterUnserializeFromBuffer(resource->handle, bin.data, bin.size);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  exg_set_footprint(&resource->footprint, bin.size);
+  ret = ok_atom(env);
+END:
   return ret;
 }
 
 ERL_NIF_TERM EXGBoosterLoadModelFromBuffer(ErlNifEnv *env, int argc,
                                            const ERL_NIF_TERM argv[]) {
   BoosterHandle booster;
-  char *buf = NULL;
   int result = -1;
   ERL_NIF_TERM ret = -1;
   ErlNifBinary bin;
@@ -944,22 +1859,116 @@ ERL_NIF_TERM EXGBoosterLoadModelFromBuffer(ErlNifEnv *env, int argc,
     ret = exg_error(env, "Buf must be a binary");
     goto END;
   }
-  buf = (char *)enif_alloc(bin.size + 1);
-  memcpy(buf, bin.data, bin.size);
   result = XGBoosterCreate(NULL, 0, &booster);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
     goto END;
   }
-  result = XGBoosterLoadModelFromBuffer(booster, buf, bin.size);
+  result = XGBoosterLoadModelFromBuffer(booster, bin.data, bin.size);
   if (result == 0) {
-    ret = make_Booster_resource(env, booster);
+    ret = make_Booster_resource_sized(env, booster, bin.size);
   } else {
     ret = exg_error(env, XGBGetLastError());
+    XGBoosterFree(booster);
   }
 END:
-  if (buf != NULL) {
-    enif_free(buf);
+  return ret;
+}
+
+// Loads a booster from a model file mapped into memory, so that XGBoost parses
+// the page cache directly rather than a copy of the file. `serialized` selects
+// XGBoosterUnserializeFromBuffer (model and config) over
+// XGBoosterLoadModelFromBuffer (model only). Returns
+// `{booster, size, load_ns, rss_before, rss_after, peak_rss}`.
+ERL_NIF_TERM EXGBoosterLoadModelMmap(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster = NULL;
+  char *fname = NULL;
+  int serialized = 0;
+  int fd = -1;
+  struct stat st;
+  void *map = MAP_FAILED;
+  uint64_t rss_before = 0;
+  ErlNifTime started = 0;
+  int result = -1;
+  const ERL_NIF_TERM *made = NULL;
+  int arity = 0;
+  ERL_NIF_TERM stats[6];
+  ERL_NIF_TERM ret = -1;
+  if (2 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[0], &fname)) {
+    ret = exg_error(env, "Fname must be a string representing a file path");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[1], &serialized)) {
+    ret = exg_error(env, "Serialized must be an integer");
+    goto END;
+  }
+  fd = open(fname, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    ret = exg_error(env, "Failed to open model file");
+    goto END;
+  }
+  if (st.st_size == 0) {
+    ret = exg_error(env, "Model file is empty");
+    goto END;
+  }
+  rss_before = exg_process_rss();
+  started = enif_monotonic_time(ERL_NIF_NSEC);
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    ret = exg_error(env, "Failed to map model file");
+    goto END;
+  }
+  // The model is parsed front to back once
+  posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+  result = XGBoosterCreate(NULL, 0, &booster);
+  if (result != 0) {
+    booster = NULL;
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  result = serialized ? XGBoosterUnserializeFromBuffer(booster, map,
+                                                       (bst_ulong)st.st_size)
+                      : XGBoosterLoadModelFromBuffer(booster, map,
+                                                     (bst_ulong)st.st_size);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  // Unmapped before measuring, so the file's pages don't count towards the
+  // resident size left by the load
+  munmap(map, (size_t)st.st_size);
+  map = MAP_FAILED;
+  stats[2] = enif_make_int64(env, enif_monotonic_time(ERL_NIF_NSEC) - started);
+  ret = make_Booster_resource_sized(env, booster, (uint64_t)st.st_size);
+  // Handed over to the resource
+  booster = NULL;
+  if (!enif_get_tuple(env, ret, &arity, &made) ||
+      !enif_is_identical(made[0], ok_atom(env))) {
+    goto END;
+  }
+  stats[0] = made[1];
+  stats[1] = enif_make_uint64(env, (uint64_t)st.st_size);
+  stats[3] = enif_make_uint64(env, rss_before);
+  stats[4] = enif_make_uint64(env, exg_process_rss());
+  stats[5] = enif_make_uint64(env, exg_process_peak_rss());
+  ret = exg_ok(env, enif_make_tuple_from_array(env, stats, 6));
+END:
+  if (booster != NULL) {
+    XGBoosterFree(booster);
+  }
+  if (map != MAP_FAILED) {
+    munmap(map, (size_t)st.st_size);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (fname != NULL) {
+    enif_free(fname);
   }
   return ret;
 }
@@ -989,6 +1998,10 @@ ERL_NIF_TERM EXGBoosterSaveModelToBuffer(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterSaveModelToBuffer(booster, config, &out_len, &out_buf);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
@@ -1026,6 +2039,10 @@ ERL_NIF_TERM EXGBoosterSaveJsonConfig(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterSaveJsonConfig(booster, &out_len, &out_buf);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
@@ -1065,6 +2082,10 @@ ERL_NIF_TERM EXGBoosterLoadJsonConfig(ErlNifEnv *env, int argc,
   buf = (char *)enif_alloc(bin.size + 1);
   memcpy(buf, bin.data, bin.size);
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterLoadJsonConfig(booster, buf);
   if (result == 0) {
     ret = ok_atom(env);
@@ -1111,6 +2132,10 @@ ERL_NIF_TERM EXGBoosterDumpModelEx(ErlNifEnv *env, int argc,
     goto END;
   }
   booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
   result = XGBoosterDumpModelEx(booster, fmap, with_stats, format, &out_len,
                                 &out_dump_array);
   if (result == 0) {
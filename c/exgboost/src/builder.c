@@ -0,0 +1,761 @@
+#include "builder.h"
+#include <math.h>
+
+#define EXG_ARRAY_INTERFACE_SIZE 128
+
+static int is_missing(float value, float missing) {
+  return value != value || value == missing;
+}
+
+// Allocates a chunk and all of its arrays in a single block
+static exg_builder_chunk *alloc_chunk(bst_ulong nrow, bst_ulong nnz,
+                                      int has_labels, int has_weights) {
+  size_t size = sizeof(exg_builder_chunk) + sizeof(uint64_t) * (nrow + 1) +
+                sizeof(float) * nnz + sizeof(unsigned) * nnz +
+                sizeof(float) * nrow * (has_labels + has_weights);
+  exg_builder_chunk *chunk = enif_alloc(size);
+  char *cursor = NULL;
+  if (chunk == NULL) {
+    return NULL;
+  }
+  cursor = (char *)(chunk + 1);
+  chunk->next = NULL;
+  chunk->refs = 1;
+  chunk->nrow = nrow;
+  chunk->nnz = nnz;
+  chunk->timestamp = enif_monotonic_time(ERL_NIF_SEC);
+  chunk->indptr = (uint64_t *)cursor;
+  cursor += sizeof(uint64_t) * (nrow + 1);
+  chunk->values = (float *)cursor;
+  cursor += sizeof(float) * nnz;
+  chunk->indices = (unsigned *)cursor;
+  cursor += sizeof(unsigned) * nnz;
+  chunk->labels = has_labels ? (float *)cursor : NULL;
+  cursor += has_labels ? sizeof(float) * nrow : 0;
+  chunk->weights = has_weights ? (float *)cursor : NULL;
+  return chunk;
+}
+
+// Must be called with the builder lock held
+static void release_chunk(exg_builder_chunk *chunk) {
+  if (--chunk->refs == 0) {
+    enif_free(chunk);
+  }
+}
+
+static void drop_head(exg_builder *builder) {
+  exg_builder_chunk *head = builder->head;
+  builder->nrow -= head->nrow - builder->head_offset;
+  builder->nnz -= head->indptr[head->nrow] - head->indptr[builder->head_offset];
+  builder->head_offset = 0;
+  builder->head = head->next;
+  if (builder->head == NULL) {
+    builder->tail = NULL;
+  }
+  release_chunk(head);
+}
+
+// Must be called with the builder lock held
+static void evict(exg_builder *builder) {
+  if (builder->max_age > 0) {
+    ErlNifSInt64 now = enif_monotonic_time(ERL_NIF_SEC);
+    while (builder->head != NULL &&
+           now - builder->head->timestamp > builder->max_age) {
+      drop_head(builder);
+    }
+  }
+  if (builder->max_rows > 0) {
+    while (builder->nrow > builder->max_rows) {
+      exg_builder_chunk *head = builder->head;
+      bst_ulong excess = builder->nrow - builder->max_rows;
+      if (excess >= head->nrow - builder->head_offset) {
+        drop_head(builder);
+      } else {
+        builder->nnz -= head->indptr[builder->head_offset + excess] -
+                        head->indptr[builder->head_offset];
+        builder->head_offset += excess;
+        builder->nrow -= excess;
+      }
+    }
+  }
+}
+
+// Must be called with the builder lock held
+static void append_chunk(exg_builder *builder, exg_builder_chunk *chunk) {
+  if (builder->tail == NULL) {
+    builder->head = chunk;
+  } else {
+    builder->tail->next = chunk;
+  }
+  builder->tail = chunk;
+  builder->nrow += chunk->nrow;
+  builder->nnz += chunk->nnz;
+  evict(builder);
+}
+
+// Labels and weights are optional, but once the first batch decides whether
+// they are present every following batch must agree.
+static const char *check_meta(exg_builder *builder, int has_labels,
+                              int has_weights) {
+  if (builder->has_labels == -1) {
+    builder->has_labels = has_labels;
+    builder->has_weights = has_weights;
+    return NULL;
+  }
+  if (builder->has_labels != has_labels) {
+    return "Every batch must either have labels or not";
+  }
+  if (builder->has_weights != has_weights) {
+    return "Every batch must either have weights or not";
+  }
+  return NULL;
+}
+
+// Reads an optional per-row float binary. An empty binary means absent.
+static int get_row_floats(ErlNifEnv *env, ERL_NIF_TERM term, bst_ulong nrow,
+                          ErlNifBinary *bin, int *present) {
+  if (!enif_inspect_binary(env, term, bin)) {
+    return 0;
+  }
+  *present = bin->size > 0;
+  return bin->size == 0 || bin->size == sizeof(float) * nrow;
+}
+
+void Builder_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg) {
+  exg_builder *builder = (exg_builder *)arg;
+  while (builder->head != NULL) {
+    drop_head(builder);
+  }
+  if (builder->lock != NULL) {
+    enif_mutex_destroy(builder->lock);
+    builder->lock = NULL;
+  }
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderCreate(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  ErlNifUInt64 ncol = 0;
+  ErlNifUInt64 max_rows = 0;
+  ErlNifSInt64 max_age = 0;
+  double missing = 0.0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 4) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[0], &ncol) || ncol == 0) {
+    ret = exg_error(env, "ncol must be a positive integer");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[1], &max_rows)) {
+    ret = exg_error(env, "max_rows must be a non-negative integer");
+    goto END;
+  }
+  if (!enif_get_int64(env, argv[2], &max_age) || max_age < 0) {
+    ret = exg_error(env, "max_age must be a non-negative integer");
+    goto END;
+  }
+  // nil means only NaN is treated as missing
+  if (enif_is_identical(argv[3], enif_make_atom(env, "nil"))) {
+    missing = NAN;
+  } else if (!enif_get_double(env, argv[3], &missing)) {
+    ret = exg_error(env, "missing must be a float or nil");
+    goto END;
+  }
+  builder = enif_alloc_resource(Builder_RESOURCE_TYPE, sizeof(exg_builder));
+  if (builder == NULL) {
+    ret = exg_error(env, "Failed to allocate memory for DMatrix builder");
+    goto END;
+  }
+  memset(builder, 0, sizeof(exg_builder));
+  builder->ncol = ncol;
+  builder->max_rows = max_rows;
+  builder->max_age = max_age;
+  builder->missing = (float)missing;
+  builder->has_labels = -1;
+  builder->has_weights = -1;
+  builder->lock = enif_mutex_create("exgboost.dmatrix_builder");
+  if (builder->lock == NULL) {
+    ret = exg_error(env, "Failed to create DMatrix builder lock");
+    goto END;
+  }
+  ret = exg_ok(env, enif_make_resource(env, builder));
+END:
+  if (builder != NULL) {
+    enif_release_resource(builder);
+  }
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderPushDense(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  exg_builder_chunk *chunk = NULL;
+  ErlNifBinary data;
+  ErlNifBinary labels;
+  ErlNifBinary weights;
+  int has_labels = 0;
+  int has_weights = 0;
+  ErlNifUInt64 nrow = 0;
+  bst_ulong nnz = 0;
+  uint64_t bytes = 0;
+  const float *values = NULL;
+  const char *err = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 5) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[1], &data)) {
+    ret = exg_error(env, "Data must be a binary of f32");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[2], &nrow)) {
+    ret = exg_error(env, "nrow must be a non-negative integer");
+    goto END;
+  }
+  if (!exg_mul_size(nrow, builder->ncol, &bytes) ||
+      !exg_mul_size(bytes, sizeof(float), &bytes) || data.size != bytes) {
+    ret = exg_error(env, "Data size does not match nrow * ncol");
+    goto END;
+  }
+  if (!get_row_floats(env, argv[3], nrow, &labels, &has_labels)) {
+    ret = exg_error(env, "Labels must be an empty binary or one f32 per row");
+    goto END;
+  }
+  if (!get_row_floats(env, argv[4], nrow, &weights, &has_weights)) {
+    ret = exg_error(env, "Weights must be an empty binary or one f32 per row");
+    goto END;
+  }
+  if (nrow == 0) {
+    ret = ok_atom(env);
+    goto END;
+  }
+  // Missing values are dropped here so every chunk is stored as CSR, which
+  // lets dense and sparse batches share a single buffer.
+  values = (const float *)data.data;
+  for (bst_ulong i = 0; i < nrow * builder->ncol; ++i) {
+    nnz += !is_missing(values[i], builder->missing);
+  }
+  chunk = alloc_chunk(nrow, nnz, has_labels, has_weights);
+  if (chunk == NULL) {
+    ret = exg_error(env, "Failed to allocate memory for DMatrix builder");
+    goto END;
+  }
+  nnz = 0;
+  chunk->indptr[0] = 0;
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    const float *row = values + r * builder->ncol;
+    for (bst_ulong c = 0; c < builder->ncol; ++c) {
+      if (!is_missing(row[c], builder->missing)) {
+        chunk->indices[nnz] = (unsigned)c;
+        chunk->values[nnz] = row[c];
+        ++nnz;
+      }
+    }
+    chunk->indptr[r + 1] = nnz;
+  }
+  if (has_labels) {
+    memcpy(chunk->labels, labels.data, labels.size);
+  }
+  if (has_weights) {
+    memcpy(chunk->weights, weights.data, weights.size);
+  }
+  enif_mutex_lock(builder->lock);
+  err = check_meta(builder, has_labels, has_weights);
+  if (err == NULL) {
+    append_chunk(builder, chunk);
+    chunk = NULL;
+  }
+  enif_mutex_unlock(builder->lock);
+  ret = err == NULL ? ok_atom(env) : exg_error(env, err);
+END:
+  if (chunk != NULL) {
+    enif_free(chunk);
+  }
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderPushCSR(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  exg_builder_chunk *chunk = NULL;
+  ErlNifBinary indptr_bin;
+  ErlNifBinary indices_bin;
+  ErlNifBinary values_bin;
+  ErlNifBinary labels;
+  ErlNifBinary weights;
+  int has_labels = 0;
+  int has_weights = 0;
+  bst_ulong nrow = 0;
+  bst_ulong nnz = 0;
+  const uint64_t *indptr = NULL;
+  const unsigned *indices = NULL;
+  const float *values = NULL;
+  const char *err = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 6) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[1], &indptr_bin) ||
+      indptr_bin.size < sizeof(uint64_t) ||
+      indptr_bin.size % sizeof(uint64_t) != 0) {
+    ret = exg_error(env, "Indptr must be a non-empty binary of u64");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[2], &indices_bin) ||
+      indices_bin.size % sizeof(unsigned) != 0) {
+    ret = exg_error(env, "Indices must be a binary of u32");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[3], &values_bin) ||
+      values_bin.size != sizeof(float) * (indices_bin.size / sizeof(unsigned))) {
+    ret = exg_error(env, "Values must be a binary of f32 matching indices");
+    goto END;
+  }
+  nrow = indptr_bin.size / sizeof(uint64_t) - 1;
+  indptr = (const uint64_t *)indptr_bin.data;
+  indices = (const unsigned *)indices_bin.data;
+  values = (const float *)values_bin.data;
+  if (indptr[0] != 0 || indptr[nrow] != indices_bin.size / sizeof(unsigned)) {
+    ret = exg_error(env, "Indptr must start at 0 and end at the number of "
+                         "values");
+    goto END;
+  }
+  if (!get_row_floats(env, argv[4], nrow, &labels, &has_labels)) {
+    ret = exg_error(env, "Labels must be an empty binary or one f32 per row");
+    goto END;
+  }
+  if (!get_row_floats(env, argv[5], nrow, &weights, &has_weights)) {
+    ret = exg_error(env, "Weights must be an empty binary or one f32 per row");
+    goto END;
+  }
+  // Every offset must be within the indices before any of them is followed
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    if (indptr[r + 1] < indptr[r]) {
+      ret = exg_error(env, "Indptr must be non-decreasing");
+      goto END;
+    }
+  }
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    for (uint64_t j = indptr[r]; j < indptr[r + 1]; ++j) {
+      if (indices[j] >= builder->ncol) {
+        ret = exg_error(env, "Column index out of range");
+        goto END;
+      }
+      nnz += !is_missing(values[j], builder->missing);
+    }
+  }
+  if (nrow == 0) {
+    ret = ok_atom(env);
+    goto END;
+  }
+  chunk = alloc_chunk(nrow, nnz, has_labels, has_weights);
+  if (chunk == NULL) {
+    ret = exg_error(env, "Failed to allocate memory for DMatrix builder");
+    goto END;
+  }
+  nnz = 0;
+  chunk->indptr[0] = 0;
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    for (uint64_t j = indptr[r]; j < indptr[r + 1]; ++j) {
+      if (!is_missing(values[j], builder->missing)) {
+        chunk->indices[nnz] = indices[j];
+        chunk->values[nnz] = values[j];
+        ++nnz;
+      }
+    }
+    chunk->indptr[r + 1] = nnz;
+  }
+  if (has_labels) {
+    memcpy(chunk->labels, labels.data, labels.size);
+  }
+  if (has_weights) {
+    memcpy(chunk->weights, weights.data, weights.size);
+  }
+  enif_mutex_lock(builder->lock);
+  err = check_meta(builder, has_labels, has_weights);
+  if (err == NULL) {
+    append_chunk(builder, chunk);
+    chunk = NULL;
+  }
+  enif_mutex_unlock(builder->lock);
+  ret = err == NULL ? ok_atom(env) : exg_error(env, err);
+END:
+  if (chunk != NULL) {
+    enif_free(chunk);
+  }
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderNumRow(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  bst_ulong nrow = 0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 1) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  enif_mutex_lock(builder->lock);
+  nrow = builder->nrow;
+  enif_mutex_unlock(builder->lock);
+  ret = exg_ok(env, enif_make_uint64(env, nrow));
+END:
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderEvict(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  bst_ulong nrow = 0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 1) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  enif_mutex_lock(builder->lock);
+  evict(builder);
+  nrow = builder->nrow;
+  enif_mutex_unlock(builder->lock);
+  ret = exg_ok(env, enif_make_uint64(env, nrow));
+END:
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderToDMatrix(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  DMatrixHandle out = NULL;
+  char *config = NULL;
+  uint64_t *indptr = NULL;
+  unsigned *indices = NULL;
+  float *values = NULL;
+  float *labels = NULL;
+  float *weights = NULL;
+  bst_ulong nrow = 0;
+  bst_ulong nnz = 0;
+  bst_ulong ncol = 0;
+  char indptr_interface[EXG_ARRAY_INTERFACE_SIZE];
+  char indices_interface[EXG_ARRAY_INTERFACE_SIZE];
+  char values_interface[EXG_ARRAY_INTERFACE_SIZE];
+  int locked = 0;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 2) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[1], &config)) {
+    ret = exg_error(env, "Config must be a JSON-encoded string");
+    goto END;
+  }
+  enif_mutex_lock(builder->lock);
+  locked = 1;
+  evict(builder);
+  nrow = builder->nrow;
+  nnz = builder->nnz;
+  ncol = builder->ncol;
+  if (nrow == 0) {
+    ret = exg_error(env, "DMatrix builder is empty");
+    goto END;
+  }
+  indptr = enif_alloc(sizeof(uint64_t) * (nrow + 1));
+  indices = enif_alloc(sizeof(unsigned) * (nnz > 0 ? nnz : 1));
+  values = enif_alloc(sizeof(float) * (nnz > 0 ? nnz : 1));
+  if (builder->has_labels) {
+    labels = enif_alloc(sizeof(float) * nrow);
+  }
+  if (builder->has_weights) {
+    weights = enif_alloc(sizeof(float) * nrow);
+  }
+  if (!indptr || !indices || !values || (builder->has_labels && !labels) ||
+      (builder->has_weights && !weights)) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  // Gather the live rows of every chunk into one CSR matrix, rebasing the
+  // row pointers as we go.
+  {
+    bst_ulong row = 0;
+    bst_ulong pos = 0;
+    bst_ulong offset = builder->head_offset;
+    indptr[0] = 0;
+    for (exg_builder_chunk *chunk = builder->head; chunk != NULL;
+         chunk = chunk->next) {
+      uint64_t begin = chunk->indptr[offset];
+      uint64_t len = chunk->indptr[chunk->nrow] - begin;
+      bst_ulong rows = chunk->nrow - offset;
+      memcpy(indices + pos, chunk->indices + begin, sizeof(unsigned) * len);
+      memcpy(values + pos, chunk->values + begin, sizeof(float) * len);
+      for (bst_ulong r = 0; r < rows; ++r) {
+        indptr[row + r + 1] = pos + chunk->indptr[offset + r + 1] - begin;
+      }
+      if (labels != NULL) {
+        memcpy(labels + row, chunk->labels + offset, sizeof(float) * rows);
+      }
+      if (weights != NULL) {
+        memcpy(weights + row, chunk->weights + offset, sizeof(float) * rows);
+      }
+      row += rows;
+      pos += len;
+      offset = 0;
+    }
+  }
+  enif_mutex_unlock(builder->lock);
+  locked = 0;
+  if (!exg_make_array_interface(indptr_interface, EXG_ARRAY_INTERFACE_SIZE,
+                                indptr, nrow + 1, "<u8") ||
+      !exg_make_array_interface(indices_interface, EXG_ARRAY_INTERFACE_SIZE,
+                                indices, nnz, "<u4") ||
+      !exg_make_array_interface(values_interface, EXG_ARRAY_INTERFACE_SIZE,
+                                values, nnz, "<f4")) {
+    ret = exg_error(env, "Failed to build array interface");
+    goto END;
+  }
+  result = XGDMatrixCreateFromCSR(indptr_interface, indices_interface,
+                                  values_interface, ncol, config, &out);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  if (labels != NULL) {
+    result = XGDMatrixSetDenseInfo(out, "label", labels, nrow, 1);
+  }
+  if (result == 0 && weights != NULL) {
+    result = XGDMatrixSetDenseInfo(out, "weight", weights, nrow, 1);
+  }
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    XGDMatrixFree(out);
+    goto END;
+  }
+  ret = make_DMatrix_resource(env, out);
+END:
+  if (locked) {
+    enif_mutex_unlock(builder->lock);
+  }
+  if (config != NULL) {
+    enif_free(config);
+  }
+  if (indptr != NULL) {
+    enif_free(indptr);
+  }
+  if (indices != NULL) {
+    enif_free(indices);
+  }
+  if (values != NULL) {
+    enif_free(values);
+  }
+  if (labels != NULL) {
+    enif_free(labels);
+  }
+  if (weights != NULL) {
+    enif_free(weights);
+  }
+  return ret;
+}
+
+// A snapshot of the buffered chunks, each holding a reference, so the sketch
+// reads them without the builder lock while pushes and evictions go on
+typedef struct {
+  exg_builder_chunk **chunks;
+  size_t num_chunks;
+  size_t next;
+  bst_ulong head_offset;
+  bst_ulong ncol;
+  DMatrixHandle proxy;
+  // Rebased row pointers for the partially evicted head chunk
+  uint64_t *head_indptr;
+} exg_builder_iter;
+
+static void builder_iter_reset(DataIterHandle handle) {
+  exg_builder_iter *iter = (exg_builder_iter *)handle;
+  iter->next = 0;
+}
+
+// Hands the chunks to XGBoost one at a time through the proxy DMatrix, so
+// the quantile sketch is built without first concatenating the batches.
+static int builder_iter_next(DataIterHandle handle) {
+  exg_builder_iter *iter = (exg_builder_iter *)handle;
+  exg_builder_chunk *chunk = NULL;
+  bst_ulong offset = 0;
+  uint64_t begin = 0;
+  const uint64_t *indptr = NULL;
+  char indptr_interface[EXG_ARRAY_INTERFACE_SIZE];
+  char indices_interface[EXG_ARRAY_INTERFACE_SIZE];
+  char values_interface[EXG_ARRAY_INTERFACE_SIZE];
+  bst_ulong rows = 0;
+  if (iter->next == iter->num_chunks) {
+    return 0;
+  }
+  chunk = iter->chunks[iter->next++];
+  if (iter->next == 1 && iter->head_offset > 0) {
+    offset = iter->head_offset;
+    indptr = iter->head_indptr;
+  } else {
+    indptr = chunk->indptr;
+  }
+  begin = chunk->indptr[offset];
+  rows = chunk->nrow - offset;
+  exg_make_array_interface(indptr_interface, EXG_ARRAY_INTERFACE_SIZE, indptr,
+                           rows + 1, "<u8");
+  exg_make_array_interface(indices_interface, EXG_ARRAY_INTERFACE_SIZE,
+                           chunk->indices + begin,
+                           chunk->indptr[chunk->nrow] - begin, "<u4");
+  exg_make_array_interface(values_interface, EXG_ARRAY_INTERFACE_SIZE,
+                           chunk->values + begin,
+                           chunk->indptr[chunk->nrow] - begin, "<f4");
+  XGProxyDMatrixSetDataCSR(iter->proxy, indptr_interface, indices_interface,
+                           values_interface, iter->ncol);
+  if (chunk->labels != NULL) {
+    XGDMatrixSetDenseInfo(iter->proxy, "label", chunk->labels + offset, rows,
+                          1);
+  }
+  if (chunk->weights != NULL) {
+    XGDMatrixSetDenseInfo(iter->proxy, "weight", chunk->weights + offset,
+                          rows, 1);
+  }
+  return 1;
+}
+
+ERL_NIF_TERM EXGDMatrixBuilderToQuantileDMatrix(ErlNifEnv *env, int argc,
+                                                const ERL_NIF_TERM argv[]) {
+  exg_builder *builder = NULL;
+  exg_builder_iter iter;
+  DMatrixHandle ref = NULL;
+  DMatrixHandle **ref_resource = NULL;
+  DMatrixHandle out = NULL;
+  char *config = NULL;
+  size_t num_chunks = 0;
+  int locked = 0;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  memset(&iter, 0, sizeof(iter));
+  if (argc != 3) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Builder_RESOURCE_TYPE,
+                         (void *)&builder)) {
+    ret = exg_error(env, "Builder must be a resource");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[1], &config)) {
+    ret = exg_error(env, "Config must be a JSON-encoded string");
+    goto END;
+  }
+  // The reference DMatrix is optional and provides the quantile cuts when
+  // building validation data
+  if (enif_get_resource(env, argv[2], DMatrix_RESOURCE_TYPE,
+                        (void *)&ref_resource)) {
+    ref = *ref_resource;
+    if (ref == NULL) {
+      ret = exg_error(env, "DMatrix has been freed");
+      goto END;
+    }
+  } else if (!enif_is_identical(argv[2], enif_make_atom(env, "nil"))) {
+    ret = exg_error(env, "Reference must be a DMatrix resource or nil");
+    goto END;
+  }
+  result = XGProxyDMatrixCreate(&iter.proxy);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  enif_mutex_lock(builder->lock);
+  locked = 1;
+  evict(builder);
+  if (builder->nrow == 0) {
+    ret = exg_error(env, "DMatrix builder is empty");
+    goto END;
+  }
+  for (exg_builder_chunk *chunk = builder->head; chunk != NULL;
+       chunk = chunk->next) {
+    ++num_chunks;
+  }
+  iter.chunks = enif_alloc(sizeof(exg_builder_chunk *) * num_chunks);
+  if (iter.chunks == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  if (builder->head_offset > 0) {
+    exg_builder_chunk *head = builder->head;
+    bst_ulong rows = head->nrow - builder->head_offset;
+    uint64_t begin = head->indptr[builder->head_offset];
+    iter.head_indptr = enif_alloc(sizeof(uint64_t) * (rows + 1));
+    if (iter.head_indptr == NULL) {
+      ret = exg_error(env, "Failed to allocate memory");
+      goto END;
+    }
+    for (bst_ulong r = 0; r <= rows; ++r) {
+      iter.head_indptr[r] = head->indptr[builder->head_offset + r] - begin;
+    }
+  }
+  for (exg_builder_chunk *chunk = builder->head; chunk != NULL;
+       chunk = chunk->next) {
+    ++chunk->refs;
+    iter.chunks[iter.num_chunks++] = chunk;
+  }
+  iter.head_offset = builder->head_offset;
+  iter.ncol = builder->ncol;
+  enif_mutex_unlock(builder->lock);
+  locked = 0;
+  result = XGQuantileDMatrixCreateFromCallback(
+      &iter, iter.proxy, ref, builder_iter_reset, builder_iter_next, config,
+      &out);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  ret = make_DMatrix_resource(env, out);
+END:
+  if (locked) {
+    enif_mutex_unlock(builder->lock);
+  }
+  if (iter.proxy != NULL) {
+    XGDMatrixFree(iter.proxy);
+  }
+  if (iter.head_indptr != NULL) {
+    enif_free(iter.head_indptr);
+  }
+  if (iter.chunks != NULL) {
+    enif_mutex_lock(builder->lock);
+    for (size_t i = 0; i < iter.num_chunks; ++i) {
+      release_chunk(iter.chunks[i]);
+    }
+    enif_mutex_unlock(builder->lock);
+    enif_free(iter.chunks);
+  }
+  if (config != NULL) {
+    enif_free(config);
+  }
+  return ret;
+}
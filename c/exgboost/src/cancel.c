@@ -0,0 +1,86 @@
+#include "cancel.h"
+
+static void cancel_token_down(ErlNifEnv *env, void *obj, ErlNifPid *pid,
+                              ErlNifMonitor *monitor) {
+  atomic_store(&((exg_cancel_token *)obj)->cancelled, 1);
+}
+
+ErlNifResourceType *exg_open_cancel_token_type(ErlNifEnv *env,
+                                               ErlNifResourceFlags flags) {
+  ErlNifResourceTypeInit init = {NULL, NULL, cancel_token_down};
+  return enif_open_resource_type_x(env, "CancelToken_RESOURCE_TYPE", &init,
+                                   flags, NULL);
+}
+
+int exg_get_cancel_token(ErlNifEnv *env, ERL_NIF_TERM term,
+                         exg_cancel_token **token) {
+  if (enif_is_identical(term, enif_make_atom(env, "nil"))) {
+    *token = NULL;
+    return 1;
+  }
+  return enif_get_resource(env, term, CancelToken_RESOURCE_TYPE,
+                           (void *)token);
+}
+
+int exg_cancelled(ErlNifEnv *env, exg_cancel_token *token) {
+  if (token != NULL && atomic_load(&token->cancelled)) {
+    return 1;
+  }
+  // Calls handed to the communicator thread have no calling process there
+  return exg_caller_env(env) != NULL && !enif_is_current_process_alive(env);
+}
+
+ERL_NIF_TERM exg_cancel_token_create(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  ErlNifPid pid;
+  exg_cancel_token *token = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_local_pid(env, argv[0], &pid)) {
+    return exg_error(env, "Pid must be a local pid");
+  }
+  token = enif_alloc_resource(CancelToken_RESOURCE_TYPE,
+                              sizeof(exg_cancel_token));
+  if (token == NULL) {
+    return exg_error(env, "Failed to allocate memory");
+  }
+  atomic_init(&token->cancelled, 0);
+  // Non-zero when the process is already gone
+  if (enif_monitor_process(env, token, &pid, &token->monitor) != 0) {
+    atomic_store(&token->cancelled, 1);
+  }
+  ret = exg_ok(env, enif_make_resource(env, token));
+  enif_release_resource(token);
+  return ret;
+}
+
+ERL_NIF_TERM exg_cancel_token_cancel(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  exg_cancel_token *token = NULL;
+  if (1 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_resource(env, argv[0], CancelToken_RESOURCE_TYPE,
+                         (void *)&token)) {
+    return exg_error(env, "Invalid CancelToken");
+  }
+  atomic_store(&token->cancelled, 1);
+  return ok_atom(env);
+}
+
+ERL_NIF_TERM exg_cancel_token_cancelled(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]) {
+  exg_cancel_token *token = NULL;
+  if (1 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_resource(env, argv[0], CancelToken_RESOURCE_TYPE,
+                         (void *)&token)) {
+    return exg_error(env, "Invalid CancelToken");
+  }
+  return exg_ok(env, enif_make_atom(env, atomic_load(&token->cancelled)
+                                             ? "true"
+                                             : "false"));
+}
@@ -0,0 +1,269 @@
+#define _POSIX_C_SOURCE 200809L
+#include "checkpoint.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct exg_checkpoint_job {
+  char *path;
+  char **remove;
+  unsigned num_remove;
+  char *data;
+  size_t len;
+  // Set when the caller asked to be told `{ref, result}` once written
+  ErlNifEnv *msg_env;
+  ErlNifPid pid;
+  ERL_NIF_TERM ref;
+  struct exg_checkpoint_job *next;
+} exg_checkpoint_job;
+
+static ErlNifMutex *writer_lock = NULL;
+static ErlNifCond *writer_cond = NULL;
+static ErlNifTid writer_tid;
+static exg_checkpoint_job *writer_head = NULL;
+static exg_checkpoint_job *writer_tail = NULL;
+static int writer_running = 0;
+static int writer_stopping = 0;
+
+static void free_job(exg_checkpoint_job *job) {
+  if (job->path != NULL) {
+    enif_free(job->path);
+  }
+  if (job->remove != NULL) {
+    for (unsigned i = 0; i < job->num_remove; ++i) {
+      enif_free(job->remove[i]);
+    }
+    enif_free(job->remove);
+  }
+  if (job->data != NULL) {
+    enif_free(job->data);
+  }
+  if (job->msg_env != NULL) {
+    enif_free_env(job->msg_env);
+  }
+  enif_free(job);
+}
+
+// Makes the rename durable. Failing to sync the directory is not reported, as
+// some filesystems don't support it and the checkpoint itself is complete.
+static void sync_parent_dir(const char *path) {
+  const char *slash = strrchr(path, '/');
+  char *dir = NULL;
+  int fd = -1;
+  size_t len = slash == NULL ? 1 : (size_t)(slash - path);
+  if (len == 0) {
+    len = 1;
+  }
+  dir = enif_alloc(len + 1);
+  if (dir == NULL) {
+    return;
+  }
+  if (slash == NULL) {
+    dir[0] = '.';
+  } else {
+    memcpy(dir, path, len);
+  }
+  dir[len] = '\0';
+  fd = open(dir, O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+  enif_free(dir);
+}
+
+// Returns NULL on success, otherwise the reason for the failure
+static const char *write_checkpoint(exg_checkpoint_job *job) {
+  size_t path_len = strlen(job->path);
+  char *tmp = enif_alloc(path_len + 5);
+  FILE *file = NULL;
+  const char *error = NULL;
+  if (tmp == NULL) {
+    return "Failed to allocate memory";
+  }
+  memcpy(tmp, job->path, path_len);
+  memcpy(tmp + path_len, ".tmp", 5);
+  file = fopen(tmp, "wb");
+  if (file == NULL) {
+    error = "Failed to open checkpoint file";
+    goto END;
+  }
+  if (fwrite(job->data, 1, job->len, file) != job->len ||
+      fflush(file) != 0 || fsync(fileno(file)) != 0) {
+    fclose(file);
+    remove(tmp);
+    error = "Failed to write checkpoint file";
+    goto END;
+  }
+  if (fclose(file) != 0 || rename(tmp, job->path) != 0) {
+    remove(tmp);
+    error = "Failed to move checkpoint into place";
+    goto END;
+  }
+  sync_parent_dir(job->path);
+  // Older checkpoints only go once the new one is safely on disk
+  for (unsigned i = 0; i < job->num_remove; ++i) {
+    remove(job->remove[i]);
+  }
+END:
+  enif_free(tmp);
+  return error;
+}
+
+// `caller_env` is NULL on the writer thread
+static void run_job(ErlNifEnv *caller_env, exg_checkpoint_job *job) {
+  const char *error = write_checkpoint(job);
+  if (job->msg_env != NULL) {
+    ERL_NIF_TERM result =
+        error == NULL
+            ? enif_make_atom(job->msg_env, "ok")
+            : enif_make_tuple2(job->msg_env,
+                               enif_make_atom(job->msg_env, "error"),
+                               enif_make_string(job->msg_env, error,
+                                                ERL_NIF_LATIN1));
+    enif_send(caller_env, &job->pid, job->msg_env,
+              enif_make_tuple2(job->msg_env, job->ref, result));
+  }
+  free_job(job);
+}
+
+static void *writer_main(void *arg) {
+  enif_mutex_lock(writer_lock);
+  for (;;) {
+    exg_checkpoint_job *job = NULL;
+    while (writer_head == NULL && !writer_stopping) {
+      enif_cond_wait(writer_cond, writer_lock);
+    }
+    if (writer_head == NULL) {
+      break;
+    }
+    job = writer_head;
+    writer_head = job->next;
+    if (writer_head == NULL) {
+      writer_tail = NULL;
+    }
+    enif_mutex_unlock(writer_lock);
+    run_job(NULL, job);
+    enif_mutex_lock(writer_lock);
+  }
+  enif_mutex_unlock(writer_lock);
+  return NULL;
+}
+
+int exg_checkpoint_writer_start(void) {
+  writer_lock = enif_mutex_create("exgboost_checkpoint_lock");
+  writer_cond = enif_cond_create("exgboost_checkpoint_cond");
+  if (writer_lock == NULL || writer_cond == NULL) {
+    return 0;
+  }
+  writer_stopping = 0;
+  if (enif_thread_create("exgboost_checkpoint", &writer_tid, writer_main,
+                         NULL, NULL) != 0) {
+    return 0;
+  }
+  writer_running = 1;
+  return 1;
+}
+
+void exg_checkpoint_writer_stop(void) {
+  if (writer_running) {
+    enif_mutex_lock(writer_lock);
+    writer_stopping = 1;
+    enif_cond_signal(writer_cond);
+    enif_mutex_unlock(writer_lock);
+    enif_thread_join(writer_tid, NULL);
+    writer_running = 0;
+  }
+  if (writer_cond != NULL) {
+    enif_cond_destroy(writer_cond);
+    writer_cond = NULL;
+  }
+  if (writer_lock != NULL) {
+    enif_mutex_destroy(writer_lock);
+    writer_lock = NULL;
+  }
+}
+
+// Snapshots the booster and queues it to be written to `path`, after which the
+// files in `remove` are deleted. With `{pid, ref}` as the last argument,
+// `{ref, :ok | {:error, reason}}` is sent to `pid` once done.
+ERL_NIF_TERM EXGBoosterCheckpoint(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  exg_booster_resource *booster_resource = NULL;
+  exg_checkpoint_job *job = NULL;
+  const ERL_NIF_TERM *notify = NULL;
+  int notify_arity = 0;
+  bst_ulong out_len = 0;
+  const char *out_buf = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (4 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = booster_resource->handle;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  job = enif_alloc(sizeof(exg_checkpoint_job));
+  if (job == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  memset(job, 0, sizeof(*job));
+  if (!exg_get_string(env, argv[1], &job->path)) {
+    ret = exg_error(env, "Path must be a string");
+    goto END;
+  }
+  if (!exg_get_string_list(env, argv[2], &job->remove, &job->num_remove)) {
+    ret = exg_error(env, "Paths to remove must be a list of strings");
+    goto END;
+  }
+  if (enif_get_tuple(env, argv[3], &notify_arity, &notify)) {
+    if (notify_arity != 2 || !enif_get_local_pid(env, notify[0], &job->pid)) {
+      ret = exg_error(env, "Notify must be {pid, ref} or nil");
+      goto END;
+    }
+    job->msg_env = enif_alloc_env();
+    job->ref = enif_make_copy(job->msg_env, notify[1]);
+  }
+  if (XGBoosterSerializeToBuffer(booster, &out_len, &out_buf) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  // The serialized size is the footprint estimate, so refresh it for free
+  exg_set_footprint(&booster_resource->footprint, out_len);
+  // XGBoost reuses its buffer on the next call, so the checkpoint needs a copy
+  job->data = enif_alloc(out_len);
+  if (job->data == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  memcpy(job->data, out_buf, out_len);
+  job->len = out_len;
+  if (!writer_running) {
+    run_job(env, job);
+  } else {
+    enif_mutex_lock(writer_lock);
+    if (writer_tail == NULL) {
+      writer_head = job;
+    } else {
+      writer_tail->next = job;
+    }
+    writer_tail = job;
+    enif_cond_signal(writer_cond);
+    enif_mutex_unlock(writer_lock);
+  }
+  job = NULL;
+  ret = ok_atom(env);
+END:
+  if (job != NULL) {
+    free_job(job);
+  }
+  return ret;
+}
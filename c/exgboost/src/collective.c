@@ -0,0 +1,332 @@
+#include "collective.h"
+
+typedef struct exg_collective_job {
+  exg_nif_fun fun;
+  // Process independent, holds the copied arguments and the result
+  ErlNifEnv *env;
+  int argc;
+  ERL_NIF_TERM argv[EXG_COLLECTIVE_MAX_ARGS];
+  ERL_NIF_TERM result;
+  int done;
+  struct exg_collective_job *next;
+} exg_collective_job;
+
+static ErlNifMutex *collective_lock = NULL;
+// Signalled when a job is queued
+static ErlNifCond *collective_cond = NULL;
+// Broadcast when a job is done
+static ErlNifCond *collective_done = NULL;
+static ErlNifTid collective_tid;
+static exg_collective_job *collective_head = NULL;
+static exg_collective_job *collective_tail = NULL;
+static int collective_running = 0;
+static int collective_stopping = 0;
+static _Atomic int communicator_active = 0;
+// The process whose calls run on the communicator thread. Guarded by
+// collective_lock.
+static ErlNifPid communicator_owner;
+static _Thread_local int on_collective_thread = 0;
+
+static void *collective_main(void *arg) {
+  on_collective_thread = 1;
+  enif_mutex_lock(collective_lock);
+  for (;;) {
+    exg_collective_job *job = NULL;
+    while (collective_head == NULL && !collective_stopping) {
+      enif_cond_wait(collective_cond, collective_lock);
+    }
+    if (collective_head == NULL) {
+      break;
+    }
+    job = collective_head;
+    collective_head = job->next;
+    if (collective_head == NULL) {
+      collective_tail = NULL;
+    }
+    enif_mutex_unlock(collective_lock);
+    job->result = job->fun(job->env, job->argc, job->argv);
+    enif_mutex_lock(collective_lock);
+    job->done = 1;
+    enif_cond_broadcast(collective_done);
+  }
+  enif_mutex_unlock(collective_lock);
+  return NULL;
+}
+
+int exg_collective_start(void) {
+  collective_lock = enif_mutex_create("exgboost_collective_lock");
+  collective_cond = enif_cond_create("exgboost_collective_cond");
+  collective_done = enif_cond_create("exgboost_collective_done");
+  if (collective_lock == NULL || collective_cond == NULL ||
+      collective_done == NULL) {
+    return 0;
+  }
+  collective_stopping = 0;
+  if (enif_thread_create("exgboost_collective", &collective_tid,
+                         collective_main, NULL, NULL) != 0) {
+    return 0;
+  }
+  collective_running = 1;
+  return 1;
+}
+
+void exg_collective_stop(void) {
+  if (collective_running) {
+    enif_mutex_lock(collective_lock);
+    collective_stopping = 1;
+    enif_cond_signal(collective_cond);
+    enif_mutex_unlock(collective_lock);
+    enif_thread_join(collective_tid, NULL);
+    collective_running = 0;
+  }
+  if (collective_done != NULL) {
+    enif_cond_destroy(collective_done);
+    collective_done = NULL;
+  }
+  if (collective_cond != NULL) {
+    enif_cond_destroy(collective_cond);
+    collective_cond = NULL;
+  }
+  if (collective_lock != NULL) {
+    enif_mutex_destroy(collective_lock);
+    collective_lock = NULL;
+  }
+}
+
+// Runs `fun` on the communicator thread and waits for its result. The caller
+// blocks its (dirty) scheduler for as long as the call takes, as it would
+// running the call itself.
+static ERL_NIF_TERM run_on_thread(exg_nif_fun fun, ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  exg_collective_job job;
+  ERL_NIF_TERM result;
+  if (on_collective_thread) {
+    return fun(env, argc, argv);
+  }
+  if (!collective_running) {
+    return exg_error(env, "Communicator thread is not running");
+  }
+  if (argc > EXG_COLLECTIVE_MAX_ARGS) {
+    return exg_error(env, "Too many arguments");
+  }
+  memset(&job, 0, sizeof(job));
+  job.env = enif_alloc_env();
+  if (job.env == NULL) {
+    return exg_error(env, "Failed to allocate memory");
+  }
+  job.fun = fun;
+  job.argc = argc;
+  // Binaries and resources are shared rather than copied
+  for (int i = 0; i < argc; ++i) {
+    job.argv[i] = enif_make_copy(job.env, argv[i]);
+  }
+  enif_mutex_lock(collective_lock);
+  if (collective_tail == NULL) {
+    collective_head = &job;
+  } else {
+    collective_tail->next = &job;
+  }
+  collective_tail = &job;
+  enif_cond_signal(collective_cond);
+  while (!job.done) {
+    enif_cond_wait(collective_done, collective_lock);
+  }
+  enif_mutex_unlock(collective_lock);
+  result = enif_make_copy(env, job.result);
+  enif_free_env(job.env);
+  return result;
+}
+
+static int is_owner(ErlNifEnv *env) {
+  ErlNifPid self;
+  int owner = 0;
+  if (on_collective_thread || enif_self(env, &self) == NULL) {
+    return 0;
+  }
+  enif_mutex_lock(collective_lock);
+  owner = atomic_load(&communicator_active) &&
+          enif_compare_pids(&self, &communicator_owner) == 0;
+  enif_mutex_unlock(collective_lock);
+  return owner;
+}
+
+ERL_NIF_TERM exg_collective_dispatch(exg_nif_fun fun, ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  if (!atomic_load(&communicator_active) || !is_owner(env)) {
+    return fun(env, argc, argv);
+  }
+  return run_on_thread(fun, env, argc, argv);
+}
+
+ErlNifEnv *exg_caller_env(ErlNifEnv *env) {
+  return on_collective_thread ? NULL : env;
+}
+
+static ERL_NIF_TERM communicator_init(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]) {
+  char *config = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (atomic_load(&communicator_active)) {
+    ret = exg_error(env, "A communicator is already initialized");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[0], &config)) {
+    ret = exg_error(env, "Config must be a JSON string");
+    goto END;
+  }
+  // Blocks until the tracker has connected this worker to its peers
+  if (XGCommunicatorInit(config) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  atomic_store(&communicator_active, 1);
+  ret = ok_atom(env);
+END:
+  if (config != NULL) {
+    enif_free(config);
+  }
+  return ret;
+}
+
+static ERL_NIF_TERM communicator_finalize(ErlNifEnv *env, int argc,
+                                          const ERL_NIF_TERM argv[]) {
+  if (0 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!atomic_load(&communicator_active)) {
+    return ok_atom(env);
+  }
+  atomic_store(&communicator_active, 0);
+  if (XGCommunicatorFinalize() != 0) {
+    return exg_error(env, XGBGetLastError());
+  }
+  return ok_atom(env);
+}
+
+static ERL_NIF_TERM communicator_get_rank(ErlNifEnv *env, int argc,
+                                          const ERL_NIF_TERM argv[]) {
+  if (0 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  return exg_ok(env, enif_make_int(env, XGCommunicatorGetRank()));
+}
+
+static ERL_NIF_TERM communicator_get_world_size(ErlNifEnv *env, int argc,
+                                                const ERL_NIF_TERM argv[]) {
+  if (0 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  return exg_ok(env, enif_make_int(env, XGCommunicatorGetWorldSize()));
+}
+
+static ERL_NIF_TERM communicator_is_distributed(ErlNifEnv *env, int argc,
+                                                const ERL_NIF_TERM argv[]) {
+  if (0 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  return exg_ok(env, enif_make_atom(env, XGCommunicatorIsDistributed()
+                                             ? "true"
+                                             : "false"));
+}
+
+static ERL_NIF_TERM communicator_print(ErlNifEnv *env, int argc,
+                                       const ERL_NIF_TERM argv[]) {
+  char *message = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[0], &message)) {
+    ret = exg_error(env, "Message must be a string");
+    goto END;
+  }
+  if (XGCommunicatorPrint(message) != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  ret = ok_atom(env);
+END:
+  if (message != NULL) {
+    enif_free(message);
+  }
+  return ret;
+}
+
+// The communicator only exists on its thread, so these always run there
+
+ERL_NIF_TERM EXGCommunicatorInit(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]) {
+  ErlNifPid self;
+  if (!collective_running) {
+    return exg_error(env, "Communicator thread is not running");
+  }
+  if (enif_self(env, &self) == NULL) {
+    return exg_error(env, "Must be called from a process");
+  }
+  // The owner is set before the communicator is marked active, so no call
+  // is routed by a stale owner
+  enif_mutex_lock(collective_lock);
+  if (!atomic_load(&communicator_active)) {
+    communicator_owner = self;
+  }
+  enif_mutex_unlock(collective_lock);
+  return run_on_thread(communicator_init, env, argc, argv);
+}
+
+ERL_NIF_TERM EXGCommunicatorFinalize(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  return run_on_thread(communicator_finalize, env, argc, argv);
+}
+
+ERL_NIF_TERM EXGCommunicatorGetRank(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]) {
+  return run_on_thread(communicator_get_rank, env, argc, argv);
+}
+
+ERL_NIF_TERM EXGCommunicatorGetWorldSize(ErlNifEnv *env, int argc,
+                                         const ERL_NIF_TERM argv[]) {
+  return run_on_thread(communicator_get_world_size, env, argc, argv);
+}
+
+ERL_NIF_TERM EXGCommunicatorIsDistributed(ErlNifEnv *env, int argc,
+                                          const ERL_NIF_TERM argv[]) {
+  return run_on_thread(communicator_is_distributed, env, argc, argv);
+}
+
+ERL_NIF_TERM EXGCommunicatorPrint(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  return run_on_thread(communicator_print, env, argc, argv);
+}
+
+// Hands the communicator from `from` to `to` if `from` owns it, so a process
+// can run the owner's collective calls, such as a task training on its behalf.
+// Returns whether the communicator changed hands.
+ERL_NIF_TERM EXGCommunicatorAdopt(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  ErlNifPid from;
+  ErlNifPid to;
+  int adopted = 0;
+  if (2 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!collective_running) {
+    return exg_ok(env, enif_make_atom(env, "false"));
+  }
+  if (!enif_get_local_pid(env, argv[0], &from) ||
+      !enif_get_local_pid(env, argv[1], &to)) {
+    return exg_error(env, "Owners must be local pids");
+  }
+  enif_mutex_lock(collective_lock);
+  if (atomic_load(&communicator_active) &&
+      enif_compare_pids(&from, &communicator_owner) == 0) {
+    communicator_owner = to;
+    adopted = 1;
+  }
+  enif_mutex_unlock(collective_lock);
+  return exg_ok(env, enif_make_atom(env, adopted ? "true" : "false"));
+}
@@ -0,0 +1,85 @@
+#include "cpu_budget.h"
+
+// Resolved from the OpenMP runtime XGBoost links against, if it has one
+extern int omp_get_max_threads(void) __attribute__((weak));
+extern void omp_set_num_threads(int num_threads) __attribute__((weak));
+
+// Cores shared between XGBoost calls, 0 when there is no budget
+static _Atomic int cpu_budget = 0;
+static _Atomic int cpu_active = 0;
+static _Atomic int cpu_in_use = 0;
+static _Atomic uint64_t cpu_calls = 0;
+// Sum over calls of their threads times their duration in nanoseconds
+static _Atomic uint64_t cpu_thread_ns = 0;
+
+void exg_cpu_share_acquire(exg_cpu_share *share) {
+  int budget = atomic_load(&cpu_budget);
+  int active = 0;
+  int in_use = 0;
+  int threads = 0;
+  share->threads = 0;
+  if (budget <= 0 || omp_set_num_threads == NULL ||
+      omp_get_max_threads == NULL) {
+    return;
+  }
+  active = atomic_fetch_add(&cpu_active, 1) + 1;
+  in_use = atomic_load(&cpu_in_use);
+  do {
+    int fair = budget / active;
+    int free = budget - in_use;
+    threads = fair < free ? fair : free;
+    if (threads < 1) {
+      threads = 1;
+    }
+  } while (!atomic_compare_exchange_weak(&cpu_in_use, &in_use,
+                                         in_use + threads));
+  atomic_fetch_add(&cpu_calls, 1);
+  share->previous = omp_get_max_threads();
+  share->threads = threads;
+  share->started = enif_monotonic_time(ERL_NIF_NSEC);
+  omp_set_num_threads(threads);
+}
+
+void exg_cpu_share_release(exg_cpu_share *share) {
+  ErlNifTime elapsed = 0;
+  if (share->threads == 0) {
+    return;
+  }
+  elapsed = enif_monotonic_time(ERL_NIF_NSEC) - share->started;
+  atomic_fetch_add(&cpu_thread_ns, (uint64_t)elapsed * share->threads);
+  atomic_fetch_sub(&cpu_in_use, share->threads);
+  atomic_fetch_sub(&cpu_active, 1);
+  omp_set_num_threads(share->previous);
+  share->threads = 0;
+}
+
+ERL_NIF_TERM exg_cpu_budget_set_nif(ErlNifEnv *env, int argc,
+                                    const ERL_NIF_TERM argv[]) {
+  int cores = 0;
+  if (1 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_int(env, argv[0], &cores) || cores < 0) {
+    return exg_error(env, "Budget must be a non-negative integer");
+  }
+  if (cores > 0 &&
+      (omp_set_num_threads == NULL || omp_get_max_threads == NULL)) {
+    return exg_error(env, "XGBoost was built without OpenMP");
+  }
+  atomic_store(&cpu_budget, cores);
+  return ok_atom(env);
+}
+
+ERL_NIF_TERM exg_cpu_budget_stats_nif(ErlNifEnv *env, int argc,
+                                      const ERL_NIF_TERM argv[]) {
+  ERL_NIF_TERM stats[5];
+  if (0 != argc) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  stats[0] = enif_make_int(env, atomic_load(&cpu_budget));
+  stats[1] = enif_make_int(env, atomic_load(&cpu_active));
+  stats[2] = enif_make_int(env, atomic_load(&cpu_in_use));
+  stats[3] = enif_make_uint64(env, atomic_load(&cpu_calls));
+  stats[4] = enif_make_uint64(env, atomic_load(&cpu_thread_ns));
+  return exg_ok(env, enif_make_tuple_from_array(env, stats, 5));
+}
@@ -1,14 +1,27 @@
 #include "dmatrix.h"
+#include <math.h>
 
-static ERL_NIF_TERM make_DMatrix_resource(ErlNifEnv *env,
-                                          DMatrixHandle handle) {
+int make_DMatrix_resource_term(ErlNifEnv *env, DMatrixHandle handle,
+                               ERL_NIF_TERM *out) {
+  exg_dmatrix_resource *resource =
+      enif_alloc_resource(DMatrix_RESOURCE_TYPE, sizeof(exg_dmatrix_resource));
+  if (resource == NULL) {
+    return 0;
+  }
+  resource->handle = handle;
+  atomic_init(&resource->footprint, 0);
+  atomic_init(&resource->freed, 0);
+  exg_set_footprint(&resource->footprint, exg_dmatrix_footprint(handle));
+  *out = enif_make_resource(env, resource);
+  enif_release_resource(resource);
+  return 1;
+}
+
+ERL_NIF_TERM make_DMatrix_resource(ErlNifEnv *env, DMatrixHandle handle) {
   ERL_NIF_TERM ret = -1;
-  DMatrixHandle **resource =
-      enif_alloc_resource(DMatrix_RESOURCE_TYPE, sizeof(DMatrixHandle *));
-  if (resource != NULL) {
-    *resource = handle;
-    ret = exg_ok(env, enif_make_resource(env, resource));
-    enif_release_resource(resource);
+  ERL_NIF_TERM term;
+  if (make_DMatrix_resource_term(env, handle, &term)) {
+    ret = exg_ok(env, term);
   } else {
     ret = exg_error(env, "Failed to allocate memory for XGBoost DMatrix");
   }
@@ -277,6 +290,109 @@ END:
   return ret;
 }
 
+ERL_NIF_TERM EXGDMatrixCreateFromCOO(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  ErlNifBinary rows_bin;
+  ErlNifBinary cols_bin;
+  ErlNifBinary values_bin;
+  ErlNifUInt64 nrow = 0;
+  ErlNifUInt64 ncol = 0;
+  int sum_duplicates = 1;
+  char *config = NULL;
+  uint64_t *indptr = NULL;
+  unsigned *indices = NULL;
+  float *values = NULL;
+  size_t nnz = 0;
+  size_t out_nnz = 0;
+  uint64_t indptr_size = 0;
+  char indptr_interface[128];
+  char indices_interface[128];
+  char values_interface[128];
+  const char *err = NULL;
+  DMatrixHandle handle;
+  int result = -1;
+  ERL_NIF_TERM ret = 0;
+  if (argc != 7) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[0], &rows_bin) ||
+      !enif_inspect_binary(env, argv[1], &cols_bin) ||
+      !enif_inspect_binary(env, argv[2], &values_bin)) {
+    ret = exg_error(env, "Rows, cols and values must be binaries");
+    goto END;
+  }
+  nnz = values_bin.size / sizeof(float);
+  if (values_bin.size % sizeof(float) != 0 ||
+      rows_bin.size != nnz * sizeof(unsigned) ||
+      cols_bin.size != nnz * sizeof(unsigned)) {
+    ret = exg_error(env, "Rows and cols must be u32 and values f32 binaries "
+                         "of the same length");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[3], &nrow) ||
+      !enif_get_uint64(env, argv[4], &ncol)) {
+    ret = exg_error(env, "nrow and ncol must be non-negative integers");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[5], &sum_duplicates)) {
+    ret = exg_error(env, "sum_duplicates must be an int");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[6], &config)) {
+    ret = exg_error(env, "Config must be a string");
+    goto END;
+  }
+  err = exg_check_coo_shape(nrow, ncol);
+  if (err != NULL ||
+      !exg_mul_size(nrow + 1, sizeof(uint64_t), &indptr_size)) {
+    ret = exg_error(env, err != NULL ? err : "nrow is too large");
+    goto END;
+  }
+  indptr = enif_alloc(indptr_size);
+  indices = enif_alloc(sizeof(unsigned) * (nnz > 0 ? nnz : 1));
+  values = enif_alloc(sizeof(float) * (nnz > 0 ? nnz : 1));
+  if (indptr == NULL || indices == NULL || values == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  err = exg_coo_to_csr((const unsigned *)rows_bin.data,
+                       (const unsigned *)cols_bin.data,
+                       (const float *)values_bin.data, nnz, nrow, ncol,
+                       sum_duplicates, indptr, indices, values, &out_nnz);
+  if (err != NULL) {
+    ret = exg_error(env, err);
+    goto END;
+  }
+  exg_make_array_interface(indptr_interface, sizeof(indptr_interface), indptr,
+                           nrow + 1, "<u8");
+  exg_make_array_interface(indices_interface, sizeof(indices_interface),
+                           indices, out_nnz, "<u4");
+  exg_make_array_interface(values_interface, sizeof(values_interface), values,
+                           out_nnz, "<f4");
+  result = XGDMatrixCreateFromCSR(indptr_interface, indices_interface,
+                                  values_interface, ncol, config, &handle);
+  if (result == 0) {
+    ret = make_DMatrix_resource(env, handle);
+  } else {
+    ret = exg_error(env, XGBGetLastError());
+  }
+END:
+  if (config != NULL) {
+    enif_free(config);
+  }
+  if (indptr != NULL) {
+    enif_free(indptr);
+  }
+  if (indices != NULL) {
+    enif_free(indices);
+  }
+  if (values != NULL) {
+    enif_free(values);
+  }
+  return ret;
+}
+
 ERL_NIF_TERM EXGDMatrixCreateFromDense(ErlNifEnv *env, int argc,
                                        const ERL_NIF_TERM argv[]) {
   int result = -1;
@@ -311,6 +427,143 @@ END:
   return ret;
 }
 
+// Scans a row-major f32 matrix once for missing values and builds the DMatrix
+// from whichever of dense, CSR or CSC is the smallest at the measured density.
+ERL_NIF_TERM EXGDMatrixCreateFromDenseAuto(ErlNifEnv *env, int argc,
+                                           const ERL_NIF_TERM argv[]) {
+  ErlNifBinary data_bin;
+  ErlNifUInt64 nrow = 0;
+  ErlNifUInt64 ncol = 0;
+  float missing = NAN;
+  char *config = NULL;
+  uint64_t *row_nnz = NULL;
+  uint64_t *col_nnz = NULL;
+  uint64_t *indptr = NULL;
+  unsigned *indices = NULL;
+  float *values = NULL;
+  uint64_t nnz = 0;
+  uint64_t bytes = 0;
+  exg_format format = EXG_FORMAT_DENSE;
+  const char *format_name = "dense";
+  char data_interface[256];
+  char indptr_interface[128];
+  char indices_interface[128];
+  char values_interface[128];
+  DMatrixHandle handle;
+  ERL_NIF_TERM dmat;
+  int result = -1;
+  ERL_NIF_TERM ret = 0;
+  if (argc != 5) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[0], &data_bin)) {
+    ret = exg_error(env, "Data must be a binary of f32");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[1], &nrow) ||
+      !enif_get_uint64(env, argv[2], &ncol)) {
+    ret = exg_error(env, "nrow and ncol must be non-negative integers");
+    goto END;
+  }
+  if (!exg_mul_size(nrow, ncol, &bytes) ||
+      !exg_mul_size(bytes, sizeof(float), &bytes) || data_bin.size != bytes) {
+    ret = exg_error(env, "Data size does not match nrow * ncol");
+    goto END;
+  }
+  // An empty binary matches any nrow when ncol is 0 (and vice versa), which
+  // would leave the count and pointer buffers sized from an unchecked shape
+  if ((nrow == 0) != (ncol == 0)) {
+    ret = exg_error(env, "nrow and ncol must both be zero or both non-zero");
+    goto END;
+  }
+  if (!exg_get_missing(env, argv[3], &missing)) {
+    ret = exg_error(env, "Missing must be a float or nil");
+    goto END;
+  }
+  if (!exg_get_string(env, argv[4], &config)) {
+    ret = exg_error(env, "Config must be a JSON-Encoded string");
+    goto END;
+  }
+  row_nnz = enif_alloc(sizeof(uint64_t) * (nrow > 0 ? nrow : 1));
+  col_nnz = enif_alloc(sizeof(uint64_t) * (ncol > 0 ? ncol : 1));
+  if (row_nnz == NULL || col_nnz == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  nnz = exg_dense_scan((const float *)data_bin.data, nrow, ncol, missing,
+                       row_nnz, col_nnz);
+  format = exg_choose_format(nrow, ncol, nnz, 1);
+  if (format == EXG_FORMAT_DENSE) {
+    snprintf(data_interface, sizeof(data_interface),
+             "{\"data\": [%llu, true], \"shape\": [%llu, %llu], "
+             "\"typestr\": \"<f4\", \"version\": 3}",
+             (unsigned long long)(uintptr_t)data_bin.data,
+             (unsigned long long)nrow, (unsigned long long)ncol);
+    result = XGDMatrixCreateFromDense(data_interface, config, &handle);
+  } else {
+    bst_ulong nptr = format == EXG_FORMAT_CSR ? nrow + 1 : ncol + 1;
+    indptr = enif_alloc(sizeof(uint64_t) * nptr);
+    indices = enif_alloc(sizeof(unsigned) * (nnz > 0 ? nnz : 1));
+    values = enif_alloc(sizeof(float) * (nnz > 0 ? nnz : 1));
+    if (indptr == NULL || indices == NULL || values == NULL) {
+      ret = exg_error(env, "Failed to allocate memory");
+      goto END;
+    }
+    exg_make_array_interface(indptr_interface, sizeof(indptr_interface),
+                             indptr, nptr, "<u8");
+    exg_make_array_interface(indices_interface, sizeof(indices_interface),
+                             indices, nnz, "<u4");
+    exg_make_array_interface(values_interface, sizeof(values_interface),
+                             values, nnz, "<f4");
+    if (format == EXG_FORMAT_CSR) {
+      format_name = "csr";
+      exg_dense_to_csr((const float *)data_bin.data, nrow, ncol, missing,
+                       row_nnz, indptr, indices, values);
+      result = XGDMatrixCreateFromCSR(indptr_interface, indices_interface,
+                                      values_interface, ncol, config, &handle);
+    } else {
+      format_name = "csc";
+      exg_dense_to_csc((const float *)data_bin.data, nrow, ncol, missing,
+                       col_nnz, indptr, indices, values);
+      result = XGDMatrixCreateFromCSC(indptr_interface, indices_interface,
+                                      values_interface, nrow, config, &handle);
+    }
+  }
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  if (!make_DMatrix_resource_term(env, handle, &dmat)) {
+    XGDMatrixFree(handle);
+    ret = exg_error(env, "Failed to allocate memory for XGBoost DMatrix");
+    goto END;
+  }
+  ret = exg_ok(env,
+               enif_make_tuple3(env, dmat, enif_make_atom(env, format_name),
+                                enif_make_uint64(env, nnz)));
+END:
+  if (config != NULL) {
+    enif_free(config);
+  }
+  if (row_nnz != NULL) {
+    enif_free(row_nnz);
+  }
+  if (col_nnz != NULL) {
+    enif_free(col_nnz);
+  }
+  if (indptr != NULL) {
+    enif_free(indptr);
+  }
+  if (indices != NULL) {
+    enif_free(indices);
+  }
+  if (values != NULL) {
+    enif_free(values);
+  }
+  return ret;
+}
+
 ERL_NIF_TERM EXGDMatrixSetStrFeatureInfo(ErlNifEnv *env, int argc,
                                          const ERL_NIF_TERM argv[]) {
   DMatrixHandle handle;
@@ -343,6 +596,10 @@ ERL_NIF_TERM EXGDMatrixSetStrFeatureInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixSetStrFeatureInfo(handle, field, features, num_features);
   if (result == 0) {
     ret = ok_atom(env);
@@ -385,6 +642,10 @@ ERL_NIF_TERM EXGDMatrixGetStrFeatureInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result =
       XGDMatrixGetStrFeatureInfo(handle, field, &out_size, &c_out_features);
   if (result == 0) {
@@ -406,15 +667,43 @@ END:
   return ret;
 }
 
+// Returns NULL on success, otherwise the reason for the failure
+static const char *set_dense_info(DMatrixHandle handle, const char *field,
+                                  const ErlNifBinary *data, bst_ulong size,
+                                  int type) {
+  // Element sizes of xgboost::DataType, indexed by type
+  static const size_t type_sizes[] = {0, 4, 8, 4, 8};
+  uint64_t bytes = 0;
+  if (strcmp(field, "label") != 0 && strcmp(field, "weight") != 0 &&
+      strcmp(field, "base_margin") != 0 && strcmp(field, "group") != 0 &&
+      strcmp(field, "label_lower_bound") != 0 &&
+      strcmp(field, "label_upper_bound") != 0 &&
+      strcmp(field, "feature_weights") != 0) {
+    return "Field must be in ['label', 'weight', "
+           "'base_margin','group','label_lower_bound','label_"
+           "upper_bound','feature_weights']";
+  }
+  if (type < 1 || type > 4) {
+    return "Type must be in [1..4]";
+  }
+  if (!exg_mul_size(size, type_sizes[type], &bytes) || bytes > data->size) {
+    return "Size is larger than the data binary";
+  }
+  if (XGDMatrixSetDenseInfo(handle, field, data->data, size, type) != 0) {
+    return XGBGetLastError();
+  }
+  return NULL;
+}
+
 ERL_NIF_TERM EXGDMatrixSetDenseInfo(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]) {
   DMatrixHandle handle;
   ErlNifBinary data_bin;
   DMatrixHandle **resource = NULL;
   char *field = NULL;
+  const char *err = NULL;
   bst_ulong size = 0;
   int type = -1;
-  int result = -1;
   ERL_NIF_TERM ret = 0;
   if (argc != 5) {
     ret = exg_error(env, "Wrong number of arguments");
@@ -433,7 +722,7 @@ ERL_NIF_TERM EXGDMatrixSetDenseInfo(ErlNifEnv *env, int argc,
     ret = exg_error(env, "Data must be a binary");
     goto END;
   }
-  if (!enif_get_ulong(env, argv[3], &size)) {
+  if (!enif_get_uint64(env, argv[3], &size)) {
     ret = exg_error(env, "Size must be an integer");
     goto END;
   }
@@ -441,27 +730,84 @@ ERL_NIF_TERM EXGDMatrixSetDenseInfo(ErlNifEnv *env, int argc,
     ret = exg_error(env, "Type must be an integer");
     goto END;
   }
-  if (strcmp(field, "label") != 0 && strcmp(field, "weight") != 0 &&
-      strcmp(field, "base_margin") != 0 && strcmp(field, "group") != 0 &&
-      strcmp(field, "label_lower_bound") != 0 &&
-      strcmp(field, "label_upper_bound") != 0 &&
-      strcmp(field, "feature_weights") != 0) {
-    ret = exg_error(env, "Field must be in ['label', 'weight', "
-                         "'base_margin','group','label_lower_bound','label_"
-                         "upper_bound','feature_weights']");
+  handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  err = set_dense_info(handle, field, &data_bin, size, type);
+  if (err == NULL) {
+    ret = ok_atom(env);
+  } else {
+    ret = exg_error(env, err);
+  }
+END:
+  if (field != NULL) {
+    enif_free(field);
+  }
+  return ret;
+}
+
+ERL_NIF_TERM EXGDMatrixSetDenseInfoList(ErlNifEnv *env, int argc,
+                                        const ERL_NIF_TERM argv[]) {
+  DMatrixHandle handle;
+  DMatrixHandle **resource = NULL;
+  ERL_NIF_TERM head, tail;
+  const ERL_NIF_TERM *tuple = NULL;
+  ErlNifBinary data_bin;
+  char *field = NULL;
+  const char *err = NULL;
+  int arity = 0;
+  int type = -1;
+  ERL_NIF_TERM ret = 0;
+  if (argc != 2) {
+    ret = exg_error(env, "Wrong number of arguments");
     goto END;
   }
-  if (type < 1 && type > 4) {
-    ret = exg_error(env, "Type must be in [1..4]");
+  if (!enif_get_resource(env, argv[0], DMatrix_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "DMatrix must be a resource");
+    goto END;
+  }
+  if (!enif_is_list(env, argv[1])) {
+    ret = exg_error(env, "Fields must be a list of {field, data, type}");
     goto END;
   }
   handle = *resource;
-  result = XGDMatrixSetDenseInfo(handle, field, data_bin.data, size, type);
-  if (result == 0) {
-    ret = ok_atom(env);
-  } else {
-    ret = exg_error(env, XGBGetLastError());
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  tail = argv[1];
+  while (enif_get_list_cell(env, tail, &head, &tail)) {
+    if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 3) {
+      ret = exg_error(env, "Fields must be a list of {field, data, type}");
+      goto END;
+    }
+    if (!exg_get_string(env, tuple[0], &field)) {
+      ret = exg_error(env, "Field must be a string");
+      goto END;
+    }
+    if (!enif_inspect_binary(env, tuple[1], &data_bin)) {
+      ret = exg_error(env, "Data must be a binary");
+      goto END;
+    }
+    if (!enif_get_int(env, tuple[2], &type)) {
+      ret = exg_error(env, "Type must be an integer");
+      goto END;
+    }
+    // The number of elements follows from the binary size and the type
+    err = set_dense_info(handle, field, &data_bin,
+                         data_bin.size / (type == 2 || type == 4 ? 8 : 4),
+                         type);
+    if (err != NULL) {
+      ret = exg_error(env, err);
+      goto END;
+    }
+    enif_free(field);
+    field = NULL;
   }
+  ret = ok_atom(env);
 END:
   if (field != NULL) {
     enif_free(field);
@@ -486,6 +832,10 @@ ERL_NIF_TERM EXGDMatrixNumRow(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixNumRow(handle, &out);
   if (result == 0) {
     ret = exg_ok(env, enif_make_ulong(env, out));
@@ -513,6 +863,10 @@ ERL_NIF_TERM EXGDMatrixNumCol(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixNumCol(handle, &out);
   if (result == 0) {
     ret = exg_ok(env, enif_make_ulong(env, out));
@@ -540,6 +894,10 @@ ERL_NIF_TERM EXGDMatrixNumNonMissing(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixNumNonMissing(handle, &out);
   if (result == 0) {
     ret = exg_ok(env, enif_make_ulong(env, out));
@@ -550,6 +908,60 @@ END:
   return ret;
 }
 
+ERL_NIF_TERM EXGDMatrixMemory(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]) {
+  exg_dmatrix_resource *resource = NULL;
+  uint64_t footprint = 0;
+  ERL_NIF_TERM ret = 0;
+  if (argc != 1) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], DMatrix_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "DMatrix must be a resource");
+    goto END;
+  }
+  // Meta info such as labels can be set after creation, so re-estimate
+  footprint = exg_dmatrix_footprint(resource->handle);
+  exg_set_footprint(&resource->footprint, footprint);
+  ret = exg_ok(env, enif_make_uint64(env, footprint));
+END:
+  return ret;
+}
+
+// Frees the DMatrix now rather than when the resource is garbage collected.
+// Freeing again is a no-op. Must not race with other calls using the DMatrix.
+ERL_NIF_TERM EXGDMatrixFree(ErlNifEnv *env, int argc,
+                            const ERL_NIF_TERM argv[]) {
+  exg_dmatrix_resource *resource = NULL;
+  DMatrixHandle handle = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (1 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], DMatrix_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  if (atomic_exchange(&resource->freed, 1)) {
+    ret = ok_atom(env);
+    goto END;
+  }
+  handle = resource->handle;
+  resource->handle = NULL;
+  exg_set_footprint(&resource->footprint, 0);
+  if (XGDMatrixFree(handle) == 0) {
+    ret = ok_atom(env);
+  } else {
+    ret = exg_error(env, XGBGetLastError());
+  }
+END:
+  return ret;
+}
+
 ERL_NIF_TERM EXGDMatrixSetInfoFromInterface(ErlNifEnv *env, int argc,
                                             const ERL_NIF_TERM argv[]) {
   DMatrixHandle handle;
@@ -586,6 +998,10 @@ ERL_NIF_TERM EXGDMatrixSetInfoFromInterface(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixSetInfoFromInterface(handle, field, data_interface);
   if (result == 0) {
     ret = ok_atom(env);
@@ -628,6 +1044,10 @@ ERL_NIF_TERM EXGDMatrixSaveBinary(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixSaveBinary(handle, fname, silent);
   if (result == 0) {
     ret = ok_atom(env);
@@ -675,6 +1095,10 @@ ERL_NIF_TERM EXGDMatrixGetFloatInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixGetFloatInfo(handle, field, &len, &out);
   if (result == 0) {
     arr = enif_alloc(sizeof(ERL_NIF_TERM) * len);
@@ -724,6 +1148,10 @@ ERL_NIF_TERM EXGDMatrixGetUIntInfo(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixGetUIntInfo(handle, field, &len, &out);
   if (result == 0) {
     arr = enif_alloc(sizeof(ERL_NIF_TERM) * len);
@@ -773,6 +1201,10 @@ ERL_NIF_TERM EXGDMatrixGetDataAsCSR(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixNumRow(handle, &num_rows);
   if (result != 0) {
     ret = exg_error(env, XGBGetLastError());
@@ -874,6 +1306,10 @@ ERL_NIF_TERM EXGDMatrixSliceDMatrix(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   int index_count = (int)(bin.size / sizeof(int));
   for (bst_ulong i = 0; i < index_count; i++) {
     if (((int *)bin.data)[i] < 0) {
@@ -892,6 +1328,259 @@ END:
   return ret;
 }
 
+typedef struct {
+  float label;
+  int unit;
+} exg_fold_key;
+
+static int compare_fold_keys(const void *a, const void *b) {
+  const exg_fold_key *ka = (const exg_fold_key *)a;
+  const exg_fold_key *kb = (const exg_fold_key *)b;
+  // NaN labels compare unordered, which would make the order inconsistent, so
+  // they sort last as a class of their own
+  if (isnan(ka->label) || isnan(kb->label)) {
+    if (!isnan(kb->label)) {
+      return 1;
+    }
+    if (!isnan(ka->label)) {
+      return -1;
+    }
+  } else if (ka->label < kb->label) {
+    return -1;
+  } else if (ka->label > kb->label) {
+    return 1;
+  }
+  // Ties keep their shuffled order so each class is spread randomly
+  return (ka->unit > kb->unit) - (ka->unit < kb->unit);
+}
+
+ERL_NIF_TERM EXGDMatrixFolds(ErlNifEnv *env, int argc,
+                             const ERL_NIF_TERM argv[]) {
+  DMatrixHandle handle;
+  DMatrixHandle **resource = NULL;
+  DMatrixHandle *out_handles = NULL;
+  ERL_NIF_TERM *fold_terms = NULL;
+  int *order = NULL;
+  int *fold_of = NULL;
+  int *indices = NULL;
+  unsigned *group_sizes = NULL;
+  exg_fold_key *keys = NULL;
+  const unsigned *group_ptr = NULL;
+  const float *labels = NULL;
+  bst_ulong num_rows = 0;
+  bst_ulong group_ptr_len = 0;
+  bst_ulong labels_len = 0;
+  ErlNifUInt64 seed = 0;
+  uint64_t rng = 0;
+  int nfold = 0;
+  int stratified = 0;
+  int allow_groups = 0;
+  int num_units = 0;
+  int num_handles = 0;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 5) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], DMatrix_RESOURCE_TYPE,
+                         (void *)&resource)) {
+    ret = exg_error(env, "DMatrix must be a resource");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[1], &nfold)) {
+    ret = exg_error(env, "nfold must be an int");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[2], &seed)) {
+    ret = exg_error(env, "seed must be a non-negative integer");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[3], &stratified)) {
+    ret = exg_error(env, "stratified must be an int");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[4], &allow_groups)) {
+    ret = exg_error(env, "allow_groups must be an int");
+    goto END;
+  }
+  if (allow_groups != 0 && allow_groups != 1) {
+    ret = exg_error(env, "allow_groups must be 0 or 1");
+    goto END;
+  }
+  handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  result = XGDMatrixNumRow(handle, &num_rows);
+  if (result != 0) {
+    ret = exg_error(env, XGBGetLastError());
+    goto END;
+  }
+  // When groups are allowed, whole query groups are assigned to folds rather
+  // than individual rows so that no group is split between train and test.
+  if (allow_groups) {
+    result = XGDMatrixGetUIntInfo(handle, "group_ptr", &group_ptr_len,
+                                  &group_ptr);
+    if (result != 0) {
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+  }
+  num_units = group_ptr_len > 1 ? (int)(group_ptr_len - 1) : (int)num_rows;
+  if (nfold < 2 || nfold > num_units) {
+    ret = exg_error(env, "nfold must be in [2, number of rows (or groups)]");
+    goto END;
+  }
+  if (stratified) {
+    if (group_ptr_len > 1) {
+      ret = exg_error(env, "Stratified folds are not supported with groups");
+      goto END;
+    }
+    result = XGDMatrixGetFloatInfo(handle, "label", &labels_len, &labels);
+    if (result != 0) {
+      ret = exg_error(env, XGBGetLastError());
+      goto END;
+    }
+    if (labels_len != num_rows) {
+      ret = exg_error(env, "Stratified folds require one label per row");
+      goto END;
+    }
+  }
+  order = enif_alloc(sizeof(int) * num_units);
+  fold_of = enif_alloc(sizeof(int) * num_units);
+  indices = enif_alloc(sizeof(int) * num_rows);
+  out_handles = enif_alloc(sizeof(DMatrixHandle) * 2 * nfold);
+  fold_terms = enif_alloc(sizeof(ERL_NIF_TERM) * nfold);
+  if (group_ptr_len > 1) {
+    group_sizes = enif_alloc(sizeof(unsigned) * num_units);
+  }
+  if (!order || !fold_of || !indices || !out_handles || !fold_terms ||
+      (group_ptr_len > 1 && !group_sizes)) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  // Fisher-Yates shuffle of the units
+  rng = (uint64_t)seed;
+  for (int i = 0; i < num_units; ++i) {
+    order[i] = i;
+  }
+  for (int i = num_units - 1; i > 0; --i) {
+    int j = (int)(exg_rand_next(&rng) % (uint64_t)(i + 1));
+    int tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+  if (stratified) {
+    // Sort the shuffled rows by label, then deal them out round-robin so that
+    // every fold receives the same share of each class.
+    keys = enif_alloc(sizeof(exg_fold_key) * num_units);
+    if (!keys) {
+      ret = exg_error(env, "Failed to allocate memory");
+      goto END;
+    }
+    for (int i = 0; i < num_units; ++i) {
+      keys[i].label = labels[order[i]];
+      keys[i].unit = i;
+    }
+    qsort(keys, num_units, sizeof(exg_fold_key), compare_fold_keys);
+    for (int i = 0; i < num_units; ++i) {
+      fold_of[order[keys[i].unit]] = i % nfold;
+    }
+  } else {
+    for (int f = 0; f < nfold; ++f) {
+      int begin = (int)((int64_t)num_units * f / nfold);
+      int end = (int)((int64_t)num_units * (f + 1) / nfold);
+      for (int i = begin; i < end; ++i) {
+        fold_of[order[i]] = f;
+      }
+    }
+  }
+  for (int f = 0; f < nfold; ++f) {
+    for (int is_test = 0; is_test < 2; ++is_test) {
+      DMatrixHandle out = NULL;
+      int count = 0;
+      int group_count = 0;
+      for (int u = 0; u < num_units; ++u) {
+        if ((fold_of[u] == f) != is_test) {
+          continue;
+        }
+        if (group_ptr_len > 1) {
+          for (unsigned r = group_ptr[u]; r < group_ptr[u + 1]; ++r) {
+            indices[count++] = (int)r;
+          }
+          group_sizes[group_count++] = group_ptr[u + 1] - group_ptr[u];
+        } else {
+          indices[count++] = u;
+        }
+      }
+      result = XGDMatrixSliceDMatrixEx(handle, indices, (bst_ulong)count, &out,
+                                       allow_groups);
+      if (result != 0) {
+        ret = exg_error(env, XGBGetLastError());
+        goto END;
+      }
+      out_handles[num_handles++] = out;
+      if (group_ptr_len > 1) {
+        result = XGDMatrixSetDenseInfo(out, "group", group_sizes,
+                                       (bst_ulong)group_count, 3);
+        if (result != 0) {
+          ret = exg_error(env, XGBGetLastError());
+          goto END;
+        }
+      }
+    }
+  }
+  for (int f = 0; f < nfold; ++f) {
+    ERL_NIF_TERM train;
+    ERL_NIF_TERM test;
+    // Ownership of the handles moves to the resources one by one, so a failure
+    // here only leaves the not-yet-wrapped handles for cleanup below.
+    if (!make_DMatrix_resource_term(env, out_handles[2 * f], &train)) {
+      ret = exg_error(env, "Failed to allocate memory for XGBoost DMatrix");
+      goto END;
+    }
+    out_handles[2 * f] = NULL;
+    if (!make_DMatrix_resource_term(env, out_handles[2 * f + 1], &test)) {
+      ret = exg_error(env, "Failed to allocate memory for XGBoost DMatrix");
+      goto END;
+    }
+    out_handles[2 * f + 1] = NULL;
+    fold_terms[f] = enif_make_tuple2(env, train, test);
+  }
+  num_handles = 0;
+  ret = exg_ok(env, enif_make_list_from_array(env, fold_terms, nfold));
+END:
+  for (int i = 0; i < num_handles; ++i) {
+    if (out_handles[i] != NULL) {
+      XGDMatrixFree(out_handles[i]);
+    }
+  }
+  if (out_handles != NULL) {
+    enif_free(out_handles);
+  }
+  if (fold_terms != NULL) {
+    enif_free(fold_terms);
+  }
+  if (order != NULL) {
+    enif_free(order);
+  }
+  if (fold_of != NULL) {
+    enif_free(fold_of);
+  }
+  if (indices != NULL) {
+    enif_free(indices);
+  }
+  if (group_sizes != NULL) {
+    enif_free(group_sizes);
+  }
+  if (keys != NULL) {
+    enif_free(keys);
+  }
+  return ret;
+}
+
 ERL_NIF_TERM EXGProxyDMatrixCreate(ErlNifEnv *env, int argc,
                                    const ERL_NIF_TERM argv[]) {
   DMatrixHandle handle;
@@ -935,6 +1624,10 @@ ERL_NIF_TERM EXGDMatrixGetQuantileCut(ErlNifEnv *env, int argc,
     goto END;
   }
   handle = *resource;
+  if (handle == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
   result = XGDMatrixGetQuantileCut(handle, config, &out_indptr, &out_data);
   if (result == 0) {
     ret = exg_ok(
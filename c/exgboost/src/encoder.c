@@ -0,0 +1,445 @@
+#include "encoder.h"
+#include <math.h>
+
+#define EXG_ENCODER_MAGIC "EXGC"
+#define EXG_ENCODER_VERSION 1
+// Codes are handed to XGBoost as f32, which is exact up to 2^24
+#define EXG_ENCODER_MAX_CATEGORIES (1u << 24)
+
+static uint64_t fnv1a(const unsigned char *data, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= data[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Returns code + 1 if the category is known, otherwise 0 and the empty slot
+// where it would be inserted
+static uint32_t lookup(const exg_encoder *enc, const unsigned char *data,
+                       size_t len, uint64_t hash, size_t *slot) {
+  size_t mask = enc->capacity - 1;
+  size_t i = hash & mask;
+  while (enc->slots[i] != 0) {
+    uint32_t code = enc->slots[i] - 1;
+    uint64_t begin = enc->offsets[code];
+    if (enc->hashes[i] == hash && enc->offsets[code + 1] - begin == len &&
+        memcmp(enc->bytes + begin, data, len) == 0) {
+      return enc->slots[i];
+    }
+    i = (i + 1) & mask;
+  }
+  *slot = i;
+  return 0;
+}
+
+static int grow_table(exg_encoder *enc) {
+  size_t capacity = enc->capacity * 2;
+  uint32_t *slots = enif_alloc(sizeof(uint32_t) * capacity);
+  uint64_t *hashes = enif_alloc(sizeof(uint64_t) * capacity);
+  if (slots == NULL || hashes == NULL) {
+    if (slots != NULL) {
+      enif_free(slots);
+    }
+    if (hashes != NULL) {
+      enif_free(hashes);
+    }
+    return 0;
+  }
+  memset(slots, 0, sizeof(uint32_t) * capacity);
+  for (size_t i = 0; i < enc->capacity; ++i) {
+    if (enc->slots[i] != 0) {
+      size_t j = enc->hashes[i] & (capacity - 1);
+      while (slots[j] != 0) {
+        j = (j + 1) & (capacity - 1);
+      }
+      slots[j] = enc->slots[i];
+      hashes[j] = enc->hashes[i];
+    }
+  }
+  enif_free(enc->slots);
+  enif_free(enc->hashes);
+  enc->slots = slots;
+  enc->hashes = hashes;
+  enc->capacity = capacity;
+  return 1;
+}
+
+// Must be called with the write lock held. Returns NULL on success.
+static const char *insert(exg_encoder *enc, const unsigned char *data,
+                          size_t len, uint64_t hash, size_t slot) {
+  if (enc->count >= EXG_ENCODER_MAX_CATEGORIES) {
+    return "Too many categories to encode exactly as f32";
+  }
+  // Keep the load factor under 3/4
+  if ((size_t)(enc->count + 1) * 4 > enc->capacity * 3) {
+    if (!grow_table(enc)) {
+      return "Failed to allocate memory";
+    }
+    lookup(enc, data, len, hash, &slot);
+  }
+  if (enc->bytes_len + len > enc->bytes_cap) {
+    size_t cap = enc->bytes_cap * 2;
+    while (cap < enc->bytes_len + len) {
+      cap *= 2;
+    }
+    char *bytes = enif_realloc(enc->bytes, cap);
+    if (bytes == NULL) {
+      return "Failed to allocate memory";
+    }
+    enc->bytes = bytes;
+    enc->bytes_cap = cap;
+  }
+  if (enc->count + 2 > enc->offsets_cap) {
+    uint64_t *offsets =
+        enif_realloc(enc->offsets, sizeof(uint64_t) * enc->offsets_cap * 2);
+    if (offsets == NULL) {
+      return "Failed to allocate memory";
+    }
+    enc->offsets = offsets;
+    enc->offsets_cap *= 2;
+  }
+  memcpy(enc->bytes + enc->bytes_len, data, len);
+  enc->bytes_len += len;
+  enc->offsets[enc->count + 1] = enc->bytes_len;
+  enc->slots[slot] = enc->count + 1;
+  enc->hashes[slot] = hash;
+  enc->count++;
+  atomic_store(&enc->num_categories, enc->count);
+  return NULL;
+}
+
+// Adds every category of the list that is not known yet. Must be called with
+// the write lock held. Returns NULL on success.
+static const char *fit_list(ErlNifEnv *env, exg_encoder *enc,
+                            ERL_NIF_TERM list) {
+  ERL_NIF_TERM head, tail;
+  ErlNifBinary bin;
+  ERL_NIF_TERM nil = enif_make_atom(env, "nil");
+  tail = list;
+  while (enif_get_list_cell(env, tail, &head, &tail)) {
+    size_t slot = 0;
+    uint64_t hash = 0;
+    const char *err = NULL;
+    if (enif_is_identical(head, nil)) {
+      continue;
+    }
+    if (!enif_inspect_binary(env, head, &bin)) {
+      return "Categories must be strings or nil";
+    }
+    hash = fnv1a(bin.data, bin.size);
+    if (lookup(enc, bin.data, bin.size, hash, &slot) == 0) {
+      err = insert(enc, bin.data, bin.size, hash, slot);
+      if (err != NULL) {
+        return err;
+      }
+    }
+  }
+  return NULL;
+}
+
+static ERL_NIF_TERM make_Encoder_resource(ErlNifEnv *env, exg_encoder **out) {
+  exg_encoder *enc =
+      enif_alloc_resource(Encoder_RESOURCE_TYPE, sizeof(exg_encoder));
+  ERL_NIF_TERM ret = -1;
+  if (enc == NULL) {
+    return exg_error(env, "Failed to allocate memory for categorical encoder");
+  }
+  memset(enc, 0, sizeof(exg_encoder));
+  atomic_init(&enc->num_categories, 0);
+  enc->capacity = 64;
+  enc->bytes_cap = 256;
+  enc->offsets_cap = 64;
+  enc->lock = enif_rwlock_create("exgboost.categorical_encoder");
+  enc->slots = enif_alloc(sizeof(uint32_t) * enc->capacity);
+  enc->hashes = enif_alloc(sizeof(uint64_t) * enc->capacity);
+  enc->bytes = enif_alloc(enc->bytes_cap);
+  enc->offsets = enif_alloc(sizeof(uint64_t) * enc->offsets_cap);
+  if (enc->lock == NULL || enc->slots == NULL || enc->hashes == NULL ||
+      enc->bytes == NULL || enc->offsets == NULL) {
+    ret = exg_error(env, "Failed to allocate memory for categorical encoder");
+  } else {
+    memset(enc->slots, 0, sizeof(uint32_t) * enc->capacity);
+    enc->offsets[0] = 0;
+    *out = enc;
+    ret = exg_ok(env, enif_make_resource(env, enc));
+  }
+  enif_release_resource(enc);
+  return ret;
+}
+
+void Encoder_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg) {
+  exg_encoder *enc = (exg_encoder *)arg;
+  if (enc->lock != NULL) {
+    enif_rwlock_destroy(enc->lock);
+  }
+  if (enc->slots != NULL) {
+    enif_free(enc->slots);
+  }
+  if (enc->hashes != NULL) {
+    enif_free(enc->hashes);
+  }
+  if (enc->bytes != NULL) {
+    enif_free(enc->bytes);
+  }
+  if (enc->offsets != NULL) {
+    enif_free(enc->offsets);
+  }
+}
+
+ERL_NIF_TERM EXGEncoderCreate(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  if (argc != 0) {
+    return exg_error(env, "EXGEncoderCreate doesn't take arguments");
+  }
+  return make_Encoder_resource(env, &enc);
+}
+
+ERL_NIF_TERM EXGEncoderFit(ErlNifEnv *env, int argc,
+                           const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  const char *err = NULL;
+  uint32_t count = 0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 2) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Encoder_RESOURCE_TYPE, (void *)&enc)) {
+    ret = exg_error(env, "Encoder must be a resource");
+    goto END;
+  }
+  if (!enif_is_list(env, argv[1])) {
+    ret = exg_error(env, "Categories must be a list");
+    goto END;
+  }
+  enif_rwlock_rwlock(enc->lock);
+  err = fit_list(env, enc, argv[1]);
+  count = enc->count;
+  enif_rwlock_rwunlock(enc->lock);
+  if (err != NULL) {
+    ret = exg_error(env, err);
+  } else {
+    ret = exg_ok(env, enif_make_uint(env, count));
+  }
+END:
+  return ret;
+}
+
+ERL_NIF_TERM EXGEncoderEncode(ErlNifEnv *env, int argc,
+                              const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM nil;
+  ErlNifBinary bin;
+  ErlNifBinary out_bin;
+  unsigned len = 0;
+  unsigned i = 0;
+  int error_on_unknown = 0;
+  int allocated = 0;
+  int locked = 0;
+  float *codes = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 3) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Encoder_RESOURCE_TYPE, (void *)&enc)) {
+    ret = exg_error(env, "Encoder must be a resource");
+    goto END;
+  }
+  if (!enif_get_list_length(env, argv[1], &len)) {
+    ret = exg_error(env, "Categories must be a list");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[2], &error_on_unknown)) {
+    ret = exg_error(env, "error_on_unknown must be an int");
+    goto END;
+  }
+  if (!enif_alloc_binary(sizeof(float) * len, &out_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 1;
+  codes = (float *)out_bin.data;
+  nil = enif_make_atom(env, "nil");
+  enif_rwlock_rlock(enc->lock);
+  locked = 1;
+  tail = argv[1];
+  while (enif_get_list_cell(env, tail, &head, &tail)) {
+    size_t slot = 0;
+    uint32_t code = 0;
+    if (enif_is_identical(head, nil)) {
+      codes[i++] = NAN;
+      continue;
+    }
+    if (!enif_inspect_binary(env, head, &bin)) {
+      ret = exg_error(env, "Categories must be strings or nil");
+      goto END;
+    }
+    code = lookup(enc, bin.data, bin.size, fnv1a(bin.data, bin.size), &slot);
+    if (code == 0 && error_on_unknown) {
+      ret = exg_error(env, "Unknown category");
+      goto END;
+    }
+    // Unknown categories become missing values
+    codes[i++] = code == 0 ? NAN : (float)(code - 1);
+  }
+  enif_rwlock_runlock(enc->lock);
+  locked = 0;
+  allocated = 0;
+  ret = exg_ok(env, enif_make_binary(env, &out_bin));
+END:
+  if (locked) {
+    enif_rwlock_runlock(enc->lock);
+  }
+  if (allocated) {
+    enif_release_binary(&out_bin);
+  }
+  return ret;
+}
+
+ERL_NIF_TERM EXGEncoderNumCategories(ErlNifEnv *env, int argc,
+                                     const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  uint32_t count = 0;
+  if (argc != 1) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_resource(env, argv[0], Encoder_RESOURCE_TYPE, (void *)&enc)) {
+    return exg_error(env, "Encoder must be a resource");
+  }
+  // A fit can hold the write lock for long, so this call, which runs on a
+  // regular scheduler, reads the published count instead of waiting for it
+  count = atomic_load(&enc->num_categories);
+  return exg_ok(env, enif_make_uint(env, count));
+}
+
+ERL_NIF_TERM EXGEncoderCategories(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  ERL_NIF_TERM list;
+  if (argc != 1) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_resource(env, argv[0], Encoder_RESOURCE_TYPE, (void *)&enc)) {
+    return exg_error(env, "Encoder must be a resource");
+  }
+  list = enif_make_list(env, 0);
+  enif_rwlock_rlock(enc->lock);
+  // Built back to front so the list is in code order
+  for (uint32_t code = enc->count; code > 0; --code) {
+    uint64_t begin = enc->offsets[code - 1];
+    size_t size = enc->offsets[code] - begin;
+    ERL_NIF_TERM term;
+    unsigned char *data = enif_make_new_binary(env, size, &term);
+    memcpy(data, enc->bytes + begin, size);
+    list = enif_make_list_cell(env, term, list);
+  }
+  enif_rwlock_runlock(enc->lock);
+  return exg_ok(env, list);
+}
+
+static void put_u32(unsigned char *out, uint32_t value) {
+  out[0] = value & 0xff;
+  out[1] = (value >> 8) & 0xff;
+  out[2] = (value >> 16) & 0xff;
+  out[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t get_u32(const unsigned char *in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+         ((uint32_t)in[3] << 24);
+}
+
+// Layout: "EXGC", u32 version, u32 count, then per category a u32 length
+// followed by its bytes. Integers are little-endian.
+ERL_NIF_TERM EXGEncoderSerialize(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  ERL_NIF_TERM term;
+  unsigned char *out = NULL;
+  if (argc != 1) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_get_resource(env, argv[0], Encoder_RESOURCE_TYPE, (void *)&enc)) {
+    return exg_error(env, "Encoder must be a resource");
+  }
+  enif_rwlock_rlock(enc->lock);
+  out = enif_make_new_binary(env, 12 + 4 * (size_t)enc->count + enc->bytes_len,
+                             &term);
+  memcpy(out, EXG_ENCODER_MAGIC, 4);
+  put_u32(out + 4, EXG_ENCODER_VERSION);
+  put_u32(out + 8, enc->count);
+  out += 12;
+  for (uint32_t code = 0; code < enc->count; ++code) {
+    uint64_t begin = enc->offsets[code];
+    uint32_t size = (uint32_t)(enc->offsets[code + 1] - begin);
+    put_u32(out, size);
+    memcpy(out + 4, enc->bytes + begin, size);
+    out += 4 + size;
+  }
+  enif_rwlock_runlock(enc->lock);
+  return exg_ok(env, term);
+}
+
+ERL_NIF_TERM EXGEncoderDeserialize(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]) {
+  exg_encoder *enc = NULL;
+  ErlNifBinary bin;
+  const unsigned char *cursor = NULL;
+  const unsigned char *end = NULL;
+  const char *err = NULL;
+  uint32_t count = 0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 1) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  if (!enif_inspect_binary(env, argv[0], &bin)) {
+    return exg_error(env, "Serialized encoder must be a binary");
+  }
+  if (bin.size < 12 || memcmp(bin.data, EXG_ENCODER_MAGIC, 4) != 0) {
+    return exg_error(env, "Not a serialized categorical encoder");
+  }
+  if (get_u32(bin.data + 4) != EXG_ENCODER_VERSION) {
+    return exg_error(env, "Unsupported categorical encoder version");
+  }
+  count = get_u32(bin.data + 8);
+  ret = make_Encoder_resource(env, &enc);
+  if (enc == NULL) {
+    return ret;
+  }
+  cursor = bin.data + 12;
+  end = bin.data + bin.size;
+  // The resource isn't shared yet, but insert expects the write lock
+  enif_rwlock_rwlock(enc->lock);
+  for (uint32_t i = 0; i < count && err == NULL; ++i) {
+    uint32_t size = 0;
+    size_t slot = 0;
+    uint64_t hash = 0;
+    if (end - cursor < 4) {
+      err = "Truncated categorical encoder";
+      break;
+    }
+    size = get_u32(cursor);
+    cursor += 4;
+    if ((size_t)(end - cursor) < size) {
+      err = "Truncated categorical encoder";
+      break;
+    }
+    hash = fnv1a(cursor, size);
+    if (lookup(enc, cursor, size, hash, &slot) != 0) {
+      err = "Duplicate category in serialized encoder";
+      break;
+    }
+    err = insert(enc, cursor, size, hash, slot);
+    cursor += size;
+  }
+  enif_rwlock_rwunlock(enc->lock);
+  if (err != NULL) {
+    return exg_error(env, err);
+  }
+  return ret;
+}
@@ -7,9 +7,24 @@ static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info) {
   Booster_RESOURCE_TYPE = enif_open_resource_type(
       env, NULL, "Booster_RESOURCE_TYPE", Booster_RESOURCE_TYPE_cleanup,
       (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER), NULL);
-  if (DMatrix_RESOURCE_TYPE == NULL || Booster_RESOURCE_TYPE == NULL) {
+  Builder_RESOURCE_TYPE = enif_open_resource_type(
+      env, NULL, "Builder_RESOURCE_TYPE", Builder_RESOURCE_TYPE_cleanup,
+      (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER), NULL);
+  Encoder_RESOURCE_TYPE = enif_open_resource_type(
+      env, NULL, "Encoder_RESOURCE_TYPE", Encoder_RESOURCE_TYPE_cleanup,
+      (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER), NULL);
+  CancelToken_RESOURCE_TYPE = exg_open_cancel_token_type(
+      env, (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER));
+  if (DMatrix_RESOURCE_TYPE == NULL || Booster_RESOURCE_TYPE == NULL ||
+      Builder_RESOURCE_TYPE == NULL || Encoder_RESOURCE_TYPE == NULL ||
+      CancelToken_RESOURCE_TYPE == NULL) {
     return 1;
   }
+  // Destructors fall back to freeing inline if the reaper can't start, and
+  // checkpoints to being written by the caller
+  exg_reaper_start();
+  exg_checkpoint_writer_start();
+  exg_collective_start();
   return 0;
 }
 
@@ -21,32 +36,115 @@ static int upgrade(ErlNifEnv *env, void **priv_data, void **old_priv_data,
   Booster_RESOURCE_TYPE = enif_open_resource_type(
       env, NULL, "Booster_RESOURCE_TYPE", Booster_RESOURCE_TYPE_cleanup,
       ERL_NIF_RT_TAKEOVER, NULL);
-  if (DMatrix_RESOURCE_TYPE == NULL || Booster_RESOURCE_TYPE == NULL) {
+  Builder_RESOURCE_TYPE = enif_open_resource_type(
+      env, NULL, "Builder_RESOURCE_TYPE", Builder_RESOURCE_TYPE_cleanup,
+      (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER), NULL);
+  Encoder_RESOURCE_TYPE = enif_open_resource_type(
+      env, NULL, "Encoder_RESOURCE_TYPE", Encoder_RESOURCE_TYPE_cleanup,
+      (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER), NULL);
+  CancelToken_RESOURCE_TYPE = exg_open_cancel_token_type(
+      env, (ErlNifResourceFlags)(ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER));
+  if (DMatrix_RESOURCE_TYPE == NULL || Booster_RESOURCE_TYPE == NULL ||
+      Builder_RESOURCE_TYPE == NULL || Encoder_RESOURCE_TYPE == NULL ||
+      CancelToken_RESOURCE_TYPE == NULL) {
     return 1;
   }
+  // Destructors fall back to freeing inline if the reaper can't start, and
+  // checkpoints to being written by the caller
+  exg_reaper_start();
+  exg_checkpoint_writer_start();
+  exg_collective_start();
   return 0;
 }
 
+static void unload(ErlNifEnv *env, void *priv_data) {
+  exg_collective_stop();
+  exg_checkpoint_writer_stop();
+  exg_reaper_stop();
+}
+
+// NIFs that run an OpenMP team, within a share of the CPU budget. See
+// cpu_budget.h. booster_train takes its shares itself.
+EXG_CPU_BUDGET_NIF(EXGDMatrixCreateFromSparse)
+EXG_CPU_BUDGET_NIF(EXGDMatrixCreateFromDense)
+EXG_CPU_BUDGET_NIF(EXGDMatrixCreateFromCOO)
+EXG_CPU_BUDGET_NIF(EXGDMatrixCreateFromDenseAuto)
+EXG_CPU_BUDGET_NIF(EXGDMatrixBuilderToDMatrix)
+EXG_CPU_BUDGET_NIF(EXGDMatrixBuilderToQuantileDMatrix)
+EXG_CPU_BUDGET_NIF(EXGBoosterUpdateOneIter)
+EXG_CPU_BUDGET_NIF(EXGBoosterBoostNative)
+EXG_CPU_BUDGET_NIF(EXGBoosterBoostGOSS)
+EXG_CPU_BUDGET_NIF(EXGBoosterBoostOneIter)
+EXG_CPU_BUDGET_NIF(EXGBoosterEvalOneIter)
+EXG_CPU_BUDGET_NIF(EXGBoosterEval)
+EXG_CPU_BUDGET_NIF(EXGBoosterPredictFromDMatrix)
+EXG_CPU_BUDGET_NIF(EXGBoosterPredictChunked)
+EXG_CPU_BUDGET_NIF(EXGBoosterPredictMargin)
+EXG_CPU_BUDGET_NIF(EXGBoosterPredictFromDense)
+EXG_CPU_BUDGET_NIF(EXGBoosterPredictFromCSR)
+
+// NIFs that may take part in a collective operation while a communicator is
+// initialized, all dirty. See collective.h.
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromFile)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromURI)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromMat)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromSparseBudgeted)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromDenseBudgeted)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromCOOBudgeted)
+EXG_COLLECTIVE_NIF(EXGDMatrixCreateFromDenseAutoBudgeted)
+EXG_COLLECTIVE_NIF(EXGDMatrixBuilderToDMatrixBudgeted)
+EXG_COLLECTIVE_NIF(EXGDMatrixBuilderToQuantileDMatrixBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterGetNumFeature)
+EXG_COLLECTIVE_NIF(EXGBoosterUpdateOneIterBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterBoostNativeBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterBoostGOSSBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterBoostOneIterBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterEvalOneIterBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterTrain)
+EXG_COLLECTIVE_NIF(EXGBoosterEvalBudgeted)
+EXG_COLLECTIVE_NIF(EXGBoosterSaveJsonConfig)
+
 static ErlNifFunc nif_funcs[] = {
     {"get_int_size", 0, exg_get_int_size},
+    {"native_memory", 0, exg_native_memory_nif},
+    {"process_rss", 0, exg_process_rss_nif},
+    {"cpu_budget_set", 1, exg_cpu_budget_set_nif},
+    {"cpu_budget_stats", 0, exg_cpu_budget_stats_nif},
+    {"cancel_token_create", 1, exg_cancel_token_create},
+    {"cancel_token_cancel", 1, exg_cancel_token_cancel},
+    {"cancel_token_cancelled", 1, exg_cancel_token_cancelled},
     {"xgboost_version", 0, EXGBoostVersion},
     {"xgboost_build_info", 0, EXGBuildInfo},
     {"set_global_config", 1, EXGBSetGlobalConfig},
     {"get_global_config", 0, EXGBGetGlobalConfig},
     {"proxy_dmatrix_create", 0, EXGProxyDMatrixCreate},
-    {"dmatrix_create_from_file", 2, EXGDMatrixCreateFromFile,
+    {"dmatrix_create_from_file", 2, EXGDMatrixCreateFromFileCollective,
      ERL_NIF_DIRTY_JOB_IO_BOUND},
-    {"dmatrix_create_from_uri", 1, EXGDMatrixCreateFromURI,
+    {"dmatrix_create_from_uri", 1, EXGDMatrixCreateFromURICollective,
      ERL_NIF_DIRTY_JOB_IO_BOUND},
-    {"dmatrix_create_from_mat", 4, EXGDMatrixCreateFromMat},
-    {"dmatrix_create_from_sparse", 6, EXGDMatrixCreateFromSparse},
-    {"dmatrix_create_from_dense", 2, EXGDMatrixCreateFromDense},
+    {"dmatrix_create_from_mat", 4, EXGDMatrixCreateFromMatCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_create_from_sparse", 6,
+     EXGDMatrixCreateFromSparseBudgetedCollective, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_create_from_dense", 2,
+     EXGDMatrixCreateFromDenseBudgetedCollective, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_create_from_coo", 7, EXGDMatrixCreateFromCOOBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"coo_to_csr", 6, exg_coo_to_csr_nif, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_create_from_dense_auto", 5,
+     EXGDMatrixCreateFromDenseAutoBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dense_to_csr", 4, exg_dense_to_csr_nif, ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"dmatrix_set_str_feature_info", 3, EXGDMatrixSetStrFeatureInfo},
     {"dmatrix_get_str_feature_info", 2, EXGDMatrixGetStrFeatureInfo},
     {"dmatrix_num_row", 1, EXGDMatrixNumRow},
     {"dmatrix_num_col", 1, EXGDMatrixNumCol},
     {"dmatrix_num_non_missing", 1, EXGDMatrixNumNonMissing},
+    {"dmatrix_memory", 1, EXGDMatrixMemory},
+    {"dmatrix_free", 1, EXGDMatrixFree, ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"dmatrix_set_info_from_interface", 3, EXGDMatrixSetInfoFromInterface},
+    {"dmatrix_set_dense_info", 5, EXGDMatrixSetDenseInfo},
+    {"dmatrix_set_dense_info_list", 2, EXGDMatrixSetDenseInfoList},
     {"dmatrix_save_binary", 3, EXGDMatrixSaveBinary},
     {"get_binary_address", 1, exg_get_binary_address},
     {"get_binary_from_address", 2, exg_get_binary_from_address},
@@ -54,16 +152,51 @@ static ErlNifFunc nif_funcs[] = {
     {"dmatrix_get_uint_info", 2, EXGDMatrixGetUIntInfo},
     {"dmatrix_get_data_as_csr", 2, EXGDMatrixGetDataAsCSR},
     {"dmatrix_slice", 3, EXGDMatrixSliceDMatrix},
+    {"dmatrix_folds", 5, EXGDMatrixFolds, ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"dmatrix_get_quantile_cut", 2, EXGDMatrixGetQuantileCut},
+    {"dmatrix_builder_create", 4, EXGDMatrixBuilderCreate},
+    {"dmatrix_builder_push_dense", 5, EXGDMatrixBuilderPushDense,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_builder_push_csr", 6, EXGDMatrixBuilderPushCSR,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_builder_num_row", 1, EXGDMatrixBuilderNumRow},
+    {"dmatrix_builder_evict", 1, EXGDMatrixBuilderEvict},
+    {"dmatrix_builder_to_dmatrix", 2,
+     EXGDMatrixBuilderToDMatrixBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"dmatrix_builder_to_quantile_dmatrix", 3,
+     EXGDMatrixBuilderToQuantileDMatrixBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"encoder_create", 0, EXGEncoderCreate},
+    {"encoder_fit", 2, EXGEncoderFit, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"encoder_encode", 3, EXGEncoderEncode, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"encoder_num_categories", 1, EXGEncoderNumCategories},
+    {"encoder_categories", 1, EXGEncoderCategories,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"encoder_serialize", 1, EXGEncoderSerialize, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"encoder_deserialize", 1, EXGEncoderDeserialize,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_create", 1, EXGBoosterCreate},
     {"booster_boosted_rounds", 1, EXGBoosterBoostedRounds},
     {"booster_set_param", 3, EXGBoosterSetParam},
-    {"booster_get_num_feature", 1, EXGBoosterGetNumFeature},
-    {"booster_update_one_iter", 3, EXGBoosterUpdateOneIter,
+    {"booster_get_num_feature", 1, EXGBoosterGetNumFeatureCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_update_one_iter", 3, EXGBoosterUpdateOneIterBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_boost_native", 3, EXGBoosterBoostNativeBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_boost_goss", 5, EXGBoosterBoostGOSSBudgetedCollective,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
-    {"booster_boost_one_iter", 4, EXGBoosterBoostOneIter,
+    {"booster_boost_one_iter", 4, EXGBoosterBoostOneIterBudgetedCollective,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
-    {"booster_eval_one_iter", 4, EXGBoosterEvalOneIter,
+    {"booster_eval_one_iter", 4, EXGBoosterEvalOneIterBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_train", 12, EXGBoosterTrainCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_eval", 4, EXGBoosterEvalBudgetedCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_eval_history", 1, EXGBoosterEvalHistory},
+    {"booster_checkpoint", 4, EXGBoosterCheckpoint,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_get_attr_names", 1, EXGBoosterGetAttrNames},
     {"booster_get_attr", 2, EXGBoosterGetAttr},
@@ -72,11 +205,16 @@ static ErlNifFunc nif_funcs[] = {
     {"booster_get_str_feature_info", 2, EXGBoosterGetStrFeatureInfo},
     {"booster_feature_score", 2, EXGBoosterFeatureScore},
     {"booster_slice", 4, EXGBoosterSlice},
-    {"booster_predict_from_dmatrix", 3, EXGBoosterPredictFromDMatrix,
+    {"booster_predict_from_dmatrix", 3,
+     EXGBoosterPredictFromDMatrixBudgeted,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_predict_chunked", 5, EXGBoosterPredictChunkedBudgeted,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
-    {"booster_predict_from_dense", 4, EXGBoosterPredictFromDense,
+    {"booster_predict_margin", 3, EXGBoosterPredictMarginBudgeted,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
-    {"booster_predict_from_csr", 7, EXGBoosterPredictFromCSR,
+    {"booster_predict_from_dense", 4, EXGBoosterPredictFromDenseBudgeted,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_predict_from_csr", 7, EXGBoosterPredictFromCSRBudgeted,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_load_model", 1, EXGBoosterLoadModel, ERL_NIF_DIRTY_JOB_IO_BOUND},
     {"booster_save_model", 2, EXGBoosterSaveModel, ERL_NIF_DIRTY_JOB_IO_BOUND},
@@ -85,14 +223,32 @@ static ErlNifFunc nif_funcs[] = {
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_deserialize_from_buffer", 1, EXGBoosterDeserializeFromBuffer,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_restore_from_buffer", 2, EXGBoosterRestoreFromBuffer,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_memory", 1, EXGBoosterMemory, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_free", 1, EXGBoosterFree, ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_save_model_to_buffer", 2, EXGBoosterSaveModelToBuffer,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_load_model_from_buffer", 1, EXGBoosterLoadModelFromBuffer,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"booster_load_model_mmap", 2, EXGBoosterLoadModelMmap,
+     ERL_NIF_DIRTY_JOB_IO_BOUND},
     {"booster_load_json_config", 2, EXGBoosterLoadJsonConfig,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
     {"booster_dump_model", 4, EXGBoosterDumpModelEx,
      ERL_NIF_DIRTY_JOB_CPU_BOUND},
-    {"booster_save_json_config", 1, EXGBoosterSaveJsonConfig,
-     ERL_NIF_DIRTY_JOB_CPU_BOUND}};
-ERL_NIF_INIT(Elixir.EXGBoost.NIF, nif_funcs, load, NULL, upgrade, NULL)
+    {"booster_save_json_config", 1, EXGBoosterSaveJsonConfigCollective,
+     ERL_NIF_DIRTY_JOB_CPU_BOUND},
+    {"communicator_init", 1, EXGCommunicatorInit, ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"communicator_adopt", 2, EXGCommunicatorAdopt},
+    {"communicator_finalize", 0, EXGCommunicatorFinalize,
+     ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"communicator_get_rank", 0, EXGCommunicatorGetRank,
+     ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"communicator_get_world_size", 0, EXGCommunicatorGetWorldSize,
+     ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"communicator_is_distributed", 0, EXGCommunicatorIsDistributed,
+     ERL_NIF_DIRTY_JOB_IO_BOUND},
+    {"communicator_print", 1, EXGCommunicatorPrint,
+     ERL_NIF_DIRTY_JOB_IO_BOUND}};
+ERL_NIF_INIT(Elixir.EXGBoost.NIF, nif_funcs, load, NULL, upgrade, unload)
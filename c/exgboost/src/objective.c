@@ -0,0 +1,615 @@
+#include "objective.h"
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+
+// Smallest hessian handed to XGBoost. Focal loss and the identity-link Tweedie
+// loss are not convex everywhere, and a non-positive hessian breaks the split
+// gain and leaf weight computations.
+#define EXG_MIN_HESS 1e-16f
+#define EXG_PROB_EPS 1e-7f
+
+// The kernels below are plain loops over contiguous buffers. `omp simd` is
+// only a hint: kernels calling expf, logf or powf stay scalar, as libm has no
+// vector variants without -ffast-math, which would break the NaN handling.
+
+static inline float sigmoid(float x) { return 1.0f / (1.0f + expf(-x)); }
+
+static inline float clamp_prob(float p) {
+  return fminf(fmaxf(p, EXG_PROB_EPS), 1.0f - EXG_PROB_EPS);
+}
+
+// Binary focal loss, -a1 y (1-p)^g log(p) - a0 (1-y) p^g log(1-p), where
+// a1 = alpha and a0 = 1 - alpha when alpha is given and both are 1 otherwise.
+// Soft labels in [0, 1] are allowed.
+static void focal_kernel(const float *margin, const float *label,
+                         const float *weight, size_t n, const double *params,
+                         float *grad, float *hess) {
+  const float gamma = (float)params[0];
+  const float a1 = isnan(params[1]) ? 1.0f : (float)params[1];
+  const float a0 = isnan(params[1]) ? 1.0f : 1.0f - (float)params[1];
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    float w = weight != NULL ? weight[i] : 1.0f;
+    float y = label[i];
+    float p = clamp_prob(sigmoid(margin[i]));
+    float q = 1.0f - p;
+    float log_p = logf(p);
+    float log_q = logf(q);
+    float qg = powf(q, gamma);
+    float pg = powf(p, gamma);
+    float u1 = gamma * p * log_p + p - 1.0f;
+    float u0 = gamma * q * log_q + q - 1.0f;
+    float g1 = qg * u1;
+    float g0 = -pg * u0;
+    float h1 = p * qg * (-gamma * u1 + q * (gamma * log_p + gamma + 1.0f));
+    float h0 = q * pg * (-gamma * u0 + p * (gamma * log_q + gamma + 1.0f));
+    grad[i] = w * (a1 * y * g1 + a0 * (1.0f - y) * g0);
+    hess[i] = w * fmaxf(a1 * y * h1 + a0 * (1.0f - y) * h0, EXG_MIN_HESS);
+  }
+}
+
+// Squared error, as XGBoost's reg:squarederror, for sampling schemes that need
+// the gradients of the booster's own objective
+static void squared_error_kernel(const float *margin, const float *label,
+                                 const float *weight, size_t n,
+                                 const double *params, float *grad,
+                                 float *hess) {
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    float w = weight != NULL ? weight[i] : 1.0f;
+    grad[i] = w * (margin[i] - label[i]);
+    hess[i] = w;
+  }
+}
+
+// Pinball loss for the `alpha` quantile. The hessian is constant, as for
+// XGBoost's own absolute error objectives.
+static void pinball_kernel(const float *margin, const float *label,
+                           const float *weight, size_t n, const double *params,
+                           float *grad, float *hess) {
+  const float alpha = (float)params[0];
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    float w = weight != NULL ? weight[i] : 1.0f;
+    float r = margin[i] - label[i];
+    grad[i] = w * (r >= 0.0f ? 1.0f - alpha : -alpha);
+    hess[i] = w;
+  }
+}
+
+// Asymmetric squared error (expectile regression): residuals where the label
+// is above the prediction are weighted by `alpha`, the others by 1 - alpha
+static void expectile_kernel(const float *margin, const float *label,
+                             const float *weight, size_t n,
+                             const double *params, float *grad, float *hess) {
+  const float alpha = (float)params[0];
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    float w = weight != NULL ? weight[i] : 1.0f;
+    float r = margin[i] - label[i];
+    float c = w * (r < 0.0f ? alpha : 1.0f - alpha);
+    grad[i] = c * r;
+    hess[i] = c;
+  }
+}
+
+// Tweedie deviance with variance power `rho`, with either the log link
+// (mu = exp(margin), as XGBoost's reg:tweedie) or the identity link
+// (mu = margin, floored at a small positive value)
+static void tweedie_kernel(const float *margin, const float *label,
+                           const float *weight, size_t n, const double *params,
+                           float *grad, float *hess) {
+  const float rho = (float)params[0];
+  if (params[1] == 0) {
+#pragma omp simd
+    for (size_t i = 0; i < n; ++i) {
+      float w = weight != NULL ? weight[i] : 1.0f;
+      float a = expf((1.0f - rho) * margin[i]);
+      float b = expf((2.0f - rho) * margin[i]);
+      grad[i] = w * (-label[i] * a + b);
+      hess[i] = w * (-label[i] * (1.0f - rho) * a + (2.0f - rho) * b);
+    }
+  } else {
+#pragma omp simd
+    for (size_t i = 0; i < n; ++i) {
+      float w = weight != NULL ? weight[i] : 1.0f;
+      float mu = fmaxf(margin[i], 1e-6f);
+      float mu_rho = powf(mu, -rho);
+      grad[i] = w * mu_rho * (mu - label[i]);
+      hess[i] = w * fmaxf(mu_rho / mu * ((1.0f - rho) * mu + rho * label[i]),
+                          EXG_MIN_HESS);
+    }
+  }
+}
+
+// Logloss with labels smoothed towards 0.5 by `smoothing` and the positive
+// class weighted by `pos_weight`
+static void smooth_logloss_kernel(const float *margin, const float *label,
+                                  const float *weight, size_t n,
+                                  const double *params, float *grad,
+                                  float *hess) {
+  const float smoothing = (float)params[0];
+  const float pos_weight = (float)params[1];
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    float w = weight != NULL ? weight[i] : 1.0f;
+    float y = label[i] * (1.0f - smoothing) + 0.5f * smoothing;
+    float s = pos_weight * y + 1.0f - y;
+    float p = sigmoid(margin[i]);
+    grad[i] = w * (p * s - pos_weight * y);
+    hess[i] = w * fmaxf(p * (1.0f - p) * s, EXG_MIN_HESS);
+  }
+}
+
+static const exg_objective_def objectives[] = {
+    {"squared_error", {NULL}, {0}, squared_error_kernel},
+    {"focal", {"gamma", "alpha"}, {2.0, NAN}, focal_kernel},
+    {"pinball", {"alpha"}, {0.5}, pinball_kernel},
+    {"expectile", {"alpha"}, {0.5}, expectile_kernel},
+    {"tweedie", {"rho", "link"}, {1.5, 0}, tweedie_kernel},
+    {"smooth_logloss",
+     {"smoothing", "pos_weight"},
+     {0.0, 1.0},
+     smooth_logloss_kernel},
+};
+
+#define EXG_NUM_OBJECTIVES (sizeof(objectives) / sizeof(objectives[0]))
+
+static const char *validate_params(const exg_objective *obj) {
+  const char *name = obj->def->name;
+  const double *params = obj->params;
+  if (strcmp(name, "focal") == 0) {
+    if (!(params[0] >= 0)) {
+      return "focal gamma must be non-negative";
+    }
+    if (!isnan(params[1]) && !(params[1] > 0 && params[1] < 1)) {
+      return "focal alpha must be in (0, 1)";
+    }
+  } else if (strcmp(name, "pinball") == 0 || strcmp(name, "expectile") == 0) {
+    if (!(params[0] > 0 && params[0] < 1)) {
+      return "alpha must be in (0, 1)";
+    }
+  } else if (strcmp(name, "tweedie") == 0) {
+    if (!(params[0] > 1 && params[0] < 2)) {
+      return "tweedie rho must be in (1, 2)";
+    }
+    if (params[1] != 0 && params[1] != 1) {
+      return "tweedie link must be 0 (log) or 1 (identity)";
+    }
+  } else if (strcmp(name, "smooth_logloss") == 0) {
+    if (!(params[0] >= 0 && params[0] <= 1)) {
+      return "smoothing must be in [0, 1]";
+    }
+    if (!(params[1] > 0)) {
+      return "pos_weight must be positive";
+    }
+  }
+  return NULL;
+}
+
+int exg_get_objective(ErlNifEnv *env, ERL_NIF_TERM term, exg_objective *obj,
+                      const char **error) {
+  const ERL_NIF_TERM *tuple = NULL;
+  int arity = 0;
+  char *name = NULL;
+  ERL_NIF_TERM head;
+  ERL_NIF_TERM tail;
+  int ok = 0;
+  memset(obj, 0, sizeof(*obj));
+  if (!enif_get_tuple(env, term, &arity, &tuple) || arity != 2 ||
+      !exg_get_string(env, tuple[0], &name)) {
+    *error = "Objective must be {name, params}";
+    goto END;
+  }
+  for (size_t i = 0; i < EXG_NUM_OBJECTIVES; ++i) {
+    if (strcmp(objectives[i].name, name) == 0) {
+      obj->def = &objectives[i];
+    }
+  }
+  if (obj->def == NULL) {
+    *error = "Unknown native objective";
+    goto END;
+  }
+  memcpy(obj->params, obj->def->defaults, sizeof(obj->params));
+  tail = tuple[1];
+  while (enif_get_list_cell(env, tail, &head, &tail)) {
+    const ERL_NIF_TERM *param = NULL;
+    char *key = NULL;
+    double value = 0;
+    ErlNifSInt64 int_value = 0;
+    int found = 0;
+    if (!enif_get_tuple(env, head, &arity, &param) || arity != 2 ||
+        !exg_get_string(env, param[0], &key)) {
+      *error = "Objective params must be {name, number} tuples";
+      goto END;
+    }
+    if (!enif_get_double(env, param[1], &value)) {
+      if (!enif_get_int64(env, param[1], &int_value)) {
+        enif_free(key);
+        *error = "Objective params must be {name, number} tuples";
+        goto END;
+      }
+      value = (double)int_value;
+    }
+    for (int i = 0; i < EXG_OBJECTIVE_MAX_PARAMS; ++i) {
+      if (obj->def->param_names[i] != NULL &&
+          strcmp(obj->def->param_names[i], key) == 0) {
+        obj->params[i] = value;
+        found = 1;
+      }
+    }
+    enif_free(key);
+    if (!found) {
+      *error = "Unknown objective parameter";
+      goto END;
+    }
+  }
+  *error = validate_params(obj);
+  ok = *error == NULL;
+END:
+  if (name != NULL) {
+    enif_free(name);
+  }
+  return ok;
+}
+
+// Fills `obj->grad` and `obj->hess` for every output of `dtrain` and sets
+// `num` to their count. Returns like exg_objective_boost.
+static int objective_gradients(BoosterHandle booster, DMatrixHandle dtrain,
+                               exg_objective *obj, bst_ulong *num,
+                               const char **error) {
+  static const char *config = "{\"type\": 1, \"training\": true, "
+                              "\"iteration_begin\": 0, \"iteration_end\": 0, "
+                              "\"strict_shape\": false}";
+  bst_ulong const *shape = NULL;
+  bst_ulong dim = 0;
+  float const *margin = NULL;
+  bst_ulong num_margin = 1;
+  float const *label = NULL;
+  bst_ulong num_label = 0;
+  float const *weight = NULL;
+  bst_ulong num_weight = 0;
+  // Margins come from the booster's prediction cache, and labels and weights
+  // point into the DMatrix, so nothing is copied before the kernel runs
+  if (XGBoosterPredictFromDMatrix(booster, dtrain, config, &shape, &dim,
+                                  &margin) != 0 ||
+      XGDMatrixGetFloatInfo(dtrain, "label", &num_label, &label) != 0 ||
+      XGDMatrixGetFloatInfo(dtrain, "weight", &num_weight, &weight) != 0) {
+    return -1;
+  }
+  for (bst_ulong i = 0; i < dim; ++i) {
+    num_margin *= shape[i];
+  }
+  if (num_margin != num_label) {
+    *error = "Native objectives need exactly one label per output";
+    return -2;
+  }
+  if (num_weight != 0 && num_weight != num_label) {
+    *error = "Weights must have one value per row";
+    return -2;
+  }
+  if (num_margin > obj->capacity) {
+    float *grad = enif_realloc(obj->grad, sizeof(float) * num_margin);
+    float *hess = grad == NULL
+                      ? NULL
+                      : enif_realloc(obj->hess, sizeof(float) * num_margin);
+    if (grad != NULL) {
+      obj->grad = grad;
+    }
+    if (hess == NULL) {
+      *error = "Failed to allocate memory";
+      return -2;
+    }
+    obj->hess = hess;
+    obj->capacity = num_margin;
+  }
+  obj->def->kernel(margin, label, num_weight != 0 ? weight : NULL, num_margin,
+                   obj->params, obj->grad, obj->hess);
+  *num = num_margin;
+  return 0;
+}
+
+int exg_objective_boost(BoosterHandle booster, DMatrixHandle dtrain,
+                        exg_objective *obj, const char **error) {
+  bst_ulong num = 0;
+  int result = objective_gradients(booster, dtrain, obj, &num, error);
+  if (result != 0) {
+    return result;
+  }
+  return XGBoosterBoostOneIter(booster, dtrain, obj->grad, obj->hess, num) != 0
+             ? -1
+             : 0;
+}
+
+// splitmix64, enough to draw the sampled rows of a round reproducibly
+static inline uint64_t goss_next(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Partially sorts `v` in descending order around position `k` and returns the
+// value there, the k-th largest (0-based)
+static float kth_largest(float *v, ptrdiff_t n, ptrdiff_t k) {
+  ptrdiff_t lo = 0;
+  ptrdiff_t hi = n - 1;
+  while (lo < hi) {
+    float pivot = v[lo + (hi - lo) / 2];
+    ptrdiff_t i = lo;
+    ptrdiff_t j = hi;
+    while (i <= j) {
+      while (v[i] > pivot) {
+        ++i;
+      }
+      while (v[j] < pivot) {
+        --j;
+      }
+      if (i <= j) {
+        float t = v[i];
+        v[i] = v[j];
+        v[j] = t;
+        ++i;
+        --j;
+      }
+    }
+    if (k <= j) {
+      hi = j;
+    } else if (k >= i) {
+      lo = i;
+    } else {
+      break;
+    }
+  }
+  return v[k];
+}
+
+int exg_get_goss(ErlNifEnv *env, ERL_NIF_TERM term, exg_goss *goss,
+                 const char **error) {
+  const ERL_NIF_TERM *tuple = NULL;
+  int arity = 0;
+  ErlNifUInt64 seed = 0;
+  memset(goss, 0, sizeof(*goss));
+  if (!enif_get_tuple(env, term, &arity, &tuple) || arity != 3 ||
+      !enif_get_double(env, tuple[0], &goss->top_rate) ||
+      !enif_get_double(env, tuple[1], &goss->other_rate) ||
+      !enif_get_uint64(env, tuple[2], &seed)) {
+    *error = "GOSS must be {top_rate, other_rate, seed}";
+    return 0;
+  }
+  if (!(goss->top_rate >= 0 && goss->other_rate > 0 &&
+        goss->top_rate + goss->other_rate <= 1)) {
+    *error = "GOSS rates must be non-negative, other_rate positive and their "
+             "sum at most 1";
+    return 0;
+  }
+  goss->seed = seed;
+  return 1;
+}
+
+int exg_objective_boost_goss(BoosterHandle booster, DMatrixHandle dtrain,
+                             exg_objective *obj, exg_goss *goss, int iteration,
+                             const char **error) {
+  bst_ulong num = 0;
+  bst_ulong num_rows = 0;
+  size_t num_top = 0;
+  size_t above = 0;
+  size_t ties = 0;
+  size_t kept = 0;
+  float threshold = INFINITY;
+  double keep = 0;
+  float amplify = 1.0f;
+  uint64_t state = goss->seed ^ ((uint64_t)iteration * 0xD1B54A32D192ED03ULL);
+  DMatrixHandle slice = NULL;
+  int result = objective_gradients(booster, dtrain, obj, &num, error);
+  if (result != 0) {
+    return result;
+  }
+  if (XGDMatrixNumRow(dtrain, &num_rows) != 0) {
+    return -1;
+  }
+  if (num != num_rows) {
+    *error = "GOSS needs exactly one output per row";
+    return -2;
+  }
+  if (num > INT_MAX) {
+    *error = "GOSS supports at most INT_MAX rows";
+    return -2;
+  }
+  if (num > goss->capacity) {
+    float *abs_grad = enif_realloc(goss->abs_grad, sizeof(float) * num);
+    int *rows = abs_grad == NULL
+                    ? NULL
+                    : enif_realloc(goss->rows, sizeof(int) * num);
+    if (abs_grad != NULL) {
+      goss->abs_grad = abs_grad;
+    }
+    if (rows == NULL) {
+      *error = "Failed to allocate memory";
+      return -2;
+    }
+    goss->rows = rows;
+    goss->capacity = num;
+  }
+  // Rows with the largest gradients are all kept
+  num_top = (size_t)(goss->top_rate * (double)num);
+  if (num_top > 0) {
+#pragma omp simd
+    for (size_t i = 0; i < num; ++i) {
+      goss->abs_grad[i] = fabsf(obj->grad[i]);
+    }
+    threshold = kth_largest(goss->abs_grad, (ptrdiff_t)num,
+                            (ptrdiff_t)num_top - 1);
+#pragma omp simd reduction(+ : above)
+    for (size_t i = 0; i < num; ++i) {
+      above += fabsf(obj->grad[i]) > threshold;
+    }
+    ties = num_top - above;
+  }
+  // The others are sampled so that other_rate of all rows are drawn, and
+  // weighted up to stand for the ones left out
+  keep = goss->other_rate / (1.0 - goss->top_rate);
+  if (keep < 1) {
+    amplify = (float)(1.0 / keep);
+  }
+  for (size_t i = 0; i < num; ++i) {
+    float a = fabsf(obj->grad[i]);
+    float scale = 1.0f;
+    if (num_top > 0 && (a > threshold || (a == threshold && ties > 0))) {
+      ties -= a == threshold;
+    } else if ((double)(goss_next(&state) >> 11) * 0x1.0p-53 < keep) {
+      scale = amplify;
+    } else {
+      continue;
+    }
+    // Compacted in place, as rows are only ever moved towards the front
+    goss->rows[kept] = (int)i;
+    obj->grad[kept] = obj->grad[i] * scale;
+    obj->hess[kept] = obj->hess[i] * scale;
+    ++kept;
+  }
+  if (XGDMatrixSliceDMatrix(dtrain, goss->rows, kept, &slice) != 0) {
+    return -1;
+  }
+  result = XGBoosterBoostOneIter(booster, slice, obj->grad, obj->hess, kept) !=
+                   0
+               ? -1
+               : 0;
+  XGDMatrixFree(slice);
+  return result;
+}
+
+void exg_goss_free(exg_goss *goss) {
+  if (goss->abs_grad != NULL) {
+    enif_free(goss->abs_grad);
+  }
+  if (goss->rows != NULL) {
+    enif_free(goss->rows);
+  }
+  goss->abs_grad = NULL;
+  goss->rows = NULL;
+  goss->capacity = 0;
+}
+
+void exg_objective_free(exg_objective *obj) {
+  if (obj->grad != NULL) {
+    enif_free(obj->grad);
+  }
+  if (obj->hess != NULL) {
+    enif_free(obj->hess);
+  }
+  obj->grad = NULL;
+  obj->hess = NULL;
+  obj->capacity = 0;
+}
+
+ERL_NIF_TERM EXGBoosterBoostNative(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  BoosterHandle **booster_resource = NULL;
+  DMatrixHandle dtrain;
+  DMatrixHandle **dtrain_resource = NULL;
+  exg_objective obj;
+  const char *error = NULL;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  memset(&obj, 0, sizeof(obj));
+  if (3 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
+                         (void *)&(dtrain_resource))) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  dtrain = *dtrain_resource;
+  if (dtrain == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  if (!exg_get_objective(env, argv[2], &obj, &error)) {
+    ret = exg_error(env, error);
+    goto END;
+  }
+  result = exg_objective_boost(booster, dtrain, &obj, &error);
+  if (result == 0) {
+    ret = ok_atom(env);
+  } else {
+    ret = exg_error(env, result == -1 ? XGBGetLastError() : error);
+  }
+END:
+  exg_objective_free(&obj);
+  return ret;
+}
+
+ERL_NIF_TERM EXGBoosterBoostGOSS(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]) {
+  BoosterHandle booster;
+  BoosterHandle **booster_resource = NULL;
+  DMatrixHandle dtrain;
+  DMatrixHandle **dtrain_resource = NULL;
+  exg_objective obj;
+  exg_goss goss;
+  int iteration = 0;
+  const char *error = NULL;
+  int result = -1;
+  ERL_NIF_TERM ret = -1;
+  memset(&obj, 0, sizeof(obj));
+  memset(&goss, 0, sizeof(goss));
+  if (5 != argc) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[0], Booster_RESOURCE_TYPE,
+                         (void *)&(booster_resource))) {
+    ret = exg_error(env, "Invalid Booster");
+    goto END;
+  }
+  booster = *booster_resource;
+  if (booster == NULL) {
+    ret = exg_error(env, "Booster has been freed");
+    goto END;
+  }
+  if (!enif_get_resource(env, argv[1], DMatrix_RESOURCE_TYPE,
+                         (void *)&(dtrain_resource))) {
+    ret = exg_error(env, "Invalid DMatrix");
+    goto END;
+  }
+  dtrain = *dtrain_resource;
+  if (dtrain == NULL) {
+    ret = exg_error(env, "DMatrix has been freed");
+    goto END;
+  }
+  if (!exg_get_objective(env, argv[2], &obj, &error) ||
+      !exg_get_goss(env, argv[3], &goss, &error)) {
+    ret = exg_error(env, error);
+    goto END;
+  }
+  if (!enif_get_int(env, argv[4], &iteration)) {
+    ret = exg_error(env, "Iteration must be an integer");
+    goto END;
+  }
+  result =
+      exg_objective_boost_goss(booster, dtrain, &obj, &goss, iteration, &error);
+  if (result == 0) {
+    ret = ok_atom(env);
+  } else {
+    ret = exg_error(env, result == -1 ? XGBGetLastError() : error);
+  }
+END:
+  exg_goss_free(&goss);
+  exg_objective_free(&obj);
+  return ret;
+}
@@ -1,4 +1,7 @@
 #include "utils.h"
+#include <math.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 // Atoms
 ERL_NIF_TERM exg_error(ErlNifEnv *env, const char *msg) {
@@ -15,13 +18,20 @@ ERL_NIF_TERM exg_ok(ErlNifEnv *env, ERL_NIF_TERM term) {
 
 // Resource type helpers
 void DMatrix_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg) {
-  DMatrixHandle handle = *((DMatrixHandle *)arg);
-  XGDMatrixFree(handle);
+  exg_dmatrix_resource *resource = (exg_dmatrix_resource *)arg;
+  exg_set_footprint(&resource->footprint, 0);
+  if (resource->handle != NULL) {
+    exg_reap(EXG_REAP_DMATRIX, resource->handle);
+  }
 }
 
 void Booster_RESOURCE_TYPE_cleanup(ErlNifEnv *env, void *arg) {
-  BoosterHandle handle = *((BoosterHandle *)arg);
-  XGBoosterFree(handle);
+  exg_booster_resource *resource = (exg_booster_resource *)arg;
+  exg_set_footprint(&resource->footprint, 0);
+  exg_history_free(&resource->history);
+  if (resource->handle != NULL) {
+    exg_reap(EXG_REAP_BOOSTER, resource->handle);
+  }
 }
 
 // Argument helpers
@@ -114,6 +124,9 @@ int exg_get_dmatrix_list(ErlNifEnv *env, ERL_NIF_TERM term,
                            (void *)&(resource))) {
       return 0;
     }
+    if (*resource == NULL) {
+      return 0;
+    }
     memcpy(&((*dmats)[i]), resource, sizeof(DMatrixHandle));
     term = tail;
     i++;
@@ -121,6 +134,804 @@ int exg_get_dmatrix_list(ErlNifEnv *env, ERL_NIF_TERM term,
   return 1;
 }
 
+int exg_make_array_interface(char *buf, size_t size, const void *data,
+                             bst_ulong len, const char *typestr) {
+  int written = snprintf(
+      buf, size,
+      "{\"data\": [%llu, true], \"shape\": [%llu], \"typestr\": \"%s\", "
+      "\"version\": 3}",
+      (unsigned long long)(uintptr_t)data, (unsigned long long)len, typestr);
+  return written > 0 && (size_t)written < size;
+}
+
+// Two stable counting sorts, first by column and then by row, leave every row
+// with its columns ascending and duplicates in input order. Both passes and
+// the merge are linear in nnz.
+const char *exg_check_coo_shape(bst_ulong nrow, bst_ulong ncol) {
+  if (nrow > SIZE_MAX / sizeof(uint64_t) - 1 ||
+      ncol > SIZE_MAX / sizeof(uint64_t) - 1) {
+    return "nrow and ncol are too large";
+  }
+  if (ncol > UINT32_MAX) {
+    return "ncol must fit in u32 column indices";
+  }
+  return NULL;
+}
+
+const char *exg_coo_to_csr(const unsigned *rows, const unsigned *cols,
+                           const float *values, size_t nnz, bst_ulong nrow,
+                           bst_ulong ncol, int sum_duplicates,
+                           uint64_t *indptr, unsigned *indices,
+                           float *out_values, size_t *out_nnz) {
+  size_t *order = NULL;
+  uint64_t *next = NULL;
+  uint64_t begin = 0;
+  size_t out = 0;
+  const char *err = exg_check_coo_shape(nrow, ncol);
+  if (err != NULL) {
+    return err;
+  }
+  for (size_t i = 0; i < nnz; ++i) {
+    if (rows[i] >= nrow) {
+      return "Row index out of range";
+    }
+    if (cols[i] >= ncol) {
+      return "Column index out of range";
+    }
+  }
+  order = enif_alloc(sizeof(size_t) * (nnz > 0 ? nnz : 1));
+  next = enif_alloc(sizeof(uint64_t) * ((nrow > ncol ? nrow : ncol) + 1));
+  if (order == NULL || next == NULL) {
+    if (order != NULL) {
+      enif_free(order);
+    }
+    if (next != NULL) {
+      enif_free(next);
+    }
+    return "Failed to allocate memory";
+  }
+  // Pass 1: order the entries by column
+  memset(next, 0, sizeof(uint64_t) * (ncol + 1));
+  for (size_t i = 0; i < nnz; ++i) {
+    next[cols[i] + 1]++;
+  }
+  for (bst_ulong c = 0; c < ncol; ++c) {
+    next[c + 1] += next[c];
+  }
+  for (size_t i = 0; i < nnz; ++i) {
+    order[next[cols[i]]++] = i;
+  }
+  // Pass 2: scatter the column-ordered entries into their rows
+  memset(indptr, 0, sizeof(uint64_t) * (nrow + 1));
+  for (size_t i = 0; i < nnz; ++i) {
+    indptr[rows[i] + 1]++;
+  }
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    indptr[r + 1] += indptr[r];
+  }
+  memcpy(next, indptr, sizeof(uint64_t) * nrow);
+  for (size_t k = 0; k < nnz; ++k) {
+    size_t i = order[k];
+    uint64_t dst = next[rows[i]]++;
+    indices[dst] = cols[i];
+    out_values[dst] = values[i];
+  }
+  // Merge duplicates in place, compacting the rows as we go
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    uint64_t end = indptr[r + 1];
+    size_t row_start = out;
+    for (uint64_t j = begin; j < end; ++j) {
+      if (out > row_start && indices[out - 1] == indices[j]) {
+        out_values[out - 1] =
+            sum_duplicates ? out_values[out - 1] + out_values[j] : out_values[j];
+      } else {
+        indices[out] = indices[j];
+        out_values[out] = out_values[j];
+        ++out;
+      }
+    }
+    indptr[r + 1] = out;
+    begin = end;
+  }
+  *out_nnz = out;
+  enif_free(order);
+  enif_free(next);
+  return NULL;
+}
+
+ERL_NIF_TERM exg_coo_to_csr_nif(ErlNifEnv *env, int argc,
+                                const ERL_NIF_TERM argv[]) {
+  ErlNifBinary rows_bin;
+  ErlNifBinary cols_bin;
+  ErlNifBinary values_bin;
+  ErlNifBinary indptr_bin;
+  ErlNifBinary indices_bin;
+  ErlNifBinary out_values_bin;
+  ErlNifUInt64 nrow = 0;
+  ErlNifUInt64 ncol = 0;
+  int sum_duplicates = 1;
+  int allocated = 0;
+  size_t nnz = 0;
+  size_t out_nnz = 0;
+  uint64_t indptr_size = 0;
+  const char *err = NULL;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 6) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[0], &rows_bin) ||
+      !enif_inspect_binary(env, argv[1], &cols_bin) ||
+      !enif_inspect_binary(env, argv[2], &values_bin)) {
+    ret = exg_error(env, "Rows, cols and values must be binaries");
+    goto END;
+  }
+  nnz = values_bin.size / sizeof(float);
+  if (values_bin.size % sizeof(float) != 0 ||
+      rows_bin.size != nnz * sizeof(unsigned) ||
+      cols_bin.size != nnz * sizeof(unsigned)) {
+    ret = exg_error(env, "Rows and cols must be u32 and values f32 binaries "
+                         "of the same length");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[3], &nrow) ||
+      !enif_get_uint64(env, argv[4], &ncol)) {
+    ret = exg_error(env, "nrow and ncol must be non-negative integers");
+    goto END;
+  }
+  if (!enif_get_int(env, argv[5], &sum_duplicates)) {
+    ret = exg_error(env, "sum_duplicates must be an int");
+    goto END;
+  }
+  err = exg_check_coo_shape(nrow, ncol);
+  if (err != NULL ||
+      !exg_mul_size(nrow + 1, sizeof(uint64_t), &indptr_size)) {
+    ret = exg_error(env, err != NULL ? err : "nrow is too large");
+    goto END;
+  }
+  if (!enif_alloc_binary(indptr_size, &indptr_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 1;
+  if (!enif_alloc_binary(sizeof(unsigned) * nnz, &indices_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 2;
+  if (!enif_alloc_binary(sizeof(float) * nnz, &out_values_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 3;
+  err = exg_coo_to_csr((const unsigned *)rows_bin.data,
+                       (const unsigned *)cols_bin.data,
+                       (const float *)values_bin.data, nnz, nrow, ncol,
+                       sum_duplicates, (uint64_t *)indptr_bin.data,
+                       (unsigned *)indices_bin.data,
+                       (float *)out_values_bin.data, &out_nnz);
+  if (err != NULL) {
+    ret = exg_error(env, err);
+    goto END;
+  }
+  if (out_nnz < nnz) {
+    enif_realloc_binary(&indices_bin, sizeof(unsigned) * out_nnz);
+    enif_realloc_binary(&out_values_bin, sizeof(float) * out_nnz);
+  }
+  allocated = 0;
+  ret = exg_ok(env, enif_make_tuple3(env, enif_make_binary(env, &indptr_bin),
+                                     enif_make_binary(env, &indices_bin),
+                                     enif_make_binary(env, &out_values_bin)));
+END:
+  if (allocated > 2) {
+    enif_release_binary(&out_values_bin);
+  }
+  if (allocated > 1) {
+    enif_release_binary(&indices_bin);
+  }
+  if (allocated > 0) {
+    enif_release_binary(&indptr_bin);
+  }
+  return ret;
+}
+
+int exg_mul_size(uint64_t a, uint64_t b, uint64_t *out) {
+  if (b != 0 && a > UINT64_MAX / b) {
+    return 0;
+  }
+  *out = a * b;
+  return 1;
+}
+
+int exg_get_missing(ErlNifEnv *env, ERL_NIF_TERM term, float *missing) {
+  double value = 0;
+  if (enif_get_double(env, term, &value)) {
+    *missing = (float)value;
+    return 1;
+  }
+  if (enif_is_identical(term, enif_make_atom(env, "nil"))) {
+    *missing = NAN;
+    return 1;
+  }
+  return 0;
+}
+
+// An entry is present when it is not NaN and differs from `missing`. With a
+// NaN `missing` the second comparison is always true, so both cases share one
+// branch-free loop that the compiler can vectorize.
+#define EXG_PRESENT(v, missing) (((v) == (v)) & ((v) != (missing)))
+
+uint64_t exg_dense_scan(const float *data, bst_ulong nrow, bst_ulong ncol,
+                        float missing, uint64_t *row_nnz, uint64_t *col_nnz) {
+  uint64_t total = 0;
+  if (col_nnz != NULL) {
+    memset(col_nnz, 0, sizeof(uint64_t) * ncol);
+  }
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    const float *row = data + r * ncol;
+    uint64_t count = 0;
+    if (col_nnz != NULL) {
+      for (bst_ulong c = 0; c < ncol; ++c) {
+        uint64_t present = EXG_PRESENT(row[c], missing);
+        col_nnz[c] += present;
+        count += present;
+      }
+    } else {
+      for (bst_ulong c = 0; c < ncol; ++c) {
+        count += EXG_PRESENT(row[c], missing);
+      }
+    }
+    row_nnz[r] = count;
+    total += count;
+  }
+  return total;
+}
+
+exg_format exg_choose_format(bst_ulong nrow, bst_ulong ncol, uint64_t nnz,
+                             int allow_csc) {
+  // Dense stores 4 bytes per cell, the compressed layouts 4 bytes of index and
+  // 4 of value per present entry plus an 8 byte pointer per row (column)
+  double dense = 4.0 * (double)nrow * (double)ncol;
+  double csr = 8.0 * (double)nnz + 8.0 * ((double)nrow + 1);
+  double csc = 8.0 * (double)nnz + 8.0 * ((double)ncol + 1);
+  // XGBoost transposes CSC input while building the DMatrix, so it has to be
+  // a clear win over CSR to be worth it
+  if (allow_csc && nrow <= UINT32_MAX && 2 * csc < csr && csc < dense) {
+    return EXG_FORMAT_CSC;
+  }
+  if (ncol <= UINT32_MAX && csr < dense) {
+    return EXG_FORMAT_CSR;
+  }
+  return EXG_FORMAT_DENSE;
+}
+
+void exg_dense_to_csr(const float *data, bst_ulong nrow, bst_ulong ncol,
+                      float missing, const uint64_t *row_nnz, uint64_t *indptr,
+                      unsigned *indices, float *values) {
+  indptr[0] = 0;
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    const float *row = data + r * ncol;
+    uint64_t out = indptr[r];
+    for (bst_ulong c = 0; c < ncol; ++c) {
+      if (EXG_PRESENT(row[c], missing)) {
+        indices[out] = (unsigned)c;
+        values[out] = row[c];
+        ++out;
+      }
+    }
+    indptr[r + 1] = indptr[r] + row_nnz[r];
+  }
+}
+
+void exg_dense_to_csc(const float *data, bst_ulong nrow, bst_ulong ncol,
+                      float missing, const uint64_t *col_nnz, uint64_t *indptr,
+                      unsigned *indices, float *values) {
+  indptr[0] = 0;
+  for (bst_ulong c = 0; c < ncol; ++c) {
+    indptr[c + 1] = indptr[c] + col_nnz[c];
+  }
+  // Walk the rows in order and append to each column, so the row indices of
+  // every column come out ascending. The last pointer doubles as the cursor.
+  for (bst_ulong r = 0; r < nrow; ++r) {
+    const float *row = data + r * ncol;
+    for (bst_ulong c = 0; c < ncol; ++c) {
+      if (EXG_PRESENT(row[c], missing)) {
+        uint64_t out = indptr[c]++;
+        indices[out] = (unsigned)r;
+        values[out] = row[c];
+      }
+    }
+  }
+  // Shift the cursors back into column starts
+  for (bst_ulong c = ncol; c > 0; --c) {
+    indptr[c] = indptr[c - 1];
+  }
+  indptr[0] = 0;
+}
+
+ERL_NIF_TERM exg_dense_to_csr_nif(ErlNifEnv *env, int argc,
+                                  const ERL_NIF_TERM argv[]) {
+  ErlNifBinary data_bin;
+  ErlNifBinary indptr_bin;
+  ErlNifBinary indices_bin;
+  ErlNifBinary values_bin;
+  ErlNifUInt64 nrow = 0;
+  ErlNifUInt64 ncol = 0;
+  float missing = NAN;
+  uint64_t *row_nnz = NULL;
+  uint64_t nnz = 0;
+  uint64_t bytes = 0;
+  int allocated = 0;
+  ERL_NIF_TERM ret = -1;
+  if (argc != 4) {
+    ret = exg_error(env, "Wrong number of arguments");
+    goto END;
+  }
+  if (!enif_inspect_binary(env, argv[0], &data_bin)) {
+    ret = exg_error(env, "Data must be a binary of f32");
+    goto END;
+  }
+  if (!enif_get_uint64(env, argv[1], &nrow) ||
+      !enif_get_uint64(env, argv[2], &ncol)) {
+    ret = exg_error(env, "nrow and ncol must be non-negative integers");
+    goto END;
+  }
+  if (!exg_mul_size(nrow, ncol, &bytes) ||
+      !exg_mul_size(bytes, sizeof(float), &bytes) || data_bin.size != bytes) {
+    ret = exg_error(env, "Data size does not match nrow * ncol");
+    goto END;
+  }
+  // An empty binary matches any nrow when ncol is 0 (and vice versa), which
+  // would leave the count and pointer buffers sized from an unchecked shape
+  if ((nrow == 0) != (ncol == 0)) {
+    ret = exg_error(env, "nrow and ncol must both be zero or both non-zero");
+    goto END;
+  }
+  if (!exg_get_missing(env, argv[3], &missing)) {
+    ret = exg_error(env, "Missing must be a float or nil");
+    goto END;
+  }
+  row_nnz = enif_alloc(sizeof(uint64_t) * (nrow > 0 ? nrow : 1));
+  if (row_nnz == NULL) {
+    ret = exg_error(env, "Failed to allocate memory");
+    goto END;
+  }
+  nnz = exg_dense_scan((const float *)data_bin.data, nrow, ncol, missing,
+                       row_nnz, NULL);
+  if (exg_choose_format(nrow, ncol, nnz, 0) == EXG_FORMAT_DENSE) {
+    ret = exg_ok(env, enif_make_atom(env, "dense"));
+    goto END;
+  }
+  if (!enif_alloc_binary(sizeof(uint64_t) * (nrow + 1), &indptr_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 1;
+  if (!enif_alloc_binary(sizeof(unsigned) * nnz, &indices_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 2;
+  if (!enif_alloc_binary(sizeof(float) * nnz, &values_bin)) {
+    ret = exg_error(env, "Failed to allocate binary");
+    goto END;
+  }
+  allocated = 3;
+  exg_dense_to_csr((const float *)data_bin.data, nrow, ncol, missing, row_nnz,
+                   (uint64_t *)indptr_bin.data, (unsigned *)indices_bin.data,
+                   (float *)values_bin.data);
+  allocated = 0;
+  ret = exg_ok(env, enif_make_tuple3(env, enif_make_binary(env, &indptr_bin),
+                                     enif_make_binary(env, &indices_bin),
+                                     enif_make_binary(env, &values_bin)));
+END:
+  if (allocated > 2) {
+    enif_release_binary(&values_bin);
+  }
+  if (allocated > 1) {
+    enif_release_binary(&indices_bin);
+  }
+  if (allocated > 0) {
+    enif_release_binary(&indptr_bin);
+  }
+  if (row_nnz != NULL) {
+    enif_free(row_nnz);
+  }
+  return ret;
+}
+
+// Evaluation helpers
+size_t exg_parse_eval(const char *msg, char **evnames, unsigned num_evals,
+                      exg_eval_entry *entries) {
+  size_t count = 0;
+  const char *token = strchr(msg, '\t');
+  while (token != NULL) {
+    const char *end = NULL;
+    const char *colon = NULL;
+    size_t best_len = 0;
+    unsigned best = num_evals;
+    token++;
+    end = strchr(token, '\t');
+    if (end == NULL) {
+      end = token + strlen(token);
+    }
+    // Eval names may contain '-', so take the longest name that matches
+    for (unsigned i = 0; i < num_evals; ++i) {
+      size_t len = strlen(evnames[i]);
+      if (len >= best_len && token + len < end &&
+          strncmp(token, evnames[i], len) == 0 && token[len] == '-') {
+        best = i;
+        best_len = len;
+      }
+    }
+    for (const char *c = end; c > token; --c) {
+      if (c[-1] == ':') {
+        colon = c - 1;
+        break;
+      }
+    }
+    if (best < num_evals && colon != NULL && colon > token + best_len) {
+      entries[count].eval = best;
+      entries[count].metric = token + best_len + 1;
+      entries[count].metric_len = colon - entries[count].metric;
+      entries[count].value = strtod(colon + 1, NULL);
+      count++;
+    }
+    token = *end == '\t' ? end : NULL;
+  }
+  return count;
+}
+
+
+static int history_find_key(const exg_eval_history *history,
+                            const char *dataset, const char *metric,
+                            size_t metric_len) {
+  for (unsigned k = 0; k < history->num_keys; ++k) {
+    if (strcmp(history->datasets[k], dataset) == 0 &&
+        strncmp(history->metrics[k], metric, metric_len) == 0 &&
+        history->metrics[k][metric_len] == '\0') {
+      return (int)k;
+    }
+  }
+  return -1;
+}
+
+// Adds a column for a new key, moving the existing rows to the wider layout
+static int history_add_key(exg_eval_history *history, const char *dataset,
+                           const char *metric, size_t metric_len) {
+  unsigned num_keys = history->num_keys + 1;
+  size_t dataset_len = strlen(dataset);
+  char **datasets = NULL;
+  char **metrics = NULL;
+  double *values = NULL;
+  datasets = enif_realloc(history->datasets, sizeof(char *) * num_keys);
+  if (datasets == NULL) {
+    return 0;
+  }
+  history->datasets = datasets;
+  metrics = enif_realloc(history->metrics, sizeof(char *) * num_keys);
+  if (metrics == NULL) {
+    return 0;
+  }
+  history->metrics = metrics;
+  if (history->capacity > 0) {
+    values = enif_alloc(sizeof(double) * history->capacity * num_keys);
+    if (values == NULL) {
+      return 0;
+    }
+    for (size_t r = 0; r < history->num_rows; ++r) {
+      memcpy(values + r * num_keys, history->values + r * history->num_keys,
+             sizeof(double) * history->num_keys);
+      values[r * num_keys + num_keys - 1] = NAN;
+    }
+  }
+  datasets[num_keys - 1] = enif_alloc(dataset_len + 1);
+  metrics[num_keys - 1] = enif_alloc(metric_len + 1);
+  if (datasets[num_keys - 1] == NULL || metrics[num_keys - 1] == NULL) {
+    if (datasets[num_keys - 1] != NULL) {
+      enif_free(datasets[num_keys - 1]);
+    }
+    if (metrics[num_keys - 1] != NULL) {
+      enif_free(metrics[num_keys - 1]);
+    }
+    if (values != NULL) {
+      enif_free(values);
+    }
+    return 0;
+  }
+  memcpy(datasets[num_keys - 1], dataset, dataset_len + 1);
+  memcpy(metrics[num_keys - 1], metric, metric_len);
+  metrics[num_keys - 1][metric_len] = '\0';
+  if (history->values != NULL) {
+    enif_free(history->values);
+  }
+  history->values = values;
+  history->num_keys = num_keys;
+  return 1;
+}
+
+int exg_history_append(exg_eval_history *history, int iteration,
+                       char **evnames, const exg_eval_entry *entries,
+                       size_t count) {
+  int ok = 0;
+  enif_mutex_lock(history->lock);
+  for (size_t i = 0; i < count; ++i) {
+    if (history_find_key(history, evnames[entries[i].eval], entries[i].metric,
+                         entries[i].metric_len) < 0 &&
+        !history_add_key(history, evnames[entries[i].eval], entries[i].metric,
+                         entries[i].metric_len)) {
+      goto END;
+    }
+  }
+  if (history->num_rows == history->capacity) {
+    size_t capacity = history->capacity == 0 ? 64 : history->capacity * 2;
+    int32_t *iterations =
+        enif_realloc(history->iterations, sizeof(int32_t) * capacity);
+    double *values = NULL;
+    if (iterations == NULL) {
+      goto END;
+    }
+    history->iterations = iterations;
+    values = enif_realloc(history->values,
+                          sizeof(double) * capacity * history->num_keys);
+    if (values == NULL && history->num_keys > 0) {
+      goto END;
+    }
+    history->values = values;
+    history->capacity = capacity;
+  }
+  {
+    double *row = history->values + history->num_rows * history->num_keys;
+    for (unsigned k = 0; k < history->num_keys; ++k) {
+      row[k] = NAN;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      row[history_find_key(history, evnames[entries[i].eval],
+                           entries[i].metric, entries[i].metric_len)] =
+          entries[i].value;
+    }
+  }
+  history->iterations[history->num_rows++] = iteration;
+  ok = 1;
+END:
+  enif_mutex_unlock(history->lock);
+  return ok;
+}
+
+void exg_history_free(exg_eval_history *history) {
+  for (unsigned k = 0; k < history->num_keys; ++k) {
+    enif_free(history->datasets[k]);
+    enif_free(history->metrics[k]);
+  }
+  if (history->datasets != NULL) {
+    enif_free(history->datasets);
+  }
+  if (history->metrics != NULL) {
+    enif_free(history->metrics);
+  }
+  if (history->iterations != NULL) {
+    enif_free(history->iterations);
+  }
+  if (history->values != NULL) {
+    enif_free(history->values);
+  }
+  if (history->lock != NULL) {
+    enif_mutex_destroy(history->lock);
+  }
+  memset(history, 0, sizeof(*history));
+}
+
+static _Atomic uint64_t native_memory = 0;
+
+uint64_t exg_native_memory(void) { return atomic_load(&native_memory); }
+
+void exg_set_footprint(_Atomic uint64_t *footprint, uint64_t bytes) {
+  uint64_t old = atomic_exchange(footprint, bytes);
+  if (bytes >= old) {
+    atomic_fetch_add(&native_memory, bytes - old);
+  } else {
+    atomic_fetch_sub(&native_memory, old - bytes);
+  }
+}
+
+uint64_t exg_dmatrix_footprint(DMatrixHandle handle) {
+  bst_ulong nrow = 0;
+  bst_ulong nnz = 0;
+  // Freed handles, and those XGBoost cannot size like proxies, count as empty
+  if (handle == NULL || XGDMatrixNumRow(handle, &nrow) != 0 ||
+      XGDMatrixNumNonMissing(handle, &nnz) != 0) {
+    return 0;
+  }
+  return 8 * nnz + 12 * nrow;
+}
+
+uint64_t exg_booster_footprint(BoosterHandle handle) {
+  bst_ulong len = 0;
+  const char *buf = NULL;
+  if (handle == NULL || XGBoosterSerializeToBuffer(handle, &len, &buf) != 0) {
+    return 0;
+  }
+  return len;
+}
+
+ERL_NIF_TERM exg_native_memory_nif(ErlNifEnv *env, int argc,
+                                   const ERL_NIF_TERM argv[]) {
+  if (argc != 0) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  return exg_ok(env, enif_make_uint64(env, exg_native_memory()));
+}
+
+uint64_t exg_process_rss(void) {
+  uint64_t rss = 0;
+  struct rusage usage;
+#if defined(__linux__)
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (statm != NULL) {
+    if (fscanf(statm, "%llu %llu", &size, &resident) == 2) {
+      rss = (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+    }
+    fclose(statm);
+  }
+#endif
+  if (rss == 0 && getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    rss = (uint64_t)usage.ru_maxrss;
+#else
+    rss = (uint64_t)usage.ru_maxrss * 1024;
+#endif
+  }
+  return rss;
+}
+
+uint64_t exg_process_peak_rss(void) {
+  uint64_t peak = 0;
+  struct rusage usage;
+#if defined(__linux__)
+  char line[128];
+  unsigned long long kb = 0;
+  FILE *status = fopen("/proc/self/status", "r");
+  if (status != NULL) {
+    while (fgets(line, sizeof(line), status) != NULL) {
+      if (sscanf(line, "VmHWM: %llu kB", &kb) == 1) {
+        peak = (uint64_t)kb * 1024;
+        break;
+      }
+    }
+    fclose(status);
+  }
+#endif
+  if (peak == 0 && getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+    peak = (uint64_t)usage.ru_maxrss;
+#else
+    peak = (uint64_t)usage.ru_maxrss * 1024;
+#endif
+  }
+  return peak;
+}
+
+ERL_NIF_TERM exg_process_rss_nif(ErlNifEnv *env, int argc,
+                                 const ERL_NIF_TERM argv[]) {
+  if (argc != 0) {
+    return exg_error(env, "Wrong number of arguments");
+  }
+  return exg_ok(env, enif_make_uint64(env, exg_process_rss()));
+}
+
+typedef struct exg_reap_node {
+  exg_reap_kind kind;
+  void *handle;
+  struct exg_reap_node *next;
+} exg_reap_node;
+
+static ErlNifMutex *reaper_lock = NULL;
+static ErlNifCond *reaper_cond = NULL;
+static ErlNifTid reaper_tid;
+static exg_reap_node *reaper_head = NULL;
+static exg_reap_node *reaper_tail = NULL;
+static int reaper_running = 0;
+static int reaper_stopping = 0;
+
+static void reap_handle(exg_reap_kind kind, void *handle) {
+  if (kind == EXG_REAP_DMATRIX) {
+    XGDMatrixFree(handle);
+  } else {
+    XGBoosterFree(handle);
+  }
+}
+
+static void *reaper_main(void *arg) {
+  enif_mutex_lock(reaper_lock);
+  for (;;) {
+    exg_reap_node *node = NULL;
+    while (reaper_head == NULL && !reaper_stopping) {
+      enif_cond_wait(reaper_cond, reaper_lock);
+    }
+    if (reaper_head == NULL) {
+      break;
+    }
+    node = reaper_head;
+    reaper_head = node->next;
+    if (reaper_head == NULL) {
+      reaper_tail = NULL;
+    }
+    enif_mutex_unlock(reaper_lock);
+    reap_handle(node->kind, node->handle);
+    enif_free(node);
+    enif_mutex_lock(reaper_lock);
+  }
+  enif_mutex_unlock(reaper_lock);
+  return NULL;
+}
+
+int exg_reaper_start(void) {
+  reaper_lock = enif_mutex_create("exgboost_reaper_lock");
+  reaper_cond = enif_cond_create("exgboost_reaper_cond");
+  if (reaper_lock == NULL || reaper_cond == NULL) {
+    return 0;
+  }
+  reaper_stopping = 0;
+  if (enif_thread_create("exgboost_reaper", &reaper_tid, reaper_main, NULL,
+                         NULL) != 0) {
+    return 0;
+  }
+  reaper_running = 1;
+  return 1;
+}
+
+void exg_reaper_stop(void) {
+  if (reaper_running) {
+    enif_mutex_lock(reaper_lock);
+    reaper_stopping = 1;
+    enif_cond_signal(reaper_cond);
+    enif_mutex_unlock(reaper_lock);
+    enif_thread_join(reaper_tid, NULL);
+    reaper_running = 0;
+  }
+  if (reaper_cond != NULL) {
+    enif_cond_destroy(reaper_cond);
+    reaper_cond = NULL;
+  }
+  if (reaper_lock != NULL) {
+    enif_mutex_destroy(reaper_lock);
+    reaper_lock = NULL;
+  }
+}
+
+void exg_reap(exg_reap_kind kind, void *handle) {
+  exg_reap_node *node = NULL;
+  if (reaper_running) {
+    node = enif_alloc(sizeof(exg_reap_node));
+  }
+  // Without the thread, or the memory to queue, free on the caller
+  if (node == NULL) {
+    reap_handle(kind, handle);
+    return;
+  }
+  node->kind = kind;
+  node->handle = handle;
+  node->next = NULL;
+  enif_mutex_lock(reaper_lock);
+  if (reaper_tail == NULL) {
+    reaper_head = node;
+  } else {
+    reaper_tail->next = node;
+  }
+  reaper_tail = node;
+  enif_cond_signal(reaper_cond);
+  enif_mutex_unlock(reaper_lock);
+}
+
+uint64_t exg_rand_next(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
 ERL_NIF_TERM exg_get_binary_address(ErlNifEnv *env, int argc,
                                     const ERL_NIF_TERM argv[]) {
   ErlNifBinary bin;
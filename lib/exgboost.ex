@@ -30,6 +30,21 @@ defmodule EXGBoost do
   @doc type: :system
   def xgboost_version, do: EXGBoost.NIF.xgboost_version() |> Internal.unwrap!()
 
+  @doc """
+  Get the estimated native memory held by all live `EXGBoost.DMatrix` and
+  `EXGBoost.Booster` resources, in bytes.
+
+  The BEAM only accounts for the small resource handles, so this gauge is the
+  way to watch the memory they pin. DMatrix sizes are estimated from their rows
+  and present values, booster sizes are their serialized size as last measured:
+  when loaded, serialized or checkpointed and on every
+  `EXGBoost.Booster.memory/1`. Training doesn't measure, so call
+  `EXGBoost.Booster.memory/1` on trained boosters the gauge should reflect.
+  """
+  @spec native_memory() :: non_neg_integer()
+  @doc type: :system
+  def native_memory, do: EXGBoost.NIF.native_memory() |> Internal.unwrap!()
+
   @doc """
   Set global configuration.
 
@@ -60,6 +75,9 @@ defmodule EXGBoost do
   @doc """
   Train a new booster model given a data tensor and a label tensor.
 
+  Training and each of its rounds are reported as `:telemetry` spans, see
+  `EXGBoost.Telemetry`.
+
   ## Options
 
   * `:obj` - Specify the learning task and the corresponding learning objective.
@@ -67,6 +85,28 @@ defmodule EXGBoost do
     predicted real valued scores. dtrain is the training data set. This function
     returns gradient and second order gradient.
 
+    Alternatively `{:native, name, params}` selects one of the objectives compiled
+    into the NIF, whose gradients are computed natively without leaving the
+    training call:
+
+      * `:squared_error` - squared error, as `:reg_squarederror`.
+      * `:focal` - binary focal loss. Params `:gamma` (default `2.0`) and
+        `:alpha`, the weight of the positive class (unweighted by default).
+      * `:pinball` - quantile regression for the `:alpha` quantile (default `0.5`).
+      * `:expectile` - asymmetric squared error where residuals above the
+        prediction are weighted by `:alpha` (default `0.5`) and the others by
+        `1 - alpha`.
+      * `:tweedie` - Tweedie deviance with variance power `:rho` (default `1.5`)
+        and `:link` either `:log` (default) or `:identity`. The identity link
+        needs positive margins, so set `:base_score` accordingly.
+      * `:smooth_logloss` - logloss with labels smoothed towards 0.5 by
+        `:smoothing` (default `0.0`) and positives weighted by `:pos_weight`
+        (default `1.0`).
+
+    DMatrix weights are applied to all of them. The booster's `:objective` still
+    decides how predictions are transformed, so use `output_margin: true` or a
+    matching objective (e.g. `:binary_logitraw`) when predicting.
+
   * `:num_boost_rounds` - Number of boosting iterations.
 
   * `:evals` - A list of 3-Tuples `{x, y, label}` to use as a validation set for
@@ -89,7 +129,7 @@ defmodule EXGBoost do
       integer then the evaluation metric on the validation set is printed at every given `verbose_eval` boosting stage. The last boosting stage / the boosting stage found by using `early_stopping_rounds`
       is also printed. Example: with `verbose_eval=4` and at least one item in evals, an evaluation metric is printed every 4 boosting stages, instead of every boosting stage.
 
-  * `:learning_rates` - Either an arity 1 function that accept an integer parameter epoch and returns the corresponding learning rate or a list with the same length as num_boost_rounds.
+  * `:learning_rates` - Either an arity 1 function that accept an integer parameter epoch and returns the corresponding learning rate or a list of rates per round. Rounds past the end of the list keep its last rate.
 
   * `:callbacks` - List of `EXGBoost.Training.Callback` that are called during a given event. It is possible to use predefined callbacks by using `EXGBoost.Training.Callback` module.
       Callbacks should be in the form of a keyword list where the only valid keys are `:before_training`, `:after_training`, `:before_iteration`, and `:after_iteration`.
@@ -97,6 +137,42 @@ defmodule EXGBoost do
       as the arguments. The function should return the booster. If the function returns a booster with a different memory address, the original booster will be replaced with the new booster.
       If the function returns the original booster, the original booster will be used. If the function returns a booster with the same memory address but different contents, the behavior is undefined.
 
+  * `:checkpoint` - Periodically snapshots the booster along with the training state
+    to a directory. The snapshot is taken between rounds and written to disk on a
+    background thread, so training doesn't wait on the disk. Files are written to a
+    temporary path and renamed once synced, so a crash never leaves a partial
+    checkpoint. Options:
+
+      - `:path` - Directory the `checkpoint-<round>.bin` files are written to.
+      - `:every` - Write a checkpoint every `every` rounds.
+      - `:interval` - Write a checkpoint once `interval` seconds have passed since
+        the last one. Can be combined with `:every`.
+      - `:keep` - Number of most recent checkpoints to keep. Defaults to `3`.
+
+  * `:resume_from` - A checkpoint file, or a `:checkpoint` directory to resume from
+    its newest checkpoint. Training continues after the last round the checkpoint
+    completed, up to `:num_boost_rounds`, restoring the state of early stopping and
+    user callbacks. The booster params given are applied on top of the saved ones.
+    Checkpoints whose callback state holds functions are refused, as resuming would
+    run code read from disk. The returned booster doesn't keep the checkpoint state.
+
+  * `:booster` - An existing booster to train in place for `:num_boost_rounds` more
+    rounds instead of creating a new one. See `EXGBoost.Booster.continue/3`.
+
+  * `:cancel` - An `EXGBoost.CancelToken`. Training raises between rounds once it
+    is cancelled. Training also stops if the calling process exits.
+
+  * `:goss` - Gradient-based one-side sampling on the CPU, `true` or a keyword list
+    with `:top_rate` (default `0.2`), `:other_rate` (default `0.1`) and `:seed`
+    (default `0`). Every round keeps the `:top_rate` fraction of rows with the
+    largest gradients and samples `:other_rate` of all rows from the rest, whose
+    gradients are scaled up by `(1 - top_rate) / other_rate` to make up for the
+    rows left out. The tree is built on the kept rows only, so the work of each
+    round shrinks with the sampled fraction, at the cost of copying them out of
+    the DMatrix. Gradients are computed natively, so `:obj` must be a native
+    objective unless the booster's objective is `:reg_squarederror`,
+    `:binary_logistic` or `:binary_logitraw`. Requires a DMatrix that can be
+    sliced, so not a quantile DMatrix.
 
   * `opts` - Refer to `EXGBoost.Parameters` for the full list of options.
   """
@@ -106,10 +182,116 @@ defmodule EXGBoost do
     x = Nx.concatenate(x)
     y = Nx.concatenate(y)
     dmat_opts = Keyword.take(opts, Internal.dmatrix_feature_opts())
-    dmat = DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :dense))
+    dmat = DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto))
     Training.train(dmat, opts)
   end
 
+  @doc """
+  Train one booster per set of params in `param_sets`, all on the same data.
+
+  The DMatrix is built once from `x` and `y` and shared by every booster, as are
+  its histogram cuts, which are sketched once before training starts. This
+  suits sweeps over params that don't change the data, such as `:quantile_alpha`
+  for per-quantile models. Boosters are trained concurrently, each in a process
+  started with `Task.async_stream/3` whose training NIF calls run on dirty CPU
+  schedulers, and unless `nthread` is given every booster gets an equal share of
+  the machine's cores.
+
+  Every set of params is merged into `opts`, and may hold any option of
+  `train/3` except `:booster`, `:checkpoint` and `:resume_from`. As the cuts are
+  shared, boosters are grown with `tree_method: :hist`, and any other
+  `:tree_method` raises. The params the cuts are sketched with, `:max_bin`, must
+  be the same in every set, or an `ArgumentError` is raised before any training.
+
+  ## Options
+
+  * `:max_concurrency` - Maximum number of boosters trained at the same time.
+    Defaults to the number of param sets, capped at the number of dirty CPU
+    schedulers.
+
+  * `:evals` - See `train/3`. The evaluation sets are also built once.
+
+  Any other option is passed to `train/3` for every set.
+
+  Returns the boosters in the order of `param_sets`.
+
+  ## Examples
+
+      param_sets = for alpha <- [0.1, 0.5, 0.9], do: [quantile_alpha: alpha]
+
+      EXGBoost.train_many(x, y, param_sets,
+        objective: :reg_quantileerror,
+        num_boost_rounds: 100
+      )
+  """
+  @spec train_many(Nx.Tensor.t(), Nx.Tensor.t(), [Keyword.t()], Keyword.t()) :: [Booster.t()]
+  @doc type: :train_pred
+  def train_many(x, y, param_sets, opts \\ []) when is_list(param_sets) do
+    x = Nx.concatenate(x)
+    y = Nx.concatenate(y)
+    dmat_opts = Keyword.take(opts, Internal.dmatrix_feature_opts())
+    dmat = DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto))
+    Training.train_many(dmat, param_sets, opts)
+  end
+
+  @doc """
+  Run k-fold cross-validation given a data tensor and a label tensor.
+
+  The folds are trained concurrently, one booster per fold, each in a process of
+  its own started with `Task.async_stream/3`. Only the NIF calls doing the work of
+  a round run on dirty CPU schedulers. Unless `nthread` is given, every booster
+  gets an equal share of the machine's cores. Boosters advance one round at a
+  time, so the per-round metrics are aggregated across folds and early stopping
+  is decided on the mean of the test metric. Since each fold's booster only
+  ever sees its own data, the result is the same as training the folds one
+  after another.
+
+  ## Options
+
+  * `:nfold` - Number of folds. Defaults to `3`.
+
+  * `:seed` - Seed used to shuffle rows into folds. Defaults to `0`.
+
+  * `:stratified` - Keep the label distribution of every fold close to that of
+    the whole dataset. Defaults to `false`.
+
+  * `:max_concurrency` - Maximum number of folds trained at the same time.
+    Defaults to `nfold`, capped at the number of dirty CPU schedulers.
+
+  * `:num_boost_rounds` - Number of boosting iterations.
+
+  * `:early_stopping_rounds` - Stop when the mean of the last test metric has not
+    improved for this many rounds.
+
+  * `:verbose_eval` - If `true`, print the aggregated metrics each round. If an
+    integer, print them every given number of rounds. Defaults to `false`.
+
+  * `:learning_rates` - See `train/3`.
+
+  * `:obj` - See `train/3`.
+
+  * `opts` - Refer to `EXGBoost.Parameters` for the full list of options.
+
+  Returns a map with the following keys:
+
+  * `:history` - A list with one entry per round, each a map of
+    `%{"train" | "test" => %{metric => {mean, std}}}`, or `{:nan, :nan}` when a fold's
+    metric isn't finite.
+
+  * `:best_iteration` and `:best_score` - Set when early stopping is enabled.
+
+  * `:boosters` - The trained booster of each fold.
+  """
+  @spec cv(Nx.Tensor.t(), Nx.Tensor.t(), Keyword.t()) :: map()
+  @doc type: :train_pred
+  def cv(x, y, opts \\ []) do
+    x = Nx.concatenate(x)
+    y = Nx.concatenate(y)
+    dmat_opts = Keyword.take(opts, Internal.dmatrix_feature_opts())
+    dmat = DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto))
+    Training.cv(dmat, opts)
+  end
+
   @doc """
   Predict with a booster model against a tensor.
 
@@ -164,19 +346,31 @@ defmodule EXGBoost do
       n_groups), n_groups == 1 when multi-class is not used. Defaults to `false`, in
       which case the output shape can be (n_samples, ) if multi-class is not used.
 
+  * `:chunk_rows` - Predict this many rows at a time, so the prediction can be
+      stopped between blocks of rows. Defaults to `65_536` when `:cancel` is set.
+      Each block is copied out of the DMatrix, so this doesn't lower peak memory.
+      Quantile DMatrices can't be split into blocks and are predicted whole.
+
+  * `:cancel` - An `EXGBoost.CancelToken`. The prediction raises between blocks of
+      rows once it is cancelled.
+
   Returns an Nx.Tensor containing the predictions.
   """
   @doc type: :train_pred
   def predict(%Booster{} = bst, x, opts \\ []) do
     x = Nx.concatenate(x)
     {dmat_opts, opts} = Keyword.split(opts, Internal.dmatrix_feature_opts())
-    dmat = DMatrix.from_tensor(x, Keyword.put_new(dmat_opts, :format, :dense))
+    dmat = DMatrix.from_tensor(x, Keyword.put_new(dmat_opts, :format, :auto))
     Booster.predict(bst, dmat, opts)
   end
 
   @doc """
   Run prediction in-place, Unlike `EXGBoost.predict/2`, in-place prediction does not cache the prediction result.
 
+  `data` is either a dense tensor, a CSR tuple `{indptr, indices, values, ncol}`, or
+  unsorted COO triplets `{:coo, rows, cols, values, {nrow, ncol}}`, which are converted
+  to CSR natively (duplicates are summed).
+
   ## Options
 
   * `:base_margin` -  Base margin used for boosting from existing model.
@@ -195,6 +389,10 @@ defmodule EXGBoost do
 
   * `:strict_shape` - See `EXGBoost.predict/2` for details.
 
+  * `:format` - `:dense` (the default) predicts a dense tensor as is. `:auto` first
+    scans it and predicts through CSR when that is smaller, which pays off for mostly
+    missing tensors. CSR values are converted to `f32`, as XGBoost stores them.
+
   Returns an Nx.Tensor containing the predictions.
   """
   @doc type: :train_pred
@@ -206,7 +404,8 @@ defmodule EXGBoost do
         missing: Nx.Constants.nan(),
         validate_features: true,
         base_margin: nil,
-        strict_shape: false
+        strict_shape: false,
+        format: :dense
       )
 
     base_margin = Keyword.fetch!(opts, :base_margin)
@@ -231,7 +430,7 @@ defmodule EXGBoost do
         nil
       end
 
-    case data do
+    case maybe_sparse(data, opts[:format], opts[:missing]) do
       %Nx.Tensor{} = data ->
         data_interface = ArrayInterface.from_tensor(data) |> Jason.encode!()
 
@@ -246,6 +445,11 @@ defmodule EXGBoost do
 
         Nx.tensor(preds) |> Nx.reshape(shape)
 
+      {:coo, %Nx.Tensor{} = rows, %Nx.Tensor{} = cols, %Nx.Tensor{} = values, shape} ->
+        {_nrow, ncol} = shape
+        {indptr, indices, values} = DMatrix.coo_to_csr(rows, cols, values, shape)
+        inplace_predict(boostr, {indptr, indices, values, ncol}, opts)
+
       {%Nx.Tensor{} = indptr, %Nx.Tensor{} = indices, %Nx.Tensor{} = values, ncol} ->
         indptr_interface = ArrayInterface.from_tensor(indptr) |> Jason.encode!()
         indices_interface = ArrayInterface.from_tensor(indices) |> Jason.encode!()
@@ -282,6 +486,25 @@ defmodule EXGBoost do
     end
   end
 
+  # With `format: :auto`, 2-D tensors sparse enough to be smaller as CSR are
+  # predicted through the CSR path, which only visits the present values.
+  # Dense tensors keep their type
+  defp maybe_sparse(%Nx.Tensor{shape: {nrow, ncol}} = data, :auto, missing) do
+    binary = data |> Nx.as_type(:f32) |> Nx.to_binary()
+
+    case EXGBoost.NIF.dense_to_csr(binary, nrow, ncol, Internal.missing_value(missing))
+         |> Internal.unwrap!() do
+      :dense ->
+        data
+
+      {indptr, indices, values} ->
+        {Nx.from_binary(indptr, :u64), Nx.from_binary(indices, :u32),
+         Nx.from_binary(values, :f32), ncol}
+    end
+  end
+
+  defp maybe_sparse(data, _format, _missing), do: data
+
   @format_opts [
     format: [
       type: {:in, [:json, :ubj]},
@@ -333,11 +556,13 @@ defmodule EXGBoost do
 
   @doc """
   Read a model from a file and return the Booster.
+
+  The file is mapped into memory rather than read, see `EXGBoost.Booster.load_mmap/2`.
   """
   @doc type: :serialization
   @spec read_model(String.t()) :: EXGBoost.Booster.t()
   def read_model(path) do
-    EXGBoost.Booster.load(path, deserialize: :model)
+    EXGBoost.Booster.load_mmap(path, deserialize: :model)
   end
 
   @doc """
@@ -442,11 +667,13 @@ defmodule EXGBoost do
 
   @doc """
   Read a model's trained parameters from a file and return the Booster.
+
+  The file is mapped into memory rather than read, see `EXGBoost.Booster.load_mmap/2`.
   """
   @spec read_weights(String.t()) :: EXGBoost.Booster.t()
   @doc type: :serialization
   def read_weights(path) do
-    EXGBoost.Booster.load(path, deserialize: :weights)
+    EXGBoost.Booster.load_mmap(path, deserialize: :weights)
   end
 
   @doc """
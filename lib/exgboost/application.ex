@@ -4,6 +4,11 @@ defmodule EXGBoost.Application do
   def start(_type, _args) do
     global_config = Application.get_all_env(:exgboost) |> Enum.into(%{})
     :ok = EXGBoost.set_config(global_config)
+
+    if cpu_budget = global_config[:cpu_budget] do
+      :ok = EXGBoost.CPUBudget.set(cpu_budget)
+    end
+
     Supervisor.start_link([], strategy: :one_for_one)
   end
 end
@@ -13,6 +13,10 @@ defmodule EXGBoost.Booster do
   If you need more control over the training process, please refer to `EXGBoost.Training.Callback` for
   guidance on how to inject custom logic into the training process.
 
+  An existing Booster can be kept up to date with new data without retraining it:
+  `EXGBoost.Booster.refresh/3` recomputes the statistics of its trees, and
+  `EXGBoost.Booster.continue/3` grows more trees on top of them.
+
   ## Creation
 
   A Booster can be created using `EXGBoost.Booster.booster` from a list of DMatrices, a single DMatrix, or
@@ -119,6 +123,18 @@ defmodule EXGBoost.Booster do
     ]
   ]
 
+  @load_mmap_schema [
+    deserialize: [
+      type: {:in, [:weights, :model]},
+      default: :model,
+      doc: """
+      The contents of the file. `:model` for the model along with its configuration, as
+      written by `EXGBoost.write_model/3`, or `:weights` for the model alone, as written by
+      `EXGBoost.write_weights/3`.
+      """
+    ]
+  ]
+
   @dump_schema [
     fmap: [
       type: :string,
@@ -145,6 +161,7 @@ defmodule EXGBoost.Booster do
 
   @save_schema NimbleOptions.new!(@save_schema)
   @load_schema NimbleOptions.new!(@load_schema)
+  @load_mmap_schema NimbleOptions.new!(@load_mmap_schema)
   @dump_schema NimbleOptions.new!(@dump_schema)
 
   @doc """
@@ -163,16 +180,9 @@ defmodule EXGBoost.Booster do
   def booster(dmats, opts \\ [])
 
   def booster(dmats, opts) when is_list(dmats) do
-    {str_opts, opts} = Keyword.split(opts, Internal.dmatrix_str_feature_opts())
-    opts = EXGBoost.Parameters.validate!(opts)
     refs = Enum.map(dmats, & &1.ref)
     booster_ref = EXGBoost.NIF.booster_create(refs) |> Internal.unwrap!()
-
-    Enum.each(str_opts, fn {key, value} ->
-      EXGBoost.NIF.booster_set_str_feature_info(booster_ref, Atom.to_string(key), value)
-    end)
-
-    set_params(%__MODULE__{ref: booster_ref}, opts)
+    configure(%__MODULE__{ref: booster_ref}, opts)
   end
 
   def booster(%DMatrix{} = dmat, opts) do
@@ -180,16 +190,22 @@ defmodule EXGBoost.Booster do
   end
 
   def booster(%__MODULE__{} = bst, opts) do
-    {str_opts, opts} = Keyword.split(opts, Internal.dmatrix_str_feature_opts())
-    opts = EXGBoost.Parameters.validate!(opts)
     boostr_bytes = EXGBoost.NIF.booster_serialize_to_buffer(bst.ref) |> Internal.unwrap!()
     booster_ref = EXGBoost.NIF.booster_deserialize_from_buffer(boostr_bytes) |> Internal.unwrap!()
+    configure(%__MODULE__{ref: booster_ref}, opts)
+  end
+
+  @doc false
+  # Applies the validated params and string feature info of `booster/2` in place
+  def configure(%__MODULE__{} = booster, opts) do
+    {str_opts, opts} = Keyword.split(opts, Internal.dmatrix_str_feature_opts())
+    opts = EXGBoost.Parameters.validate!(opts)
 
     Enum.each(str_opts, fn {key, value} ->
-      EXGBoost.NIF.booster_set_str_feature_info(booster_ref, Atom.to_string(key), value)
+      EXGBoost.NIF.booster_set_str_feature_info(booster.ref, Atom.to_string(key), value)
     end)
 
-    set_params(%__MODULE__{ref: booster_ref}, opts)
+    set_params(booster, opts)
   end
 
   @doc """
@@ -303,6 +319,59 @@ defmodule EXGBoost.Booster do
     struct(booster, ref: booster_ref)
   end
 
+  @doc """
+  Load a Booster from a JSON or UBJ model file mapped into memory.
+
+  `load/2` reads the whole file into a binary before XGBoost parses it. Here the
+  file is mapped and XGBoost parses the mapping on a dirty IO scheduler, so the
+  only memory the load adds is the loaded booster itself, and the file's pages
+  are left to the page cache.
+
+  Emits `[:exgboost, :booster, :load]` once loaded, with the measurements:
+
+    * `:duration` - Time spent mapping and parsing the file, in `:native` units.
+    * `:size` - Size of the file in bytes.
+    * `:rss_before` and `:rss_after` - Resident set size of the VM in bytes
+      before and after the load.
+    * `:peak_rss` - Peak resident set size of the VM in bytes, which includes
+      the load if it set a new peak.
+
+  The metadata is `%{path: path, booster: booster}`.
+
+  ## Options
+  #{NimbleOptions.docs(@load_mmap_schema)}
+  """
+  @spec load_mmap(Path.t(), Keyword.t()) :: t()
+  def load_mmap(path, opts \\ []) do
+    opts = NimbleOptions.validate!(opts, @load_mmap_schema)
+    path = Path.absname(path)
+
+    if not File.exists?(path) do
+      raise ArgumentError, "File not found: #{path}"
+    end
+
+    serialized = if opts[:deserialize] == :model, do: 1, else: 0
+
+    {ref, size, load_ns, rss_before, rss_after, peak_rss} =
+      EXGBoost.NIF.booster_load_model_mmap(path, serialized) |> Internal.unwrap!()
+
+    booster = %__MODULE__{ref: ref}
+
+    :telemetry.execute(
+      [:exgboost, :booster, :load],
+      %{
+        duration: System.convert_time_unit(load_ns, :nanosecond, :native),
+        size: size,
+        rss_before: rss_before,
+        rss_after: rss_after,
+        peak_rss: peak_rss
+      },
+      %{path: path, booster: booster}
+    )
+
+    booster
+  end
+
   @doc """
   Get a formatted representation of the Booster's model.
 
@@ -332,7 +401,22 @@ defmodule EXGBoost.Booster do
 
   @doc """
   Boost the booster for one iteration, with customized gradient statistics.
+
+  `grad` and `hess` are `f32` tensors, or binaries of native-endian `f32`s which
+  are handed to XGBoost without being copied.
   """
+  def boost(booster, dmatrix, grad, hess)
+
+  def boost(%__MODULE__{} = booster, %DMatrix{} = dmatrix, grad, hess)
+      when is_binary(grad) and is_binary(hess) do
+    if byte_size(grad) != byte_size(hess) do
+      raise ArgumentError,
+            "grad and hess must have the same size, got #{byte_size(grad)} and #{byte_size(hess)} bytes"
+    end
+
+    EXGBoost.NIF.booster_boost_one_iter(booster.ref, dmatrix.ref, grad, hess)
+  end
+
   def boost(
         %__MODULE__{} = booster,
         %DMatrix{} = dmatrix,
@@ -366,7 +450,9 @@ defmodule EXGBoost.Booster do
         validate_features: true,
         training: false,
         iteration_range: {0, 0},
-        strict_shape: false
+        strict_shape: false,
+        chunk_rows: nil,
+        cancel: nil
       )
 
     if Keyword.fetch!(opts, :validate_features) do
@@ -413,8 +499,21 @@ defmodule EXGBoost.Booster do
       strict_shape: Keyword.fetch!(opts, :strict_shape)
     }
 
+    # Predicting in row blocks lets the call be cancelled between blocks
     {shape, preds} =
-      EXGBoost.NIF.booster_predict_from_dmatrix(booster.ref, data.ref, Jason.encode!(config))
+      case {Keyword.fetch!(opts, :chunk_rows), Keyword.fetch!(opts, :cancel)} do
+        {nil, nil} ->
+          EXGBoost.NIF.booster_predict_from_dmatrix(booster.ref, data.ref, Jason.encode!(config))
+
+        {chunk_rows, cancel} ->
+          EXGBoost.NIF.booster_predict_chunked(
+            booster.ref,
+            data.ref,
+            Jason.encode!(config),
+            chunk_rows || 65_536,
+            cancel && cancel.ref
+          )
+      end
       |> Internal.unwrap!()
 
     Nx.tensor(preds) |> Nx.reshape(shape)
@@ -504,14 +603,36 @@ defmodule EXGBoost.Booster do
     EXGBoost.NIF.booster_boosted_rounds(booster.ref) |> Internal.unwrap!()
   end
 
+  @doc """
+  Get the native memory held by the booster in bytes, measured as the size of
+  its serialized form.
+
+  Measuring serializes the booster, so it costs time proportional to the model size.
+  Created, sliced and trained boosters keep the size they were last measured
+  at in `EXGBoost.native_memory/0`, which starts at empty, until they are
+  measured again, serialized or checkpointed.
+  """
+  def memory(%__MODULE__{} = booster),
+    do: EXGBoost.NIF.booster_memory(booster.ref) |> Internal.unwrap!()
+
+  @doc """
+  Release the native memory of the booster now rather than when it is garbage collected.
+
+  Any later use of the booster raises. Freeing twice is a no-op. The booster
+  must not be in use by another process while it is freed.
+  """
+  def free(%__MODULE__{} = booster),
+    do: EXGBoost.NIF.booster_free(booster.ref) |> Internal.unwrap!()
+
   @doc """
   Get the attribute value for the given key.
   """
   def get_attr(%__MODULE__{} = booster, attr) do
     attrs = get_attrs(booster)
 
-    if Enum.member?(attrs, attr) do
-      EXGBoost.NIF.booster_get_attr(booster.ref, attr) |> Internal.unwrap!()
+    # Attribute names come back from the NIF as charlists
+    if Enum.any?(attrs, &(to_string(&1) == to_string(attr))) do
+      EXGBoost.NIF.booster_get_attr(booster.ref, attr) |> Internal.unwrap!() |> to_string()
     else
       :error
     end
@@ -544,6 +665,7 @@ defmodule EXGBoost.Booster do
   * `feval` - Custom evaluation function.
 
   Returns the resulting metrics as a list of 2-tuples in the form of {eval_metric, value}.
+  Non-finite values, such as a logloss that diverged, are returned as `:nan`.
   """
   def eval_set(%__MODULE__{} = booster, evals, iteration, opts \\ []) when is_list(evals) do
     opts = Keyword.validate!(opts, feval: nil, output_margin: true)
@@ -553,16 +675,9 @@ defmodule EXGBoost.Booster do
     {dmats_refs, evnames} = Enum.unzip(evals)
     dmats_refs = Enum.map(dmats_refs, & &1.ref)
 
-    msg =
-      EXGBoost.NIF.booster_eval_one_iter(booster.ref, iteration, dmats_refs, evnames)
-      |> Internal.unwrap!()
-
     res =
-      Regex.scan(~r/[[:blank:]](\w+)-(\w+):(-?\d+\.?\d+)/, to_string(msg), capture: :all_but_first)
-      |> Enum.map(fn [ev_name | [metric_name | [value]]] ->
-        {fval, _rem} = Float.parse(value)
-        {ev_name, metric_name, fval}
-      end)
+      EXGBoost.NIF.booster_eval(booster.ref, iteration, dmats_refs, evnames)
+      |> Internal.unwrap!()
 
     if feval do
       Enum.each(evals, fn {dmat, evname} ->
@@ -586,6 +701,44 @@ defmodule EXGBoost.Booster do
     end
   end
 
+  @doc """
+  Get the metrics recorded each time the booster was evaluated, either by
+  `eval_set/4` or during training with `:evals`.
+
+  Returns `nil` if the booster has not been evaluated, otherwise a map with the
+  evaluated iterations as an `s32` tensor under `:iterations` and one `f64`
+  tensor of the same length per eval set and metric under `:metrics`:
+
+      %{
+        iterations: #Nx.Tensor<s32[10]>,
+        metrics: %{"valid" => %{"rmse" => #Nx.Tensor<f64[10]>}}
+      }
+
+  Metrics that were not computed in a given evaluation are NaN.
+  """
+  @spec eval_history(t()) :: %{iterations: Nx.Tensor.t(), metrics: map()} | nil
+  def eval_history(%__MODULE__{} = booster) do
+    case EXGBoost.NIF.booster_eval_history(booster.ref) |> Internal.unwrap!() do
+      {keys, iterations, _values} when keys == [] or iterations == <<>> ->
+        nil
+
+      {keys, iterations, values} ->
+        iterations = Nx.from_binary(iterations, :s32)
+        shape = {Nx.size(iterations), length(keys)}
+        values = values |> Nx.from_binary(:f64) |> Nx.reshape(shape)
+
+        metrics =
+          keys
+          |> Enum.with_index()
+          |> Enum.reduce(%{}, fn {{ev, metric}, k}, acc ->
+            column = values[[.., k]]
+            Map.update(acc, ev, %{metric => column}, &Map.put(&1, metric, column))
+          end)
+
+        %{iterations: iterations, metrics: metrics}
+    end
+  end
+
   @doc """
   Update for one iteration, with objective function calculated internally.
 
@@ -593,11 +746,31 @@ defmodule EXGBoost.Booster do
   updates for one iteration, with objective function defined by the user.
 
   See [Custom Objective](https://xgboost.readthedocs.io/en/latest/tutorials/custom_metric_obj.html) for details.
+
+  `objective` may also be `{:native, name, params}`, see the `:obj` option of `EXGBoost.train/3`,
+  or `{:goss, {:native, name, params}, {top_rate, other_rate, seed}}` to build the round on
+  the rows sampled by gradient-based one-side sampling, see its `:goss` option.
   """
+  def update(booster, dmatrix, iteration, objective)
+
+  def update(%__MODULE__{} = booster, %DMatrix{} = dmatrix, iteration, {:goss, objective, goss})
+      when is_integer(iteration) do
+    native = Internal.native_objective(objective)
+    NIF.booster_boost_goss(booster.ref, dmatrix.ref, native, goss, iteration)
+    |> Internal.unwrap!()
+  end
+
   def update(%__MODULE__{} = booster, %DMatrix{} = dmatrix, iteration, objective)
       when is_integer(iteration) do
     if is_function(objective, 2) do
-      pred = predict(booster, dmatrix, output_margin: true, training: true)
+      Internal.validate_features!(booster, dmatrix)
+
+      # Margins come back as a single f32 binary rather than a list of floats,
+      # so the only host copies per round are this one and the gradients' own
+      {shape, margins} =
+        NIF.booster_predict_margin(booster.ref, dmatrix.ref, 1) |> Internal.unwrap!()
+
+      pred = margins |> Nx.from_binary(:f32) |> Nx.reshape(List.to_tuple(shape))
 
       # TO-DO(polvalente): the custom objective actually received a tensor in the first argument and
       # a dmatrix in the second argument. How are the objective functions actually meant
@@ -607,7 +780,74 @@ defmodule EXGBoost.Booster do
       {grad, hess} = objective.(pred, dmatrix)
       boost(booster, dmatrix, grad, hess)
     else
-      NIF.booster_update_one_iter(booster.ref, dmatrix.ref, iteration) |> Internal.unwrap!()
+      case Internal.native_objective(objective) do
+        nil ->
+          NIF.booster_update_one_iter(booster.ref, dmatrix.ref, iteration) |> Internal.unwrap!()
+
+        native ->
+          NIF.booster_boost_native(booster.ref, dmatrix.ref, native) |> Internal.unwrap!()
+      end
     end
   end
+
+  @doc """
+  Recompute the node statistics and leaf values of the booster's trees on
+  `dmatrix`, without growing new trees.
+
+  Every boosting round is replayed with XGBoost's `refresh` updater
+  (`process_type: :update`), so the trees keep their structure while their
+  statistics are recomputed from the new data. The booster is refreshed in place
+  and returned, and its configuration is restored afterwards. If the replay
+  fails, the booster is restored to its trees from before the refresh.
+
+  ## Options
+
+    * `:refresh_leaf` - whether to update the leaf values as well as the node
+      statistics. Defaults to `true`.
+    * `:prune` - whether to also prune the splits whose loss change on the new
+      data falls below `min_split_loss`. Defaults to `false`.
+  """
+  def refresh(%__MODULE__{} = booster, %DMatrix{} = dmatrix, opts \\ []) do
+    opts = Keyword.validate!(opts, refresh_leaf: true, prune: false)
+    config = NIF.booster_save_json_config(booster.ref) |> Internal.unwrap!()
+    # The replay rewrites the trees round by round, so a failure part way
+    # through would leave only the rounds replayed so far
+    snapshot = NIF.booster_serialize_to_buffer(booster.ref) |> Internal.unwrap!()
+    rounds = get_boosted_rounds(booster)
+
+    set_params(booster,
+      process_type: "update",
+      updater: if(opts[:prune], do: "refresh,prune", else: "refresh"),
+      refresh_leaf: if(opts[:refresh_leaf], do: 1, else: 0)
+    )
+
+    try do
+      for iteration <- 0..(rounds - 1)//1 do
+        NIF.booster_update_one_iter(booster.ref, dmatrix.ref, iteration) |> Internal.unwrap!()
+      end
+    rescue
+      e ->
+        NIF.booster_restore_from_buffer(booster.ref, snapshot) |> Internal.unwrap!()
+        reraise e, __STACKTRACE__
+    after
+      NIF.booster_load_json_config(booster.ref, config) |> Internal.unwrap!()
+    end
+
+    booster
+  end
+
+  @doc """
+  Train the booster for `num_boost_rounds` more rounds on `dmatrix`, adding new
+  trees on top of the existing ones, like passing `xgb_model` to XGBoost's
+  `train`.
+
+  The booster is trained in place rather than copied first. Accepts the options
+  of `EXGBoost.train/3` except `:checkpoint` and `:resume_from`. Booster
+  parameters given in `opts` are set on the booster, and every other parameter
+  keeps its current value. Iterations seen by callbacks and `:learning_rates`
+  continue from the booster's last round.
+  """
+  def continue(%__MODULE__{} = booster, %DMatrix{} = dmatrix, opts \\ []) do
+    EXGBoost.Training.train(dmatrix, Keyword.put(opts, :booster, booster))
+  end
 end
@@ -0,0 +1,355 @@
+defmodule EXGBoost.BoosterCache do
+  @moduledoc """
+  A cache of boosters keyed by model id, loaded on first use and evicted least
+  recently used first once they hold more native memory than a budget.
+
+  Models stay serialized wherever the `:loader` finds them, on disk or in any
+  other store, and are only deserialized when `fetch/2` first asks for them.
+  Fetching a cached booster reads an ETS table from the calling process and
+  never goes through the cache process. A miss asks the cache process, which
+  loads the model in a task, so hits and loads of other models are served while
+  it runs. Concurrent misses on the same id wait for a single load.
+
+  Each booster is counted as the size of its serialized form, the same estimate
+  `EXGBoost.native_memory/0` uses. Once a load takes the total over
+  `:max_memory`, the least recently fetched boosters are evicted until it is
+  back under, never the one just loaded. Evicted boosters are not freed with
+  `EXGBoost.Booster.free/1`: a booster is freed by the garbage collector once no
+  process holds it, so predictions still running on it finish.
+
+  ## Example
+
+      {:ok, _pid} =
+        EXGBoost.BoosterCache.start_link(
+          name: MyApp.Boosters,
+          loader: &{:file, "models/#{&1}.ubj"},
+          max_memory: 2 * 1024 ** 3
+        )
+
+      booster = EXGBoost.BoosterCache.fetch(MyApp.Boosters, customer_id)
+      EXGBoost.predict(booster, x)
+
+  ## Telemetry
+
+    * `[:exgboost, :booster_cache, :load]` - Emitted after a miss loads a
+      booster, with the measurements `%{duration: integer(), size: integer()}`,
+      the duration in `:native` time units, and the metadata
+      `%{cache: atom(), id: term()}`.
+
+    * `[:exgboost, :booster_cache, :evict]` - Emitted when a booster is evicted,
+      with the measurement `%{size: integer()}` and the metadata
+      `%{cache: atom(), id: term()}`.
+
+    * `[:exgboost, :booster_cache]` - Emitted by `measure/1` with the
+      measurements of `stats/1`, counted since the previous call from the same
+      process for `:hits`, `:misses`, `:loads` and `:evictions`, and the metadata
+      `%{cache: atom()}`. It can be polled, for instance by `:telemetry_poller`:
+
+          :telemetry_poller.start_link(
+            measurements: [{EXGBoost.BoosterCache, :measure, [MyApp.Boosters]}],
+            period: :timer.seconds(5)
+          )
+  """
+
+  use GenServer
+
+  alias EXGBoost.Booster
+
+  @type cache :: atom()
+
+  @start_schema NimbleOptions.new!(
+                  name: [
+                    type: :atom,
+                    required: true,
+                    doc: """
+                    The name of the cache process and of its ETS table.
+                    """
+                  ],
+                  loader: [
+                    type: {:fun, 1},
+                    required: true,
+                    doc: """
+                    A function called with a model id that returns `{:file, path}` or
+                    `{:buffer, binary}` with the serialized model, or `nil` when there is no
+                    model with that id.
+                    """
+                  ],
+                  max_memory: [
+                    type: :pos_integer,
+                    required: true,
+                    doc: """
+                    The native memory budget of the cached boosters, in bytes.
+                    """
+                  ],
+                  deserialize: [
+                    type: {:in, [:model, :weights]},
+                    default: :model,
+                    doc: """
+                    Whether the loader returns models (`EXGBoost.write_model/3`) or only
+                    their weights (`EXGBoost.write_weights/3`).
+                    """
+                  ]
+                )
+
+  # Positions of the counters in the `:counters` array
+  @hits 1
+  @misses 2
+  @loads 3
+  @evictions 4
+
+  @doc """
+  Start a cache linked to the calling process.
+
+  ## Options
+  #{NimbleOptions.docs(@start_schema)}
+  """
+  @spec start_link(Keyword.t()) :: GenServer.on_start()
+  def start_link(opts) do
+    opts = NimbleOptions.validate!(opts, @start_schema)
+    GenServer.start_link(__MODULE__, opts, name: opts[:name])
+  end
+
+  @doc """
+  The booster of model `id`, loaded through the `:loader` if it isn't cached.
+
+  Raises if the loader has no model for `id` or the model can't be loaded.
+  """
+  @spec fetch(cache(), term(), timeout()) :: Booster.t()
+  def fetch(cache, id, timeout \\ :infinity) do
+    [{:counters, counters}] = :ets.lookup(cache, :counters)
+
+    case :ets.lookup(cache, {:booster, id}) do
+      [{key, booster, _size, _last_used}] ->
+        :counters.add(counters, @hits, 1)
+        :ets.update_element(cache, key, {4, System.monotonic_time()})
+        booster
+
+      [] ->
+        :counters.add(counters, @misses, 1)
+
+        case GenServer.call(cache, {:fetch, id}, timeout) do
+          {:ok, booster} -> booster
+          {:error, exception} -> raise exception
+        end
+    end
+  end
+
+  @doc """
+  Evict the booster of model `id`, if it is cached.
+  """
+  @spec evict(cache(), term()) :: :ok
+  def evict(cache, id), do: GenServer.call(cache, {:evict, id})
+
+  @doc """
+  Whether the booster of model `id` is cached.
+  """
+  @spec cached?(cache(), term()) :: boolean()
+  def cached?(cache, id), do: :ets.member(cache, {:booster, id})
+
+  @doc """
+  Returns the current state of the cache:
+
+    * `:boosters` - Boosters cached.
+    * `:memory` - Native memory of the cached boosters, in bytes.
+    * `:max_memory` - The native memory budget, in bytes.
+    * `:hits` - Fetches served from the cache since it started.
+    * `:misses` - Fetches that had to wait for a load since it started.
+    * `:loads` - Boosters loaded since it started. Lower than `:misses` when
+      concurrent misses waited for the same load.
+    * `:evictions` - Boosters evicted since it started.
+  """
+  @spec stats(cache()) :: map()
+  def stats(cache) do
+    [{:counters, counters}] = :ets.lookup(cache, :counters)
+    [{:memory, memory, max_memory}] = :ets.lookup(cache, :memory)
+
+    %{
+      boosters: :ets.info(cache, :size) - 2,
+      memory: memory,
+      max_memory: max_memory,
+      hits: :counters.get(counters, @hits),
+      misses: :counters.get(counters, @misses),
+      loads: :counters.get(counters, @loads),
+      evictions: :counters.get(counters, @evictions)
+    }
+  end
+
+  @doc """
+  Emit `[:exgboost, :booster_cache]` with the statistics of `cache` since the
+  previous call from this process.
+  """
+  @spec measure(cache()) :: :ok
+  def measure(cache) do
+    stats = stats(cache)
+    counted = [:hits, :misses, :loads, :evictions]
+    previous = Process.get({__MODULE__, cache}, Map.new(counted, &{&1, 0}))
+    Process.put({__MODULE__, cache}, stats)
+    since = Map.new(counted, &{&1, stats[&1] - previous[&1]})
+    :telemetry.execute([:exgboost, :booster_cache], Map.merge(stats, since), %{cache: cache})
+  end
+
+  @impl true
+  def init(opts) do
+    table =
+      :ets.new(opts[:name], [
+        :named_table,
+        :public,
+        read_concurrency: true,
+        write_concurrency: true
+      ])
+
+    :ets.insert(table, {:counters, :counters.new(4, [:write_concurrency])})
+    :ets.insert(table, {:memory, 0, opts[:max_memory]})
+    {:ok, tasks} = Task.Supervisor.start_link()
+
+    state = %{
+      table: table,
+      loader: opts[:loader],
+      deserialize: opts[:deserialize],
+      max_memory: opts[:max_memory],
+      memory: 0,
+      tasks: tasks,
+      # Maps each load task to the id it loads, and each id to its waiting callers
+      loading: %{},
+      waiting: %{}
+    }
+
+    {:ok, state}
+  end
+
+  @impl true
+  def handle_call({:fetch, id}, from, state) do
+    case {:ets.lookup(state.table, {:booster, id}), state.waiting} do
+      # Loaded between the caller's lookup and this call
+      {[{_key, booster, _size, _last_used}], _waiting} ->
+        {:reply, {:ok, booster}, state}
+
+      {[], waiting} when is_map_key(waiting, id) ->
+        {:noreply, update_in(state.waiting[id], &[from | &1])}
+
+      {[], _waiting} ->
+        %{loader: loader, deserialize: deserialize} = state
+        task = Task.Supervisor.async_nolink(state.tasks, fn -> load(loader, deserialize, id) end)
+        state = put_in(state.loading[task.ref], id)
+        {:noreply, put_in(state.waiting[id], [from])}
+    end
+  end
+
+  def handle_call({:evict, id}, _from, state) do
+    case :ets.lookup(state.table, {:booster, id}) do
+      [{key, _booster, size, _last_used}] -> {:reply, :ok, evict(state, key, size)}
+      [] -> {:reply, :ok, state}
+    end
+  end
+
+  @impl true
+  def handle_info({ref, result}, state) when is_map_key(state.loading, ref) do
+    Process.demonitor(ref, [:flush])
+    {id, state} = pop_in(state.loading[ref])
+    {waiting, state} = pop_in(state.waiting[id])
+
+    state =
+      case result do
+        {:ok, booster, size, duration} ->
+          [{:counters, counters}] = :ets.lookup(state.table, :counters)
+          :counters.add(counters, @loads, 1)
+          :ets.insert(state.table, {{:booster, id}, booster, size, System.monotonic_time()})
+
+          :telemetry.execute(
+            [:exgboost, :booster_cache, :load],
+            %{duration: duration, size: size},
+            %{cache: state.table, id: id}
+          )
+
+          state |> put_memory(state.memory + size) |> evict_over_budget(id)
+
+        {:error, _exception} ->
+          state
+      end
+
+    reply = with {:ok, booster, _size, _duration} <- result, do: {:ok, booster}
+    Enum.each(waiting, &GenServer.reply(&1, reply))
+    {:noreply, state}
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, reason}, state)
+      when is_map_key(state.loading, ref) do
+    {id, state} = pop_in(state.loading[ref])
+    {waiting, state} = pop_in(state.waiting[id])
+    message = "Loading #{inspect(id)} failed: #{Exception.format_exit(reason)}"
+    error = RuntimeError.exception(message)
+    Enum.each(waiting, &GenServer.reply(&1, {:error, error}))
+    {:noreply, state}
+  end
+
+  def handle_info(_message, state), do: {:noreply, state}
+
+  defp load(loader, deserialize, id) do
+    started = System.monotonic_time()
+
+    {booster, size} =
+      case loader.(id) do
+        {:file, path} ->
+          {Booster.load_mmap(path, deserialize: deserialize), File.stat!(path).size}
+
+        {:buffer, buffer} when is_binary(buffer) ->
+          booster = Booster.load(buffer, from: :buffer, deserialize: deserialize)
+          {booster, byte_size(buffer)}
+
+        nil ->
+          raise ArgumentError, "No model with id #{inspect(id)}"
+      end
+
+    {:ok, booster, size, System.monotonic_time() - started}
+  rescue
+    exception -> {:error, exception}
+  end
+
+  # Evicts the least recently fetched boosters other than `keep_id` until the
+  # cache is within its budget
+  defp evict_over_budget(%{memory: memory, max_memory: max_memory} = state, _keep_id)
+       when memory <= max_memory,
+       do: state
+
+  defp evict_over_budget(state, keep_id) do
+    lru =
+      :ets.foldl(
+        fn
+          {{:booster, id} = key, _booster, size, last_used}, lru when id != keep_id ->
+            case lru do
+              {_key, _size, lru_used} when lru_used <= last_used -> lru
+              _lru -> {key, size, last_used}
+            end
+
+          _entry, lru ->
+            lru
+        end,
+        nil,
+        state.table
+      )
+
+    case lru do
+      {key, size, _last_used} -> state |> evict(key, size) |> evict_over_budget(keep_id)
+      nil -> state
+    end
+  end
+
+  defp evict(state, {:booster, id} = key, size) do
+    :ets.delete(state.table, key)
+    [{:counters, counters}] = :ets.lookup(state.table, :counters)
+    :counters.add(counters, @evictions, 1)
+
+    :telemetry.execute(
+      [:exgboost, :booster_cache, :evict],
+      %{size: size},
+      %{cache: state.table, id: id}
+    )
+
+    put_memory(state, state.memory - size)
+  end
+
+  defp put_memory(state, memory) do
+    :ets.update_element(state.table, :memory, {2, memory})
+    %{state | memory: memory}
+  end
+end
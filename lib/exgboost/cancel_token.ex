@@ -0,0 +1,58 @@
+defmodule EXGBoost.CancelToken do
+  @moduledoc """
+  Stops long-running native calls part way through.
+
+  Training, and prediction with `:chunk_rows` or `:cancel`, run on dirty
+  schedulers and keep going after the process that started them has moved on.
+  Given a token through their `:cancel` option, they check it between boosting
+  rounds or blocks of rows and raise once it is cancelled, freeing the scheduler
+  and the cores it held.
+
+  A token is cancelled by `cancel/1` or when the process it monitors exits, so
+  a caller that gives up can simply exit:
+
+      token = EXGBoost.CancelToken.new()
+
+      task =
+        Task.async(fn ->
+          EXGBoost.train(x, y, num_boost_rounds: 10_000, cancel: token)
+        end)
+
+      # Elsewhere, once the result is no longer wanted
+      EXGBoost.CancelToken.cancel(token)
+
+  A training or prediction call also stops on its own when its calling process
+  exits, token or not.
+  """
+
+  alias EXGBoost.Internal
+
+  defstruct [:ref]
+
+  @type t :: %__MODULE__{ref: reference()}
+
+  @doc """
+  Create a token that is cancelled once `pid` exits. Defaults to the calling
+  process.
+  """
+  @spec new(pid()) :: t()
+  def new(pid \\ self()) when is_pid(pid) do
+    %__MODULE__{ref: EXGBoost.NIF.cancel_token_create(pid) |> Internal.unwrap!()}
+  end
+
+  @doc """
+  Cancel the `token`, stopping the calls using it at their next check.
+  """
+  @spec cancel(t()) :: :ok
+  def cancel(%__MODULE__{ref: ref}) do
+    EXGBoost.NIF.cancel_token_cancel(ref) |> Internal.unwrap!()
+  end
+
+  @doc """
+  Whether the `token` has been cancelled.
+  """
+  @spec cancelled?(t()) :: boolean()
+  def cancelled?(%__MODULE__{ref: ref}) do
+    EXGBoost.NIF.cancel_token_cancelled(ref) |> Internal.unwrap!()
+  end
+end
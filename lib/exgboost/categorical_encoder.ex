@@ -0,0 +1,183 @@
+defmodule EXGBoost.CategoricalEncoder do
+  @moduledoc """
+  Native dictionary encoding of string categorical features.
+
+  XGBoost expects categorical features as integer codes stored in a float
+  tensor along with a `"c"` feature type. An encoder holds one native hash
+  dictionary per column that maps each string to a dense code, assigned in
+  order of first appearance. Encoding a batch is a single NIF call per column,
+  so no per-row `Map` lookups happen in Elixir.
+
+  Categories that were not seen while fitting are encoded as missing values
+  (NaN) by default, which XGBoost routes down the default branch of each split.
+  Pass `unknown: :error` to raise instead.
+
+  The encoder can be stored in a booster's attributes with `put_in_booster/3`
+  and restored with `from_booster/2`, so that serving uses exactly the same
+  codes as training.
+
+  ## Example
+
+      encoder = EXGBoost.CategoricalEncoder.fit([merchant_ids, skus])
+      x = EXGBoost.CategoricalEncoder.transform(encoder, [merchant_ids, skus])
+      booster = EXGBoost.train(x, y, feature_type: ["c", "c"], tree_method: :hist)
+      EXGBoost.CategoricalEncoder.put_in_booster(encoder, booster)
+
+      # At serving time
+      encoder = EXGBoost.CategoricalEncoder.from_booster(booster)
+      EXGBoost.inplace_predict(booster, EXGBoost.CategoricalEncoder.transform(encoder, columns))
+  """
+  alias EXGBoost.Booster
+  alias EXGBoost.Internal
+
+  @enforce_keys [:refs]
+  defstruct [:refs, unknown: :nan]
+
+  @type t :: %__MODULE__{refs: [reference()], unknown: :nan | :error}
+
+  @attr_key "exgboost_categorical_encoder"
+
+  @doc """
+  Create an encoder with `ncols` empty dictionaries.
+
+  ## Options
+
+    * `:unknown` - `:nan` to encode unseen categories as missing values or `:error`
+      to raise. Defaults to `:nan`.
+  """
+  @spec new(pos_integer(), Keyword.t()) :: t()
+  def new(ncols, opts \\ []) when is_integer(ncols) and ncols > 0 do
+    opts = Keyword.validate!(opts, unknown: :nan)
+    validate_unknown!(opts[:unknown])
+
+    refs =
+      Enum.map(1..ncols, fn _ -> EXGBoost.NIF.encoder_create() |> Internal.unwrap!() end)
+
+    %__MODULE__{refs: refs, unknown: opts[:unknown]}
+  end
+
+  @doc """
+  Create an encoder from a list of columns, each a list of strings.
+
+  Accepts the same options as `new/2`.
+  """
+  @spec fit([[String.t() | nil]], Keyword.t()) :: t()
+  def fit(columns, opts \\ []) when is_list(columns) do
+    columns |> length() |> new(opts) |> update(columns)
+  end
+
+  @doc """
+  Add the unseen categories of each column to the encoder. Existing codes never change.
+  """
+  @spec update(t(), [[String.t() | nil]]) :: t()
+  def update(%__MODULE__{refs: refs} = encoder, columns) when is_list(columns) do
+    validate_columns!(encoder, columns)
+
+    Enum.zip_with(refs, columns, fn ref, column ->
+      EXGBoost.NIF.encoder_fit(ref, column) |> Internal.unwrap!()
+    end)
+
+    encoder
+  end
+
+  @doc """
+  Encode a list of columns into a `{nrow, ncols}` `f32` tensor of codes.
+
+  `nil` values are encoded as missing values.
+  """
+  @spec transform(t(), [[String.t() | nil]]) :: Nx.Tensor.t()
+  def transform(%__MODULE__{refs: refs} = encoder, columns) when is_list(columns) do
+    validate_columns!(encoder, columns)
+    error_on_unknown = if encoder.unknown == :error, do: 1, else: 0
+
+    Enum.zip_with(refs, columns, fn ref, column ->
+      ref
+      |> EXGBoost.NIF.encoder_encode(column, error_on_unknown)
+      |> Internal.unwrap!()
+      |> Nx.from_binary(:f32)
+    end)
+    |> Nx.stack(axis: 1)
+  end
+
+  @doc """
+  The number of known categories of each column.
+
+  It doesn't wait for a concurrent `update/2`, and counts the categories it has added
+  so far.
+  """
+  @spec num_categories(t()) :: [non_neg_integer()]
+  def num_categories(%__MODULE__{refs: refs}) do
+    Enum.map(refs, &(EXGBoost.NIF.encoder_num_categories(&1) |> Internal.unwrap!()))
+  end
+
+  @doc """
+  The known categories of each column, in code order.
+  """
+  @spec categories(t()) :: [[String.t()]]
+  def categories(%__MODULE__{refs: refs}) do
+    Enum.map(refs, &(EXGBoost.NIF.encoder_categories(&1) |> Internal.unwrap!()))
+  end
+
+  @doc """
+  Serialize the encoder to a binary.
+  """
+  @spec serialize(t()) :: binary()
+  def serialize(%__MODULE__{refs: refs, unknown: unknown}) do
+    columns =
+      Enum.map(refs, fn ref ->
+        ref |> EXGBoost.NIF.encoder_serialize() |> Internal.unwrap!() |> Base.encode64()
+      end)
+
+    %{"version" => 1, "unknown" => Atom.to_string(unknown), "columns" => columns}
+    |> Jason.encode!()
+  end
+
+  @doc """
+  Deserialize an encoder created with `serialize/1`.
+  """
+  @spec deserialize(binary()) :: t()
+  def deserialize(buffer) when is_binary(buffer) do
+    %{"version" => 1, "unknown" => unknown, "columns" => columns} = Jason.decode!(buffer)
+
+    refs =
+      Enum.map(columns, fn column ->
+        column |> Base.decode64!() |> EXGBoost.NIF.encoder_deserialize() |> Internal.unwrap!()
+      end)
+
+    %__MODULE__{refs: refs, unknown: String.to_existing_atom(unknown)}
+  end
+
+  @doc """
+  Store the encoder in the booster's attributes under `key`, so it is saved
+  along with the model. Returns the booster.
+  """
+  @spec put_in_booster(t(), Booster.t(), String.t()) :: Booster.t()
+  def put_in_booster(%__MODULE__{} = encoder, %Booster{} = booster, key \\ @attr_key) do
+    EXGBoost.NIF.booster_set_attr(booster.ref, key, serialize(encoder)) |> Internal.unwrap!()
+    booster
+  end
+
+  @doc """
+  Restore an encoder stored with `put_in_booster/3`. Returns `nil` if the
+  booster has no encoder under `key`.
+  """
+  @spec from_booster(Booster.t(), String.t()) :: t() | nil
+  def from_booster(%Booster{} = booster, key \\ @attr_key) do
+    case EXGBoost.NIF.booster_get_attr(booster.ref, key) |> Internal.unwrap!() do
+      :undefined -> nil
+      value -> value |> to_string() |> deserialize()
+    end
+  end
+
+  defp validate_unknown!(unknown) do
+    unless unknown in [:nan, :error] do
+      raise ArgumentError, "unknown must be :nan or :error, got #{inspect(unknown)}"
+    end
+  end
+
+  defp validate_columns!(%__MODULE__{refs: refs}, columns) do
+    unless length(refs) == length(columns) do
+      raise ArgumentError, "expected #{length(refs)} columns, got #{length(columns)}"
+    end
+  end
+end
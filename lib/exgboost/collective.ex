@@ -0,0 +1,146 @@
+defmodule EXGBoost.Collective do
+  @moduledoc """
+  Distributed training across several workers through XGBoost's collective
+  communicator.
+
+  Each worker holds a shard of the training data. A tracker, started from any
+  one process with `start_tracker/2`, brings the workers together. Every worker
+  then joins the communicator with `init/1`, builds its DMatrix (or passes its
+  tensors) from its own shard and calls `EXGBoost.train/3` unchanged. XGBoost
+  aggregates gradient statistics and evaluation metrics across workers, so every
+  worker ends up with the same model, trained on all shards.
+
+  Rows are split between workers by default. Pass `data_split_mode: :column` to
+  the DMatrix constructors when each worker holds some of the features of every
+  row instead.
+
+  XGBoost allows one communicator per OS process, so each worker must run in its
+  own VM, such as a `:peer` node on the same machine or a node on another one.
+  Only the process that called `init/1` trains through the communicator; calls
+  from other processes of the VM run locally, as they would without one, and
+  don't wait for the distributed run.
+
+  ## Example
+
+      # On the coordinator
+      tracker = EXGBoost.Collective.start_tracker(2, host: "10.0.0.1")
+      args = EXGBoost.Collective.worker_args(tracker)
+
+      # On each worker, with `args` sent over by the coordinator
+      booster =
+        EXGBoost.Collective.run(args, fn ->
+          EXGBoost.train(x_shard, y_shard, tree_method: :hist)
+        end)
+
+      # Back on the coordinator, once the workers are done
+      :ok = EXGBoost.Collective.wait_tracker(tracker)
+  """
+
+  alias EXGBoost.Collective.Tracker
+  alias EXGBoost.Internal
+
+  @type tracker :: %Tracker{}
+
+  @doc """
+  Start a tracker for `n_workers` workers, listening in a linked process.
+
+  ## Options
+
+    * `:host` - the address to listen on, which must be reachable by every
+      worker. Defaults to `"127.0.0.1"`.
+    * `:port` - the port to listen on. Defaults to `0` (any free port).
+  """
+  @spec start_tracker(pos_integer(), Keyword.t()) :: tracker()
+  def start_tracker(n_workers, opts \\ []) when is_integer(n_workers) and n_workers > 0 do
+    Tracker.start(n_workers, opts)
+  end
+
+  @doc """
+  The arguments workers pass to `init/1` to join the `tracker`.
+  """
+  @spec worker_args(tracker()) :: map()
+  def worker_args(%Tracker{host: host, port: port}) do
+    %{"dmlc_communicator" => "rabit", "DMLC_TRACKER_URI" => host, "DMLC_TRACKER_PORT" => port}
+  end
+
+  @doc """
+  Wait until every worker of the `tracker` has called `finalize/0`.
+
+  Must be called by the process that started the tracker.
+  """
+  @spec wait_tracker(tracker(), timeout()) :: :ok
+  def wait_tracker(%Tracker{} = tracker, timeout \\ :infinity),
+    do: Tracker.await(tracker, timeout)
+
+  @doc """
+  Join the communicator, blocking until every worker has joined.
+
+  `args` are the ones returned by `worker_args/1`, along with any other
+  communicator option XGBoost accepts, such as `"dmlc_task_id"`.
+  """
+  @spec init(map()) :: :ok
+  def init(args) when is_map(args) do
+    args |> Jason.encode!() |> EXGBoost.NIF.communicator_init() |> Internal.unwrap!()
+  end
+
+  @doc """
+  Leave the communicator. A no-op unless `init/1` was called.
+  """
+  @spec finalize() :: :ok
+  def finalize, do: EXGBoost.NIF.communicator_finalize() |> Internal.unwrap!()
+
+  @doc """
+  Run `fun` as a worker, between `init/1` and `finalize/0`.
+  """
+  @spec run(map(), (-> result)) :: result when result: term()
+  def run(args, fun) when is_function(fun, 0) do
+    :ok = init(args)
+
+    try do
+      fun.()
+    after
+      finalize()
+    end
+  end
+
+  @doc false
+  # Runs `fun` in this process on behalf of `owner`, with the communicator
+  # handed over if `owner` holds it
+  def delegate(owner, fun) do
+    if EXGBoost.NIF.communicator_adopt(owner, self()) |> Internal.unwrap!() do
+      try do
+        fun.()
+      after
+        EXGBoost.NIF.communicator_adopt(self(), owner)
+      end
+    else
+      fun.()
+    end
+  end
+
+  @doc """
+  Rank of this worker, or `0` outside of a communicator.
+  """
+  @spec rank() :: non_neg_integer()
+  def rank, do: EXGBoost.NIF.communicator_get_rank() |> Internal.unwrap!()
+
+  @doc """
+  Number of workers, or `1` outside of a communicator.
+  """
+  @spec world_size() :: pos_integer()
+  def world_size, do: EXGBoost.NIF.communicator_get_world_size() |> Internal.unwrap!()
+
+  @doc """
+  Whether this worker is part of a distributed run.
+  """
+  @spec distributed?() :: boolean()
+  def distributed?, do: EXGBoost.NIF.communicator_is_distributed() |> Internal.unwrap!()
+
+  @doc """
+  Print `message` through the tracker, which prints it on the coordinator.
+  """
+  @spec print(String.t()) :: :ok
+  def print(message) when is_binary(message) do
+    EXGBoost.NIF.communicator_print(message) |> Internal.unwrap!()
+  end
+end
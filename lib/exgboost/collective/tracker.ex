@@ -0,0 +1,298 @@
+defmodule EXGBoost.Collective.Tracker do
+  @moduledoc false
+  # Elixir port of XGBoost's rabit tracker (`xgboost/tracker.py`), which XGBoost
+  # 2.0 doesn't expose through its C API. Workers connect to it from
+  # `XGCommunicatorInit`; it assigns their ranks, tells each one which peers to
+  # link to (a binary tree for allreduce plus a ring), and returns once every
+  # worker has connected again to report its shutdown.
+  #
+  # Integers on the wire are native-endian int32 and strings are their length
+  # followed by their bytes.
+
+  @magic 0xFF99
+
+  defstruct [:host, :port, :task]
+
+  def start(n_workers, opts) do
+    opts = Keyword.validate!(opts, host: "127.0.0.1", port: 0)
+    host = Keyword.fetch!(opts, :host)
+    {:ok, ip} = :inet.parse_address(String.to_charlist(host))
+
+    {:ok, listen} =
+      :gen_tcp.listen(Keyword.fetch!(opts, :port), [
+        :binary,
+        ip: ip,
+        packet: :raw,
+        active: false,
+        reuseaddr: true
+      ])
+
+    {:ok, port} = :inet.port(listen)
+    task = Task.async(fn -> accept_workers(listen, n_workers) end)
+    :ok = :gen_tcp.controlling_process(listen, task.pid)
+    %__MODULE__{host: host, port: port, task: task}
+  end
+
+  def await(%__MODULE__{task: task}, timeout), do: Task.await(task, timeout)
+
+  defp accept_workers(listen, n_workers) do
+    state = %{
+      n_workers: n_workers,
+      shutdown: MapSet.new(),
+      wait_conn: %{},
+      job_map: %{},
+      pending: [],
+      todo: [],
+      links: nil
+    }
+
+    loop(listen, state)
+  after
+    :gen_tcp.close(listen)
+  end
+
+  defp loop(listen, state) do
+    if MapSet.size(state.shutdown) == state.n_workers do
+      :ok
+    else
+      {:ok, sock} = :gen_tcp.accept(listen)
+      loop(listen, handle(handshake(sock), state))
+    end
+  end
+
+  defp handshake(sock) do
+    @magic = recv_int!(sock)
+    send_int!(sock, @magic)
+    {:ok, {ip, _port}} = :inet.peername(sock)
+
+    %{
+      sock: sock,
+      host: ip |> :inet.ntoa() |> to_string(),
+      rank: recv_int!(sock),
+      world_size: recv_int!(sock),
+      task_id: recv_str!(sock),
+      cmd: recv_str!(sock)
+    }
+  end
+
+  defp handle(%{cmd: "print"} = worker, state) do
+    worker.sock |> recv_str!() |> String.trim_trailing() |> IO.puts()
+    :gen_tcp.close(worker.sock)
+    state
+  end
+
+  defp handle(%{cmd: "shutdown", rank: rank} = worker, state) when rank >= 0 do
+    :gen_tcp.close(worker.sock)
+    %{state | shutdown: MapSet.put(state.shutdown, rank)}
+  end
+
+  defp handle(%{cmd: cmd} = worker, state) when cmd in ["start", "recover"] do
+    state = ensure_links(state, worker)
+
+    case decide_rank(worker, state.job_map) do
+      -1 ->
+        pending = [worker | state.pending]
+
+        if length(pending) == length(state.todo) do
+          # Ranks are handed out in one batch once every worker has joined, so
+          # workers on the same host get neighbouring ranks
+          pending
+          |> Enum.reverse()
+          |> Enum.sort_by(& &1.host)
+          |> Enum.zip(state.todo)
+          |> Enum.reduce(%{state | pending: [], todo: []}, fn {worker, rank}, state ->
+            state =
+              if worker.task_id != "NULL",
+                do: put_in(state.job_map[worker.task_id], rank),
+                else: state
+
+            assign_rank(worker, rank, state)
+          end)
+        else
+          %{state | pending: pending}
+        end
+
+      rank ->
+        assign_rank(worker, rank, state)
+    end
+  end
+
+  defp ensure_links(%{links: nil} = state, %{cmd: "start"} = worker) do
+    n_workers = if worker.world_size > 0, do: worker.world_size, else: state.n_workers
+
+    %{
+      state
+      | n_workers: n_workers,
+        links: link_map(n_workers),
+        todo: Enum.to_list(0..(n_workers - 1))
+    }
+  end
+
+  defp ensure_links(%{links: links} = state, _worker) when links != nil, do: state
+
+  defp decide_rank(%{rank: rank}, _job_map) when rank >= 0, do: rank
+  defp decide_rank(%{task_id: "NULL"}, _job_map), do: -1
+  defp decide_rank(%{task_id: task_id}, job_map), do: Map.get(job_map, task_id, -1)
+
+  defp assign_rank(worker, rank, state) do
+    {tree, parent, ring} = state.links
+    neighbors = Map.fetch!(tree, rank)
+    {prev, next} = Map.fetch!(ring, rank)
+    sock = worker.sock
+
+    send_int!(sock, rank)
+    send_int!(sock, Map.fetch!(parent, rank))
+    send_int!(sock, map_size(tree))
+    send_int!(sock, length(neighbors))
+    Enum.each(neighbors, &send_int!(sock, &1))
+
+    links =
+      Enum.reduce([prev, next], MapSet.new(neighbors), fn link, links ->
+        if link in [-1, rank] do
+          send_int!(sock, -1)
+          links
+        else
+          send_int!(sock, link)
+          MapSet.put(links, link)
+        end
+      end)
+
+    state = connect_links(worker, rank, links, state)
+    :gen_tcp.close(sock)
+    state
+  end
+
+  # Tells the worker which of its missing links it must connect to (peers that
+  # are already listening) and how many it must accept, until it reports that
+  # every link is up
+  defp connect_links(worker, rank, links, state) do
+    sock = worker.sock
+    good = for _ <- 1..recv_int!(sock)//1, into: MapSet.new(), do: recv_int!(sock)
+    bad = links |> MapSet.difference(good) |> Enum.sort()
+    connect = Enum.filter(bad, &Map.has_key?(state.wait_conn, &1))
+
+    send_int!(sock, length(connect))
+    send_int!(sock, length(bad) - length(connect))
+
+    Enum.each(connect, fn peer_rank ->
+      peer = Map.fetch!(state.wait_conn, peer_rank)
+      send_str!(sock, peer.host)
+      send_int!(sock, peer.port)
+      send_int!(sock, peer_rank)
+    end)
+
+    case recv_int!(sock) do
+      0 ->
+        port = recv_int!(sock)
+
+        wait_conn =
+          Enum.reduce(connect, state.wait_conn, fn peer_rank, wait_conn ->
+            case Map.fetch!(wait_conn, peer_rank) do
+              %{wait_accept: 1} -> Map.delete(wait_conn, peer_rank)
+              peer -> Map.put(wait_conn, peer_rank, %{peer | wait_accept: peer.wait_accept - 1})
+            end
+          end)
+
+        wait_accept = length(bad) - length(connect)
+
+        wait_conn =
+          if wait_accept > 0 do
+            peer = %{host: worker.host, port: port, wait_accept: wait_accept}
+            Map.put(wait_conn, rank, peer)
+          else
+            wait_conn
+          end
+
+        %{state | wait_conn: wait_conn}
+
+      _errors ->
+        connect_links(worker, rank, links, state)
+    end
+  end
+
+  @doc false
+  # Returns `{tree, parent, ring}` for `n_workers`, relabelled so that ranks
+  # follow the ring
+  def link_map(n_workers) do
+    ranks = 0..(n_workers - 1)
+    tree = Map.new(ranks, &{&1, tree_neighbors(&1, n_workers)})
+    parent = Map.new(ranks, &{&1, div(&1 + 1, 2) - 1})
+    ring = ring(tree, parent, n_workers)
+
+    {relabel, _rank} =
+      Enum.reduce(1..(n_workers - 1)//1, {%{0 => 0}, 0}, fn label, {relabel, rank} ->
+        {_prev, next} = Map.fetch!(ring, rank)
+        {Map.put(relabel, next, label), next}
+      end)
+
+    {
+      Map.new(tree, fn {rank, nodes} -> {relabel[rank], Enum.map(nodes, &relabel[&1])} end),
+      Map.new(parent, fn
+        {0, _parent} -> {relabel[0], -1}
+        {rank, parent} -> {relabel[rank], relabel[parent]}
+      end),
+      Map.new(ring, fn {rank, {prev, next}} ->
+        {relabel[rank], {relabel[prev], relabel[next]}}
+      end)
+    }
+  end
+
+  defp tree_neighbors(rank, n_workers) do
+    rank = rank + 1
+
+    [
+      if(rank > 1, do: div(rank, 2) - 1),
+      if(rank * 2 - 1 < n_workers, do: rank * 2 - 1),
+      if(rank * 2 < n_workers, do: rank * 2)
+    ]
+    |> Enum.reject(&is_nil/1)
+  end
+
+  defp ring(tree, parent, n_workers) do
+    order = tree |> share_ring(parent, 0) |> List.to_tuple()
+
+    Map.new(0..(n_workers - 1), fn i ->
+      {elem(order, i),
+       {elem(order, rem(i + n_workers - 1, n_workers)), elem(order, rem(i + 1, n_workers))}}
+    end)
+  end
+
+  # Depth-first walk of the tree that visits the last child's subtree in
+  # reverse, so consecutive ranks on the ring are mostly tree neighbours too
+  defp share_ring(tree, parent, rank) do
+    children = tree |> Map.fetch!(rank) |> Enum.reject(&(&1 == parent[rank])) |> Enum.sort()
+    last = length(children)
+
+    subtrees =
+      children
+      |> Enum.with_index(1)
+      |> Enum.flat_map(fn {child, i} ->
+        walk = share_ring(tree, parent, child)
+        if i == last, do: Enum.reverse(walk), else: walk
+      end)
+
+    [rank | subtrees]
+  end
+
+  defp recv_int!(sock) do
+    {:ok, <<value::native-signed-32>>} = :gen_tcp.recv(sock, 4)
+    value
+  end
+
+  defp recv_str!(sock) do
+    case recv_int!(sock) do
+      0 ->
+        ""
+
+      size ->
+        {:ok, value} = :gen_tcp.recv(sock, size)
+        value
+    end
+  end
+
+  defp send_int!(sock, value), do: :ok = :gen_tcp.send(sock, <<value::native-signed-32>>)
+
+  defp send_str!(sock, value) do
+    :ok = :gen_tcp.send(sock, [<<byte_size(value)::native-signed-32>>, value])
+  end
+end
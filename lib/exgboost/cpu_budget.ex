@@ -0,0 +1,115 @@
+defmodule EXGBoost.CPUBudget do
+  @moduledoc """
+  Shares a budget of cores between concurrent XGBoost calls.
+
+  Every XGBoost call that trains, evaluates, predicts or builds a DMatrix runs an
+  OpenMP team of `nthread` threads, one per core by default. Calls running side
+  by side on the dirty schedulers each start a full team, so a few concurrent
+  calls oversubscribe the machine several times over.
+
+  With a budget set, each call takes a share of it when it starts: the budget
+  split evenly between the calls in flight, capped by the cores the other calls
+  hold, and never less than one thread. `EXGBoost.train/3` takes a new share
+  every round, so a long run shrinks and grows as other calls come and go.
+
+  Shares only apply to boosters and DMatrices with `nthread: 0`, the default. An
+  explicit `nthread` is left untouched. Threads are not pinned to cores.
+
+  The budget is set with `set/1`, or when the application starts with:
+
+      config :exgboost, cpu_budget: 32
+
+  ## Telemetry
+
+  `measure/0` emits `[:exgboost, :cpu_budget]` with the utilization of the
+  budget since its previous call from the same process, so it can be polled,
+  for instance by `:telemetry_poller`:
+
+      :telemetry_poller.start_link(
+        measurements: [{EXGBoost.CPUBudget, :measure, []}],
+        period: :timer.seconds(5)
+      )
+
+  Measurements:
+
+    * `:utilization` - Thread time granted to calls that finished since the
+      previous measurement, over the budget times the elapsed time.
+    * `:calls` - Shares taken since the previous measurement.
+    * `:active_calls` - Calls holding a share.
+    * `:threads` - Threads given to the calls holding a share.
+    * `:budget` - The budget.
+  """
+
+  alias EXGBoost.Internal
+
+  @doc """
+  Set the budget to `cores`, or to the number of online schedulers with
+  `:schedulers`. `0` removes the budget.
+  """
+  @spec set(non_neg_integer() | :schedulers) :: :ok
+  def set(:schedulers), do: set(System.schedulers_online())
+
+  def set(cores) when is_integer(cores) and cores >= 0 do
+    EXGBoost.NIF.cpu_budget_set(cores) |> Internal.unwrap!()
+  end
+
+  @doc """
+  The budget, `0` when none is set.
+  """
+  @spec get() :: non_neg_integer()
+  def get, do: stats().budget
+
+  @doc """
+  Returns the current state of the budget:
+
+    * `:budget` - The budget.
+    * `:active_calls` - Calls holding a share.
+    * `:threads` - Threads given to the calls holding a share.
+    * `:calls` - Shares taken since the VM started.
+    * `:thread_time` - Threads times duration of every finished share, in
+      `:native` time units.
+  """
+  @spec stats() :: map()
+  def stats do
+    {budget, active_calls, threads, calls, thread_ns} =
+      EXGBoost.NIF.cpu_budget_stats() |> Internal.unwrap!()
+
+    %{
+      budget: budget,
+      active_calls: active_calls,
+      threads: threads,
+      calls: calls,
+      thread_time: System.convert_time_unit(thread_ns, :nanosecond, :native)
+    }
+  end
+
+  @doc """
+  Emit `[:exgboost, :cpu_budget]` with the utilization since the previous call
+  from this process. The first call reports a utilization of `0.0`.
+  """
+  @spec measure() :: :ok
+  def measure do
+    now = System.monotonic_time()
+    stats = stats()
+    {previous_time, previous} = Process.get(__MODULE__, {now, stats})
+    Process.put(__MODULE__, {now, stats})
+    elapsed = now - previous_time
+
+    utilization =
+      if elapsed > 0 and stats.budget > 0,
+        do: (stats.thread_time - previous.thread_time) / (elapsed * stats.budget),
+        else: 0.0
+
+    :telemetry.execute(
+      [:exgboost, :cpu_budget],
+      %{
+        utilization: utilization,
+        calls: stats.calls - previous.calls,
+        active_calls: stats.active_calls,
+        threads: stats.threads,
+        budget: stats.budget
+      },
+      %{}
+    )
+  end
+end
@@ -41,6 +41,10 @@ defmodule EXGBoost.DMatrix do
   nthread :
       Number of threads to use for loading data when parallelization is
       applicable. If -1, uses maximum threads available on the system.
+  data_split_mode :
+      How the data is split between the workers of a distributed run, `:row`
+      (each worker holds some rows) or `:column` (each worker holds some
+      features). Defaults to `:row`. See `EXGBoost.Collective`.
   group :
       Group size for all ranking group.
   qid :
@@ -105,6 +109,23 @@ defmodule EXGBoost.DMatrix do
   def get_num_non_missing(dmatrix),
     do: EXGBoost.NIF.dmatrix_num_non_missing(dmatrix.ref) |> Internal.unwrap!()
 
+  @doc """
+  Estimated native memory held by the DMatrix, in bytes.
+
+  Counts 8 bytes per present value plus 12 bytes per row for the row offset and label.
+  """
+  def memory(%__MODULE__{} = dmatrix),
+    do: EXGBoost.NIF.dmatrix_memory(dmatrix.ref) |> Internal.unwrap!()
+
+  @doc """
+  Release the native memory of the DMatrix now rather than when it is garbage collected.
+
+  Any later use of the DMatrix raises. Freeing twice is a no-op. The DMatrix
+  must not be in use by another process while it is freed.
+  """
+  def free(%__MODULE__{} = dmatrix),
+    do: EXGBoost.NIF.dmatrix_free(dmatrix.ref) |> Internal.unwrap!()
+
   def get_data(dmatrix),
     do:
       EXGBoost.NIF.dmatrix_get_data_as_csr(dmatrix.ref, Jason.encode!(%{})) |> Internal.unwrap!()
@@ -126,7 +147,18 @@ defmodule EXGBoost.DMatrix do
 
     args = Enum.into(Keyword.merge(meta_opts, str_opts), %{})
 
-    Enum.each(meta_opts, fn {key, value} ->
+    # Vectors go straight to XGBoost as binaries, which is cheap enough to do
+    # every boosting round. Higher-rank tensors (e.g. a multi-class base_margin)
+    # need the shape carried by the array interface.
+    {dense_opts, interface_opts} =
+      Enum.split_with(meta_opts, fn {_key, value} -> Nx.rank(value) <= 1 end)
+
+    if dense_opts != [] do
+      EXGBoost.NIF.dmatrix_set_dense_info_list(dmat.ref, Enum.map(dense_opts, &dense_info/1))
+      |> Internal.unwrap!()
+    end
+
+    Enum.each(interface_opts, fn {key, value} ->
       data_interface = ArrayInterface.from_tensor(value) |> Jason.encode!()
 
       EXGBoost.NIF.dmatrix_set_info_from_interface(
@@ -143,6 +175,28 @@ defmodule EXGBoost.DMatrix do
     struct(dmat, args)
   end
 
+  # xgboost::DataType codes: float = 1, double = 2, uint32_t = 3, uint64_t = 4
+  defp dense_info({:group, value}),
+    do: {"group", value |> Nx.as_type(:u32) |> Nx.to_binary(), 3}
+
+  defp dense_info({key, value}) do
+    {value, type} =
+      case Nx.type(value) do
+        {:f, 32} -> {value, 1}
+        {:f, 64} -> {value, 2}
+        {:u, 32} -> {value, 3}
+        {:u, 64} -> {value, 4}
+        # Widened without loss. Signed values may be negative, and XGBoost keeps
+        # these fields as floats anyway, so they go through double.
+        {:u, _} -> {Nx.as_type(value, :u32), 3}
+        {:s, _} -> {Nx.as_type(value, :f64), 2}
+        {_, size} when size < 32 -> {Nx.as_type(value, :f32), 1}
+        type -> raise ArgumentError, "#{key} can't be a #{Nx.Type.to_string(type)} tensor"
+      end
+
+    {Atom.to_string(key), Nx.to_binary(value), type}
+  end
+
   @doc """
   Slice the DMatrix and return a new DMatrix that only contains rindex.
   """
@@ -153,6 +207,37 @@ defmodule EXGBoost.DMatrix do
     EXGBoost.NIF.dmatrix_slice(dmat.ref, Nx.to_binary(r_index), allow_groups)
   end
 
+  @doc """
+  Split the DMatrix into `nfold` train/test pairs for cross-validation.
+
+  Fold assignment and slicing happen natively in a single call, so no row
+  indices cross the NIF boundary. Returns a list of `{train, test}` tuples.
+
+  ## Options
+
+    * `:nfold` - number of folds. Defaults to `3`.
+    * `:seed` - seed for the shuffle. The same seed always yields the same folds. Defaults to `0`.
+    * `:stratified` - keep the label distribution of every fold close to the
+      distribution of the whole DMatrix. Defaults to `false`.
+    * `:allow_groups` - when the DMatrix has query groups, assign whole groups to
+      folds instead of rows. Defaults to `false`.
+  """
+  def folds(%__MODULE__{} = dmat, opts \\ []) when is_list(opts) do
+    opts = Keyword.validate!(opts, nfold: 3, seed: 0, stratified: false, allow_groups: false)
+
+    EXGBoost.NIF.dmatrix_folds(
+      dmat.ref,
+      Keyword.fetch!(opts, :nfold),
+      Keyword.fetch!(opts, :seed),
+      if(Keyword.fetch!(opts, :stratified), do: 1, else: 0),
+      if(Keyword.fetch!(opts, :allow_groups), do: 1, else: 0)
+    )
+    |> Internal.unwrap!()
+    |> Enum.map(fn {train, test} ->
+      {%__MODULE__{ref: train, format: dmat.format}, %__MODULE__{ref: test, format: dmat.format}}
+    end)
+  end
+
   @doc """
   Export the quantile cuts used for training histogram-based models like `hist` and `approx`.
   Useful for model compression.
@@ -298,18 +383,44 @@ defmodule EXGBoost.DMatrix do
     opts = Keyword.validate!(opts, Internal.dmatrix_feature_opts())
 
     {config_opts, opts} = Keyword.split(opts, Internal.dmatrix_config_feature_opts())
-    config_opts = Keyword.validate!(config_opts, missing: Nx.Constants.nan(), nthread: 0)
-    {format_opts, opts} = Keyword.split(opts, Internal.dmatrix_format_feature_opts())
+    config_opts =
+      Keyword.validate!(config_opts,
+        missing: Nx.Constants.nan(),
+        nthread: 0,
+        data_split_mode: :row
+      )
 
-    config = Enum.into(config_opts, %{}, fn {key, value} -> {Atom.to_string(key), value} end)
-    format = Keyword.fetch!(format_opts, :format)
+    {format_opts, opts} = Keyword.split(opts, Internal.dmatrix_format_feature_opts())
 
-    dmat =
-      EXGBoost.NIF.dmatrix_create_from_dense(
-        Jason.encode!(ArrayInterface.from_tensor(tensor)),
-        Jason.encode!(config)
-      )
-      |> Internal.unwrap!()
+    config = Internal.dmatrix_config(config_opts)
+
+    {dmat, format} =
+      case {Keyword.fetch!(format_opts, :format), Nx.shape(tensor)} do
+        {:auto, {nrow, ncol}} ->
+          # The tensor is scanned natively and built as :dense, :csr or :csc,
+          # whichever is the smallest at its density of present values
+          {dmat, format, _nnz} =
+            EXGBoost.NIF.dmatrix_create_from_dense_auto(
+              tensor |> Nx.as_type(:f32) |> Nx.to_binary(),
+              nrow,
+              ncol,
+              Internal.missing_value(config["missing"]),
+              Jason.encode!(config)
+            )
+            |> Internal.unwrap!()
+
+          {dmat, format}
+
+        {format, _shape} ->
+          dmat =
+            EXGBoost.NIF.dmatrix_create_from_dense(
+              Jason.encode!(ArrayInterface.from_tensor(tensor)),
+              Jason.encode!(config)
+            )
+            |> Internal.unwrap!()
+
+          {dmat, if(format == :auto, do: :dense, else: format)}
+      end
 
     set_params(%__MODULE__{ref: dmat, format: format}, opts)
   end
@@ -353,10 +464,16 @@ defmodule EXGBoost.DMatrix do
     opts = Keyword.validate!(opts, Internal.dmatrix_feature_opts())
 
     {config_opts, opts} = Keyword.split(opts, Internal.dmatrix_config_feature_opts())
-    config_opts = Keyword.validate!(config_opts, missing: Nx.Constants.nan(), nthread: 0)
+    config_opts =
+      Keyword.validate!(config_opts,
+        missing: Nx.Constants.nan(),
+        nthread: 0,
+        data_split_mode: :row
+      )
+
     {format_opts, opts} = Keyword.split(opts, Internal.dmatrix_format_feature_opts())
 
-    config = Enum.into(config_opts, %{}, fn {key, value} -> {Atom.to_string(key), value} end)
+    config = Internal.dmatrix_config(config_opts)
     format = Keyword.fetch!(format_opts, :format)
 
     if format not in [:csr, :csc] do
@@ -376,6 +493,95 @@ defmodule EXGBoost.DMatrix do
 
     set_params(%__MODULE__{ref: dmat, format: format}, opts)
   end
+
+  @doc """
+  Create a DMatrix from unsorted COO `(row, col, value)` triplets.
+
+  The triplets are converted to CSR natively with two counting-sort passes, so
+  no sorting happens on the Nx side. `rows`, `cols` and `values` are 1-D tensors
+  of the same length and `shape` is `{nrow, ncol}`.
+
+  ## Options
+
+    * `:duplicates` - how entries sharing a `(row, col)` are combined, either
+      `:sum` or `:last` (the last one in input order wins). Defaults to `:sum`.
+
+  Any other option is the same as for `from_tensor/2`.
+  """
+  def from_coo(
+        %Nx.Tensor{} = rows,
+        %Nx.Tensor{} = cols,
+        %Nx.Tensor{} = values,
+        {nrow, ncol},
+        opts \\ []
+      )
+      when is_integer(nrow) and is_integer(ncol) and ncol > 0 do
+    {duplicates, opts} = Keyword.pop(opts, :duplicates, :sum)
+    opts = Keyword.validate!(opts, Internal.dmatrix_feature_opts())
+
+    {config_opts, opts} = Keyword.split(opts, Internal.dmatrix_config_feature_opts())
+    config_opts =
+      Keyword.validate!(config_opts,
+        missing: Nx.Constants.nan(),
+        nthread: 0,
+        data_split_mode: :row
+      )
+
+    {_format_opts, opts} = Keyword.split(opts, Internal.dmatrix_format_feature_opts())
+
+    config = Internal.dmatrix_config(config_opts)
+    {rows, cols, values, sum_duplicates} = coo_binaries(rows, cols, values, duplicates)
+
+    dmat =
+      EXGBoost.NIF.dmatrix_create_from_coo(
+        rows,
+        cols,
+        values,
+        nrow,
+        ncol,
+        sum_duplicates,
+        Jason.encode!(config)
+      )
+      |> Internal.unwrap!()
+
+    set_params(%__MODULE__{ref: dmat, format: :csr}, opts)
+  end
+
+  @doc """
+  Convert unsorted COO `(row, col, value)` triplets into CSR tensors.
+
+  Returns `{indptr, indices, values}` with `u64`, `u32` and `f32` types, the same
+  layout accepted by `from_csr/2` and `EXGBoost.inplace_predict/3`. Accepts the
+  `:duplicates` option of `from_coo/5`.
+  """
+  def coo_to_csr(
+        %Nx.Tensor{} = rows,
+        %Nx.Tensor{} = cols,
+        %Nx.Tensor{} = values,
+        {nrow, ncol},
+        opts \\ []
+      ) do
+    opts = Keyword.validate!(opts, duplicates: :sum)
+    {rows, cols, values, sum_duplicates} = coo_binaries(rows, cols, values, opts[:duplicates])
+
+    {indptr, indices, values} =
+      EXGBoost.NIF.coo_to_csr(rows, cols, values, nrow, ncol, sum_duplicates)
+      |> Internal.unwrap!()
+
+    {Nx.from_binary(indptr, :u64), Nx.from_binary(indices, :u32), Nx.from_binary(values, :f32)}
+  end
+
+  defp coo_binaries(rows, cols, values, duplicates) do
+    sum_duplicates =
+      case duplicates do
+        :sum -> 1
+        :last -> 0
+        other -> raise ArgumentError, "duplicates must be :sum or :last, got #{inspect(other)}"
+      end
+
+    {rows |> Nx.as_type(:u32) |> Nx.to_binary(), cols |> Nx.as_type(:u32) |> Nx.to_binary(),
+     values |> Nx.as_type(:f32) |> Nx.to_binary(), sum_duplicates}
+  end
 end
 
 defmodule EXGBoost.ProxyDMatrix do
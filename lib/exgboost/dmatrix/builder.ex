@@ -0,0 +1,204 @@
+defmodule EXGBoost.DMatrix.Builder do
+  @moduledoc """
+  An appendable buffer of rows that can be turned into a `EXGBoost.DMatrix` on demand.
+
+  Online learners receive data in mini-batches. Concatenating every batch into a
+  new tensor and rebuilding the DMatrix for each retrain copies all the data seen
+  so far each time. A builder instead keeps each pushed batch in its own native
+  chunk, so appending never copies rows that are already buffered, and only
+  copies the live rows once when materialized.
+
+  The builder can optionally act as a sliding window, keeping at most
+  `:max_rows` rows and/or dropping batches older than `:max_age` seconds.
+
+  ## Example
+
+      builder = EXGBoost.DMatrix.Builder.new(4, max_rows: 100_000)
+      builder = EXGBoost.DMatrix.Builder.push(builder, x_batch, label: y_batch)
+      dmat = EXGBoost.DMatrix.Builder.to_dmatrix(builder)
+      booster = EXGBoost.Training.train(dmat, num_boost_rounds: 10)
+  """
+  alias EXGBoost.DMatrix
+  alias EXGBoost.Internal
+
+  @enforce_keys [:ref, :ncol]
+  defstruct [:ref, :ncol]
+
+  @type t :: %__MODULE__{ref: reference(), ncol: pos_integer()}
+
+  @new_schema NimbleOptions.new!(
+                max_rows: [
+                  type: {:or, [:pos_integer, nil]},
+                  default: nil,
+                  doc: "Keep at most this many of the most recent rows."
+                ],
+                max_age: [
+                  type: {:or, [:pos_integer, nil]},
+                  default: nil,
+                  doc: "Drop batches pushed more than this many seconds ago."
+                ],
+                missing: [
+                  type: {:or, [:float, nil]},
+                  default: nil,
+                  doc: "Value treated as missing in addition to NaN."
+                ]
+              )
+
+  @doc """
+  Create a builder for rows with `ncol` features.
+
+  ## Options
+  #{NimbleOptions.docs(@new_schema)}
+  """
+  @spec new(pos_integer(), Keyword.t()) :: t()
+  def new(ncol, opts \\ []) when is_integer(ncol) and ncol > 0 do
+    opts = NimbleOptions.validate!(opts, @new_schema)
+
+    ref =
+      EXGBoost.NIF.dmatrix_builder_create(
+        ncol,
+        opts[:max_rows] || 0,
+        opts[:max_age] || 0,
+        opts[:missing]
+      )
+      |> Internal.unwrap!()
+
+    %__MODULE__{ref: ref, ncol: ncol}
+  end
+
+  @doc """
+  Append a batch of rows.
+
+  `data` is either a `{nrow, ncol}` tensor or a CSR tuple `{indptr, indices, values}`.
+
+  ## Options
+
+    * `:label` - a tensor of one label per row.
+    * `:weight` - a tensor of one weight per row.
+
+  Either every batch has labels (or weights) or none does.
+  """
+  @spec push(t(), Nx.Tensor.t() | {Nx.Tensor.t(), Nx.Tensor.t(), Nx.Tensor.t()}, Keyword.t()) ::
+          t()
+  def push(builder, data, opts \\ [])
+
+  def push(%__MODULE__{ncol: ncol} = builder, %Nx.Tensor{shape: {nrow, ncol}} = data, opts) do
+    opts = Keyword.validate!(opts, label: nil, weight: nil)
+
+    EXGBoost.NIF.dmatrix_builder_push_dense(
+      builder.ref,
+      data |> Nx.as_type(:f32) |> Nx.to_binary(),
+      nrow,
+      row_binary(opts[:label], nrow),
+      row_binary(opts[:weight], nrow)
+    )
+    |> Internal.unwrap!()
+
+    builder
+  end
+
+  def push(%__MODULE__{} = builder, {indptr, indices, values}, opts) do
+    opts = Keyword.validate!(opts, label: nil, weight: nil)
+    {nrow_plus_one} = Nx.shape(indptr)
+
+    EXGBoost.NIF.dmatrix_builder_push_csr(
+      builder.ref,
+      indptr |> Nx.as_type(:u64) |> Nx.to_binary(),
+      indices |> Nx.as_type(:u32) |> Nx.to_binary(),
+      values |> Nx.as_type(:f32) |> Nx.to_binary(),
+      row_binary(opts[:label], nrow_plus_one - 1),
+      row_binary(opts[:weight], nrow_plus_one - 1)
+    )
+    |> Internal.unwrap!()
+
+    builder
+  end
+
+  def push(%__MODULE__{ncol: ncol}, %Nx.Tensor{shape: shape}, _opts) do
+    raise ArgumentError, "expected a tensor of shape {nrow, #{ncol}}, got #{inspect(shape)}"
+  end
+
+  @doc """
+  Number of rows currently buffered, after any eviction done so far.
+  """
+  @spec num_rows(t()) :: non_neg_integer()
+  def num_rows(%__MODULE__{} = builder),
+    do: EXGBoost.NIF.dmatrix_builder_num_row(builder.ref) |> Internal.unwrap!()
+
+  @doc """
+  Apply the `:max_age` window now and return the number of rows left.
+
+  Eviction otherwise happens on every push and when materializing.
+  """
+  @spec evict(t()) :: non_neg_integer()
+  def evict(%__MODULE__{} = builder),
+    do: EXGBoost.NIF.dmatrix_builder_evict(builder.ref) |> Internal.unwrap!()
+
+  @doc """
+  Materialize the buffered rows into a `EXGBoost.DMatrix`.
+
+  ## Options
+
+    * `:nthread` - number of threads used to build the DMatrix. Defaults to `0` (all).
+  """
+  @spec to_dmatrix(t(), Keyword.t()) :: DMatrix.t()
+  def to_dmatrix(%__MODULE__{} = builder, opts \\ []) do
+    opts = Keyword.validate!(opts, nthread: 0)
+    config = %{"missing" => Nx.Constants.nan(), "nthread" => opts[:nthread]}
+
+    ref =
+      EXGBoost.NIF.dmatrix_builder_to_dmatrix(builder.ref, Jason.encode!(config))
+      |> Internal.unwrap!()
+
+    %DMatrix{ref: ref, format: :csr}
+  end
+
+  @doc """
+  Materialize the buffered rows into a QuantileDMatrix for the `hist` tree method.
+
+  The batches are sketched one at a time, so no concatenated copy of the data is made.
+
+  ## Options
+
+    * `:max_bin` - maximum number of bins per feature. Defaults to `256`.
+    * `:ref` - a DMatrix whose quantile cuts are reused, typically the training
+      DMatrix when building validation data.
+    * `:nthread` - number of threads used to build the DMatrix. Defaults to `0` (all).
+  """
+  @spec to_quantile_dmatrix(t(), Keyword.t()) :: DMatrix.t()
+  def to_quantile_dmatrix(%__MODULE__{} = builder, opts \\ []) do
+    opts = Keyword.validate!(opts, max_bin: 256, ref: nil, nthread: 0)
+
+    config = %{
+      "missing" => Nx.Constants.nan(),
+      "nthread" => opts[:nthread],
+      "max_bin" => opts[:max_bin]
+    }
+
+    ref_dmat =
+      case opts[:ref] do
+        %DMatrix{ref: ref} -> ref
+        nil -> nil
+      end
+
+    ref =
+      EXGBoost.NIF.dmatrix_builder_to_quantile_dmatrix(
+        builder.ref,
+        Jason.encode!(config),
+        ref_dmat
+      )
+      |> Internal.unwrap!()
+
+    %DMatrix{ref: ref, format: :csr}
+  end
+
+  defp row_binary(nil, _nrow), do: <<>>
+
+  defp row_binary(%Nx.Tensor{} = tensor, nrow) do
+    unless Nx.size(tensor) == nrow do
+      raise ArgumentError, "expected #{nrow} values, got #{Nx.size(tensor)}"
+    end
+
+    tensor |> Nx.as_type(:f32) |> Nx.to_binary()
+  end
+end
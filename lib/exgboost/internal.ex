@@ -24,7 +24,33 @@ defmodule EXGBoost.Internal do
       :feature_weights
     ]
 
-  def dmatrix_config_feature_opts, do: [:nthread, :missing]
+  def dmatrix_config_feature_opts, do: [:nthread, :missing, :data_split_mode]
+
+  # DMatrix constructors take the split mode as XGBoost's DataSplitMode enum
+  def dmatrix_config(config_opts) do
+    Enum.into(config_opts, %{}, fn
+      {:data_split_mode, :row} -> {"data_split_mode", 0}
+      {:data_split_mode, :column} -> {"data_split_mode", 1}
+      {:data_split_mode, mode} -> raise ArgumentError, "invalid data_split_mode #{inspect(mode)}"
+      {key, value} -> {Atom.to_string(key), value}
+    end)
+  end
+
+  # Native objectives take `{name, [{param, number}]}`, so non-numeric params are
+  # encoded here
+  def native_objective({:native, name, params}) when is_atom(name) and is_list(params) do
+    params =
+      Enum.map(params, fn
+        {:link, :log} -> {"link", 0}
+        {:link, :identity} -> {"link", 1}
+        {key, value} when is_number(value) -> {Atom.to_string(key), value}
+        param -> raise ArgumentError, "invalid native objective param #{inspect(param)}"
+      end)
+
+    {Atom.to_string(name), params}
+  end
+
+  def native_objective(_objective), do: nil
 
   def validate_type!(%Nx.Tensor{} = tensor, type) do
     unless Nx.type(tensor) == type do
@@ -138,6 +164,17 @@ defmodule EXGBoost.Internal do
     end
   end
 
+  # NIFs that scan the data themselves take `missing` as a float, or nil for NaN
+  def missing_value(%Nx.Tensor{} = missing) do
+    case Nx.to_number(missing) do
+      :nan -> nil
+      value when is_number(value) -> value / 1
+      other -> raise ArgumentError, "missing must be a number or NaN, got #{inspect(other)}"
+    end
+  end
+
+  def missing_value(missing) when is_number(missing), do: missing / 1
+
   def unwrap!({:ok, val}), do: val
   def unwrap!({:error, reason}), do: raise(reason)
   def unwrap!(:ok), do: :ok
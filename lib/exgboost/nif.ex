@@ -19,6 +19,7 @@ defmodule EXGBoost.NIF do
   @type dmatrix_reference :: reference()
   @type booster_reference :: reference()
   @type exgboost_return_type(return_type) :: {:ok, return_type} | {:error, String.t()}
+  @type native_objective :: {String.t(), [{String.t(), number()}]}
 
   def on_load do
     path = :filename.join([:code.priv_dir(:exgboost), "libexgboost"])
@@ -28,6 +29,49 @@ defmodule EXGBoost.NIF do
   @spec get_int_size :: integer()
   def get_int_size, do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Total estimated native memory held by live DMatrix and Booster resources, in bytes.
+  """
+  @spec native_memory :: exgboost_return_type(non_neg_integer())
+  def native_memory, do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Resident set size of the VM process in bytes. Where `/proc` is unavailable this
+  is the peak resident size instead.
+  """
+  @spec process_rss :: exgboost_return_type(non_neg_integer())
+  def process_rss, do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Set the number of cores shared between XGBoost calls, or `0` for no budget.
+  """
+  @spec cpu_budget_set(non_neg_integer()) :: :ok | {:error, String.t()}
+  def cpu_budget_set(_cores), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Returns `{budget, active_calls, threads, calls, thread_ns}`: the budget, the
+  calls holding a share and the threads given to them, along with the number of
+  shares ever taken and the sum of their threads times their duration.
+  """
+  @spec cpu_budget_stats ::
+          exgboost_return_type(
+            {non_neg_integer(), non_neg_integer(), non_neg_integer(), non_neg_integer(),
+             non_neg_integer()}
+          )
+  def cpu_budget_stats, do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Create a cancellation token that is cancelled once `pid` exits.
+  """
+  @spec cancel_token_create(pid()) :: exgboost_return_type(reference())
+  def cancel_token_create(_pid), do: :erlang.nif_error(:not_implemented)
+
+  @spec cancel_token_cancel(reference()) :: :ok | {:error, String.t()}
+  def cancel_token_cancel(_token), do: :erlang.nif_error(:not_implemented)
+
+  @spec cancel_token_cancelled(reference()) :: exgboost_return_type(boolean())
+  def cancel_token_cancelled(_token), do: :erlang.nif_error(:not_implemented)
+
   @spec xgboost_version :: exgboost_return_type(tuple)
   @doc """
   Get the version of the XGBoost library.
@@ -160,6 +204,67 @@ defmodule EXGBoost.NIF do
   def dmatrix_create_from_dense(_array_interface, _config),
     do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Create a DMatrix from unsorted COO triplets.
+
+  `rows` and `cols` are binaries of `u32` and `values` a binary of `f32`, all of
+  the same length. Duplicate entries are summed when `sum_duplicates` is 1,
+  otherwise the last one wins.
+  """
+  @spec dmatrix_create_from_coo(
+          binary(),
+          binary(),
+          binary(),
+          non_neg_integer(),
+          non_neg_integer(),
+          0 | 1,
+          String.t()
+        ) :: exgboost_return_type(dmatrix_reference())
+  def dmatrix_create_from_coo(_rows, _cols, _values, _nrow, _ncol, _sum_duplicates, _config),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Convert unsorted COO triplets into CSR.
+
+  Takes the same arguments as `dmatrix_create_from_coo/7` without the config.
+  Returns `{indptr, indices, values}` as binaries of `u64`, `u32` and `f32`.
+  """
+  @spec coo_to_csr(binary(), binary(), binary(), non_neg_integer(), non_neg_integer(), 0 | 1) ::
+          exgboost_return_type({binary(), binary(), binary()})
+  def coo_to_csr(_rows, _cols, _values, _nrow, _ncol, _sum_duplicates),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Create a DMatrix from a row-major `f32` binary of `nrow * ncol` values.
+
+  The data is scanned once for missing values (NaN, or `missing` when it is a
+  float) and built as dense, CSR or CSC, whichever is the smallest at the
+  measured density. Returns `{dmatrix, format, nnz}` where `format` is one of
+  `:dense`, `:csr` or `:csc` and `nnz` the number of present values.
+  """
+  @spec dmatrix_create_from_dense_auto(
+          binary(),
+          non_neg_integer(),
+          non_neg_integer(),
+          float() | nil,
+          String.t()
+        ) ::
+          exgboost_return_type({dmatrix_reference(), :dense | :csr | :csc, non_neg_integer()})
+  def dmatrix_create_from_dense_auto(_data, _nrow, _ncol, _missing, _config),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Convert a row-major `f32` binary of `nrow * ncol` values to CSR when that is
+  smaller than the dense layout.
+
+  Returns `:dense` when the data is dense enough to be used as is, otherwise
+  `{indptr, indices, values}` as binaries of `u64`, `u32` and `f32`.
+  """
+  @spec dense_to_csr(binary(), non_neg_integer(), non_neg_integer(), float() | nil) ::
+          exgboost_return_type(:dense | {binary(), binary(), binary()})
+  def dense_to_csr(_data, _nrow, _ncol, _missing),
+    do: :erlang.nif_error(:not_implemented)
+
   @spec dmatrix_get_str_feature_info(dmatrix_reference(), String.t()) ::
           exgboost_return_type([String.t()])
   def dmatrix_get_str_feature_info(_dmatrix_resource, _field),
@@ -179,6 +284,20 @@ defmodule EXGBoost.NIF do
   @spec dmatrix_num_non_missing(dmatrix_reference()) :: exgboost_return_type(pos_integer())
   def dmatrix_num_non_missing(_handle), do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Estimated native memory held by the DMatrix, in bytes.
+  """
+  @spec dmatrix_memory(dmatrix_reference()) :: exgboost_return_type(non_neg_integer())
+  def dmatrix_memory(_handle), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Free the DMatrix now instead of when the reference is garbage collected.
+
+  Later calls using the DMatrix return an error. Freeing again is a no-op.
+  """
+  @spec dmatrix_free(dmatrix_reference()) :: :ok | {:error, String.t()}
+  def dmatrix_free(_handle), do: :erlang.nif_error(:not_implemented)
+
   @spec dmatrix_set_info_from_interface(
           dmatrix_reference(),
           String.t(),
@@ -199,6 +318,35 @@ defmodule EXGBoost.NIF do
   def dmatrix_set_info_from_interface(_handle, _field, _data_interface),
     do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Set meta info from a binary of `size` elements of the given `xgboost_data_type`.
+
+  The data is copied by XGBoost during the call, so unlike
+  `dmatrix_set_info_from_interface/3` no address outlives the binary. Valid
+  fields are the same as for `dmatrix_set_info_from_interface/3`.
+  """
+  @spec dmatrix_set_dense_info(
+          dmatrix_reference(),
+          String.t(),
+          binary(),
+          non_neg_integer(),
+          xgboost_data_type()
+        ) :: :ok | {:error, String.t()}
+  def dmatrix_set_dense_info(_handle, _field, _data, _size, _type),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Set several meta info fields in one call.
+
+  Takes a list of `{field, data, type}` where `data` is a binary of the given
+  `xgboost_data_type`. Fields are set in order and the first error stops the call.
+  """
+  @spec dmatrix_set_dense_info_list(dmatrix_reference(), [
+          {String.t(), binary(), xgboost_data_type()}
+        ]) :: :ok | {:error, String.t()}
+  def dmatrix_set_dense_info_list(_handle, _fields),
+    do: :erlang.nif_error(:not_implemented)
+
   @spec dmatrix_save_binary(dmatrix_reference(), String.t(), integer()) ::
           exgboost_return_type(:ok)
   def dmatrix_save_binary(_handle, _fname, _silent),
@@ -255,8 +403,118 @@ defmodule EXGBoost.NIF do
   @spec dmatrix_slice(dmatrix_reference(), binary(), 0 | 1) :: dmatrix_reference()
   def dmatrix_slice(_handle, _index_set, _allow_groups), do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Split a DMatrix into `nfold` train/test pairs.
+
+  Rows (or query groups when `allow_groups` is 1 and the DMatrix has groups) are
+  shuffled with `seed` and assigned to folds. When `stratified` is 1, rows are
+  dealt out by label so every fold has the same class balance.
+
+  Returns a list of `{train, test}` DMatrix references.
+  """
+  @spec dmatrix_folds(dmatrix_reference(), pos_integer(), non_neg_integer(), 0 | 1, 0 | 1) ::
+          exgboost_return_type([{dmatrix_reference(), dmatrix_reference()}])
+  def dmatrix_folds(_handle, _nfold, _seed, _stratified, _allow_groups),
+    do: :erlang.nif_error(:not_implemented)
+
   def dmatrix_get_quantile_cut(_handle, _config), do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Create an appendable DMatrix builder for `ncol` features.
+
+  `max_rows` and `max_age` (in seconds) bound the sliding window of buffered
+  rows, 0 disables the bound. Values equal to `missing` (or NaN when `missing`
+  is `nil`) are dropped as they are pushed.
+  """
+  @spec dmatrix_builder_create(pos_integer(), non_neg_integer(), non_neg_integer(), float() | nil) ::
+          exgboost_return_type(reference())
+  def dmatrix_builder_create(_ncol, _max_rows, _max_age, _missing),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Append `nrow` dense rows given as a binary of row-major `f32`.
+
+  Labels and weights are binaries of one `f32` per row, or empty binaries when absent.
+  """
+  @spec dmatrix_builder_push_dense(reference(), binary(), non_neg_integer(), binary(), binary()) ::
+          :ok | {:error, String.t()}
+  def dmatrix_builder_push_dense(_builder, _data, _nrow, _labels, _weights),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Append CSR rows given as binaries of `u64` indptr, `u32` indices and `f32` values.
+
+  Labels and weights are binaries of one `f32` per row, or empty binaries when absent.
+  """
+  @spec dmatrix_builder_push_csr(reference(), binary(), binary(), binary(), binary(), binary()) ::
+          :ok | {:error, String.t()}
+  def dmatrix_builder_push_csr(_builder, _indptr, _indices, _values, _labels, _weights),
+    do: :erlang.nif_error(:not_implemented)
+
+  @spec dmatrix_builder_num_row(reference()) :: exgboost_return_type(non_neg_integer())
+  def dmatrix_builder_num_row(_builder), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Apply the sliding window now rather than on the next push. Returns the number of rows left.
+  """
+  @spec dmatrix_builder_evict(reference()) :: exgboost_return_type(non_neg_integer())
+  def dmatrix_builder_evict(_builder), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Materialize the buffered rows into a new DMatrix.
+  """
+  @spec dmatrix_builder_to_dmatrix(reference(), String.t()) ::
+          exgboost_return_type(dmatrix_reference())
+  def dmatrix_builder_to_dmatrix(_builder, _config), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Materialize the buffered rows into a new QuantileDMatrix, streaming the
+  chunks through a proxy DMatrix. `ref` is either `nil` or the DMatrix whose
+  quantile cuts should be reused.
+  """
+  @spec dmatrix_builder_to_quantile_dmatrix(reference(), String.t(), dmatrix_reference() | nil) ::
+          exgboost_return_type(dmatrix_reference())
+  def dmatrix_builder_to_quantile_dmatrix(_builder, _config, _ref),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Create an empty categorical encoder.
+  """
+  @spec encoder_create() :: exgboost_return_type(reference())
+  def encoder_create, do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Add the categories of a list of strings to the encoder. `nil` entries are
+  skipped. Returns the number of known categories.
+  """
+  @spec encoder_fit(reference(), [String.t() | nil]) :: exgboost_return_type(non_neg_integer())
+  def encoder_fit(_encoder, _categories), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Encode a list of strings into a binary of `f32` codes.
+
+  `nil` entries become NaN. Unknown categories become NaN as well, or make the
+  call fail when `error_on_unknown` is 1.
+  """
+  @spec encoder_encode(reference(), [String.t() | nil], 0 | 1) :: exgboost_return_type(binary())
+  def encoder_encode(_encoder, _categories, _error_on_unknown),
+    do: :erlang.nif_error(:not_implemented)
+
+  @spec encoder_num_categories(reference()) :: exgboost_return_type(non_neg_integer())
+  def encoder_num_categories(_encoder), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  List the known categories, in code order.
+  """
+  @spec encoder_categories(reference()) :: exgboost_return_type([String.t()])
+  def encoder_categories(_encoder), do: :erlang.nif_error(:not_implemented)
+
+  @spec encoder_serialize(reference()) :: exgboost_return_type(binary())
+  def encoder_serialize(_encoder), do: :erlang.nif_error(:not_implemented)
+
+  @spec encoder_deserialize(binary()) :: exgboost_return_type(reference())
+  def encoder_deserialize(_buffer), do: :erlang.nif_error(:not_implemented)
+
   @spec booster_create([dmatrix_reference()]) :: exgboost_return_type(booster_reference())
   def booster_create(_handles), do: :erlang.nif_error(:not_implemented)
 
@@ -290,12 +548,120 @@ defmodule EXGBoost.NIF do
   def booster_boost_one_iter(_booster_handle, _dmatrix_handle, _grad, _hess),
     do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Boost one round with gradients computed by a native objective, given as
+  `{name, [{param, value}]}` with string names and numeric values.
+  """
+  @spec booster_boost_native(booster_reference(), dmatrix_reference(), native_objective()) ::
+          :ok | {:error, String.t()}
+  def booster_boost_native(_booster_handle, _dmatrix_handle, _objective),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Same as `booster_boost_native/3`, building the round on the rows sampled by
+  gradient-based one-side sampling. `goss` is `{top_rate, other_rate, seed}`,
+  and the rows drawn depend on the seed and `iteration`.
+  """
+  @spec booster_boost_goss(
+          booster_reference(),
+          dmatrix_reference(),
+          native_objective(),
+          {float(), float(), non_neg_integer()},
+          integer()
+        ) :: :ok | {:error, String.t()}
+  def booster_boost_goss(_booster_handle, _dmatrix_handle, _objective, _goss, _iteration),
+    do: :erlang.nif_error(:not_implemented)
+
   @spec booster_eval_one_iter(booster_reference(), pos_integer(), [dmatrix_reference()], [
           String.t()
         ]) :: exgboost_return_type(String.t())
   def booster_eval_one_iter(_booster_handle, _iteration, _dmatrix_handles, _eval_names),
     do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Evaluate the booster on each DMatrix like `booster_eval_one_iter/4`, returning
+  `[{eval_name, metric, value}]` and recording the metrics in the booster's
+  eval history. Non-finite values are returned as `:nan`.
+  """
+  @spec booster_eval(booster_reference(), pos_integer(), [dmatrix_reference()], [String.t()]) ::
+          exgboost_return_type([{String.t(), String.t(), float() | :nan}])
+  def booster_eval(_booster_handle, _iteration, _dmatrix_handles, _eval_names),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  The booster's eval history as `{keys, iterations, values}`, where `keys` is a
+  list of `{eval_name, metric}`, `iterations` a binary of `s32` and `values` a
+  row-major binary of `f64` with one column per key. Keys missing from an
+  evaluation are NaN.
+  """
+  @spec booster_eval_history(booster_reference()) ::
+          exgboost_return_type({[{String.t(), String.t()}], binary(), binary()})
+  def booster_eval_history(_booster_handle), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Serializes the booster and writes it to `path` on a background thread, then
+  deletes the files in `remove`. The file is written to a temporary path and
+  renamed once synced, so `path` never holds a partial checkpoint. When `notify`
+  is `{pid, ref}`, `{ref, :ok | {:error, reason}}` is sent to `pid` once done.
+  """
+  @spec booster_checkpoint(
+          booster_reference(),
+          String.t(),
+          [String.t()],
+          {pid(), reference()} | nil
+        ) :: :ok | {:error, String.t()}
+  def booster_checkpoint(_booster_handle, _path, _remove, _notify),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Run `num_rounds` boosting rounds starting at iteration `begin`, setting the
+  learning rate of round `i` to the `i`-th element of `learning_rates` if any.
+
+  When `eval_names` is non-empty, every round is evaluated and, if
+  `early_stopping_rounds` is positive, training stops once the last metric of
+  the last evaluation set has not improved for that many rounds. If `progress`
+  is `{pid, ref, period, rounds}`, `{ref, iteration, [{eval_name, metric, value}]}`
+  is sent to `pid` every `period` rounds, and if `rounds` is true
+  `{ref, :round, iteration, update_ns, eval_ns, boosted_rounds}` after every
+  round. `objective` is `nil` to use the booster's objective or a native
+  objective as accepted by `booster_boost_native/3`. Training stops with
+  `{:error, "Cancelled"}` between rounds once `token` is cancelled or the
+  calling process has exited. `goss` is `nil` or, with a native objective, as
+  accepted by `booster_boost_goss/5`.
+
+  Returns `{last_iteration, best_iteration, best_score}`, where the best values
+  are `nil` without early stopping.
+  """
+  @spec booster_train(
+          booster_reference(),
+          dmatrix_reference(),
+          pos_integer(),
+          non_neg_integer(),
+          [dmatrix_reference()],
+          [String.t()],
+          [float()],
+          non_neg_integer(),
+          {pid(), reference(), non_neg_integer(), boolean()} | nil,
+          native_objective() | nil,
+          reference() | nil,
+          {float(), float(), non_neg_integer()} | nil
+        ) :: exgboost_return_type({integer(), pos_integer() | nil, float() | nil})
+  def booster_train(
+        _booster_handle,
+        _dmatrix_handle,
+        _begin,
+        _num_rounds,
+        _dmatrix_handles,
+        _eval_names,
+        _learning_rates,
+        _early_stopping_rounds,
+        _progress,
+        _objective,
+        _token,
+        _goss
+      ),
+      do: :erlang.nif_error(:not_implemented)
+
   @spec booster_get_attr_names(booster_reference()) :: exgboost_return_type([String.t()])
   def booster_get_attr_names(_booster_handle), do: :erlang.nif_error(:not_implemented)
 
@@ -326,6 +692,32 @@ defmodule EXGBoost.NIF do
   def booster_predict_from_dmatrix(_boster, _dmatrix, _config),
     do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Same as `booster_predict_from_dmatrix/3`, predicting `chunk_rows` rows at a
+  time and returning `{:error, "Cancelled"}` between chunks once `token` is
+  cancelled or the calling process has exited.
+  """
+  @spec booster_predict_chunked(
+          booster_reference(),
+          dmatrix_reference(),
+          String.t(),
+          pos_integer(),
+          reference() | nil
+        ) :: tuple()
+  def booster_predict_chunked(_booster, _dmatrix, _config, _chunk_rows, _token),
+    do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Predict the untransformed margins of `dmatrix`, returned as `{shape, binary}`
+  where `binary` holds the margins as native-endian `f32`s.
+
+  Set `training` to `1` when computing the gradients of a custom objective.
+  """
+  @spec booster_predict_margin(booster_reference(), dmatrix_reference(), 0 | 1) ::
+          exgboost_return_type({[non_neg_integer()], binary()})
+  def booster_predict_margin(_booster, _dmatrix, _training),
+    do: :erlang.nif_error(:not_implemented)
+
   @spec booster_predict_from_dense(booster_reference(), String.t(), String.t(), reference() | nil) ::
           tuple()
   def booster_predict_from_dense(_boster, _values, _config, _proxy),
@@ -361,12 +753,47 @@ defmodule EXGBoost.NIF do
   @spec booster_deserialize_from_buffer(binary()) :: exgboost_return_type(booster_reference())
   def booster_deserialize_from_buffer(_buffer), do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Replace the model and config of the Booster in place with those serialized in
+  `buffer` by `booster_serialize_to_buffer/1`.
+  """
+  @spec booster_restore_from_buffer(booster_reference(), binary()) :: :ok | {:error, String.t()}
+  def booster_restore_from_buffer(_handle, _buffer), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Native memory held by the Booster in bytes, measured as its serialized size.
+  """
+  @spec booster_memory(booster_reference()) :: exgboost_return_type(non_neg_integer())
+  def booster_memory(_handle), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Free the Booster now instead of when the reference is garbage collected.
+
+  Later calls using the Booster return an error. Freeing again is a no-op.
+  """
+  @spec booster_free(booster_reference()) :: :ok | {:error, String.t()}
+  def booster_free(_handle), do: :erlang.nif_error(:not_implemented)
+
   @spec booster_save_model_to_buffer(booster_reference(), String.t()) :: binary()
   def booster_save_model_to_buffer(_handle, _config), do: :erlang.nif_error(:not_implemented)
 
   @spec booster_load_model_from_buffer(binary()) :: exgboost_return_type(booster_reference())
   def booster_load_model_from_buffer(_buffer), do: :erlang.nif_error(:not_implemented)
 
+  @doc """
+  Load a booster from the model file at `path`, mapped into memory. With
+  `serialized` set to `1` the file holds the model and its configuration, as
+  read by `booster_deserialize_from_buffer/1`, otherwise the model alone.
+
+  Returns `{booster, size, load_ns, rss_before, rss_after, peak_rss}`.
+  """
+  @spec booster_load_model_mmap(String.t(), 0 | 1) ::
+          exgboost_return_type(
+            {booster_reference(), non_neg_integer(), non_neg_integer(), non_neg_integer(),
+             non_neg_integer(), non_neg_integer()}
+          )
+  def booster_load_model_mmap(_path, _serialized), do: :erlang.nif_error(:not_implemented)
+
   @spec booster_load_json_config(booster_reference(), String.t()) :: :ok | {:error, String.t()}
   def booster_load_json_config(_handle, _config), do: :erlang.nif_error(:not_implemented)
 
@@ -375,4 +802,37 @@ defmodule EXGBoost.NIF do
 
   def booster_dump_model(_handle, _fmap, _with_stats, _format),
     do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Join the collective communicator described by the JSON `config`, blocking
+  until the tracker has connected every worker.
+
+  The communicator lives on a dedicated native thread, where every NIF that may
+  run a collective operation is then executed when called by the calling
+  process, which owns the communicator.
+  """
+  @spec communicator_init(String.t()) :: :ok | {:error, String.t()}
+  def communicator_init(_config), do: :erlang.nif_error(:not_implemented)
+
+  @doc """
+  Hand the communicator from `from` to `to`, if `from` owns it. Returns whether
+  it changed hands.
+  """
+  @spec communicator_adopt(pid(), pid()) :: exgboost_return_type(boolean())
+  def communicator_adopt(_from, _to), do: :erlang.nif_error(:not_implemented)
+
+  @spec communicator_finalize() :: :ok | {:error, String.t()}
+  def communicator_finalize, do: :erlang.nif_error(:not_implemented)
+
+  @spec communicator_get_rank() :: exgboost_return_type(integer())
+  def communicator_get_rank, do: :erlang.nif_error(:not_implemented)
+
+  @spec communicator_get_world_size() :: exgboost_return_type(integer())
+  def communicator_get_world_size, do: :erlang.nif_error(:not_implemented)
+
+  @spec communicator_is_distributed() :: exgboost_return_type(boolean())
+  def communicator_is_distributed, do: :erlang.nif_error(:not_implemented)
+
+  @spec communicator_print(String.t()) :: :ok | {:error, String.t()}
+  def communicator_print(_message), do: :erlang.nif_error(:not_implemented)
 end
@@ -0,0 +1,381 @@
+defmodule EXGBoost.Registry do
+  @moduledoc """
+  A registry of model versions for serving, with atomic publishing and rollback.
+
+  Each model has a name and any number of versions. One version of each name is
+  published, and every process serving the model finds it through `lookup/2` or
+  `predict/4`, which read an ETS table with read concurrency and never go
+  through the registry process. Publishing a version replaces the published
+  entry in a single write, so every lookup after it sees the new version and
+  none sees a mix of old and new.
+
+  `load/5` loads a model file in a task, off the registry process, through
+  `EXGBoost.Booster.load_mmap/2` on a dirty IO scheduler. It then runs a warm-up
+  prediction before the version can be published, so the first real request
+  doesn't pay for lazy initialization inside XGBoost. Lookups and publishes are
+  served while a load is in progress.
+
+  The registry keeps the last `:keep` versions of each name, so `rollback/2`
+  can return to the previously published version without loading it again.
+  Versions beyond those are dropped from the registry but are not freed with
+  `EXGBoost.Booster.free/1`: a booster is freed by the garbage collector once no
+  process holds it, so predictions still running on an old version finish on
+  it.
+
+  ## Example
+
+      {:ok, _pid} = EXGBoost.Registry.start_link(name: MyApp.Models)
+
+      EXGBoost.Registry.load(MyApp.Models, :churn, 7, "churn-7.json",
+        warmup: Nx.iota({1, 12}, type: :f32)
+      )
+
+      EXGBoost.Registry.predict(MyApp.Models, :churn, x)
+
+      # Back to the version published before 7
+      EXGBoost.Registry.rollback(MyApp.Models, :churn)
+
+  ## Telemetry
+
+  Publishing a version, including through `rollback/2`, emits
+  `[:exgboost, :registry, :publish]` with the measurement
+  `%{system_time: integer()}` and the metadata
+  `%{registry: atom(), name: term(), version: term(), previous: term() | nil}`.
+  """
+
+  use GenServer
+
+  alias EXGBoost.Booster
+  alias EXGBoost.DMatrix
+
+  @type registry :: atom()
+
+  @start_schema NimbleOptions.new!(
+                  name: [
+                    type: :atom,
+                    required: true,
+                    doc: """
+                    The name of the registry process and of its ETS table.
+                    """
+                  ],
+                  keep: [
+                    type: :pos_integer,
+                    default: 3,
+                    doc: """
+                    The number of versions kept for each model, including the published
+                    one.
+                    """
+                  ]
+                )
+
+  @load_schema NimbleOptions.new!(
+                 deserialize: [
+                   type: {:in, [:model, :weights]},
+                   default: :model,
+                   doc: """
+                   Whether the file holds a model (`EXGBoost.write_model/3`) or only its
+                   weights (`EXGBoost.write_weights/3`).
+                   """
+                 ],
+                 warmup: [
+                   type: :any,
+                   doc: """
+                   A tensor or `EXGBoost.DMatrix` to predict on once before the version is
+                   registered.
+                   """
+                 ],
+                 publish: [
+                   type: :boolean,
+                   default: true,
+                   doc: """
+                   Whether to publish the version once it is registered.
+                   """
+                 ],
+                 timeout: [
+                   type: :timeout,
+                   default: :infinity,
+                   doc: """
+                   How long to wait for the load.
+                   """
+                 ]
+               )
+
+  @doc """
+  Start a registry linked to the calling process.
+
+  ## Options
+  #{NimbleOptions.docs(@start_schema)}
+  """
+  @spec start_link(Keyword.t()) :: GenServer.on_start()
+  def start_link(opts) do
+    opts = NimbleOptions.validate!(opts, @start_schema)
+    GenServer.start_link(__MODULE__, opts, name: opts[:name])
+  end
+
+  @doc """
+  Load version `version` of model `name` from the model file at `path`, warm it
+  up and register it. Returns the loaded booster.
+
+  Raises if the file can't be loaded, the warm-up prediction fails or the
+  version is already registered or being loaded.
+
+  ## Options
+  #{NimbleOptions.docs(@load_schema)}
+  """
+  @spec load(registry(), term(), term(), Path.t(), Keyword.t()) :: Booster.t()
+  def load(registry, name, version, path, opts \\ []) do
+    opts = NimbleOptions.validate!(opts, @load_schema)
+    load = fn -> Booster.load_mmap(path, deserialize: opts[:deserialize]) end
+    call!(registry, {:load, name, version, load, opts}, opts[:timeout])
+  end
+
+  @doc """
+  Register `booster` as version `version` of model `name`.
+
+  Takes the same `:warmup` and `:publish` options as `load/5`.
+  """
+  @spec put(registry(), term(), term(), Booster.t(), Keyword.t()) :: Booster.t()
+  def put(registry, name, version, %Booster{} = booster, opts \\ []) do
+    opts = NimbleOptions.validate!(opts, @load_schema)
+    call!(registry, {:load, name, version, fn -> booster end, opts}, opts[:timeout])
+  end
+
+  @doc """
+  Publish version `version` of model `name`, which must be registered.
+  """
+  @spec publish(registry(), term(), term()) :: :ok
+  def publish(registry, name, version), do: call!(registry, {:publish, name, version})
+
+  @doc """
+  Publish the version of model `name` that was published before the current
+  one, and return it.
+
+  Raises if no previous version is still registered.
+  """
+  @spec rollback(registry(), term()) :: term()
+  def rollback(registry, name), do: call!(registry, {:rollback, name})
+
+  @doc """
+  Remove model `name`, or only its version `version`. The published version
+  can't be removed on its own.
+  """
+  @spec delete(registry(), term(), term()) :: :ok
+  def delete(registry, name, version \\ nil), do: call!(registry, {:delete, name, version})
+
+  @doc """
+  The published `{version, booster}` of model `name`, or `nil`.
+  """
+  @spec lookup(registry(), term()) :: {term(), Booster.t()} | nil
+  def lookup(registry, name) do
+    case :ets.lookup(registry, {:published, name}) do
+      [{_key, version, booster}] -> {version, booster}
+      [] -> nil
+    end
+  end
+
+  @doc """
+  The booster of version `version` of model `name`, or `nil`.
+  """
+  @spec lookup(registry(), term(), term()) :: Booster.t() | nil
+  def lookup(registry, name, version) do
+    case :ets.lookup(registry, {:version, name, version}) do
+      [{_key, booster}] -> booster
+      [] -> nil
+    end
+  end
+
+  @doc """
+  The registered versions of model `name`, newest first.
+  """
+  @spec versions(registry(), term()) :: [term()]
+  def versions(registry, name), do: GenServer.call(registry, {:versions, name})
+
+  @doc """
+  Predict on `x` with the published version of model `name`.
+
+  `x` and `opts` are passed to `EXGBoost.predict/3`. The booster is looked up
+  once, so the whole prediction runs on one version even if another one is
+  published in the meantime.
+  """
+  @spec predict(registry(), term(), Nx.Tensor.t() | DMatrix.t(), Keyword.t()) :: Nx.Tensor.t()
+  def predict(registry, name, x, opts \\ []) do
+    case lookup(registry, name) do
+      {_version, booster} -> run_predict(booster, x, opts)
+      nil -> raise ArgumentError, "No published version of model #{inspect(name)}"
+    end
+  end
+
+  defp run_predict(booster, %DMatrix{} = dmat, opts), do: Booster.predict(booster, dmat, opts)
+  defp run_predict(booster, x, opts), do: EXGBoost.predict(booster, x, opts)
+
+  defp call!(registry, request, timeout \\ 5000) do
+    case GenServer.call(registry, request, timeout) do
+      {:ok, result} -> result
+      {:error, exception} -> raise exception
+    end
+  end
+
+  @impl true
+  def init(opts) do
+    table = :ets.new(opts[:name], [:named_table, :protected, read_concurrency: true])
+    {:ok, tasks} = Task.Supervisor.start_link()
+    # `models` maps each name to its versions, newest first, and the versions it
+    # published, most recent first. `loading` maps load tasks to their caller
+    {:ok, %{table: table, keep: opts[:keep], tasks: tasks, models: %{}, loading: %{}}}
+  end
+
+  @impl true
+  def handle_call({:load, name, version, load, opts}, from, state) do
+    model = model(state, name)
+
+    loading? = Enum.any?(state.loading, &match?({_ref, {^name, ^version, _from, _}}, &1))
+
+    if version in model.versions or loading? do
+      {:reply, {:error, already_registered(name, version)}, state}
+    else
+      warmup = opts[:warmup]
+
+      task =
+        Task.Supervisor.async_nolink(state.tasks, fn ->
+          booster = load.()
+          if warmup != nil, do: run_predict(booster, warmup, [])
+          booster
+        end)
+
+      loading = Map.put(state.loading, task.ref, {name, version, from, opts[:publish]})
+      {:noreply, %{state | loading: loading}}
+    end
+  end
+
+  def handle_call({:publish, name, version}, _from, state) do
+    if version in model(state, name).versions do
+      {:reply, {:ok, :ok}, publish(state, name, version)}
+    else
+      {:reply, {:error, not_registered(name, version)}, state}
+    end
+  end
+
+  def handle_call({:rollback, name}, _from, state) do
+    model = model(state, name)
+
+    case Enum.find(tl_or_empty(model.published), &(&1 in model.versions)) do
+      nil ->
+        error = ArgumentError.exception("No version of #{inspect(name)} to roll back to")
+        {:reply, {:error, error}, state}
+
+      version ->
+        # The version rolled back from leaves the publish history, so rolling
+        # back again goes further back instead of toggling between the two
+        [_current | history] = model.published
+        history = Enum.drop_while(history, &(&1 != version))
+        state = put_in(state.models[name], %{model | published: history})
+        {:reply, {:ok, version}, publish(state, name, version)}
+    end
+  end
+
+  def handle_call({:delete, name, nil}, _from, state) do
+    :ets.match_delete(state.table, {{:version, name, :_}, :_})
+    :ets.delete(state.table, {:published, name})
+    {:reply, {:ok, :ok}, %{state | models: Map.delete(state.models, name)}}
+  end
+
+  def handle_call({:delete, name, version}, _from, state) do
+    model = model(state, name)
+
+    cond do
+      version not in model.versions ->
+        {:reply, {:error, not_registered(name, version)}, state}
+
+      List.first(model.published) == version ->
+        error = ArgumentError.exception("Version #{inspect(version)} is published")
+        {:reply, {:error, error}, state}
+
+      true ->
+        :ets.delete(state.table, {:version, name, version})
+        model = %{model | versions: List.delete(model.versions, version)}
+        {:reply, {:ok, :ok}, put_in(state.models[name], model)}
+    end
+  end
+
+  def handle_call({:versions, name}, _from, state) do
+    {:reply, model(state, name).versions, state}
+  end
+
+  @impl true
+  def handle_info({ref, booster}, state) when is_map_key(state.loading, ref) do
+    Process.demonitor(ref, [:flush])
+    {{name, version, from, publish?}, loading} = Map.pop!(state.loading, ref)
+    state = %{state | loading: loading}
+    :ets.insert(state.table, {{:version, name, version}, booster})
+    model = model(state, name)
+    state = put_in(state.models[name], %{model | versions: [version | model.versions]})
+    state = if publish?, do: publish(state, name, version), else: state
+    GenServer.reply(from, {:ok, booster})
+    {:noreply, prune(state, name)}
+  end
+
+  def handle_info({:DOWN, ref, :process, _pid, reason}, state)
+      when is_map_key(state.loading, ref) do
+    {{name, version, from, _publish?}, loading} = Map.pop!(state.loading, ref)
+
+    error =
+      case reason do
+        {%{__exception__: true} = exception, _stacktrace} ->
+          exception
+
+        reason ->
+          RuntimeError.exception(
+            "Loading #{inspect(name)} version #{inspect(version)} failed: " <>
+              Exception.format_exit(reason)
+          )
+      end
+
+    GenServer.reply(from, {:error, error})
+    {:noreply, %{state | loading: loading}}
+  end
+
+  def handle_info(_message, state), do: {:noreply, state}
+
+  defp model(state, name), do: Map.get(state.models, name, %{versions: [], published: []})
+
+  defp tl_or_empty([_current | history]), do: history
+  defp tl_or_empty([]), do: []
+
+  defp publish(state, name, version) do
+    model = model(state, name)
+    [{_key, booster}] = :ets.lookup(state.table, {:version, name, version})
+    previous = List.first(model.published)
+    :ets.insert(state.table, {{:published, name}, version, booster})
+
+    :telemetry.execute(
+      [:exgboost, :registry, :publish],
+      %{system_time: System.system_time()},
+      %{registry: state.table, name: name, version: version, previous: previous}
+    )
+
+    published = [version | List.delete(model.published, version)]
+    put_in(state.models[name], %{model | published: published})
+  end
+
+  # Drops the oldest versions beyond `:keep`, never the published one
+  defp prune(state, name) do
+    model = model(state, name)
+    current = List.first(model.published)
+    others = List.delete(model.versions, current)
+    {kept, drop} = Enum.split(others, if(current, do: state.keep - 1, else: state.keep))
+    keep = Enum.filter(model.versions, &(&1 == current or &1 in kept))
+    Enum.each(drop, &:ets.delete(state.table, {:version, name, &1}))
+    published = Enum.filter(model.published, &(&1 in keep))
+    put_in(state.models[name], %{model | versions: keep, published: published})
+  end
+
+  defp already_registered(name, version) do
+    ArgumentError.exception(
+      "Version #{inspect(version)} of #{inspect(name)} is already registered"
+    )
+  end
+
+  defp not_registered(name, version) do
+    ArgumentError.exception("Version #{inspect(version)} of #{inspect(name)} is not registered")
+  end
+end
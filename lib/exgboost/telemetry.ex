@@ -0,0 +1,199 @@
+defmodule EXGBoost.Telemetry do
+  @moduledoc """
+  Telemetry events emitted by `EXGBoost.train/3` and an aggregator that turns
+  them into per-run summaries.
+
+  ## Events
+
+  * `[:exgboost, :training, :start]` - Emitted when training starts.
+
+    * Measurements: `%{system_time: integer(), monotonic_time: integer()}`
+    * Metadata: `%{run: reference(), num_boost_rounds: pos_integer()}`
+
+  * `[:exgboost, :training, :stop]` - Emitted when training finishes.
+
+    * Measurements: `%{duration: integer(), monotonic_time: integer(), rounds: integer()}`
+    * Metadata: `%{run: reference(), booster: EXGBoost.Booster.t()}`
+
+  * `[:exgboost, :training, :exception]` - Emitted when training raises.
+
+    * Measurements: `%{duration: integer(), monotonic_time: integer()}`
+    * Metadata: the `:start` metadata along with `:kind`, `:reason` and
+      `:stacktrace`
+
+  * `[:exgboost, :training, :iteration, :start]` - Emitted when a boosting round
+    starts.
+
+    * Measurements: `%{system_time: integer(), monotonic_time: integer()}`
+    * Metadata: `%{run: reference(), iteration: pos_integer()}`
+
+  * `[:exgboost, :training, :iteration, :stop]` - Emitted when a boosting round
+    finishes, with how its time was spent:
+
+    * `:duration` - Time spent on the round.
+    * `:update` - Time spent growing the round's trees, including any custom
+      objective.
+    * `:eval` - Time spent evaluating the `:evals` sets.
+    * `:callbacks` - Time spent in the other callbacks.
+    * `:trees_added` - Trees added by the round.
+    * `:num_trees` - Trees in the model after the round.
+    * `:native_memory` - See `EXGBoost.native_memory/0`.
+    * `:rss` - Resident set size of the VM in bytes.
+
+    Metadata is the same as for `:start`. Durations are in `:native` time units.
+    Whatever is left of `:duration` went to moving data between Elixir and
+    XGBoost.
+
+  * `[:exgboost, :training, :summary]` - Emitted after `[:exgboost, :training, :stop]`
+    while `attach_summary/1` is attached. See `summary/2` for the measurements.
+
+    * Metadata: `%{run: reference(), booster: EXGBoost.Booster.t()}`
+
+  The utilization of the CPU budget is reported separately, see
+  `EXGBoost.CPUBudget`, as are model loads, see `EXGBoost.Booster.load_mmap/2`,
+  model publishes, see `EXGBoost.Registry`, and booster cache activity, see
+  `EXGBoost.BoosterCache`.
+
+  Per-round events are only emitted while a handler is attached to one of them
+  when training starts, so they cost nothing otherwise. When training runs
+  entirely in native code (no `:callbacks`, custom objective or checkpointing),
+  the round timings are measured natively and both events of a round are
+  emitted once it finishes, so `:callbacks` is always `0`.
+
+  ## Example
+
+      EXGBoost.Telemetry.attach_summary()
+
+      :telemetry.attach(
+        "log-training",
+        [:exgboost, :training, :summary],
+        fn _event, summary, _metadata, _config -> IO.inspect(summary) end,
+        nil
+      )
+  """
+
+  @round_event [:exgboost, :training, :iteration, :stop]
+  @stop_event [:exgboost, :training, :stop]
+  @exception_event [:exgboost, :training, :exception]
+
+  @doc """
+  Attaches a handler that aggregates the round durations of every training run
+  and emits `[:exgboost, :training, :summary]` once the run finishes.
+
+  Round durations are kept in the process dictionary of the training process,
+  where all training events are emitted, until the run stops.
+  """
+  @spec attach_summary(term()) :: :ok | {:error, :already_exists}
+  def attach_summary(handler_id \\ __MODULE__.Summary) do
+    :telemetry.attach_many(
+      handler_id,
+      [@round_event, @stop_event, @exception_event],
+      &__MODULE__.handle_summary_event/4,
+      nil
+    )
+  end
+
+  @doc """
+  Detaches a handler attached with `attach_summary/1`.
+  """
+  @spec detach_summary(term()) :: :ok | {:error, :not_found}
+  def detach_summary(handler_id \\ __MODULE__.Summary), do: :telemetry.detach(handler_id)
+
+  @doc false
+  def handle_summary_event(@round_event, %{duration: duration}, %{run: run}, _config) do
+    Process.put({__MODULE__, run}, [duration | Process.get({__MODULE__, run}, [])])
+  end
+
+  def handle_summary_event(@stop_event, %{duration: duration}, metadata, _config) do
+    durations = Process.delete({__MODULE__, metadata.run}) || []
+
+    :telemetry.execute(
+      [:exgboost, :training, :summary],
+      summary(durations, duration),
+      Map.take(metadata, [:run, :booster])
+    )
+  end
+
+  def handle_summary_event(@exception_event, _measurements, %{run: run}, _config) do
+    Process.delete({__MODULE__, run})
+  end
+
+  @doc """
+  Summarizes the round durations of a run that took `duration` in total. All
+  durations are in `:native` time units.
+
+  Returns a map with:
+
+  * `:rounds` - Number of rounds.
+  * `:p50`, `:p99`, `:max` - Percentiles of the round durations.
+  * `:mean` - Mean round duration.
+  * `:duration` - Total duration of the run.
+  * `:rounds_per_second` - Rounds completed per second of the whole run.
+  """
+  @spec summary([integer()], integer()) :: map()
+  def summary(round_durations, duration) do
+    sorted = Enum.sort(round_durations)
+    rounds = length(sorted)
+    seconds = System.convert_time_unit(duration, :native, :microsecond) / 1_000_000
+
+    %{
+      rounds: rounds,
+      p50: percentile(sorted, rounds, 50),
+      p99: percentile(sorted, rounds, 99),
+      max: List.last(sorted, 0),
+      mean: if(rounds > 0, do: Enum.sum(sorted) / rounds, else: 0.0),
+      duration: duration,
+      rounds_per_second: if(seconds > 0, do: rounds / seconds, else: 0.0)
+    }
+  end
+
+  # Nearest-rank percentile of an ascending list
+  defp percentile(_sorted, 0, _p), do: 0
+  defp percentile(sorted, count, p), do: Enum.at(sorted, max(ceil(p * count / 100) - 1, 0))
+
+  @doc false
+  # Whether any handler listens to the per-round events
+  def rounds_enabled? do
+    :telemetry.list_handlers([:exgboost, :training, :iteration]) != []
+  end
+
+  @doc false
+  # Number of trees each boosting round adds to `booster`
+  def trees_per_round(booster) do
+    %{"learner" => learner} = EXGBoost.dump_config(booster) |> Jason.decode!()
+    model_param = learner["learner_model_param"]
+    num_class = String.to_integer(model_param["num_class"])
+    num_target = String.to_integer(Map.get(model_param, "num_target", "1"))
+
+    gbtree =
+      case learner["gradient_booster"] do
+        %{"name" => "gblinear"} -> nil
+        %{"name" => "dart", "gbtree" => gbtree} -> gbtree
+        gbtree -> gbtree
+      end
+
+    if gbtree do
+      parallel = String.to_integer(gbtree["gbtree_model_param"]["num_parallel_tree"])
+
+      outputs =
+        if get_in(gbtree, ["gbtree_train_param", "multi_strategy"]) == "multi_output_tree",
+          do: 1,
+          else: Enum.max([num_class, num_target, 1])
+
+      parallel * outputs
+    else
+      0
+    end
+  end
+
+  @doc false
+  # Model size and memory measurements taken after a round
+  def round_measurements(boosted_rounds, trees_added, trees_per_round) do
+    %{
+      trees_added: trees_added,
+      num_trees: boosted_rounds * trees_per_round,
+      native_memory: EXGBoost.NIF.native_memory() |> EXGBoost.Internal.unwrap!(),
+      rss: EXGBoost.NIF.process_rss() |> EXGBoost.Internal.unwrap!()
+    }
+  end
+end
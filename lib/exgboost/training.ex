@@ -1,41 +1,69 @@
 defmodule EXGBoost.Training do
   @moduledoc false
   alias EXGBoost.Booster
+  alias EXGBoost.CancelToken
   alias EXGBoost.DMatrix
-  alias EXGBoost.Training.{State, Callback}
+  alias EXGBoost.Telemetry
+  alias EXGBoost.Training.{State, Callback, Checkpoint}
+
+  @train_opts [
+    booster: nil,
+    callbacks: [],
+    cancel: nil,
+    checkpoint: nil,
+    early_stopping_rounds: nil,
+    evals: [],
+    goss: nil,
+    learning_rates: nil,
+    num_boost_rounds: 10,
+    obj: nil,
+    resume_from: nil,
+    verbose_eval: true,
+    disable_default_eval_metric: false
+  ]
 
   @spec train(DMatrix.t(), Keyword.t()) :: Booster.t()
   def train(%DMatrix{} = dmat, opts \\ []) do
     dmat_opts = Keyword.take(opts, EXGBoost.Internal.dmatrix_feature_opts())
 
-    valid_opts = [
-      callbacks: [],
-      early_stopping_rounds: nil,
-      evals: [],
-      learning_rates: nil,
-      num_boost_rounds: 10,
-      obj: nil,
-      verbose_eval: true,
-      disable_default_eval_metric: false
-    ]
+    valid_opts = @train_opts
 
     {opts, booster_params} = Keyword.split(opts, Keyword.keys(valid_opts))
 
     [
+      booster: booster,
       callbacks: callbacks,
+      cancel: cancel,
+      checkpoint: checkpoint,
       disable_default_eval_metric: disable_default_eval_metric,
       early_stopping_rounds: early_stopping_rounds,
       evals: evals,
+      goss: goss,
       learning_rates: learning_rates,
       num_boost_rounds: num_boost_rounds,
       obj: objective,
+      resume_from: resume_from,
       verbose_eval: verbose_eval
     ] = opts |> Keyword.validate!(valid_opts) |> Enum.sort()
 
+    checkpoint = if checkpoint, do: Checkpoint.validate!(checkpoint)
+
+    unless is_nil(cancel) or is_struct(cancel, CancelToken) do
+      raise ArgumentError, "cancel must be an EXGBoost.CancelToken"
+    end
+
+    if booster && (checkpoint || resume_from) do
+      raise ArgumentError, "booster can't be combined with checkpoint or resume_from"
+    end
+
     unless is_nil(learning_rates) or is_function(learning_rates, 1) or is_list(learning_rates) do
       raise ArgumentError, "learning_rates must be a function/1 or a list"
     end
 
+    if goss && is_function(objective, 2) do
+      raise ArgumentError, "goss can't be combined with a function objective"
+    end
+
     if early_stopping_rounds && evals == [] do
       raise ArgumentError, "early_stopping_rounds requires at least one evaluation set"
     end
@@ -47,17 +75,119 @@ defmodule EXGBoost.Training do
         value -> value
       end
 
+    # Evaluation sets may come already built, see `train_many/3`
     evals_dmats =
-      Enum.map(evals, fn {x, y, name} ->
-        {DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :dense)), name}
+      Enum.map(evals, fn
+        {%DMatrix{} = dmat, name} ->
+          {dmat, name}
+
+        {x, y, name} ->
+          {DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto)), name}
       end)
 
-    bst =
-      Booster.booster(
-        [dmat | Enum.map(evals_dmats, fn {dmat, _name} -> dmat end)],
-        booster_params
-      )
+    # A resumed booster continues after the last completed round of the
+    # checkpoint, with the callback state it had then. A continued booster is
+    # trained in place for `num_boost_rounds` more rounds, with only the params
+    # given here changed.
+    {bst, resume, num_boost_rounds} =
+      cond do
+        resume_from ->
+          {bst, iteration, meta_vars} = Checkpoint.load(resume_from, booster_params)
+          {bst, {iteration, meta_vars}, num_boost_rounds}
+
+        booster ->
+          params = Keyword.drop(booster_params, EXGBoost.Internal.dmatrix_feature_opts())
+          bst = Booster.set_params(booster, params)
+          rounds = Booster.get_boosted_rounds(bst)
+          {bst, {rounds, %{}}, rounds + num_boost_rounds}
+
+        true ->
+          bst =
+            Booster.booster(
+              [dmat | Enum.map(evals_dmats, fn {dmat, _name} -> dmat end)],
+              booster_params
+            )
+
+          {bst, {0, %{}}, num_boost_rounds}
+      end
+
+    objective = if goss, do: goss_objective(bst, objective, goss), else: objective
+
+    run = make_ref()
+
+    # Per-round measurements are only taken while someone listens for them
+    telemetry =
+      if Telemetry.rounds_enabled?(),
+        do: %{run: run, trees_per_round: Telemetry.trees_per_round(bst)}
+
+    :telemetry.span(
+      [:exgboost, :training],
+      %{run: run, num_boost_rounds: num_boost_rounds},
+      fn ->
+        # Without user callbacks or a custom objective every round can run inside
+        # a single NIF call, so the loop doesn't return to Elixir between rounds.
+        # Checkpointing and resuming need the callback state, so they use the
+        # Elixir loop. `num_boost_rounds` is the last round to run.
+        bst =
+          if callbacks == [] and not is_function(objective, 2) and is_nil(checkpoint) and
+               is_nil(resume_from) do
+            if early_stopping_rounds,
+              do: early_stopping_metric!(bst, disable_default_eval_metric)
+
+            native_train(
+              bst,
+              dmat,
+              objective,
+              evals_dmats,
+              elem(resume, 0),
+              num_boost_rounds,
+              learning_rates,
+              verbose_eval,
+              early_stopping_rounds,
+              cancel,
+              telemetry
+            )
+          else
+            callback_train(
+              bst,
+              dmat,
+              objective,
+              callbacks,
+              num_boost_rounds,
+              learning_rates,
+              verbose_eval,
+              evals_dmats,
+              early_stopping_rounds,
+              disable_default_eval_metric,
+              checkpoint,
+              resume,
+              cancel,
+              telemetry
+            )
+          end
 
+        rounds = Booster.get_boosted_rounds(bst) - elem(resume, 0)
+        {bst, %{rounds: rounds}, %{run: run, booster: bst}}
+      end
+    )
+  end
+
+  defp callback_train(
+         bst,
+         dmat,
+         objective,
+         callbacks,
+         num_boost_rounds,
+         learning_rates,
+         verbose_eval,
+         evals_dmats,
+         early_stopping_rounds,
+         disable_default_eval_metric,
+         checkpoint,
+         {start_iteration, saved_meta_vars},
+         cancel,
+         telemetry
+       ) do
     defaults =
       default_callbacks(
         bst,
@@ -65,7 +195,8 @@ defmodule EXGBoost.Training do
         verbose_eval,
         evals_dmats,
         early_stopping_rounds,
-        disable_default_eval_metric
+        disable_default_eval_metric,
+        checkpoint
       )
 
     callbacks =
@@ -82,47 +213,558 @@ defmodule EXGBoost.Training do
       raise ArgumentError, "Found duplicate callback names.\n\nName counts:\n\n#{str}\n"
     end
 
+    meta_vars = Map.new(callbacks, &{&1.name, &1.init_state})
+
     state = %State{
       booster: bst,
-      iteration: 0,
+      iteration: start_iteration,
       max_iteration: num_boost_rounds,
-      meta_vars: Map.new(callbacks, &{&1.name, &1.init_state})
+      meta_vars: Map.merge(meta_vars, Map.take(saved_meta_vars, Map.keys(meta_vars)))
     }
 
-    callbacks = Enum.group_by(callbacks, & &1.event, & &1.fun)
+    callbacks = Enum.group_by(callbacks, & &1.event, &{&1.name, &1.fun})
 
     state =
       state
       |> run_callbacks(callbacks, :before_training)
-      |> run_training(callbacks, dmat, objective)
+      |> run_training(callbacks, dmat, objective, cancel, telemetry)
       |> run_callbacks(callbacks, :after_training)
 
-    state.booster
+    # The last checkpoint may still be on its way to disk
+    if checkpoint = state.meta_vars[:checkpoint] do
+      Checkpoint.await(checkpoint.pending)
+    end
+
+    # Checkpoints and the checkpoint resumed from leave their state in the
+    # booster's attributes
+    Checkpoint.strip(state.booster)
+  end
+
+  @spec train_many(DMatrix.t(), [Keyword.t()], Keyword.t()) :: [Booster.t()]
+  def train_many(%DMatrix{} = dmat, param_sets, opts \\ []) when is_list(param_sets) do
+    {max_concurrency, opts} = Keyword.pop(opts, :max_concurrency)
+    dmat_opts = Keyword.take(opts, EXGBoost.Internal.dmatrix_feature_opts())
+
+    # The evaluation sets are shared as well
+    opts =
+      Keyword.update(opts, :evals, [], fn evals ->
+        Enum.map(evals, fn {x, y, name} ->
+          {DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto)), name}
+        end)
+      end)
+
+    param_sets =
+      Enum.map(param_sets, fn params ->
+        params = Keyword.merge(opts, params)
+
+        for key <- [:booster, :checkpoint, :resume_from], params[key] do
+          raise ArgumentError, "train_many doesn't support #{inspect(key)}"
+        end
+
+        unless Keyword.get(params, :tree_method, :hist) == :hist do
+          raise ArgumentError,
+                "train_many shares histogram cuts, so tree_method must be :hist, " <>
+                  "got: #{inspect(params[:tree_method])}"
+        end
+
+        Keyword.put(params, :tree_method, :hist)
+      end)
+
+    # Every booster must find the cuts the warm-up round below caches, which
+    # XGBoost only reuses for the same binning params
+    with [first | rest] <- param_sets do
+      binning = binning_params(first)
+
+      for params <- rest, binning_params(params) != binning do
+        raise ArgumentError,
+              "train_many shares histogram cuts, so every param set must use the " <>
+                "binning params #{inspect(binning)}, got: #{inspect(binning_params(params))}"
+      end
+    end
+
+    max_concurrency =
+      max_concurrency ||
+        max(1, min(length(param_sets), :erlang.system_info(:dirty_cpu_schedulers_online)))
+
+    nthread = max(1, div(System.schedulers_online(), max_concurrency))
+
+    with [first | _] <- param_sets, do: warm_up(dmat, first)
+
+    param_sets
+    |> Task.async_stream(&train(dmat, Keyword.put_new(&1, :nthread, nthread)),
+      max_concurrency: max_concurrency,
+      ordered: true,
+      timeout: :infinity
+    )
+    |> Enum.map(fn {:ok, booster} -> booster end)
+  end
+
+  # Params XGBoost sketches the histogram cuts with
+  @doc false
+  def binning_params(params), do: [max_bin: Keyword.get(params, :max_bin, 256)]
+
+  @doc false
+  # XGBoost sketches the histogram cuts of a DMatrix the first time a booster
+  # trains on it and caches them in the DMatrix, where boosters with the same
+  # max_bin find them. One throwaway round builds them with every core before
+  # boosters share the DMatrix, which then only ever read it.
+  def warm_up(%DMatrix{} = dmat, params) do
+    warm_params = Keyword.drop(params, [:nthread | Keyword.keys(@train_opts)])
+    warm = Booster.booster(dmat, Keyword.put(warm_params, :max_depth, 1))
+    :ok = Booster.update(warm, dmat, 0, nil)
+    Booster.free(warm)
+  end
+
+  defp native_train(
+         bst,
+         dmat,
+         objective,
+         evals_dmats,
+         start_iteration,
+         num_boost_rounds,
+         learning_rates,
+         verbose_eval,
+         early_stopping_rounds,
+         cancel,
+         telemetry
+       ) do
+    {eval_refs, evnames} = Enum.unzip(Enum.map(evals_dmats, fn {d, name} -> {d.ref, name} end))
+
+    {objective, goss} =
+      case objective do
+        {:goss, objective, goss} -> {objective, goss}
+        objective -> {objective, nil}
+      end
+
+    rounds = num_boost_rounds - start_iteration
+
+    # Rounds past the end of a short list keep the last rate, as the booster
+    # keeps its learning rate between rounds
+    learning_rates =
+      cond do
+        is_nil(learning_rates) -> []
+        is_list(learning_rates) -> Enum.slice(learning_rates, start_iteration, rounds)
+        true -> Enum.map(start_iteration..(num_boost_rounds - 1)//1, learning_rates)
+      end
+      |> Enum.map(&(&1 / 1))
+
+    run = fn progress ->
+      EXGBoost.NIF.booster_train(
+        bst.ref,
+        dmat.ref,
+        start_iteration + 1,
+        rounds,
+        eval_refs,
+        evnames,
+        learning_rates,
+        early_stopping_rounds || 0,
+        progress,
+        EXGBoost.Internal.native_objective(objective),
+        cancel && cancel.ref,
+        goss
+      )
+    end
+
+    print? = verbose_eval != 0 and evals_dmats != []
+
+    # Progress is streamed from the dirty scheduler, so the NIF runs in a task
+    # while this process prints the metrics and reports the rounds it sends.
+    # The task trains through this process's communicator, if it owns one.
+    result =
+      if print? or telemetry do
+        ref = make_ref()
+        parent = self()
+        period = if print?, do: verbose_eval, else: 0
+        progress = {parent, ref, period, telemetry != nil}
+        task =
+          Task.async(fn -> EXGBoost.Collective.delegate(parent, fn -> run.(progress) end) end)
+        await_progress(task, ref, telemetry)
+      else
+        run.(nil)
+      end
+
+    {_last_iteration, best_iteration, best_score} = EXGBoost.Internal.unwrap!(result)
+
+    if best_iteration,
+      do: struct(bst, best_iteration: best_iteration, best_score: best_score),
+      else: bst
+  end
+
+  defp await_progress(%Task{ref: task_ref} = task, ref, telemetry) do
+    receive do
+      {^ref, :round, iteration, update_ns, eval_ns, boosted_rounds} ->
+        emit_native_round(telemetry, iteration, update_ns, eval_ns, boosted_rounds)
+        await_progress(task, ref, telemetry)
+
+      {^ref, iteration, metrics} ->
+        metrics =
+          Enum.reduce(metrics, %{}, fn {ev, metric, value}, acc ->
+            Map.update(acc, ev, %{metric => value}, &Map.put(&1, metric, value))
+          end)
+
+        IO.puts("Iteration #{iteration}: #{inspect(metrics)}")
+        await_progress(task, ref, telemetry)
+
+      {^task_ref, result} ->
+        Process.demonitor(task_ref, [:flush])
+        result
+
+      {:DOWN, ^task_ref, _, _, reason} ->
+        exit({reason, {Task, :await, [task, :infinity]}})
+    end
+  end
+
+  # The round already finished in native code, so its events are emitted
+  # back to back with the durations measured there
+  defp emit_native_round(telemetry, iteration, update_ns, eval_ns, boosted_rounds) do
+    metadata = %{run: telemetry.run, iteration: iteration}
+    update = System.convert_time_unit(update_ns, :nanosecond, :native)
+    eval = System.convert_time_unit(eval_ns, :nanosecond, :native)
+    now = System.monotonic_time()
+
+    :telemetry.execute(
+      [:exgboost, :training, :iteration, :start],
+      %{system_time: System.system_time(), monotonic_time: now - update - eval},
+      metadata
+    )
+
+    measurements =
+      Map.merge(
+        %{
+          duration: update + eval,
+          monotonic_time: now,
+          update: update,
+          eval: eval,
+          callbacks: 0
+        },
+        Telemetry.round_measurements(
+          boosted_rounds,
+          telemetry.trees_per_round,
+          telemetry.trees_per_round
+        )
+      )
+
+    :telemetry.execute([:exgboost, :training, :iteration, :stop], measurements, metadata)
+  end
+
+  # GOSS samples rows from their gradients, so they are computed natively: by
+  # the given native objective, or by the native equivalent of the booster's
+  # own objective
+  defp goss_objective(bst, objective, goss) do
+    goss = if goss == true, do: [], else: goss
+    goss = Keyword.validate!(goss, top_rate: 0.2, other_rate: 0.1, seed: 0)
+
+    native =
+      case objective do
+        {:native, _name, _params} ->
+          objective
+
+        nil ->
+          %{"learner" => %{"objective" => %{"name" => name}}} =
+            EXGBoost.dump_config(bst) |> Jason.decode!()
+
+          case name do
+            "reg:squarederror" ->
+              {:native, :squared_error, []}
+
+            name when name in ["binary:logistic", "binary:logitraw"] ->
+              {:native, :smooth_logloss, []}
+
+            name ->
+              raise ArgumentError, "goss needs a native :obj for objective #{inspect(name)}"
+          end
+      end
+
+    {:goss, native, {goss[:top_rate] / 1, goss[:other_rate] / 1, goss[:seed]}}
+  end
+
+  @doc false
+  # Name of the metric early stopping watches: the last configured metric, or
+  # the objective's default one
+  def early_stopping_metric!(bst, disable_default_eval_metric) do
+    # This is still somewhat hacky and relies on a modification made to
+    # XGBoost in the Makefile to dump the config to JSON.
+    #
+    %{"learner" => %{"metrics" => metrics, "default_metric" => default_metric}} =
+      EXGBoost.dump_config(bst) |> Jason.decode!()
+
+    cond do
+      Enum.empty?(metrics) && disable_default_eval_metric ->
+        raise ArgumentError,
+              "`:early_stopping_rounds` requires at least one evaluation set. This means you have likely set `disable_default_eval_metric: true` and have not set any explicit evalutation metrics. Please supply at least one metric in the `:eval_metric` option or set `disable_default_eval_metric: false` (default option)"
+
+      Enum.empty?(metrics) ->
+        default_metric
+
+      true ->
+        metrics |> Enum.reverse() |> hd() |> Map.fetch!("name")
+    end
+  end
+
+  @spec cv(DMatrix.t(), Keyword.t()) :: map()
+  def cv(%DMatrix{} = dmat, opts \\ []) do
+    valid_opts = [
+      early_stopping_rounds: nil,
+      learning_rates: nil,
+      max_concurrency: nil,
+      nfold: 3,
+      num_boost_rounds: 10,
+      obj: nil,
+      seed: 0,
+      stratified: false,
+      verbose_eval: false
+    ]
+
+    {opts, booster_params} = Keyword.split(opts, Keyword.keys(valid_opts))
+    booster_params = Keyword.drop(booster_params, EXGBoost.Internal.dmatrix_feature_opts())
+
+    [
+      early_stopping_rounds: early_stopping_rounds,
+      learning_rates: learning_rates,
+      max_concurrency: max_concurrency,
+      nfold: nfold,
+      num_boost_rounds: num_boost_rounds,
+      obj: objective,
+      seed: seed,
+      stratified: stratified,
+      verbose_eval: verbose_eval
+    ] = opts |> Keyword.validate!(valid_opts) |> Enum.sort()
+
+    unless is_nil(learning_rates) or is_function(learning_rates, 1) or is_list(learning_rates) do
+      raise ArgumentError, "learning_rates must be a function/1 or a list"
+    end
+
+    verbose_eval =
+      case verbose_eval do
+        true -> 1
+        false -> 0
+        value -> value
+      end
+
+    # Folds run side by side on the dirty CPU schedulers, so the machine is
+    # split between them rather than letting every booster's OpenMP pool
+    # oversubscribe the cores. An explicit `nthread` is left untouched.
+    max_concurrency =
+      max_concurrency || min(nfold, :erlang.system_info(:dirty_cpu_schedulers_online))
+
+    booster_params =
+      Keyword.put_new_lazy(booster_params, :nthread, fn ->
+        max(1, div(System.schedulers_online(), max_concurrency))
+      end)
+
+    folds =
+      dmat
+      |> DMatrix.folds(nfold: nfold, seed: seed, stratified: stratified, allow_groups: true)
+      |> Enum.map(fn {train, test} ->
+        %{
+          booster: Booster.booster([train, test], booster_params),
+          train: train,
+          evals: [{train, "train"}, {test, "test"}]
+        }
+      end)
+
+    init = %{
+      history: [],
+      best_iteration: nil,
+      best_score: nil,
+      since_last_improvement: 0
+    }
+
+    result =
+      Enum.reduce_while(1..num_boost_rounds, init, fn iter, acc ->
+        fold_metrics =
+          folds
+          |> Task.async_stream(&cv_iteration(&1, iter, learning_rates, objective),
+            max_concurrency: max_concurrency,
+            ordered: true,
+            timeout: :infinity
+          )
+          |> Enum.map(fn {:ok, fold_metrics} -> fold_metrics end)
+
+        metrics = aggregate_cv_metrics(fold_metrics)
+
+        if verbose_eval != 0 and rem(iter, verbose_eval) == 0 do
+          IO.puts("Iteration #{iter}: #{inspect(metrics)}")
+        end
+
+        acc = %{acc | history: [metrics | acc.history]}
+        cv_early_stop(acc, metrics, target_metric(fold_metrics), iter, early_stopping_rounds)
+      end)
+
+    boosters =
+      Enum.map(folds, fn %{booster: bst} ->
+        if result.best_iteration do
+          bst
+          |> struct(best_iteration: result.best_iteration, best_score: result.best_score)
+          |> Booster.set_attr(
+            best_iteration: result.best_iteration,
+            best_score: result.best_score
+          )
+        else
+          bst
+        end
+      end)
+
+    %{
+      history: Enum.reverse(result.history),
+      best_iteration: result.best_iteration,
+      best_score: result.best_score,
+      boosters: boosters
+    }
+  end
+
+  defp cv_iteration(%{booster: bst, train: train, evals: evals}, iter, learning_rates, objective) do
+    # Rounds past the end of a short list keep the last rate, as in `train/3`
+    lr =
+      cond do
+        is_nil(learning_rates) -> nil
+        is_list(learning_rates) -> Enum.at(learning_rates, iter - 1)
+        true -> learning_rates.(iter - 1)
+      end
+
+    if lr, do: Booster.set_params(bst, learning_rate: lr)
+
+    :ok = Booster.update(bst, train, iter, objective)
+    Booster.eval_set(bst, evals, iter)
+  end
+
+  defp aggregate_cv_metrics(fold_metrics) do
+    fold_metrics
+    |> List.flatten()
+    |> Enum.group_by(fn {ev, metric, _} -> {ev, metric} end, &elem(&1, 2))
+    |> Enum.reduce(%{}, fn {{ev, metric}, scores}, acc ->
+      mean_std = mean_std(scores)
+      Map.update(acc, ev, %{metric => mean_std}, &Map.put(&1, metric, mean_std))
+    end)
+  end
+
+  # A fold with a non-finite metric (`:nan`) makes the whole round's `:nan`
+  defp mean_std(scores) do
+    if :nan in scores do
+      {:nan, :nan}
+    else
+      n = length(scores)
+      mean = Enum.sum(scores) / n
+      {mean, :math.sqrt(Enum.sum(Enum.map(scores, &((&1 - mean) * (&1 - mean)))) / n)}
+    end
+  end
+
+  # Every fold reports its metrics in the same order, so the last test metric
+  # of the first fold is the early stopping target, matching `train/2`.
+  defp target_metric([first | _]) do
+    case Enum.filter(first, &(elem(&1, 0) == "test")) do
+      [] -> nil
+      test_metrics -> test_metrics |> List.last() |> elem(1)
+    end
+  end
+
+  defp cv_early_stop(acc, _metrics, nil, _iter, _patience), do: {:cont, acc}
+  defp cv_early_stop(acc, _metrics, _target, _iter, nil), do: {:cont, acc}
+
+  defp cv_early_stop(acc, metrics, target_metric, iter, patience) do
+    {score, _std} = metrics |> Map.fetch!("test") |> Map.fetch!(target_metric)
+
+    improved? =
+      cond do
+        score == :nan -> false
+        acc.best_score == nil -> true
+        maximize_metric?(target_metric) -> score > acc.best_score
+        true -> score < acc.best_score
+      end
+
+    cond do
+      improved? ->
+        {:cont, %{acc | best_iteration: iter, best_score: score, since_last_improvement: 0}}
+
+      acc.since_last_improvement < patience ->
+        {:cont, %{acc | since_last_improvement: acc.since_last_improvement + 1}}
+
+      true ->
+        {:halt, %{acc | since_last_improvement: acc.since_last_improvement + 1}}
+    end
+  end
+
+  @doc false
+  # Metrics where a larger value is better, matched by name or by the prefix of
+  # their `@` forms, like `ndcg@5`. Keep in sync with `metric_maximize` in
+  # booster.c.
+  def maximize_metric?(metric) do
+    metric in ["auc", "aucpr", "map", "ndcg", "pre"] or
+      String.starts_with?(metric, ["map@", "ndcg@", "pre@"])
   end
 
   defp run_callbacks(%{status: :halt} = state, _callbacks, _event), do: state
 
   defp run_callbacks(%{status: :cont} = state, callbacks, event) do
-    Enum.reduce_while(callbacks[event] || [], state, fn callback, state ->
+    Enum.reduce_while(callbacks[event] || [], state, fn {_name, callback}, state ->
       state = callback.(state)
       {state.status, state}
     end)
   end
 
-  defp run_training(%{status: :halt} = state, _callbacks, _dmat, _objective), do: state
+  # Like run_callbacks/3, but also adds the time each callback takes to
+  # `timings`, counting the evaluation callback as `:eval`
+  defp run_timed_callbacks(%{status: :halt} = state, _callbacks, _event, timings),
+    do: {state, timings}
+
+  defp run_timed_callbacks(%{status: :cont} = state, callbacks, event, timings) do
+    (callbacks[event] || [])
+    |> Enum.reduce_while({state, timings}, fn {name, callback}, {state, timings} ->
+      start = System.monotonic_time()
+      state = callback.(state)
+      key = if name == :eval_metrics, do: :eval, else: :callbacks
+      timings = Map.update!(timings, key, &(&1 + System.monotonic_time() - start))
+      {state.status, {state, timings}}
+    end)
+  end
+
+  defp run_training(%{status: :halt} = state, _callbacks, _dmat, _objective, _cancel, _telemetry),
+    do: state
+
+  defp run_training(%{status: :cont} = state, callbacks, dmat, objective, cancel, telemetry) do
+    Enum.reduce_while((state.iteration + 1)..state.max_iteration//1, state, fn iter, state ->
+      if cancel && CancelToken.cancelled?(cancel), do: raise(RuntimeError, "Cancelled")
 
-  defp run_training(%{status: :cont} = state, callbacks, dmat, objective) do
-    Enum.reduce_while(1..state.max_iteration, state, fn iter, state ->
       state =
-        state
-        |> run_callbacks(callbacks, :before_iteration)
-        |> run_iteration(dmat, iter, objective)
-        |> run_callbacks(callbacks, :after_iteration)
+        if telemetry do
+          run_instrumented_iteration(state, callbacks, dmat, iter, objective, telemetry)
+        else
+          state
+          |> run_callbacks(callbacks, :before_iteration)
+          |> run_iteration(dmat, iter, objective)
+          |> run_callbacks(callbacks, :after_iteration)
+        end
 
       {state.status, state}
     end)
   end
 
+  defp run_instrumented_iteration(state, callbacks, dmat, iter, objective, telemetry) do
+    metadata = %{run: telemetry.run, iteration: iter}
+
+    :telemetry.span([:exgboost, :training, :iteration], metadata, fn ->
+      timings = %{update: 0, eval: 0, callbacks: 0}
+      {state, timings} = run_timed_callbacks(state, callbacks, :before_iteration, timings)
+      start = System.monotonic_time()
+      updated = run_iteration(state, dmat, iter, objective)
+      timings = %{timings | update: System.monotonic_time() - start}
+      trees_added = if updated.iteration == iter, do: telemetry.trees_per_round, else: 0
+      {state, timings} = run_timed_callbacks(updated, callbacks, :after_iteration, timings)
+
+      measurements =
+        Map.merge(
+          timings,
+          Telemetry.round_measurements(
+            Booster.get_boosted_rounds(state.booster),
+            trees_added,
+            telemetry.trees_per_round
+          )
+        )
+
+      {state, measurements, metadata}
+    end)
+  end
+
   defp run_iteration(%{status: :halt} = state, _dmat, _iter, _objective), do: state
 
   defp run_iteration(%{status: :cont} = state, dmat, iter, objective) do
@@ -136,9 +778,24 @@ defmodule EXGBoost.Training do
          verbose_eval,
          evals_dmats,
          early_stopping_rounds,
-         disable_default_eval_metric
+         disable_default_eval_metric,
+         checkpoint
        ) do
-    default_callbacks = []
+    # Added first so that it runs last and snapshots the state left by the
+    # other callbacks
+    default_callbacks =
+      if checkpoint do
+        [
+          %Callback{
+            event: :after_iteration,
+            fun: &Callback.checkpoint/1,
+            name: :checkpoint,
+            init_state: Checkpoint.init_state(checkpoint)
+          }
+        ]
+      else
+        []
+      end
 
     default_callbacks =
       if learning_rates do
@@ -172,24 +829,7 @@ defmodule EXGBoost.Training do
       if early_stopping_rounds && evals_dmats != [] do
         [{_dmat, target_eval} | _tail] = Enum.reverse(evals_dmats)
 
-        # This is still somewhat hacky and relies on a modification made to
-        # XGBoost in the Makefile to dump the config to JSON.
-        #
-        %{"learner" => %{"metrics" => metrics, "default_metric" => default_metric}} =
-          EXGBoost.dump_config(bst) |> Jason.decode!()
-
-        metric_name =
-          cond do
-            Enum.empty?(metrics) && disable_default_eval_metric ->
-              raise ArgumentError,
-                    "`:early_stopping_rounds` requires at least one evaluation set. This means you have likely set `disable_default_eval_metric: true` and have not set any explicit evalutation metrics. Please supply at least one metric in the `:eval_metric` option or set `disable_default_eval_metric: false` (default option)"
-
-            Enum.empty?(metrics) ->
-              default_metric
-
-            true ->
-              metrics |> Enum.reverse() |> hd() |> Map.fetch!("name")
-          end
+        metric_name = early_stopping_metric!(bst, disable_default_eval_metric)
 
         early_stop = %Callback{
           event: :after_iteration,
@@ -199,7 +839,7 @@ defmodule EXGBoost.Training do
             patience: early_stopping_rounds,
             best: nil,
             since_last_improvement: 0,
-            mode: :min,
+            mode: if(maximize_metric?(metric_name), do: :max, else: :min),
             target_eval: target_eval,
             target_metric: metric_name
           }
@@ -26,6 +26,7 @@ defmodule EXGBoost.Training.Callback do
   * `early_stop` - performs early stopping
   * `eval_metrics` - evaluates metrics on the training and evaluation sets
   * `eval_monitor` - prints evaluation metrics
+  * `checkpoint` - periodically snapshots the booster to disk
 
   Callbacks can be added to the training process by passing them to `EXGBoost.Training.train/2`.
 
@@ -42,7 +43,7 @@ defmodule EXGBoost.Training.Callback do
   ```
 
   """
-  alias EXGBoost.Training.State
+  alias EXGBoost.Training.{Checkpoint, State}
   @enforce_keys [:event, :fun]
   defstruct [:event, :fun, :name, :init_state]
 
@@ -82,7 +83,7 @@ defmodule EXGBoost.Training.Callback do
 
   Requires that `learning_rates` either be a list of learning rates or a function that takes the
   iteration number and returns a learning rate.  `learning_rates` must exist in the `state` that
-  is passed to the callback.
+  is passed to the callback. Iterations past the end of a list keep its last rate.
   """
   def lr_scheduler(
         %State{
@@ -93,8 +94,11 @@ defmodule EXGBoost.Training.Callback do
         } = state
       ) do
     lr = if is_list(learning_rates), do: Enum.at(learning_rates, i), else: learning_rates.(i)
-    boostr = EXGBoost.Booster.set_params(bst, learning_rate: lr)
-    %{state | booster: boostr}
+
+    # Iterations past the end of a short list keep the last rate
+    if lr,
+      do: %{state | booster: EXGBoost.Booster.set_params(bst, learning_rate: lr)},
+      else: state
   end
 
   # TODO: Ideally this would be generalized like it is in Axon to allow generic monitoring of metrics,
@@ -142,8 +146,10 @@ defmodule EXGBoost.Training.Callback do
 
     score = metrics[target_eval][target_metric]
 
+    # Non-finite metrics come back as `:nan` and never improve
     improved? =
       cond do
+        score == :nan -> false
         best_score == nil -> true
         mode == :min -> score < best_score
         mode == :max -> score > best_score
@@ -165,12 +171,9 @@ defmodule EXGBoost.Training.Callback do
         %{state | meta_vars: %{meta_vars | early_stop: early_stop}}
 
       true ->
+        # The booster keeps the best iteration and score, as the native loop does
         early_stop = Map.update!(early_stop, :since_last_improvement, &(&1 + 1))
-        # TODO: Should this actually update the best iteration and score?
-        # This iteration is not the best, but it is the last one, so do we want
-        # another way to track last iteration?
-        bst = struct(bst, best_iteration: state.iteration, best_score: score)
-        %{state | booster: bst, meta_vars: %{meta_vars | early_stop: early_stop}, status: :halt}
+        %{state | meta_vars: %{meta_vars | early_stop: early_stop}, status: :halt}
     end
   end
 
@@ -203,6 +206,53 @@ defmodule EXGBoost.Training.Callback do
     %{state | metrics: metrics}
   end
 
+  @doc """
+  A callback function that snapshots the booster to disk.
+
+  A checkpoint is taken every `every` iterations and/or once `interval` seconds
+  have passed since the previous one. The booster is serialized on the training
+  process but written to disk on a background thread, and the newest `keep`
+  checkpoints are kept. Before taking a snapshot, the callback waits for the
+  previous one to be written.
+
+  Requires that the following exist in the `state.meta_vars` that is passed to the callback:
+   * checkpoint:
+      * path: directory the checkpoints are written to
+      * every: number of iterations between checkpoints, or `nil`
+      * interval: number of seconds between checkpoints, or `nil`
+      * keep: number of checkpoints to keep
+      * written: paths of the checkpoints kept so far, newest first
+      * last_time: monotonic time in milliseconds of the previous checkpoint
+      * pending: reference of the write in progress, or `nil`
+  """
+  def checkpoint(
+        %State{
+          booster: bst,
+          iteration: iteration,
+          meta_vars: %{checkpoint: checkpoint} = meta_vars,
+          status: :cont
+        } = state
+      ) do
+    now = System.monotonic_time(:millisecond)
+
+    due? =
+      (checkpoint.every != nil and rem(iteration, checkpoint.every) == 0) or
+        (checkpoint.interval != nil and now - checkpoint.last_time >= checkpoint.interval * 1000)
+
+    if due? do
+      Checkpoint.await(checkpoint.pending)
+      path = Checkpoint.path(checkpoint.path, iteration)
+      written = [path | List.delete(checkpoint.written, path)]
+      {written, stale} = Enum.split(written, checkpoint.keep)
+      bst = Checkpoint.put_state(bst, iteration, meta_vars)
+      ref = Checkpoint.write(bst, path, stale)
+      checkpoint = %{checkpoint | written: written, last_time: now, pending: ref}
+      %{state | meta_vars: %{meta_vars | checkpoint: checkpoint}}
+    else
+      state
+    end
+  end
+
   @doc """
   A callback function that prints evaluation metrics according to a period.
 
@@ -0,0 +1,155 @@
+defmodule EXGBoost.Training.Checkpoint do
+  @moduledoc false
+  alias EXGBoost.Booster
+  alias EXGBoost.Internal
+
+  @attr "exgboost_checkpoint"
+  @file_regex ~r/^checkpoint-(\d+)\.bin$/
+
+  # Callback meta vars rebuilt from the training options on resume. Everything
+  # else (early stopping, user callbacks) is restored from the checkpoint.
+  @transient_meta [:checkpoint, :eval_metrics, :monitor_metrics, :lr_scheduler]
+
+  def validate!(opts) do
+    opts = Keyword.validate!(opts, [:path, every: nil, interval: nil, keep: 3])
+
+    unless is_binary(opts[:path]) do
+      raise ArgumentError, "checkpoint requires a `:path` directory"
+    end
+
+    if is_nil(opts[:every]) and is_nil(opts[:interval]) do
+      raise ArgumentError, "checkpoint requires `:every` rounds and/or an `:interval` in seconds"
+    end
+
+    unless is_integer(opts[:keep]) and opts[:keep] > 0 do
+      raise ArgumentError, "checkpoint `:keep` must be a positive integer"
+    end
+
+    opts
+  end
+
+  def init_state(opts) do
+    File.mkdir_p!(opts[:path])
+
+    %{
+      path: opts[:path],
+      every: opts[:every],
+      interval: opts[:interval],
+      keep: opts[:keep],
+      written: existing(opts[:path]),
+      last_time: System.monotonic_time(:millisecond),
+      pending: nil
+    }
+  end
+
+  def path(dir, iteration), do: Path.join(dir, "checkpoint-#{iteration}.bin")
+
+  # Checkpoint files in `dir`, newest first
+  def existing(dir) do
+    dir
+    |> File.ls!()
+    |> Enum.flat_map(fn name ->
+      case Regex.run(@file_regex, name) do
+        [_, iteration] -> [{String.to_integer(iteration), Path.join(dir, name)}]
+        nil -> []
+      end
+    end)
+    |> Enum.sort(:desc)
+    |> Enum.map(&elem(&1, 1))
+  end
+
+  # Stores the training state in the booster attributes, so the snapshot taken
+  # right after carries it
+  def put_state(%Booster{} = bst, iteration, meta_vars) do
+    state = %{
+      iteration: iteration,
+      meta_vars: Map.drop(meta_vars, @transient_meta),
+      best_iteration: bst.best_iteration,
+      best_score: bst.best_score
+    }
+
+    encoded = state |> :erlang.term_to_binary() |> Base.encode64()
+    EXGBoost.NIF.booster_set_attr(bst.ref, @attr, encoded) |> Internal.unwrap!()
+    bst
+  end
+
+  def write(%Booster{} = bst, path, stale) do
+    ref = make_ref()
+    EXGBoost.NIF.booster_checkpoint(bst.ref, path, stale, {self(), ref}) |> Internal.unwrap!()
+    ref
+  end
+
+  def await(nil), do: :ok
+
+  def await(ref) do
+    receive do
+      {^ref, :ok} -> :ok
+      {^ref, {:error, reason}} -> raise RuntimeError, "checkpoint failed: #{reason}"
+    end
+  end
+
+  @doc false
+  # Loads the checkpoint at `path`, or the newest one if `path` is a directory.
+  # Returns the booster along with the last completed iteration and the meta
+  # vars to restore.
+  def load(path, booster_params) do
+    file =
+      if File.dir?(path) do
+        case existing(path) do
+          [newest | _] -> newest
+          [] -> raise ArgumentError, "no checkpoint found in #{inspect(path)}"
+        end
+      else
+        path
+      end
+
+    bst = file |> Booster.load_mmap() |> Booster.configure(booster_params)
+
+    case Booster.get_attr(bst, @attr) do
+      :error ->
+        raise ArgumentError, "#{inspect(file)} is not an EXGBoost checkpoint"
+
+      encoded ->
+        state = decode!(encoded, file)
+        bst = struct(bst, best_iteration: state.best_iteration, best_score: state.best_score)
+        {bst, state.iteration, state.meta_vars}
+    end
+  end
+
+  # Removes the training state from a booster once training is over, so it
+  # doesn't end up in the saved model
+  def strip(%Booster{} = bst) do
+    EXGBoost.NIF.booster_set_attr(bst.ref, @attr, nil) |> Internal.unwrap!()
+    bst
+  end
+
+  # Checkpoints may come from anywhere on disk, so only plain data is decoded:
+  # no new atoms, and no funs that would run code on resume
+  defp decode!(encoded, file) do
+    state =
+      try do
+        encoded |> Base.decode64!() |> :erlang.binary_to_term([:safe])
+      rescue
+        ArgumentError ->
+          message = "#{inspect(file)} is not a valid EXGBoost checkpoint"
+          reraise ArgumentError, message, __STACKTRACE__
+      end
+
+    if has_fun?(state) do
+      raise ArgumentError, "#{inspect(file)} holds functions and can't be resumed from"
+    end
+
+    state
+  end
+
+  defp has_fun?(term) when is_function(term), do: true
+  defp has_fun?(term) when is_list(term), do: has_fun_list?(term)
+  defp has_fun?(term) when is_tuple(term), do: term |> Tuple.to_list() |> has_fun?()
+  defp has_fun?(term) when is_map(term), do: term |> Map.to_list() |> has_fun?()
+  defp has_fun?(_term), do: false
+
+  # Walks improper lists too
+  defp has_fun_list?([head | tail]), do: has_fun?(head) or has_fun_list?(tail)
+  defp has_fun_list?([]), do: false
+  defp has_fun_list?(tail), do: has_fun?(tail)
+end
@@ -0,0 +1,452 @@
+defmodule EXGBoost.Tuning do
+  @moduledoc """
+  Hyperparameter search over boosters trained side by side on one shared
+  training `EXGBoost.DMatrix`.
+
+  Every trial is a booster with its own params, and trials run concurrently on
+  the dirty CPU schedulers. Unless `nthread` is given, the machine's cores are
+  split evenly between the trials running at once, so their OpenMP pools don't
+  oversubscribe it. Trials are scored on the last metric of the last `:evals`
+  set, like early stopping in `EXGBoost.train/3`.
+
+  ## Search space
+
+  The space is a keyword list of booster params to search. Each value is one of:
+
+  * a list of candidate values
+  * `{:uniform, low, high}` - a float drawn uniformly from `[low, high)`
+  * `{:log_uniform, low, high}` - a float whose logarithm is uniform, for scale
+    params like `:learning_rate` or `:lambda`
+  * `{:int, low, high}` - an integer drawn uniformly from `low..high`
+
+  `:grid` search only accepts lists and tries every combination, the other
+  strategies draw trials from the space.
+
+  Trials share the histogram cuts of the training set, so `:max_bin` can't be
+  searched.
+
+  ## Strategies
+
+  * `:grid` - Trains every combination for `:num_boost_rounds` rounds.
+
+  * `:random` - Trains `:num_trials` random trials for `:num_boost_rounds` rounds.
+
+  * `:successive_halving` - Trains all trials for `:min_rounds` rounds, keeps the
+    best `1 / factor` of them and continues the survivors' boosters to `factor`
+    times as many rounds, until they reach `:num_boost_rounds`, where `factor` is
+    the `:reduction_factor`. Trials come from the grid,
+    or are drawn at random if `:num_trials` is given.
+
+  * `:hyperband` - Runs successive halving brackets that trade the number of
+    trials against the rounds they start with, from many trials at
+    `:min_rounds` down to few trials at `:num_boost_rounds`. Trials are drawn at
+    random.
+
+  Eliminated trials have their boosters freed right away. Survivors are never
+  retrained: their boosters continue from the rounds they already have.
+  """
+
+  alias EXGBoost.Booster
+  alias EXGBoost.DMatrix
+  alias EXGBoost.Internal
+  alias EXGBoost.Training
+
+  @strategies [:grid, :random, :successive_halving, :hyperband]
+
+  @doc """
+  Searches `space` for the booster params that score best on the `:evals` sets.
+
+  ## Options
+
+  * `:evals` - A list of 3-Tuples `{x, y, label}` to score trials on. Required.
+
+  * `:strategy` - One of `:grid`, `:random`, `:successive_halving` or
+    `:hyperband`. Defaults to `:grid`.
+
+  * `:num_boost_rounds` - Rounds each trial is trained for, or the most rounds
+    any trial reaches when halving. Defaults to `10`.
+
+  * `:num_trials` - Number of random trials. Defaults to `10` for `:random`.
+
+  * `:min_rounds` - Rounds trials start with when halving. Defaults to enough
+    rounds for every halving to fit within `:num_boost_rounds`.
+
+  * `:reduction_factor` - Only `1 / reduction_factor` of the trials are kept at
+    every halving. Named after the `eta` of the Hyperband paper, which would
+    clash with the booster's `:eta`. Defaults to `3`.
+
+  * `:early_stopping_rounds` - Stops training a trial once its score has not
+    improved for this many rounds, and scores it on its best round. Without it
+    trials are scored on their last round.
+
+  * `:max_concurrency` - Number of trials trained at once. Defaults to the
+    number of dirty CPU schedulers.
+
+  * `:keep_boosters` - Number of top trials whose boosters are returned. The
+    others are freed. Defaults to `1`.
+
+  * `:obj` - A native objective, see `EXGBoost.train/3`. Elixir objective
+    functions are not supported.
+
+  * `:seed` - Seed for drawing random trials. Defaults to `0`.
+
+  Any other option is a booster param shared by all trials.
+
+  ## Returns
+
+  A map with:
+
+  * `:leaderboard` - The trials, best first. Trials that got further in a
+    halving search rank above those eliminated earlier. Each is a map with its
+    `:params`, `:score`, `:best_iteration`, `:rounds` trained and `:booster`,
+    which is `nil` for freed boosters.
+  * `:best` - The first trial of the leaderboard.
+  * `:trials` - Number of trials run.
+  * `:duration` - Time the search took, in milliseconds.
+  * `:trials_per_hour` - Trials run per hour of search.
+
+  ## Examples
+
+      space = [max_depth: [3, 6, 9], learning_rate: {:log_uniform, 0.01, 0.3}]
+
+      EXGBoost.Tuning.search(x, y, space,
+        strategy: :hyperband,
+        num_boost_rounds: 81,
+        evals: [{x_valid, y_valid, "valid"}]
+      )
+  """
+  @spec search(Nx.Tensor.t(), Nx.Tensor.t(), Keyword.t(), Keyword.t()) :: map()
+  def search(x, y, space, opts \\ []) when is_list(space) do
+    started = System.monotonic_time(:millisecond)
+    x = Nx.concatenate(x)
+    y = Nx.concatenate(y)
+    dmat_opts = Keyword.take(opts, Internal.dmatrix_feature_opts())
+
+    valid_opts = [
+      early_stopping_rounds: nil,
+      evals: [],
+      keep_boosters: 1,
+      max_concurrency: nil,
+      min_rounds: nil,
+      num_boost_rounds: 10,
+      num_trials: nil,
+      obj: nil,
+      reduction_factor: 3,
+      seed: 0,
+      strategy: :grid
+    ]
+
+    {opts, booster_params} = Keyword.split(opts, Keyword.keys(valid_opts))
+    booster_params = Keyword.drop(booster_params, Internal.dmatrix_feature_opts())
+
+    [
+      early_stopping_rounds: early_stopping_rounds,
+      evals: evals,
+      keep_boosters: keep_boosters,
+      max_concurrency: max_concurrency,
+      min_rounds: min_rounds,
+      num_boost_rounds: num_boost_rounds,
+      num_trials: num_trials,
+      obj: objective,
+      reduction_factor: eta,
+      seed: seed,
+      strategy: strategy
+    ] = opts |> Keyword.validate!(valid_opts) |> Enum.sort()
+
+    unless strategy in @strategies do
+      raise ArgumentError,
+            "expected :strategy to be one of #{inspect(@strategies)}, got: #{inspect(strategy)}"
+    end
+
+    if evals == [] do
+      raise ArgumentError, "tuning requires at least one evaluation set in :evals"
+    end
+
+    native_objective = objective && Internal.native_objective(objective)
+
+    if objective && is_nil(native_objective) do
+      raise ArgumentError,
+            "tuning only supports native :obj objectives, got: #{inspect(objective)}"
+    end
+
+    unless is_integer(eta) and eta > 1 do
+      raise ArgumentError,
+            "expected :reduction_factor to be an integer greater than 1, got: #{inspect(eta)}"
+    end
+
+    binning = binning_params!(space, booster_params)
+
+    dmat = DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto))
+
+    evals_dmats =
+      Enum.map(evals, fn {x, y, name} ->
+        {DMatrix.from_tensor(x, y, Keyword.put_new(dmat_opts, :format, :auto)), name}
+      end)
+
+    max_concurrency = max_concurrency || :erlang.system_info(:dirty_cpu_schedulers_online)
+
+    # Trials run side by side, so each gets its share of the cores, as in `cv/3`
+    booster_params =
+      Keyword.put_new_lazy(booster_params, :nthread, fn ->
+        max(1, div(System.schedulers_online(), max_concurrency))
+      end)
+
+    # Trials share the histogram cuts of `dmat`, built once before the first
+    # rung, which XGBoost only reuses for the same binning params
+    Training.warm_up(dmat, Keyword.merge(booster_params, binning))
+
+    ctx = %{
+      dmat: dmat,
+      evals_dmats: evals_dmats,
+      booster_params: booster_params,
+      objective: native_objective,
+      early_stopping_rounds: early_stopping_rounds,
+      max_concurrency: max_concurrency
+    }
+
+    rand = :rand.seed_s(:exsss, seed)
+
+    trials =
+      case strategy do
+        :grid ->
+          space |> grid!() |> new_trials(ctx) |> run_rung(num_boost_rounds, ctx)
+
+        :random ->
+          {params, _rand} = sample(space, num_trials || 10, rand)
+          params |> new_trials(ctx) |> run_rung(num_boost_rounds, ctx)
+
+        :successive_halving ->
+          params =
+            if num_trials, do: elem(sample(space, num_trials, rand), 0), else: grid!(space)
+
+          min_rounds = min_rounds || default_min_rounds(length(params), num_boost_rounds, eta)
+          params |> new_trials(ctx) |> halving(min_rounds, num_boost_rounds, eta, ctx)
+
+        :hyperband ->
+          hyperband(space, min_rounds || 1, num_boost_rounds, eta, rand, ctx)
+      end
+
+    {kept, freed} = trials |> rank() |> Enum.split(keep_boosters)
+    Enum.each(freed, &free_trial/1)
+    leaderboard = Enum.map(kept, &entry/1) ++ Enum.map(freed, &entry(%{&1 | booster: nil}))
+
+    duration = System.monotonic_time(:millisecond) - started
+
+    %{
+      leaderboard: leaderboard,
+      best: List.first(leaderboard),
+      trials: length(leaderboard),
+      duration: duration,
+      trials_per_hour: length(leaderboard) * 3_600_000 / max(duration, 1)
+    }
+  end
+
+  defp binning_params!(space, booster_params) do
+    case Keyword.fetch(space, :max_bin) do
+      :error ->
+        Training.binning_params(booster_params)
+
+      {:ok, [max_bin]} ->
+        [max_bin: max_bin]
+
+      {:ok, values} ->
+        raise ArgumentError,
+              "trials share histogram cuts, so :max_bin can't be searched, got: " <>
+                inspect(values)
+    end
+  end
+
+  defp grid!(space) do
+    Enum.reduce(Enum.reverse(space), [[]], fn {name, values}, acc ->
+      unless is_list(values) do
+        raise ArgumentError,
+              "grid search requires a list of values for #{inspect(name)}, " <>
+                "got: #{inspect(values)}"
+      end
+
+      for value <- values, params <- acc, do: [{name, value} | params]
+    end)
+  end
+
+  defp sample(space, count, rand) do
+    Enum.map_reduce(1..count//1, rand, fn _, rand ->
+      Enum.map_reduce(space, rand, fn {name, values}, rand ->
+        {value, rand} = draw(values, rand)
+        {{name, value}, rand}
+      end)
+    end)
+  end
+
+  defp draw(values, rand) when is_list(values) and values != [] do
+    {i, rand} = :rand.uniform_s(length(values), rand)
+    {Enum.at(values, i - 1), rand}
+  end
+
+  defp draw({:uniform, low, high}, rand) do
+    {u, rand} = :rand.uniform_s(rand)
+    {low + (high - low) * u, rand}
+  end
+
+  defp draw({:log_uniform, low, high}, rand) when low > 0 and high > 0 do
+    {value, rand} = draw({:uniform, :math.log(low), :math.log(high)}, rand)
+    {:math.exp(value), rand}
+  end
+
+  defp draw({:int, low, high}, rand) when is_integer(low) and is_integer(high) and low <= high do
+    {i, rand} = :rand.uniform_s(high - low + 1, rand)
+    {low + i - 1, rand}
+  end
+
+  defp draw(values, _rand) do
+    raise ArgumentError, "invalid search space values: #{inspect(values)}"
+  end
+
+  defp new_trials(params_list, ctx) do
+    dmats = [ctx.dmat | Enum.map(ctx.evals_dmats, &elem(&1, 0))]
+
+    Enum.map(params_list, fn params ->
+      booster = Booster.booster(dmats, Keyword.merge(ctx.booster_params, params))
+      metric = Training.early_stopping_metric!(booster, false)
+
+      %{
+        params: params,
+        booster: booster,
+        metric: metric,
+        maximize: Training.maximize_metric?(metric),
+        rounds: 0,
+        score: nil,
+        best_iteration: nil,
+        stopped: false,
+        target: 0
+      }
+    end)
+  end
+
+  # Trains every trial up to `rounds`, continuing from the rounds it has
+  defp run_rung(trials, rounds, ctx) do
+    trials
+    |> Task.async_stream(&advance(&1, rounds, ctx),
+      max_concurrency: ctx.max_concurrency,
+      ordered: true,
+      timeout: :infinity
+    )
+    |> Enum.map(fn {:ok, trial} -> %{trial | target: rounds} end)
+  end
+
+  defp advance(%{stopped: true} = trial, _rounds, _ctx), do: trial
+  defp advance(%{rounds: done} = trial, rounds, _ctx) when done >= rounds, do: trial
+
+  defp advance(trial, rounds, ctx) do
+    {eval_refs, evnames} = Enum.unzip(Enum.map(ctx.evals_dmats, fn {d, n} -> {d.ref, n} end))
+    num_rounds = rounds - trial.rounds
+
+    # The native loop only tracks the best score with early stopping on
+    {last_iteration, best_iteration, best_score} =
+      EXGBoost.NIF.booster_train(
+        trial.booster.ref,
+        ctx.dmat.ref,
+        trial.rounds + 1,
+        num_rounds,
+        eval_refs,
+        evnames,
+        [],
+        ctx.early_stopping_rounds || 0,
+        nil,
+        ctx.objective,
+        nil,
+        nil
+      )
+      |> Internal.unwrap!()
+
+    trial = %{trial | rounds: last_iteration, stopped: last_iteration < rounds}
+
+    cond do
+      is_nil(ctx.early_stopping_rounds) ->
+        %{trial | score: last_score(trial, ctx), best_iteration: last_iteration}
+
+      best_score && better?(best_score, trial.score, trial.maximize) ->
+        %{trial | score: best_score, best_iteration: best_iteration}
+
+      true ->
+        trial
+    end
+  end
+
+  # The score of the last round on the last eval set, from the booster's eval
+  # history. Non-finite scores leave the trial unscored
+  defp last_score(trial, ctx) do
+    {_dmat, name} = List.last(ctx.evals_dmats)
+
+    with %{metrics: %{^name => %{} = metrics}} <- Booster.eval_history(trial.booster),
+         %Nx.Tensor{} = scores <- metrics[trial.metric],
+         score when is_float(score) <- scores[-1] |> Nx.to_number() do
+      score
+    else
+      _ -> nil
+    end
+  end
+
+  defp better?(_score, nil, _maximize), do: true
+  defp better?(score, best, true), do: score > best
+  defp better?(score, best, false), do: score < best
+
+  # Trials that were trained towards more rounds first, so halving survivors
+  # rank above the trials they beat, then by score with unscored trials last
+  defp rank(trials) do
+    Enum.sort(trials, fn a, b ->
+      cond do
+        a.target != b.target -> a.target > b.target
+        is_nil(b.score) -> true
+        is_nil(a.score) -> false
+        true -> not better?(b.score, a.score, a.maximize)
+      end
+    end)
+  end
+
+  # Successive halving: train, keep the best `1 / eta`, and continue the
+  # survivors with `eta` times the rounds until they reach `max_rounds`.
+  # `eta` is the reduction factor, as in the Hyperband paper.
+  defp halving(trials, rounds, max_rounds, eta, ctx) do
+    rounds = min(rounds, max_rounds)
+    trials = run_rung(trials, rounds, ctx)
+
+    if rounds >= max_rounds do
+      trials
+    else
+      keep = max(div(length(trials), eta), 1)
+      {survivors, eliminated} = trials |> rank() |> Enum.split(keep)
+      Enum.each(eliminated, &free_trial/1)
+      eliminated = Enum.map(eliminated, &%{&1 | booster: nil})
+      halving(survivors, rounds * eta, max_rounds, eta, ctx) ++ eliminated
+    end
+  end
+
+  # Enough rounds to start with for `num_trials` trials to be halved down to
+  # one within `max_rounds`
+  defp default_min_rounds(num_trials, max_rounds, eta) do
+    halvings = num_halvings(num_trials, eta, 0)
+    max(1, div(max_rounds, Integer.pow(eta, halvings)))
+  end
+
+  defp num_halvings(n, eta, count) when n >= eta, do: num_halvings(div(n, eta), eta, count + 1)
+  defp num_halvings(_n, _eta, count), do: count
+
+  defp hyperband(space, min_rounds, max_rounds, eta, rand, ctx) do
+    s_max = num_halvings(div(max_rounds, max(min_rounds, 1)), eta, 0)
+
+    {trials, _rand} =
+      Enum.flat_map_reduce(s_max..0//-1, rand, fn s, rand ->
+        num_trials = ceil((s_max + 1) / (s + 1) * Integer.pow(eta, s))
+        rounds = max(min_rounds, div(max_rounds, Integer.pow(eta, s)))
+        {params, rand} = sample(space, num_trials, rand)
+        {params |> new_trials(ctx) |> halving(rounds, max_rounds, eta, ctx), rand}
+      end)
+
+    trials
+  end
+
+  defp free_trial(%{booster: nil}), do: :ok
+  defp free_trial(%{booster: booster}), do: Booster.free(booster)
+
+  defp entry(trial), do: Map.take(trial, [:params, :score, :best_iteration, :rounds, :booster])
+end
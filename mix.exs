@@ -48,6 +48,7 @@ defmodule EXGBoost.MixProject do
       {:elixir_make, "~> 0.4", runtime: false},
       {:nimble_options, "~> 1.0"},
       {:nx, "~> 0.7"},
+      {:telemetry, "~> 1.1"},
       {:jason, "~> 1.3"},
       {:ex_doc, "~> 0.31.0", only: :docs},
       {:cc_precompiler, "~> 0.1.0", runtime: false},
@@ -102,7 +103,13 @@ defmodule EXGBoost.MixProject do
         Training: [
           EXGBoost.Training,
           EXGBoost.Training.Callback,
+          EXGBoost.Telemetry,
+          EXGBoost.Tuning,
+          EXGBoost.Collective,
+          EXGBoost.CancelToken,
           EXGBoost.Booster,
+          EXGBoost.Registry,
+          EXGBoost.BoosterCache,
           EXGBoost.Parameters
         ]
       ],
@@ -171,6 +171,782 @@ defmodule EXGBoostTest do
     refute is_nil(booster.best_score)
   end
 
+  test "cross-validation", context do
+    nrows = 30
+    ncols = 3
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {nrows, ncols})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {nrows})
+
+    result =
+      EXGBoost.cv(x, y,
+        nfold: 3,
+        num_boost_rounds: 5,
+        tree_method: :hist,
+        eval_metric: [:rmse]
+      )
+
+    assert length(result.history) == 5
+    assert length(result.boosters) == 3
+    assert Enum.all?(result.boosters, &(Booster.get_boosted_rounds(&1) == 5))
+
+    for round <- result.history do
+      assert {mean, std} = round["test"]["rmse"]
+      assert is_float(mean) and is_float(std)
+    end
+
+    rerun = EXGBoost.cv(x, y, nfold: 3, num_boost_rounds: 5, tree_method: :hist, nthread: 1)
+    sequential =
+      EXGBoost.cv(x, y,
+        nfold: 3,
+        num_boost_rounds: 5,
+        tree_method: :hist,
+        nthread: 1,
+        max_concurrency: 1
+      )
+
+    assert rerun.history == sequential.history
+
+    # Rounds past the end of a short list keep its last rate
+    short = EXGBoost.cv(x, y, nfold: 3, num_boost_rounds: 5, learning_rates: [0.3, 0.1])
+    assert length(short.history) == 5
+  end
+
+  test "dmatrix builder", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {10, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {10})
+
+    indptr = Nx.tensor([0, 1, 3, 3, 5, 6])
+    indices = Nx.tensor([0, 1, 2, 0, 2, 1])
+    values = x[5..9] |> Nx.flatten() |> Nx.slice([0], [6])
+
+    builder =
+      DMatrix.Builder.new(3, max_rows: 8)
+      |> DMatrix.Builder.push(x[0..4], label: y[0..4])
+      |> DMatrix.Builder.push({indptr, indices, values}, label: y[5..9])
+
+    assert DMatrix.Builder.num_rows(builder) == 8
+
+    dmat = DMatrix.Builder.to_dmatrix(builder)
+    assert DMatrix.get_num_rows(dmat) == 8
+    assert DMatrix.get_num_cols(dmat) == 3
+    assert length(DMatrix.get_float_info(dmat, "label")) == 8
+
+    qdmat = DMatrix.Builder.to_quantile_dmatrix(builder, max_bin: 16)
+    assert DMatrix.get_num_rows(qdmat) == 8
+
+    booster =
+      EXGBoost.Training.train(qdmat, num_boost_rounds: 2, tree_method: :hist, max_bin: 16)
+
+    assert Booster.get_boosted_rounds(booster) == 2
+
+    # Every batch must agree on whether labels are present
+    assert catch_error(DMatrix.Builder.push(builder, x[0..1]))
+
+    # Offsets are all checked before any index is read
+    bad_indptr = Nx.tensor([0, 100, 5])
+
+    assert_raise RuntimeError, ~r/non-decreasing/, fn ->
+      DMatrix.Builder.push(builder, {bad_indptr, indices[0..4], values[0..4]}, label: y[0..1])
+    end
+  end
+
+  test "dmatrix from coo" do
+    rows = Nx.tensor([2, 0, 1, 0, 2, 2])
+    cols = Nx.tensor([1, 0, 2, 0, 0, 1])
+    values = Nx.tensor([1.0, 2.0, 3.0, 4.0, 5.0, 6.0])
+
+    dmat = DMatrix.from_coo(rows, cols, values, {3, 3}, label: Nx.tensor([0.0, 1.0, 0.0]))
+    assert DMatrix.get_num_rows(dmat) == 3
+    assert DMatrix.get_num_cols(dmat) == 3
+    assert DMatrix.get_data(dmat) == {[0, 1, 2, 4], [0, 2, 0, 1], [6.0, 3.0, 5.0, 7.0]}
+
+    # Signed labels are kept exactly, not wrapped or truncated
+    DMatrix.set_params(dmat, label: Nx.tensor([-1, 2, -3], type: :s64))
+    assert EXGBoost.NIF.dmatrix_get_float_info(dmat.ref, "label") == {:ok, [-1.0, 2.0, -3.0]}
+
+    assert_raise ArgumentError, ~r/c64/, fn ->
+      DMatrix.set_params(dmat, weight: Nx.tensor([1, 2, 3], type: :c64))
+    end
+
+    {indptr, indices, csr_values} =
+      DMatrix.coo_to_csr(rows, cols, values, {3, 3}, duplicates: :last)
+
+    assert Nx.to_list(indptr) == [0, 1, 2, 4]
+    assert Nx.to_list(indices) == [0, 2, 0, 1]
+    assert Nx.to_list(csr_values) == [4.0, 3.0, 5.0, 6.0]
+
+    assert_raise RuntimeError, ~r/too large/, fn ->
+      DMatrix.coo_to_csr(rows, cols, values, {2 ** 64 - 1, 3})
+    end
+
+    assert_raise RuntimeError, ~r/u32/, fn ->
+      DMatrix.from_coo(rows, cols, values, {3, 2 ** 32})
+    end
+
+    booster = EXGBoost.Training.train(dmat, num_boost_rounds: 2, tree_method: :hist)
+    preds = EXGBoost.inplace_predict(booster, {:coo, rows, cols, values, {3, 3}})
+    assert Nx.shape(preds) == {3}
+  end
+
+  test "dmatrix auto format" do
+    nan = :nan
+
+    sparse =
+      Nx.tensor([
+        [1.0, nan, nan, nan, nan],
+        [nan, nan, 2.0, nan, nan],
+        [nan, nan, nan, nan, nan],
+        [nan, 3.0, nan, nan, nan]
+      ])
+
+    dmat = DMatrix.from_tensor(sparse, format: :auto)
+    assert dmat.format == :csr
+    assert DMatrix.get_num_rows(dmat) == 4
+    assert DMatrix.get_num_cols(dmat) == 5
+    assert DMatrix.get_data(dmat) == {[0, 1, 2, 2, 3], [0, 2, 1], [1.0, 2.0, 3.0]}
+
+    dense = Nx.iota({4, 5}, type: :f32)
+    assert DMatrix.from_tensor(dense, format: :auto).format == :dense
+
+    tall =
+      Nx.broadcast(Nx.Constants.nan(), {100, 2})
+      |> Nx.put_slice([7, 1], Nx.tensor([[5.0]]))
+    dmat = DMatrix.from_tensor(tall, format: :auto)
+    assert dmat.format == :csc
+    assert DMatrix.get_num_rows(dmat) == 100
+    assert DMatrix.get_num_non_missing(dmat) == 1
+
+    booster = EXGBoost.train(dense, Nx.tensor([0.0, 1.0, 0.0, 1.0]), num_boost_rounds: 2)
+    preds = EXGBoost.inplace_predict(booster, sparse, format: :auto)
+    assert Nx.shape(preds) == {4}
+    assert Nx.all_close(preds, EXGBoost.predict(booster, sparse)) |> Nx.to_number() == 1
+    assert Nx.all_close(preds, EXGBoost.inplace_predict(booster, sparse)) |> Nx.to_number() == 1
+  end
+
+  test "native memory", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {20, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {20})
+    dmat = DMatrix.from_tensor(x, y, format: :dense)
+    assert DMatrix.memory(dmat) == 8 * 80 + 12 * 20
+
+    booster = EXGBoost.Training.train(dmat, num_boost_rounds: 3)
+    {:ok, serialized} = EXGBoost.NIF.booster_serialize_to_buffer(booster.ref)
+    assert Booster.memory(booster) == byte_size(serialized)
+
+    assert EXGBoost.native_memory() >= DMatrix.memory(dmat) + Booster.memory(booster)
+  end
+
+  test "explicit free", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {20, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {20})
+    dmat = DMatrix.from_tensor(x, y, format: :dense)
+    booster = EXGBoost.Training.train(dmat, num_boost_rounds: 2)
+
+    assert DMatrix.free(dmat) == :ok
+    assert DMatrix.free(dmat) == :ok
+    assert DMatrix.memory(dmat) == 0
+    assert catch_error(DMatrix.get_num_rows(dmat))
+
+    assert Booster.free(booster) == :ok
+    assert catch_error(Booster.get_boosted_rounds(booster))
+  end
+
+  test "native training loop", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    lrs = [0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1]
+
+    opts = [
+      num_boost_rounds: 10,
+      early_stopping_rounds: 2,
+      evals: [{x, y, "train"}, {x, y, "valid"}],
+      learning_rates: lrs,
+      tree_method: :hist,
+      eval_metric: [:rmse, :mae]
+    ]
+
+    {native, output} = ExUnit.CaptureIO.with_io(fn -> EXGBoost.train(x, y, opts) end)
+
+    # A no-op callback forces the Elixir training loop
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+
+    {elixir, _} =
+      ExUnit.CaptureIO.with_io(fn -> EXGBoost.train(x, y, [callbacks: [noop]] ++ opts) end)
+
+    assert output =~ "Iteration 1: "
+    assert output =~ ~s("valid" => %{"mae" => )
+    assert native.best_iteration == elixir.best_iteration
+    assert_in_delta native.best_score, elixir.best_score, 1.0e-6
+    assert EXGBoost.Booster.get_attr(native, "best_iteration") == "#{native.best_iteration}"
+
+    preds = EXGBoost.predict(native, x)
+    assert Nx.all_close(preds, EXGBoost.predict(elixir, x)) |> Nx.to_number() == 1
+  end
+
+  test "early stopping minimizes mape", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.uniform(new_key, 1, 2, shape: {50})
+
+    booster =
+      EXGBoost.train(x, y,
+        num_boost_rounds: 8,
+        early_stopping_rounds: 8,
+        evals: [{x, y, "train"}],
+        eval_metric: [:mape],
+        verbose_eval: false
+      )
+
+    %{metrics: %{"train" => %{"mape" => mape}}} = EXGBoost.Booster.eval_history(booster)
+    assert_in_delta booster.best_score, mape |> Nx.reduce_min() |> Nx.to_number(), 1.0e-6
+
+    # The Elixir training loop picks the same round
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+
+    elixir =
+      EXGBoost.train(x, y,
+        num_boost_rounds: 8,
+        early_stopping_rounds: 8,
+        evals: [{x, y, "train"}],
+        eval_metric: [:mape],
+        verbose_eval: false,
+        callbacks: [noop]
+      )
+
+    assert elixir.best_iteration == booster.best_iteration
+    refute EXGBoost.Training.maximize_metric?("mape")
+    assert EXGBoost.Training.maximize_metric?("ndcg@5")
+  end
+
+  test "non-finite metrics", context do
+    {x, _new_key} = Nx.Random.normal(context.key, 0, 1, shape: {30, 3})
+    # MAPE divides by the labels, so all-zero labels make it non-finite
+    y = Nx.broadcast(0.0, {30})
+    opts = [num_boost_rounds: 4, early_stopping_rounds: 1, eval_metric: [:mape]]
+
+    native = EXGBoost.train(x, y, [evals: [{x, y, "train"}], verbose_eval: false] ++ opts)
+    assert native.best_iteration == nil
+
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+
+    elixir =
+      EXGBoost.train(
+        x,
+        y,
+        [evals: [{x, y, "train"}], verbose_eval: false, callbacks: [noop]] ++ opts
+      )
+
+    assert elixir.best_iteration == nil
+
+    result = EXGBoost.cv(x, y, [nfold: 3, verbose_eval: false] ++ opts)
+    assert result.best_iteration == nil
+    assert [%{"test" => %{"mape" => {:nan, :nan}}} | _] = result.history
+  end
+
+  test "custom objective", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+
+    # Squared error, so the result should match the builtin objective
+    squared_error = fn preds, _dmat ->
+      {Nx.subtract(preds, y), Nx.broadcast(Nx.tensor(1.0, type: :f32), Nx.shape(preds))}
+    end
+
+    opts = [num_boost_rounds: 5, tree_method: :exact, base_score: 0.0]
+    custom = EXGBoost.train(x, y, [obj: squared_error] ++ opts)
+    builtin = EXGBoost.train(x, y, [objective: :reg_squarederror] ++ opts)
+
+    preds = EXGBoost.predict(custom, x, output_margin: true)
+    assert Nx.all_close(preds, EXGBoost.predict(builtin, x)) |> Nx.to_number() == 1
+  end
+
+  test "native objectives", context do
+    {x, _new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    y = Nx.greater(x[[.., 0]], 0)
+
+    opts = [
+      num_boost_rounds: 5,
+      tree_method: :exact,
+      objective: :binary_logistic,
+      base_score: 0.5
+    ]
+
+    builtin = EXGBoost.train(x, y, opts)
+    native = EXGBoost.train(x, y, [obj: {:native, :smooth_logloss, []}] ++ opts)
+
+    # A no-op callback forces the per-round Booster.update path
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+    per_round_opts = [obj: {:native, :smooth_logloss, []}, callbacks: [noop]]
+    per_round = EXGBoost.train(x, y, per_round_opts ++ opts)
+
+    preds = EXGBoost.predict(builtin, x)
+    assert Nx.all_close(preds, EXGBoost.predict(native, x)) |> Nx.to_number() == 1
+    assert Nx.all_close(preds, EXGBoost.predict(per_round, x)) |> Nx.to_number() == 1
+
+    focal = EXGBoost.train(x, y, [obj: {:native, :focal, gamma: 2.0, alpha: 0.25}] ++ opts)
+    assert EXGBoost.predict(focal, x) |> Nx.shape() == {50}
+
+    assert catch_error(EXGBoost.train(x, y, [obj: {:native, :focal, gamma: -1}] ++ opts))
+    assert catch_error(EXGBoost.train(x, y, [obj: {:native, :unknown, []}] ++ opts))
+  end
+
+  test "eval history", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+
+    booster =
+      EXGBoost.train(x, y,
+        num_boost_rounds: 5,
+        evals: [{x, y, "train"}],
+        eval_metric: [:rmse, :mae],
+        verbose_eval: false
+      )
+
+    %{iterations: iterations, metrics: %{"train" => %{"rmse" => rmse, "mae" => mae}}} =
+      EXGBoost.Booster.eval_history(booster)
+
+    assert Nx.to_flat_list(iterations) == [1, 2, 3, 4, 5]
+    assert Nx.shape(rmse) == {5}
+    assert Nx.shape(mae) == {5}
+
+    dmat = EXGBoost.DMatrix.from_tensor(x, y, format: :dense)
+    [{"train", "rmse", value}, {"train", "mae", _}] =
+      EXGBoost.Booster.eval_set(booster, [{dmat, "train"}], 5)
+
+    assert_in_delta value, Nx.to_number(rmse[4]), 1.0e-6
+    assert EXGBoost.Booster.eval_history(booster).iterations |> Nx.size() == 6
+    assert EXGBoost.Booster.eval_history(EXGBoost.Booster.booster(dmat)) == nil
+  end
+
+  test "checkpoint and resume", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    dir = Path.join(System.tmp_dir!(), "exgboost_ckpt_#{System.unique_integer([:positive])}")
+    on_exit(fn -> File.rm_rf!(dir) end)
+
+    opts = [evals: [{x, y, "train"}], verbose_eval: false, seed: 0]
+
+    checkpoint = [path: dir, every: 2, keep: 2]
+    EXGBoost.train(x, y, [num_boost_rounds: 6, checkpoint: checkpoint] ++ opts)
+    assert File.ls!(dir) |> Enum.sort() == ["checkpoint-4.bin", "checkpoint-6.bin"]
+
+    resumed = EXGBoost.train(x, y, [num_boost_rounds: 8, resume_from: dir] ++ opts)
+    straight = EXGBoost.train(x, y, [num_boost_rounds: 8] ++ opts)
+
+    assert EXGBoost.Booster.get_boosted_rounds(resumed) == 8
+    assert Nx.all_close(EXGBoost.predict(resumed, x), EXGBoost.predict(straight, x))
+           |> Nx.to_number() == 1
+
+    assert EXGBoost.Booster.get_attr(resumed, "exgboost_checkpoint") == :error
+
+    # Checkpoints holding funs are refused
+    meta_vars = %{fun: fn -> :ok end}
+    state = %{iteration: 1, meta_vars: meta_vars, best_iteration: nil, best_score: nil}
+    encoded = state |> :erlang.term_to_binary() |> Base.encode64()
+    EXGBoost.Booster.set_attr(straight, exgboost_checkpoint: encoded)
+    file = Path.join(dir, "checkpoint-9.bin")
+    File.write!(file, EXGBoost.NIF.booster_serialize_to_buffer(straight.ref) |> elem(1))
+
+    assert_raise ArgumentError, ~r/functions/, fn ->
+      EXGBoost.train(x, y, [num_boost_rounds: 10, resume_from: file] ++ opts)
+    end
+  end
+
+  test "training telemetry", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    parent = self()
+    handler_id = {__MODULE__, :telemetry, make_ref()}
+    summary_id = {__MODULE__, :summary, make_ref()}
+
+    :telemetry.attach_many(
+      handler_id,
+      [[:exgboost, :training, :iteration, :stop], [:exgboost, :training, :summary]],
+      # Handlers are global, so ignore training done by other tests
+      fn event, measurements, metadata, _ ->
+        if self() == parent, do: send(parent, {event, measurements, metadata})
+      end,
+      nil
+    )
+
+    EXGBoost.Telemetry.attach_summary(summary_id)
+
+    on_exit(fn ->
+      :telemetry.detach(handler_id)
+      EXGBoost.Telemetry.detach_summary(summary_id)
+    end)
+
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+    opts = [num_boost_rounds: 3, evals: [{x, y, "train"}], verbose_eval: false]
+
+    # The native loop and the callback loop report the same events
+    for extra_opts <- [[], [callbacks: [noop]]] do
+      EXGBoost.train(x, y, opts ++ extra_opts)
+
+      for iteration <- 1..3 do
+        assert_receive {[:exgboost, :training, :iteration, :stop], measurements,
+                        %{iteration: ^iteration}}
+
+        assert measurements.trees_added == 1
+        assert measurements.num_trees == iteration
+        assert measurements.rss > 0
+        assert measurements.duration >= measurements.update + measurements.eval
+      end
+
+      assert_receive {[:exgboost, :training, :summary], %{rounds: 3, p50: p50, p99: p99}, _}
+      assert p50 <= p99
+    end
+  end
+
+  test "tuning", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {60, 4})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {60})
+    opts = [evals: [{x, y, "valid"}], eval_metric: :rmse, max_concurrency: 2]
+
+    grid = EXGBoost.Tuning.search(x, y, [max_depth: [2, 4], learning_rate: [0.1, 0.3]], opts)
+    scores = Enum.map(grid.leaderboard, & &1.score)
+    assert grid.trials == 4
+    assert scores == Enum.sort(scores)
+    assert Booster.get_boosted_rounds(grid.best.booster) == 10
+    assert Enum.all?(tl(grid.leaderboard), &is_nil(&1.booster))
+    assert grid.trials_per_hour > 0
+    # Without early stopping trials are scored on their last round
+    assert grid.best.best_iteration == grid.best.rounds
+    assert Booster.get_best_iteration(grid.best.booster) == :error
+
+    assert_raise ArgumentError, ~r/native :obj/, fn ->
+      EXGBoost.Tuning.search(x, y, [max_depth: [2]], [obj: &Function.identity/1] ++ opts)
+    end
+
+    assert_raise ArgumentError, ~r/:max_bin can't be searched/, fn ->
+      EXGBoost.Tuning.search(x, y, [max_bin: [16, 32]], opts)
+    end
+
+    space = [max_depth: [2, 3, 4], learning_rate: [0.1, 0.2, 0.3]]
+    halving_opts = [strategy: :successive_halving, num_boost_rounds: 9] ++ opts
+    halving = EXGBoost.Tuning.search(x, y, space, halving_opts)
+
+    assert halving.trials == 9
+    assert Enum.map(halving.leaderboard, & &1.rounds) == [9, 3, 3, 1, 1, 1, 1, 1, 1]
+    assert Booster.get_boosted_rounds(halving.best.booster) == 9
+
+    random =
+      EXGBoost.Tuning.search(
+        x,
+        y,
+        [max_depth: {:int, 2, 4}, learning_rate: {:log_uniform, 0.05, 0.5}],
+        [strategy: :hyperband, num_boost_rounds: 9] ++ opts
+      )
+
+    assert random.best.rounds == 9
+    assert Enum.all?(random.leaderboard, &(&1.params[:max_depth] in 2..4))
+  end
+
+  test "booster cache", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    boosters = Map.new(1..3, &{&1, EXGBoost.train(x, y, num_boost_rounds: &1 + 1)})
+    buffers = Map.new(boosters, fn {id, booster} -> {id, Booster.save(booster, to: :buffer)} end)
+    max_memory = buffers |> Map.values() |> Enum.map(&byte_size/1) |> Enum.max()
+    cache = :"booster_cache_#{System.unique_integer([:positive])}"
+
+    start_supervised!(
+      {EXGBoost.BoosterCache,
+       name: cache,
+       loader: fn id -> if buffer = buffers[id], do: {:buffer, buffer} end,
+       max_memory: max_memory}
+    )
+
+    booster = EXGBoost.BoosterCache.fetch(cache, 1)
+    assert EXGBoost.predict(booster, x) == EXGBoost.predict(boosters[1], x)
+    assert EXGBoost.BoosterCache.fetch(cache, 1) == booster
+
+    1..8
+    |> Task.async_stream(fn _i -> EXGBoost.BoosterCache.fetch(cache, 3) end)
+    |> Enum.each(fn {:ok, _booster} -> :ok end)
+
+    refute EXGBoost.BoosterCache.cached?(cache, 1)
+    assert EXGBoost.BoosterCache.cached?(cache, 3)
+    assert_raise ArgumentError, fn -> EXGBoost.BoosterCache.fetch(cache, 4) end
+
+    stats = EXGBoost.BoosterCache.stats(cache)
+    assert %{boosters: 1, hits: hits, misses: misses, loads: 2, evictions: 1} = stats
+    assert hits + misses == 11
+    assert stats.memory <= max_memory
+  end
+
+  test "registry", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    old = EXGBoost.train(x, y, num_boost_rounds: 2)
+    new = EXGBoost.train(x, y, num_boost_rounds: 6)
+    path = Path.join(System.tmp_dir!(), "exgboost_registry_#{System.unique_integer([:positive])}")
+    EXGBoost.write_model(new, path, format: :ubj)
+    registry = :"registry_#{System.unique_integer([:positive])}"
+    start_supervised!({EXGBoost.Registry, name: registry, keep: 2})
+
+    try do
+      EXGBoost.Registry.put(registry, :model, 1, old)
+      EXGBoost.Registry.load(registry, :model, 2, path <> ".ubj", warmup: x)
+      assert {2, _booster} = EXGBoost.Registry.lookup(registry, :model)
+      assert EXGBoost.Registry.predict(registry, :model, x) == EXGBoost.predict(new, x)
+      assert EXGBoost.Registry.versions(registry, :model) == [2, 1]
+
+      assert EXGBoost.Registry.rollback(registry, :model) == 1
+      assert EXGBoost.Registry.predict(registry, :model, x) == EXGBoost.predict(old, x)
+      assert_raise ArgumentError, fn -> EXGBoost.Registry.rollback(registry, :model) end
+      assert_raise ArgumentError, fn -> EXGBoost.Registry.put(registry, :model, 1, old) end
+      assert_raise ArgumentError, fn -> EXGBoost.Registry.load(registry, :model, 3, "missing") end
+
+      EXGBoost.Registry.put(registry, :model, 3, new, publish: false)
+      assert EXGBoost.Registry.versions(registry, :model) == [3, 1]
+      assert {1, _booster} = EXGBoost.Registry.lookup(registry, :model)
+    after
+      File.rm(path <> ".ubj")
+    end
+  end
+
+  test "load mmap", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    booster = EXGBoost.train(x, y, num_boost_rounds: 5)
+    path = Path.join(System.tmp_dir!(), "exgboost_mmap_#{System.unique_integer([:positive])}")
+    EXGBoost.write_model(booster, path, format: :ubj)
+    path = path <> ".ubj"
+    parent = self()
+    handler = fn _event, measurements, _metadata, _config -> send(parent, measurements) end
+    :telemetry.attach("load-mmap-test", [:exgboost, :booster, :load], handler, nil)
+
+    try do
+      loaded = Booster.load_mmap(path)
+      assert EXGBoost.predict(loaded, x) == EXGBoost.predict(booster, x)
+      size = File.stat!(path).size
+      assert_receive %{size: ^size, duration: duration, peak_rss: peak_rss}
+      assert duration >= 0 and peak_rss > 0
+      assert_raise ArgumentError, fn -> Booster.load_mmap(path <> ".missing") end
+    after
+      :telemetry.detach("load-mmap-test")
+      File.rm(path)
+    end
+  end
+
+  test "train many", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {200, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {200})
+    param_sets = for alpha <- [0.1, 0.5, 0.9], do: [quantile_alpha: alpha]
+
+    boosters =
+      EXGBoost.train_many(x, y, param_sets,
+        objective: :reg_quantileerror,
+        num_boost_rounds: 5,
+        evals: [{x, y, "train"}],
+        verbose_eval: false
+      )
+
+    assert length(boosters) == 3
+    assert Enum.all?(boosters, &(Booster.get_boosted_rounds(&1) == 5))
+
+    [low, mid, high] =
+      Enum.map(boosters, &(EXGBoost.predict(&1, x) |> Nx.mean() |> Nx.to_number()))
+
+    assert low < mid and mid < high
+
+    assert_raise ArgumentError, ~r/binning params/, fn ->
+      EXGBoost.train_many(x, y, [[max_bin: 16], [max_bin: 32]])
+    end
+
+    assert_raise ArgumentError, ~r/tree_method/, fn ->
+      EXGBoost.train_many(x, y, [[tree_method: :auto]])
+    end
+  end
+
+  test "goss", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {200, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {200})
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+    opts = [num_boost_rounds: 5, tree_method: :hist, goss: [top_rate: 0.2, other_rate: 0.3]]
+    booster = EXGBoost.train(x, y, opts)
+    assert Booster.get_boosted_rounds(booster) == 5
+    preds = EXGBoost.predict(booster, x)
+    # Rows are drawn from the seed and the round, whichever loop runs them
+    assert EXGBoost.predict(EXGBoost.train(x, y, [callbacks: [noop]] ++ opts), x) == preds
+    refute EXGBoost.predict(EXGBoost.train(x, y, put_in(opts[:goss][:seed], 1)), x) == preds
+
+    labels = Nx.greater(y, 0)
+    booster = EXGBoost.train(x, labels, objective: :binary_logistic, goss: true)
+    assert Booster.get_boosted_rounds(booster) == 10
+
+    assert_raise ArgumentError, fn ->
+      EXGBoost.train(x, y, objective: :reg_pseudohubererror, goss: true)
+    end
+  end
+
+  test "cancellation", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    token = EXGBoost.CancelToken.new()
+    refute EXGBoost.CancelToken.cancelled?(token)
+    :ok = EXGBoost.CancelToken.cancel(token)
+    assert EXGBoost.CancelToken.cancelled?(token)
+
+    assert_raise RuntimeError, "Cancelled", fn ->
+      EXGBoost.train(x, y, num_boost_rounds: 5, cancel: token)
+    end
+
+    noop = EXGBoost.Training.Callback.new(:after_iteration, & &1, :noop)
+
+    assert_raise RuntimeError, "Cancelled", fn ->
+      EXGBoost.train(x, y, num_boost_rounds: 5, cancel: token, callbacks: [noop])
+    end
+
+    booster = EXGBoost.train(x, y, num_boost_rounds: 5)
+    preds = EXGBoost.predict(booster, x)
+    assert EXGBoost.predict(booster, x, chunk_rows: 7) == preds
+
+    assert_raise RuntimeError, "Cancelled", fn ->
+      EXGBoost.predict(booster, x, chunk_rows: 7, cancel: token)
+    end
+
+    pid = spawn(fn -> receive do: (:stop -> :ok) end)
+    token = EXGBoost.CancelToken.new(pid)
+    refute EXGBoost.CancelToken.cancelled?(token)
+    ref = Process.monitor(pid)
+    send(pid, :stop)
+    assert_receive {:DOWN, ^ref, :process, ^pid, :normal}
+    assert EXGBoost.CancelToken.cancelled?(token)
+  end
+
+  test "cpu budget", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    parent = self()
+    handler = fn _event, measurements, _metadata, _config -> send(parent, measurements) end
+    :telemetry.attach("cpu-budget-test", [:exgboost, :cpu_budget], handler, nil)
+    :ok = EXGBoost.CPUBudget.set(2)
+
+    try do
+      assert EXGBoost.CPUBudget.get() == 2
+      %{calls: calls} = EXGBoost.CPUBudget.stats()
+      EXGBoost.CPUBudget.measure()
+      assert_receive %{utilization: +0.0, budget: 2}
+
+      1..3
+      |> Task.async_stream(fn _ -> EXGBoost.train(x, y, num_boost_rounds: 5) end)
+      |> Enum.each(fn {:ok, booster} -> assert Booster.get_boosted_rounds(booster) == 5 end)
+
+      assert EXGBoost.CPUBudget.stats().calls >= calls + 15
+      EXGBoost.CPUBudget.measure()
+      assert_receive %{utilization: utilization, calls: new_calls}
+      assert utilization > 0 and new_calls >= 15
+    after
+      :telemetry.detach("cpu-budget-test")
+      EXGBoost.CPUBudget.set(0)
+    end
+  end
+
+  test "refresh and continue", context do
+    {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {50, 3})
+    {y, new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    {y_new, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {50})
+    booster = EXGBoost.train(x, y, num_boost_rounds: 4, tree_method: :hist)
+    trees = Booster.get_dump(booster) |> Enum.map(&Regex.replace(~r/leaf=[-\d.e]+/, &1, ""))
+    before = EXGBoost.predict(booster, x)
+
+    dmat = EXGBoost.DMatrix.from_tensor(x, y_new, format: :dense)
+    assert ^booster = Booster.refresh(booster, dmat)
+    assert Booster.get_boosted_rounds(booster) == 4
+    refreshed = Booster.get_dump(booster) |> Enum.map(&Regex.replace(~r/leaf=[-\d.e]+/, &1, ""))
+    assert refreshed == trees
+    assert EXGBoost.predict(booster, x) != before
+
+    # A failed replay puts the refreshed trees back
+    refreshed = EXGBoost.predict(booster, x)
+    unlabeled = EXGBoost.DMatrix.from_tensor(x, format: :dense)
+    assert_raise RuntimeError, fn -> Booster.refresh(booster, unlabeled) end
+    assert Booster.get_boosted_rounds(booster) == 4
+    assert EXGBoost.predict(booster, x) == refreshed
+
+    continued = Booster.continue(booster, dmat, num_boost_rounds: 3)
+    assert continued.ref == booster.ref
+    assert Booster.get_boosted_rounds(continued) == 7
+
+    evals = [{x, y_new, "valid"}]
+    continued = EXGBoost.train(x, y_new, booster: booster, num_boost_rounds: 2, evals: evals)
+    assert Booster.get_boosted_rounds(continued) == 9
+  end
+
+  if Code.ensure_loaded?(:peer) do
+    test "collective training", context do
+      {x, new_key} = Nx.Random.normal(context.key, 0, 1, shape: {40, 3})
+      {y, _new_key} = Nx.Random.normal(new_key, 0, 1, shape: {40})
+      tracker = EXGBoost.Collective.start_tracker(2)
+      args = EXGBoost.Collective.worker_args(tracker)
+      code_path = Enum.flat_map(:code.get_path(), &[~c"-pa", &1])
+
+      code = """
+      EXGBoost.Collective.run(args, fn ->
+        booster = EXGBoost.train(x, y, num_boost_rounds: 3, tree_method: :hist)
+        {EXGBoost.Collective.rank(), EXGBoost.predict(booster, all) |> Nx.to_flat_list()}
+      end)
+      """
+
+      results =
+        [0..19, 20..39]
+        |> Enum.map(fn rows ->
+          Task.async(fn ->
+            {:ok, peer, _node} = :peer.start_link(%{connection: :standard_io, args: code_path})
+            binding = [args: args, x: x[rows], y: y[rows], all: x]
+
+            try do
+              {result, _binding} = :peer.call(peer, Code, :eval_string, [code, binding], 60_000)
+              result
+            after
+              :peer.stop(peer)
+            end
+          end)
+        end)
+        |> Task.await_many(60_000)
+
+      assert :ok = EXGBoost.Collective.wait_tracker(tracker, 10_000)
+      assert [{0, preds}, {1, preds}] = Enum.sort(results)
+      assert length(preds) == 40
+    end
+  end
+
+  test "categorical encoder" do
+    alias EXGBoost.CategoricalEncoder
+
+    merchants = ["a", "b", "a", "c", nil, "b"]
+    skus = ["x", "x", "y", "y", "z", "z"]
+
+    encoder = CategoricalEncoder.fit([merchants, skus])
+    assert CategoricalEncoder.num_categories(encoder) == [3, 3]
+    assert CategoricalEncoder.categories(encoder) == [["a", "b", "c"], ["x", "y", "z"]]
+
+    x = CategoricalEncoder.transform(encoder, [merchants, skus])
+    assert Nx.shape(x) == {6, 2}
+    assert Nx.to_list(x[[.., 1]]) == [0.0, 0.0, 1.0, 1.0, 2.0, 2.0]
+    assert Nx.to_number(x[[4, 0]]) == :nan
+
+    unknown = CategoricalEncoder.transform(encoder, [["d"], ["x"]])
+    assert Nx.to_list(unknown) == [[:nan, 0.0]]
+
+    strict = %{encoder | unknown: :error}
+    assert catch_error(CategoricalEncoder.transform(strict, [["d"], ["x"]]))
+
+    y = Nx.tensor([0, 1, 0, 1, 0, 1])
+    booster = EXGBoost.train(x, y, num_boost_rounds: 2, tree_method: :hist)
+    booster = CategoricalEncoder.put_in_booster(encoder, booster)
+
+    restored =
+      booster
+      |> EXGBoost.dump_model()
+      |> EXGBoost.load_model()
+      |> CategoricalEncoder.from_booster()
+
+    assert CategoricalEncoder.categories(restored) == CategoricalEncoder.categories(encoder)
+    assert CategoricalEncoder.transform(restored, [merchants, skus]) == x
+  end
+
   test "eval with multiple metrics", context do
     nrows = :rand.uniform(10)
     ncols = :rand.uniform(10)
@@ -130,6 +130,11 @@ defmodule NifTest do
              :error
   end
 
+  test "dense scans reject a zero-width shape" do
+    assert {:error, _} = EXGBoost.NIF.dense_to_csr(<<>>, 2 ** 62, 0, nil)
+    assert {:error, _} = EXGBoost.NIF.dmatrix_create_from_dense_auto(<<>>, 0, 2 ** 62, nil, "{}")
+  end
+
   test "test_dmatrix_set_str_feature_info" do
     mat = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])
     array_interface = from_tensor(mat) |> Jason.encode!()
@@ -228,6 +233,39 @@ defmodule NifTest do
            ) != :ok
   end
 
+  test "dmatrix_set_dense_info" do
+    mat = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])
+    array_interface = from_tensor(mat) |> Jason.encode!()
+
+    config = Jason.encode!(%{"missing" => -1.0})
+
+    dmat =
+      EXGBoost.NIF.dmatrix_create_from_dense(array_interface, config)
+      |> unwrap!()
+
+    labels = Nx.tensor([1.0, 0.0], type: :f32) |> Nx.to_binary()
+    weights = Nx.tensor([0.5, 2.0], type: :f64) |> Nx.to_binary()
+
+    assert EXGBoost.NIF.dmatrix_set_dense_info(dmat, "label", labels, 2, 1) == :ok
+    assert EXGBoost.NIF.dmatrix_get_float_info(dmat, "label") |> unwrap!() == [1.0, 0.0]
+
+    assert EXGBoost.NIF.dmatrix_set_dense_info_list(dmat, [
+             {"label", labels, 1},
+             {"weight", weights, 2}
+           ]) == :ok
+
+    assert EXGBoost.NIF.dmatrix_get_float_info(dmat, "weight") |> unwrap!() == [0.5, 2.0]
+
+    {status, _e} = EXGBoost.NIF.dmatrix_set_dense_info(dmat, "label", labels, 3, 1)
+    assert status == :error
+
+    {status, _e} = EXGBoost.NIF.dmatrix_set_dense_info(dmat, "label", labels, 2, 5)
+    assert status == :error
+
+    {status, _e} = EXGBoost.NIF.dmatrix_set_dense_info_list(dmat, [{"bogus", labels, 1}])
+    assert status == :error
+  end
+
   test "dmatrix_save_binary" do
     mat = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])
     array_interface = from_tensor(mat) |> Jason.encode!()
@@ -316,6 +354,39 @@ defmodule NifTest do
     assert status == :error
   end
 
+  test "dmatrix_folds" do
+    mat = Nx.iota({6, 2}, type: :f32)
+    array_interface = from_tensor(mat) |> Jason.encode!()
+
+    config = Jason.encode!(%{"missing" => -1.0})
+
+    dmat =
+      EXGBoost.NIF.dmatrix_create_from_dense(array_interface, config)
+      |> unwrap!()
+
+    label_interface = from_tensor(Nx.tensor([0.0, 1.0, 0.0, 1.0, 0.0, 1.0])) |> Jason.encode!()
+    EXGBoost.NIF.dmatrix_set_info_from_interface(dmat, 'label', label_interface)
+
+    folds = EXGBoost.NIF.dmatrix_folds(dmat, 3, 42, 0, 0) |> unwrap!()
+    assert length(folds) == 3
+
+    for {train, test} <- folds do
+      assert EXGBoost.NIF.dmatrix_num_row(train) |> unwrap!() == 4
+      assert EXGBoost.NIF.dmatrix_num_row(test) |> unwrap!() == 2
+    end
+
+    for {_train, test} <- EXGBoost.NIF.dmatrix_folds(dmat, 3, 42, 1, 0) |> unwrap!() do
+      labels = EXGBoost.NIF.dmatrix_get_float_info(test, "label") |> unwrap!()
+      assert Enum.sort(labels) == [0.0, 1.0]
+    end
+
+    {status, _e} = EXGBoost.NIF.dmatrix_folds(dmat, 7, 42, 0, 0)
+    assert status == :error
+
+    {status, _e} = EXGBoost.NIF.dmatrix_folds(dmat, 1, 42, 0, 0)
+    assert status == :error
+  end
+
   test "booster_create" do
     mat = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])
     mat2 = Nx.tensor([[1.0, 2.0, 3.0], [4.0, 5.0, 6.0]])